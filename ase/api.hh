@@ -181,6 +181,8 @@ public:
   virtual PropertyS   access_properties () = 0;             ///< Retrieve handles for all properties.
   Value               get_value         (String ident);     ///< Get native property value.
   bool                set_value         (String ident, const Value &v); ///< Set native property value.
+  ValueR              get_values        (const StringS &idents); ///< Get native values of several properties.
+  virtual bool        set_values        (const ValueR &values); ///< Set native values of several properties at once.
   /// Assign session data, prefix ephemerals with '_'.
   virtual bool        set_data          (const String &key, const Value &v) = 0;
   /// Retrieve session data.
@@ -212,6 +214,8 @@ public:
   virtual bool       is_active     () = 0;      ///< Check whether this is the active synthesis engine project.
   virtual DeviceInfo device_info   () = 0;      ///< Describe this Device type.
   void               remove_self   ();          ///< Remove device from its container.
+  virtual bool       set_sidechain (TrackP source) = 0; ///< Feed the output of track `source` into the secondary input bus, `nullptr` disconnects.
+  virtual TrackP     get_sidechain () = 0;      ///< Retrieve the track connected to the secondary input bus.
   // GUI handling
   virtual void       gui_toggle    () = 0;      ///< Toggle GUI display.
   virtual bool       gui_supported () = 0;      ///< Has GUI display facilities.
@@ -267,6 +271,15 @@ public:
   virtual DeviceP         access_device       () = 0;                ///< Retrieve Device handle for this track.
   virtual MonitorP        create_monitor      (int32 ochannel) = 0;  /// Create signal monitor for an output channel.
   virtual TelemetryFieldS telemetry           () const = 0;          ///< Retrieve track telemetry locations.
+  virtual bool            frozen              () const = 0;          ///< Flag set if the track output is rendered into a cached recording.
+  virtual void            frozen              (bool onoff) = 0;
+  virtual double          volume              () const = 0;          ///< Linear gain of the track output fader.
+  virtual void            volume              (double gain) = 0;
+  virtual bool            set_send            (TrackP bus, double level, bool prefader) = 0; ///< Mix the track output into the input of `bus`, `level == 0` removes the send.
+  virtual double          send_level          (TrackP bus) const = 0; ///< Level at which the track output is sent to `bus`.
+  virtual bool            send_prefader       (TrackP bus) const = 0; ///< Flag set if the send to `bus` taps the signal before the volume fader.
+  virtual bool            live_input          () const = 0;          ///< Flag set if the track receives live MIDI input, other tracks may be rendered ahead of time.
+  virtual void            live_input          (bool onoff) = 0;
 };
 
 /// Bits representing a selection of probe sample data features.
@@ -285,8 +298,9 @@ public:
   virtual int64   get_mix_freq       () = 0;            ///< Mix frequency at which monitor values are calculated.
   virtual int64   get_frame_duration () = 0;            ///< Frame duration in µseconds for the calculation of monitor values.
   //int64         get_shm_offset     (MonitorField fld);  ///< Offset into shared memory for MonitorField values of `ochannel`.
-  //void          set_probe_features (ProbeFeatures pf);  ///< Configure probe features.
-  //ProbeFeatures get_probe_features ();                  ///< Get configured probe features.
+  virtual void          set_probe_features (ProbeFeatures pf) = 0; ///< Configure probe features.
+  virtual ProbeFeatures get_probe_features () = 0;                 ///< Get configured probe features.
+  virtual TelemetryFieldS telemetry        () const = 0;           ///< Retrieve monitor telemetry locations.
 };
 
 /// Projects support loading, saving, playback and act as containers for all other sound objects.
@@ -325,6 +339,9 @@ struct Resource {
   String       uri;             ///< Unique resource identifier.
   int64        size = 0;        ///< Resource size.
   int64        mtime = 0;       ///< Modification time in milliseconds.
+  int64        n_frames = 0;    ///< Number of audio frames, if known.
+  int32        sample_rate = 0; ///< Audio sample rate, if known.
+  int32        n_channels = 0;  ///< Number of audio channels, if known.
 };
 
 /// Helper to crawl hierarchical resources.
@@ -337,6 +354,16 @@ public:
   virtual Resource  canonify       (const String &utf8cwd, const String &utf8fragment, bool constraindir, bool constrainfile) = 0;
 };
 
+/// Index of audio sample folders, crawled and updated in the background.
+class SampleLibrary : public virtual Object {
+public:
+  virtual bool      indexing      () = 0;                       ///< Indicates whether library folders are being crawled.
+  virtual int64     count_entries (const String &utf8dir) = 0;  ///< Count indexed entries of a folder.
+  /// List `count` indexed entries of a folder, starting at `offset`, folders first.
+  virtual ResourceS list_entries  (const String &utf8dir, int64 offset, int64 count) = 0;
+  virtual ResourceS search        (const String &query, int64 count) = 0; ///< Find up to `count` files by fuzzy name matching.
+};
+
 /// Contents of user interface notifications.
 struct UserNote {
   enum Flags { APPEND, CLEAR, TRANSIENT };
@@ -380,6 +407,7 @@ public:
   // Browsing
   ResourceCrawlerP dir_crawler    (const String &cwd = "");  ///< Create crawler to navigate directories.
   ResourceCrawlerP url_crawler    (const String &url = "/"); ///< Create crawler to navigate URL contents.
+  SampleLibraryP   sample_library ();                        ///< Access the index of sample library folders.
 };
 #define ASE_SERVER      (::Ase::Server::instance())
 
@@ -0,0 +1,739 @@
+// This Source Code Form is licensed MPL-2.0: http://mozilla.org/MPL/2.0
+#include "audioclip.hh"
+#include "processor.hh"
+#include "signalmath.hh"
+#include "datautils.hh"
+#include "resampler.hh"
+#include "platform.hh"
+#include "internal.hh"
+#include <numeric>
+#include "external/libsndfile/include/sndfile.h"
+
+#define ADEBUG(...)     Ase::debug ("audioclip", __VA_ARGS__)
+
+namespace Ase {
+
+static constexpr uint FILL_FRAMES = 8192;       // frames read per stream and prefetch pass
+
+static inline void
+deinterleave (const float *stereo, float *left, float *right, uint n_frames)
+{
+  for (uint i = 0; i < n_frames; i++)
+    {
+      left[i] = stereo[2 * i];
+      right[i] = stereo[2 * i + 1];
+    }
+}
+
+// == AudioClipStream::Reader ==
+/// File state owned by the prefetch thread.
+struct AudioClipStream::Reader {
+  SNDFILE           *sndfile = nullptr;
+  uint               serial = 0;        // last acknowledged request
+  uint               load = 0;          // load() that opened sndfile
+  uint               n_channels = 0;
+  int64              fill_frame = 0;    // file frame at wpos_
+  std::vector<float> buffer;
+  // resampling to the stream rate
+  PolyphaseResampler resampler;
+  bool               resampling = false;
+  uint               up = 1, down = 1;  // reduced output and input rates
+  int64              in_frames = 0;     // file length in input frames
+  int64              in_frame = 0;      // next input frame fed to resampler
+  uint               skip = 0;          // resampler output to discard after seek()
+  std::vector<float> ibuffer, obuffer;  // interleaved stereo resampler input and output
+  uint               opos = 0, oend = 0; // unread frames in obuffer
+  static constexpr uint RESAMPLE_FRAMES = 1024;
+  ~Reader()
+  {
+    if (sndfile)
+      sf_close (sndfile);
+  }
+  uint
+  read_file (float *stereo, uint n_frames)
+  {
+    buffer.resize (n_frames * n_channels);
+    const sf_count_t r = sf_readf_float (sndfile, buffer.data(), n_frames);
+    const uint rch = n_channels > 1;
+    for (sf_count_t i = 0; i < r; i++)
+      {
+        stereo[2 * i] = buffer[i * n_channels];
+        stereo[2 * i + 1] = buffer[i * n_channels + rch];
+      }
+    return std::max (sf_count_t (0), r);
+  }
+  /// Position reading at `frame` of the stream rate, returns false if seeking failed.
+  bool
+  seek (int64 frame)
+  {
+    if (!resampling)
+      return sf_seek (sndfile, frame, SEEK_SET) >= 0;
+    // restart at an output frame where the resampler phase is 0 and discard the
+    // filter delay, so seeks reproduce the output of sequential reading
+    const uint delay = resampler.delay();
+    const int64 out0 = frame - frame % up, pre = delay + (down - 2 * delay % down) % down;
+    in_frame = out0 / up * down - pre;
+    skip = (pre + delay) / down * up + (frame - out0);
+    resampler.reset();
+    opos = oend = 0;
+    return in_frame >= in_frames || sf_seek (sndfile, std::max (in_frame, int64 (0)), SEEK_SET) >= 0;
+  }
+  /// Read `n_frames` at the stream rate, returns the number of frames read.
+  uint
+  read (float *stereo, uint n_frames)
+  {
+    return_unless (resampling, read_file (stereo, n_frames));
+    uint i = 0;
+    while (i < n_frames)
+      {
+        if (opos < oend)
+          {
+            const uint k = std::min (n_frames - i, oend - opos);
+            fast_copy (2 * k, stereo + 2 * i, obuffer.data() + 2 * opos);
+            opos += k;
+            i += k;
+            continue;
+          }
+        // feed the resampler, zeros pad the file start and flush the filter after the end
+        ibuffer.resize (2 * RESAMPLE_FRAMES);
+        obuffer.resize (2 * resampler.max_output (RESAMPLE_FRAMES));
+        floatfill (ibuffer.data(), 0.0, ibuffer.size());
+        const uint z = std::clamp (-in_frame, int64 (0), int64 (RESAMPLE_FRAMES));
+        if (in_frame + z < in_frames)
+          {
+            const uint n = std::min (int64 (RESAMPLE_FRAMES - z), in_frames - in_frame - z);
+            const uint r = read_file (ibuffer.data() + 2 * z, n);
+            if (r < n)
+              in_frames = in_frame + z + r;     // truncated or unreadable
+          }
+        in_frame += RESAMPLE_FRAMES;
+        oend = resampler.process (RESAMPLE_FRAMES, ibuffer.data(), obuffer.data());
+        opos = std::min (skip, oend);
+        skip -= opos;
+      }
+    return i;
+  }
+  void
+  open (AudioClipStream &s, uint pathquark)
+  {
+    if (sndfile)
+      sf_close (sndfile);
+    sndfile = nullptr;
+    n_channels = 0;
+    s.n_frames_ = 0;
+    s.head_frames_ = 0;
+    s.sample_rate_ = 0;
+    const String path = CString::temp_quark_impl (pathquark);
+    return_unless (!path.empty());
+    SF_INFO info = {};
+    sndfile = sf_open (path.c_str(), SFM_READ, &info);
+    if (!sndfile || info.channels < 1 || info.frames <= 0 || info.samplerate <= 0)
+      {
+        ADEBUG ("%s: failed to open: %s", path, sf_strerror (sndfile));
+        if (sndfile)
+          sf_close (sndfile);
+        sndfile = nullptr;
+        return;
+      }
+    if (!s.ring_)
+      {
+        s.ring_ = new float[2 * RING_FRAMES] ();
+        s.head_ = new float[2 * HEAD_FRAMES] ();
+      }
+    n_channels = info.channels;
+    s.sample_rate_ = info.samplerate;
+    s.n_frames_ = info.frames;
+    const uint rate = info.samplerate, stream_rate = s.stream_rate_;
+    resampling = stream_rate && rate != stream_rate && resampler.setup (rate, stream_rate, 2, PolyphaseResampler::MEDIUM);
+    if (resampling)
+      {
+        up = stream_rate / std::gcd (rate, stream_rate);
+        down = rate / std::gcd (rate, stream_rate);
+        in_frames = info.frames;
+        s.n_frames_ = (in_frames * up + down - 1) / down;
+        seek (0);
+      }
+    else if (stream_rate && rate != stream_rate)
+      ADEBUG ("%s: unsupported sample rate conversion: %d -> %d", path, rate, stream_rate);
+    s.head_frames_ = read (s.head_, std::min (int64 (HEAD_FRAMES), s.n_frames_));
+    ADEBUG ("%s: frames=%d rate=%d channels=%d", path, info.frames, info.samplerate, info.channels);
+  }
+  /// Handle requests and read ahead, returns if any work was done.
+  bool
+  service (AudioClipStream &s)
+  {
+    s.wakeup_ = false;
+    bool busy = false;
+    const uint req_serial = s.req_serial_.load (std::memory_order_acquire);
+    if (req_serial != serial)
+      {
+        const uint req_file = s.req_file_.load (std::memory_order_relaxed);
+        const uint req_load = s.req_load_.load (std::memory_order_relaxed);
+        const int64 req_frame = s.req_frame_.load (std::memory_order_relaxed);
+        if (req_load != load)   // also reopens a file that was unloaded and loaded again
+          {
+            load = req_load;
+            open (s, req_file);
+          }
+        fill_frame = std::min (std::max (req_frame, int64 (s.head_frames_)), s.n_frames_);
+        if (sndfile && fill_frame < s.n_frames_ && !seek (fill_frame))
+          fill_frame = s.n_frames_;
+        s.base_frame_ = fill_frame;
+        s.base_pos_ = s.wpos_.load (std::memory_order_relaxed);
+        serial = req_serial;
+        s.ack_serial_.store (serial, std::memory_order_release);
+        busy = true;
+      }
+    return_unless (sndfile && fill_frame < s.n_frames_, busy);
+    const uint64 wpos = s.wpos_.load (std::memory_order_relaxed);
+    const uint64 used = wpos - s.rpos_.load (std::memory_order_acquire);
+    return_unless (RING_FRAMES - used >= FILL_FRAMES, busy);
+    const uint offset = wpos & (RING_FRAMES - 1);
+    const uint n = std::min (std::min (FILL_FRAMES, RING_FRAMES - offset), uint (std::min (s.n_frames_ - fill_frame, int64 (FILL_FRAMES))));
+    const uint r = read (s.ring_ + 2 * offset, n);
+    if (r == 0)                 // truncated or unreadable, stop reading ahead
+      fill_frame = s.n_frames_;
+    fill_frame += r;
+    s.wpos_.store (wpos + r, std::memory_order_release);
+    return true;
+  }
+};
+
+// == AudioClipStreamer ==
+/// Prefetch thread which keeps the rings of all AudioClipStream objects filled.
+class AudioClipStreamer {
+  std::mutex                     mutex_;
+  std::vector<AudioClipStreamP>  streams_;
+  std::vector<AudioClipCaptureP> captures_;
+  ScopedSemaphore                sem_;
+  std::thread                   *thread_ = nullptr;
+  void
+  run()
+  {
+    this_thread_set_name ("AudioClipStream");
+    std::vector<AudioClipStreamP> streams, closed;
+    std::vector<AudioClipCaptureP> captures;
+    for (;;)
+      {
+        {
+          std::lock_guard<std::mutex> locker (mutex_);
+          for (auto &s : streams_)
+            if (s->closed_)
+              closed.push_back (s);
+          std::erase_if (streams_, [] (const AudioClipStreamP &s) { return s->closed_.load(); });
+          std::erase_if (captures_, [] (const AudioClipCaptureP &c) { return !c->writer_; });
+          streams.assign (streams_.begin(), streams_.end());
+          captures.assign (captures_.begin(), captures_.end());
+        }
+        closed.clear(); // close files outside of mutex_
+        bool busy = false;
+        for (auto &c : captures)        // finish captures before streams might read them
+          busy |= c->drain();
+        for (auto &s : streams)
+          busy |= s->reader_->service (*s);
+        streams.clear();
+        captures.clear();
+        if (!busy)
+          sem_.wait();
+      }
+  }
+  void
+  start_L()
+  {
+    if (!thread_)
+      thread_ = new std::thread (&AudioClipStreamer::run, this);
+  }
+public:
+  static AudioClipStreamer&
+  the()
+  {
+    static AudioClipStreamer *streamer = new AudioClipStreamer();
+    return *streamer;
+  }
+  void
+  add (AudioClipStreamP stream)
+  {
+    std::lock_guard<std::mutex> locker (mutex_);
+    streams_.push_back (stream);
+    start_L();
+  }
+  void
+  add (AudioClipCaptureP capture)
+  {
+    std::lock_guard<std::mutex> locker (mutex_);
+    captures_.push_back (capture);
+    start_L();
+  }
+  /// Wake up the prefetch thread, lock-free, may be called from the engine thread.
+  void
+  wakeup()
+  {
+    sem_.post();
+  }
+};
+
+// == AudioClipStream ==
+AudioClipStream::AudioClipStream (uint stream_rate) :
+  stream_rate_ (stream_rate), reader_ (std::make_unique<Reader>())
+{}
+
+AudioClipStream::~AudioClipStream ()
+{
+  reader_.reset();
+  delete[] ring_;
+  delete[] head_;
+}
+
+/// Create a stream and register it with the prefetch thread.
+/// Files are resampled to `stream_rate` while prefetching, a `stream_rate` of 0 keeps the file rate.
+AudioClipStreamP
+AudioClipStream::create (uint stream_rate)
+{
+  AudioClipStreamP stream = AudioClipStream::make_shared (stream_rate);
+  AudioClipStreamer::the().add (stream);
+  return stream;
+}
+
+/// Unregister from the prefetch thread, the file is closed asynchronously.
+void
+AudioClipStream::close ()
+{
+  closed_ = true;
+  AudioClipStreamer::the().wakeup();
+}
+
+void
+AudioClipStream::wakeup ()
+{
+  if (!wakeup_.exchange (true))
+    AudioClipStreamer::the().wakeup();
+}
+
+void
+AudioClipStream::request (uint file, int64 frame)
+{
+  want_frame_ = frame;
+  req_file_.store (file, std::memory_order_relaxed);
+  req_frame_.store (frame, std::memory_order_relaxed);
+  req_serial_.store (++serial_, std::memory_order_release);
+  synced_ = false;
+  wakeup();
+}
+
+/// Adopt the ring position of an acknowledged request, returns if no request is pending.
+bool
+AudioClipStream::sync ()
+{
+  return_unless (!synced_, true);
+  return_unless (ack_serial_.load (std::memory_order_acquire) == serial_, false);
+  read_frame_ = base_frame_;
+  rpos_.store (base_pos_, std::memory_order_release); // skip stale frames
+  synced_ = true;
+  loaded_ = file_ != 0;
+  return true;
+}
+
+/// Check if all load() and cue() requests have been handled, may be called from the engine thread.
+bool
+AudioClipStream::ready ()
+{
+  return sync();
+}
+
+/// Start streaming the file given as CString quark, may be called from the engine thread.
+void
+AudioClipStream::load (uint pathquark)
+{
+  return_unless (pathquark != file_);
+  file_ = pathquark;
+  loaded_ = false;
+  req_load_.store (++load_, std::memory_order_relaxed);
+  request (file_, 0);
+}
+
+/// Make sure read-ahead covers `frame`, may be called from the engine thread.
+void
+AudioClipStream::cue (int64 frame)
+{
+  return_unless (file_);
+  sync();
+  if (loaded_)
+    {
+      frame = std::max (frame, int64 (head_frames_)); // head_ is resident
+      return_unless (frame < n_frames_);
+    }
+  const int64 start = synced_ ? read_frame_ : want_frame_;
+  if (frame < start || frame >= start + RING_FRAMES / 2)
+    request (file_, frame);
+}
+
+/// Render `n_frames` from file position `frame`, returns less than `n_frames` for underruns.
+/// Missing frames are rendered silent, this never blocks, allocates or performs I/O.
+uint
+AudioClipStream::render (int64 frame, uint n_frames, float *left, float *right)
+{
+  floatfill (left, 0.0, n_frames);
+  floatfill (right, 0.0, n_frames);
+  return_unless (file_, n_frames);
+  sync();
+  uint i = frame < 0 ? std::min (-frame, int64 (n_frames)) : 0;
+  while (i < n_frames && loaded_)
+    {
+      const int64 f = frame + i;
+      if (f >= n_frames_)
+        {
+          i = n_frames;         // silence past the end
+          break;
+        }
+      const uint todo = std::min (int64 (n_frames - i), n_frames_ - f);
+      if (f < head_frames_)
+        {
+          const uint k = std::min (todo, uint (head_frames_ - f));
+          deinterleave (head_ + 2 * f, left + i, right + i, k);
+          i += k;
+          cue (f + k);
+          continue;
+        }
+      if (!synced_ || f < read_frame_ || f >= read_frame_ + RING_FRAMES / 2)
+        {
+          cue (f);
+          break;
+        }
+      uint64 rpos = rpos_.load (std::memory_order_relaxed);
+      const uint64 avail = wpos_.load (std::memory_order_acquire) - rpos;
+      const uint64 skip = f - read_frame_;
+      if (skip >= avail)
+        break;                  // prefetching lags behind
+      rpos += skip;
+      uint k = std::min (uint64 (todo), avail - skip);
+      read_frame_ = f + k;
+      while (k)
+        {
+          const uint offset = rpos & (RING_FRAMES - 1);
+          const uint l = std::min (k, RING_FRAMES - offset);
+          deinterleave (ring_ + 2 * offset, left + i, right + i, l);
+          rpos += l;
+          i += l;
+          k -= l;
+        }
+      rpos_.store (rpos, std::memory_order_release);
+    }
+  if (synced_ && loaded_)
+    {
+      const uint64 avail = wpos_.load (std::memory_order_relaxed) - rpos_.load (std::memory_order_relaxed);
+      if (avail < RING_FRAMES / 2 && read_frame_ + int64 (avail) < n_frames_)
+        wakeup();
+    }
+  if (i < n_frames)
+    underruns_.fetch_add (1, std::memory_order_relaxed);
+  return i;
+}
+
+// == AudioClipCapture ==
+AudioClipCapture::AudioClipCapture (const String &filename, WaveWriterP writer) :
+  writer_ (writer), filename_ (filename)
+{
+  ring_ = new float[2 * RING_FRAMES] ();
+}
+
+AudioClipCapture::~AudioClipCapture ()
+{
+  if (writer_)
+    writer_->close();
+  delete[] ring_;
+}
+
+/// Create a 32bit float WAV file for recording and register it with the prefetch thread.
+AudioClipCaptureP
+AudioClipCapture::create (const String &filename, uint sample_rate)
+{
+  WaveWriterP writer = wave_writer_create_wav (sample_rate, 2, filename);
+  return_unless (writer, nullptr);
+  AudioClipCaptureP capture = AudioClipCapture::make_shared (filename, writer);
+  AudioClipStreamer::the().add (capture);
+  return capture;
+}
+
+/// Queue `n_frames` for writing, frames are dropped if the disk cannot keep up.
+void
+AudioClipCapture::write (const float *left, const float *right, uint n_frames)
+{
+  uint64 wpos = wpos_.load (std::memory_order_relaxed);
+  const uint64 used = wpos - rpos_.load (std::memory_order_acquire);
+  if (used + n_frames > RING_FRAMES)
+    {
+      failed_ = true;
+      return;
+    }
+  for (uint i = 0; i < n_frames; i++, wpos++)
+    {
+      const uint offset = wpos & (RING_FRAMES - 1);
+      ring_[2 * offset] = left[i];
+      ring_[2 * offset + 1] = right[i];
+    }
+  wpos_.store (wpos, std::memory_order_release);
+  if (used + n_frames >= RING_FRAMES / 4 && !wakeup_.exchange (true))
+    AudioClipStreamer::the().wakeup();
+}
+
+/// Mark the recording as complete, may be called from the engine thread.
+void
+AudioClipCapture::complete ()
+{
+  complete_ = true;
+  AudioClipStreamer::the().wakeup();
+}
+
+/// Mark the recording as complete but unusable, may be called from the engine thread.
+void
+AudioClipCapture::discard ()
+{
+  failed_ = true;
+  complete();
+}
+
+/// Stop recording, pending frames are written and the file is closed asynchronously.
+void
+AudioClipCapture::finish ()
+{
+  finished_ = true;
+  AudioClipStreamer::the().wakeup();
+}
+
+bool
+AudioClipCapture::drain ()
+{
+  wakeup_ = false;
+  const bool finished = finished_;
+  uint64 rpos = rpos_.load (std::memory_order_relaxed);
+  const uint64 wpos = wpos_.load (std::memory_order_acquire);
+  bool busy = false;
+  while (rpos < wpos && writer_)
+    {
+      const uint offset = rpos & (RING_FRAMES - 1);
+      const uint n = std::min (wpos - rpos, uint64 (RING_FRAMES - offset));
+      if (!writer_->write (ring_ + 2 * offset, n))
+        failed_ = true;
+      rpos += n;
+      busy = true;
+    }
+  rpos_.store (wpos, std::memory_order_release);
+  if (finished && writer_)
+    {
+      if (!writer_->close())
+        failed_ = true;
+      writer_ = nullptr;
+      closed_ = true;
+      busy = true;
+    }
+  return busy;
+}
+
+// == AudioClipPlayer ==
+/// Audio file player, streams its clip from disk in sync with the transport.
+class AudioClipPlayer : public AudioProcessor {
+  static constexpr int64 MAX_DRIFT = 2; // frames, tolerance for tick rounding
+  OBusId           stereout_;
+  AudioClipStreamP stream_;
+  int64            position_ = 0;
+  int              start_bar_ = 1;
+  float            gain_ = 1.0;
+  bool             playing_ = false;
+  enum Params { FILE = 1, START, GAIN };
+public:
+  AudioClipPlayer (const ProcessorSetup &psetup) :
+    AudioProcessor (psetup), stream_ (AudioClipStream::create (sample_rate()))
+  {}
+  ~AudioClipPlayer()
+  {
+    stream_->close();
+  }
+  static void
+  static_info (AudioProcessorInfo &info)
+  {
+    info.version      = "1";
+    info.label        = "Audio Clip";
+    info.category     = "Generators";
+    info.website_url  = "https://anklang.testbit.eu";
+  }
+  void
+  initialize (SpeakerArrangement busses) override
+  {
+    remove_all_buses();
+    stereout_ = add_output_bus ("Stereo Out", SpeakerArrangement::STEREO);
+
+    ParameterMap pmap;
+
+    pmap.group = _("Audio Clip");
+    pmap[FILE] = Param { "file", _("Audio File"), _("File"), "", "", {}, "", { String ("blurb=") + _("Audio file streamed from disk"), } };
+    pmap[START] = Param { "start", _("Start Bar"), _("Start"), 1, "", { 1, 9999, }, };
+    pmap[GAIN] = Param { "gain", _("Gain"), _("Gain"), 0, "dB", { -96, 24, }, };
+
+    install_params (pmap);
+  }
+  void
+  adjust_param (uint32_t tag) override
+  {
+    switch (Params (tag))
+      {
+      case FILE:        stream_->load (irintf (get_param (tag)));       break;
+      case START:       start_bar_ = irintf (get_param (tag));         break;
+      case GAIN:        gain_ = db2voltage (get_param (tag));           break;
+      }
+  }
+  void
+  reset (uint64 target_stamp) override
+  {
+    playing_ = false;
+    adjust_all_params();
+  }
+  void
+  render (uint n_frames) override
+  {
+    float *left = oblock (stereout_, 0), *right = oblock (stereout_, 1);
+    const AudioTransport &transport = this->transport();
+    const int64 start_tick = transport.tick_sig.bar_to_tick (start_bar_ - 1);
+    const int64 position = transport.sample_from_tick (transport.current_tick) - transport.sample_from_tick (start_tick);
+    if (!transport.running())
+      {
+        playing_ = false;
+        stream_->cue (position);        // prefetch for the next start
+        floatfill (left, 0.0, n_frames);
+        floatfill (right, 0.0, n_frames);
+        return;
+      }
+    if (!playing_ || std::abs (position - position_) > MAX_DRIFT)
+      position_ = position;             // transport jumped
+    playing_ = true;
+    stream_->render (position_, n_frames, left, right);
+    position_ += n_frames;
+    if (gain_ != 1.0)
+      for (uint i = 0; i < n_frames; i++)
+        {
+          left[i] *= gain_;
+          right[i] *= gain_;
+        }
+  }
+};
+
+static auto audioclip_player = register_audio_processor<AudioClipPlayer> ("Ase::AudioClipPlayer");
+
+} // Ase
+
+// == Tests ==
+#include "testing.hh"
+#include "path.hh"
+
+namespace { // Anon
+using namespace Ase;
+
+static uint
+render_waiting (AudioClipStream &stream, int64 frame, uint n_frames, float *left, float *right)
+{
+  uint r = 0;
+  for (size_t i = 0; i < 5000 && r < n_frames; i++)
+    {
+      r = stream.render (frame, n_frames, left, right);
+      if (r < n_frames)
+        usleep (1000);
+    }
+  return r;
+}
+
+TEST_INTEGRITY (audioclip_stream_tests);
+static void
+audioclip_stream_tests()
+{
+  const char *tmpdir = getenv ("TMPDIR");
+  const String filename = Path::join (tmpdir ? tmpdir : "/tmp", string_format ("audioclip-%u.wav", getpid()));
+  const uint N = AudioClipStream::HEAD_FRAMES + 3 * AudioClipStream::RING_FRAMES + 777;
+  auto sample = [] (int64 i) { return float (i % 4096) / 4096; };
+  std::vector<float> samples (N);
+  for (uint i = 0; i < N; i++)
+    samples[i] = sample (i);
+  WaveWriterP wavewriter = wave_writer_create_wav (48000, 1, filename);
+  TASSERT (wavewriter && wavewriter->write (samples.data(), N) && wavewriter->close());
+  AudioClipStreamP stream = AudioClipStream::create();
+  constexpr uint B = 256;
+  float left[B], right[B];
+  auto check = [&] (int64 frame) {
+    const uint r = render_waiting (*stream, frame, B, left, right);
+    TCMP (r, ==, B);
+    for (uint i = 0; i < B; i++)
+      {
+        const float v = frame + i >= 0 && frame + i < N ? sample (frame + i) : 0;
+        TCMP (left[i], ==, v);
+        TCMP (right[i], ==, v);
+      }
+  };
+  stream->load (CString::temp_quark_impl (CString (filename)));
+  check (-100);                                         // pre-roll, served from head
+  TCMP (stream->n_frames(), ==, N);
+  TCMP (stream->sample_rate(), ==, 48000u);
+  for (int64 f = 0; f < 3 * AudioClipStream::RING_FRAMES; f += B)      // sequential play through ring wraps
+    check (f);
+  check (AudioClipStream::HEAD_FRAMES - 100);           // head to ring transition after seek
+  check (N - 100);                                      // end of file
+  check (N + 1000);                                     // silence past the end
+  check (1000);                                         // jump back into head
+  unlink (filename.c_str());
+  // record stereo frames and stream them back
+  const uint M = AudioClipCapture::RING_FRAMES / 2;
+  AudioClipCaptureP capture = AudioClipCapture::create (filename, 48000);
+  TASSERT (capture != nullptr);
+  for (uint f = 0; f < M; f += B)
+    capture->write (samples.data() + f, samples.data() + f, B);
+  capture->complete();
+  capture->finish();
+  for (size_t i = 0; i < 5000 && !capture->closed(); i++)
+    usleep (1000);
+  TASSERT (capture->closed() && capture->completed() && !capture->failed());
+  stream->load (0);
+  stream->load (CString::temp_quark_impl (CString (filename)));
+  for (int64 f : { 0, 1000, int (AudioClipStream::HEAD_FRAMES + 100), int (M - B) })
+    {
+      const uint r = render_waiting (*stream, f, B, left, right);
+      TCMP (r, ==, B);
+      TCMP (stream->n_frames(), ==, M);
+      for (uint i = 0; i < B; i++)
+        TCMP (right[i], ==, sample (f + i));
+    }
+  stream->close();
+  unlink (filename.c_str());
+  // files are resampled to the stream rate, seeking matches sequential reading
+  const uint R = 44100, Q = AudioClipStream::HEAD_FRAMES + AudioClipStream::RING_FRAMES;
+  const double freq = 997;
+  for (uint i = 0; i < Q; i++)
+    samples[i] = 0.5 * std::sin (2 * M_PI * freq * i / R);
+  wavewriter = wave_writer_create_wav (R, 1, filename);
+  TASSERT (wavewriter && wavewriter->write (samples.data(), Q) && wavewriter->close());
+  AudioClipStreamP resampled = AudioClipStream::create (48000);
+  resampled->load (CString::temp_quark_impl (CString (filename)));
+  render_waiting (*resampled, 0, B, left, right);
+  TCMP (resampled->sample_rate(), ==, R);
+  const int64 S = (int64 (Q) * 48000 + R - 1) / R;
+  TCMP (resampled->n_frames(), ==, S);
+  std::vector<float> sequential (S);
+  for (int64 f = 0; f < S; f += B)
+    {
+      const uint r = render_waiting (*resampled, f, B, left, right);
+      TCMP (r, ==, B);
+      std::copy (left, left + std::min (int64 (B), S - f), &sequential[f]);
+    }
+  const double offset = 0.5 / (48000 / std::gcd (R, 48000u)) / R; // fractional group delay of the resampler
+  double max_error = 0;
+  for (int64 f = 64; f < S - 64; f++)
+    max_error = std::max (max_error, std::abs (sequential[f] - 0.5 * std::sin (2 * M_PI * freq * (f / 48000.0 + offset))));
+  TCMP (max_error, <, 0.001);
+  for (int64 f : { int64 (AudioClipStream::HEAD_FRAMES + 1234), S / 2 + 77, int64 (AudioClipStream::HEAD_FRAMES + 100), S - B })
+    {
+      const uint r = render_waiting (*resampled, f, B, left, right);
+      TCMP (r, ==, B);
+      for (uint i = 0; i < B && f + i < S; i++)
+        TCMP (left[i], ==, sequential[f + i]);
+    }
+  resampled->close();
+  unlink (filename.c_str());
+}
+
+} // Anon
@@ -0,0 +1,88 @@
+// This Source Code Form is licensed MPL-2.0: http://mozilla.org/MPL/2.0
+#ifndef __ASE_AUDIOCLIP_HH__
+#define __ASE_AUDIOCLIP_HH__
+
+#include <ase/wave.hh>
+#include <atomic>
+
+namespace Ase {
+
+/// Stereo audio file stream, filled from disk by a shared prefetch thread.
+class AudioClipStream {
+  struct Reader;
+  // prefetch thread, published with ack_serial_
+  float                *ring_ = nullptr;        // RING_FRAMES interleaved stereo frames
+  float                *head_ = nullptr;        // HEAD_FRAMES interleaved stereo frames
+  int64                 n_frames_ = 0;
+  int64                 base_frame_ = 0;
+  uint64                base_pos_ = 0;
+  uint                  head_frames_ = 0;
+  uint                  sample_rate_ = 0;
+  const uint            stream_rate_ = 0;       // frames are resampled to this rate, unless 0
+  // engine thread <-> prefetch thread
+  std::atomic<uint64>   wpos_ { 0 }, rpos_ { 0 };
+  std::atomic<uint>     req_serial_ { 0 }, ack_serial_ { 0 }, req_file_ { 0 }, req_load_ { 0 };
+  std::atomic<int64>    req_frame_ { 0 };
+  std::atomic<uint64>   underruns_ { 0 };
+  std::atomic<bool>     wakeup_ { false }, closed_ { false };
+  // engine thread
+  int64                 read_frame_ = 0;        // file frame at rpos_
+  int64                 want_frame_ = 0;        // pending request position
+  uint                  serial_ = 0;
+  uint                  file_ = 0;
+  uint                  load_ = 0;              // counts load() calls, so reloads reopen the file
+  bool                  loaded_ = false;        // header, head_ and n_frames_ are valid
+  bool                  synced_ = false;        // ring_ is positioned at read_frame_
+  std::unique_ptr<Reader> reader_;
+  friend class AudioClipStreamer;
+  explicit AudioClipStream  (uint stream_rate);
+  bool     sync             ();
+  void     request          (uint file, int64 frame);
+  void     wakeup           ();
+public:
+  static constexpr uint RING_FRAMES = 65536;    ///< Read-ahead per stream, must be a power of 2.
+  static constexpr uint HEAD_FRAMES = 32768;    ///< Frames of the file start kept resident for instant (re-)starts.
+  /*dtor*/ ~AudioClipStream ();
+  static AudioClipStreamP create (uint stream_rate = 0);
+  void     close            ();
+  // engine thread API
+  void     load             (uint pathquark);
+  void     cue              (int64 frame);
+  uint     render           (int64 frame, uint n_frames, float *left, float *right);
+  bool     ready            ();
+  int64    n_frames         () const    { return loaded_ ? n_frames_ : 0; }     ///< Number of frames at the stream rate (once loaded).
+  uint     sample_rate      () const    { return loaded_ ? sample_rate_ : 0; }  ///< Sampling rate of the file (once loaded).
+  uint64   underruns        () const    { return underruns_.load (std::memory_order_relaxed); } ///< Count render() calls that lacked data.
+  ASE_DEFINE_MAKE_SHARED (AudioClipStream);
+};
+
+/// Stereo WAV file recorder, written to disk by the AudioClipStream prefetch thread.
+class AudioClipCapture {
+  float                *ring_ = nullptr;        // RING_FRAMES interleaved stereo frames
+  WaveWriterP           writer_;
+  String                filename_;
+  std::atomic<uint64>   wpos_ { 0 }, rpos_ { 0 };
+  std::atomic<bool>     wakeup_ { false }, failed_ { false }, complete_ { false }, finished_ { false }, closed_ { false };
+  friend class AudioClipStreamer;
+  explicit AudioClipCapture (const String &filename, WaveWriterP writer);
+  bool     drain            ();
+public:
+  static constexpr uint RING_FRAMES = 131072;   ///< Write-behind buffer, must be a power of 2.
+  /*dtor*/ ~AudioClipCapture ();
+  static AudioClipCaptureP create (const String &filename, uint sample_rate);
+  String   filename         () const    { return filename_; }                   ///< Name of the file being written.
+  // engine thread API
+  void     write            (const float *left, const float *right, uint n_frames);
+  void     complete         ();
+  void     discard          ();
+  // main thread API
+  bool     completed        () const    { return complete_; }                   ///< Check if complete() was called.
+  bool     failed           () const    { return failed_; }                     ///< Check if frames were dropped or discard() was called.
+  void     finish           ();
+  bool     closed           () const    { return closed_; }                     ///< Check if the file was closed after finish().
+  ASE_DEFINE_MAKE_SHARED (AudioClipCapture);
+};
+
+} // Ase
+
+#endif // __ASE_AUDIOCLIP_HH__
@@ -12,9 +12,14 @@
 #include "internal.hh"
 #include "gtk2wrap.hh"
 #include <clap/ext/draft/file-reference.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
 #include <dlfcn.h>
 #include <glob.h>
 #include <math.h>
+#include <poll.h>
+#include <spawn.h>
+#include <fcntl.h>
 
 #define CDEBUG(...)          Ase::debug ("clap", __VA_ARGS__)
 #define CDEBUG_ENABLED()     Ase::debug_key_enabled ("clap")
@@ -218,6 +223,72 @@ union ClapEventUnion {
   clap_event_midi2_t           midi2;         // CLAP_NOTE_DIALECT_MIDI2
 };
 
+// == ClapEventView ==
+/// Time ordered clap_input_events_t view of note events and enqueued parameter events.
+struct ClapEventView {
+  std::vector<const clap_event_header_t*> params;
+  std::vector<const clap_event_header_t*> events;
+  const clap_input_events_t clap_events = {
+    .ctx = (ClapEventView*) this,
+    .size = events_size,
+    .get = events_get,
+  };
+  ClapEventView (size_t n_events, size_t n_params) { reserve (n_events, n_params); }
+  ASE_CLASS_NON_COPYABLE (ClapEventView);
+  void
+  reserve (size_t n_events, size_t n_params)
+  {
+    params.reserve (n_params);
+    events.reserve (n_events + params.capacity());
+  }
+  void
+  swap (ClapEventView &other)
+  {
+    params.swap (other.params);
+    events.swap (other.events);
+  }
+  /// Merge `inputs` and the events of `queued`, does not allocate if reserve() covers both.
+  void
+  update (const ClapEventUnionS &inputs, const std::vector<ClapEventParamS*> &queued)
+  {
+    events.resize (0);
+    if (queued.empty()) {               // common case, no parameter changes
+      for (const auto &e : inputs)
+        events.push_back (&e.header);
+      return;
+    }
+    // gather parameter events in time order, insertion sort is stable and there are usually few
+    params.resize (0);
+    for (const auto &pevents : queued)
+      for (const auto &e : *pevents)
+        params.push_back (&e.header);
+    for (size_t i = 1; i < params.size(); i++)
+      for (size_t j = i; j > 0 && params[j]->time < params[j - 1]->time; j--)
+        std::swap (params[j], params[j - 1]);
+    // merge with the already sorted note events, parameter changes go first
+    size_t p = 0;
+    for (const auto &e : inputs) {
+      while (p < params.size() && params[p]->time <= e.header.time)
+        events.push_back (params[p++]);
+      events.push_back (&e.header);
+    }
+    while (p < params.size())
+      events.push_back (params[p++]);
+  }
+  static uint32_t
+  events_size (const clap_input_events *evlist)
+  {
+    ClapEventView *self = (ClapEventView*) evlist->ctx;
+    return self->events.size();
+  }
+  static const clap_event_header_t*
+  events_get (const clap_input_events *evlist, uint32_t index)
+  {
+    ClapEventView *self = (ClapEventView*) evlist->ctx;
+    return index < self->events.size() ? self->events[index] : nullptr;
+  }
+};
+
 // == ClapAudioProcessor ==
 class ClapAudioProcessor : public AudioProcessor {
   ClapPluginHandle *handle_ = nullptr;
@@ -291,6 +362,8 @@ public:
       prepare_event_input();
       input_events_.reserve (256); // avoid audio-thread allocations
     }
+    input_view_.reserve (input_events_.capacity(), params_capacity_);
+    inputs_capacity_ = input_events_.capacity();
     if (output_event_dialect & (CLAP_NOTE_DIALECT_CLAP | CLAP_NOTE_DIALECT_MIDI)) {
       prepare_event_output();
       output_events_.reserve (256); // avoid audio-thread allocations
@@ -307,37 +380,16 @@ public:
   void convert_clap_events (const clap_process_t &process, bool as_clapnotes);
   std::vector<ClapEventUnion> input_events_;
   std::vector<ClapEventUnion> output_events_;
-  static uint32_t
-  input_events_size (const clap_input_events *evlist)
-  {
-    ClapAudioProcessor *self = (ClapAudioProcessor*) evlist->ctx;
-    size_t param_events_size = 0;
-    for (const auto &pevents_b : self->enqueued_events_)
-      param_events_size += pevents_b->size();
-    return param_events_size + self->input_events_.size();
-  }
-  static const clap_event_header_t*
-  input_events_get (const clap_input_events *evlist, uint32_t index)
-  {
-    ClapAudioProcessor *self = (ClapAudioProcessor*) evlist->ctx;
-    for (const auto &pevents_b : self->enqueued_events_) {
-      if (index < pevents_b->size())
-        return &(*pevents_b)[index].header;
-      index -= pevents_b->size();
-    }
-    return index < self->input_events_.size() ? &self->input_events_[index].header : nullptr;
-  }
+  ClapEventView input_view_ { 0, 0 };   // time ordered view of enqueued_events_ and input_events_
+  size_t params_capacity_ = 256;          // parameter events input_view_ can hold, main_thread only
+  std::atomic<size_t> params_pending_ = 0;
+  std::atomic<size_t> inputs_capacity_ = 0;
   static bool
   output_events_try_push (const clap_output_events *evlist, const clap_event_header_t *event)
   {
     ClapAudioProcessor *self = (ClapAudioProcessor*) evlist->ctx;
     return event_unions_try_push (self->output_events_, event);
   }
-  const clap_input_events_t plugin_input_events = {
-    .ctx = (ClapAudioProcessor*) this,
-    .size = input_events_size,
-    .get = input_events_get,
-  };
   const clap_output_events_t plugin_output_events = {
     .ctx = (ClapAudioProcessor*) this,
     .try_push = output_events_try_push,
@@ -347,9 +399,25 @@ public:
   clap_process_t processinfo = { 0, };
   clap_event_transport_t transportinfo = { { 0, }, };
   std::vector<ClapEventParamS*> enqueued_events_;
+  /// Preallocate a larger input view in main_thread if `n_params` more parameter events would not fit.
+  ClapEventView*
+  grow_input_view (size_t n_params)
+  {
+    const size_t pending = params_pending_ += n_params;
+    return_unless (pending > params_capacity_, nullptr);
+    params_capacity_ = 2 * pending;
+    return new ClapEventView (inputs_capacity_, params_capacity_);
+  }
   void
-  enqueue_events (ClapEventParamS *pevents)
+  enqueue_events (ClapEventParamS *pevents, ClapEventView *grown)
   {
+    if (grown) {
+      if (grown->params.capacity() > input_view_.params.capacity()) {
+        input_view_.swap (*grown);
+        input_view_.reserve (input_events_.capacity(), input_view_.params.capacity()); // in case input_events_ grew meanwhile
+      }
+      main_rt_jobs += RtCall (call_delete<ClapEventView>, grown); // delete in main_thread
+    }
     // insert 0-time event list *before* other events
     if (pevents && pevents->size() && pevents->back().header.time == 0)
       for (size_t i = 0; i < enqueued_events_.size(); i++)
@@ -361,7 +429,7 @@ public:
     enqueued_events_.push_back (pevents);
   }
   bool
-  start_processing (const ClapParamInfoMap *param_info_map, const ClapParamInfoImpl *map_start, size_t map_size)
+  start_processing (const ClapParamInfoMap *param_info_map, const ClapParamInfoImpl *map_start, size_t map_size, uint latency)
   {
     return_unless (!can_process_, true);
     assert_return (clapplugin_, false);
@@ -377,7 +445,7 @@ public:
         .audio_inputs = &handle_->audio_inputs_[0], .audio_outputs = &handle_->audio_outputs_[0],
         .audio_inputs_count = uint32_t (handle_->audio_inputs_.size()),
         .audio_outputs_count = uint32_t (handle_->audio_outputs_.size()),
-        .in_events = &plugin_input_events, .out_events = &plugin_output_events,
+        .in_events = &input_view_.clap_events, .out_events = &plugin_output_events,
       };
       transportinfo = clap_event_transport_t {
         .header = clap_event_header_t {
@@ -388,6 +456,7 @@ public:
       };
       input_events_.resize (0);
       output_events_.resize (0);
+      set_latency (latency);
     }
     return can_process_;
   }
@@ -399,6 +468,7 @@ public:
     clapplugin_->stop_processing (clapplugin_);
     param_info_map_ = nullptr;
     param_info_map_start_ = nullptr;
+    set_latency (0);
     CDEBUG ("%s: %s", handle_->clapid(), __func__);
     input_events_.resize (0);
     output_events_.resize (0);
@@ -418,7 +488,7 @@ public:
     double beat_pos = trans.current_tick_d * (1.0 / TRANSPORT_PPQN);
     transportinfo.song_pos_beats      = llrint (beat_pos * CLAP_BEATTIME_FACTOR);
     transportinfo.song_pos_seconds    = llrint (sec_pos * CLAP_SECTIME_FACTOR);
-    transportinfo.tempo               = tick_sig.bpm();
+    transportinfo.tempo               = trans.bpm();
     transportinfo.tempo_inc           = 0;
     transportinfo.loop_start_beats    = 0;
     transportinfo.loop_end_beats      = 0;
@@ -436,17 +506,27 @@ public:
     const uint icount = ibusid != 0 ? this->n_ichannels (ibusid) : 0;
     if (can_process_) {
       update_transportinfo();
-      for (size_t i = 0; i < icount; i++) {
-        assert_return (processinfo.audio_inputs[imain_clapidx].channel_count == icount);
-        processinfo.audio_inputs[imain_clapidx].data32[i] = const_cast<float*> (ifloats (ibusid, i));
+      // hand out engine buffers directly, flag silent inputs so plugins may skip them
+      if (icount) {
+        clap_audio_buffer_t &ibuffer = processinfo.audio_inputs[imain_clapidx];
+        assert_return (ibuffer.channel_count == icount);
+        ibuffer.constant_mask = 0;
+        for (size_t i = 0; i < icount; i++) {
+          ibuffer.data32[i] = const_cast<float*> (ifloats (ibusid, i));
+          if (ibuffer.data32[i] == const_float_zeros)
+            ibuffer.constant_mask |= uint64_t (1) << i;
+        }
       }
       const uint ocount = obusid != 0 ? this->n_ochannels (obusid) : 0;
-      for (size_t i = 0; i < ocount; i++) {
-        assert_return (processinfo.audio_outputs[omain_clapidx].channel_count == ocount);
-        processinfo.audio_outputs[omain_clapidx].data32[i] = oblock (obusid, i);
+      if (ocount) {
+        clap_audio_buffer_t &obuffer = processinfo.audio_outputs[omain_clapidx];
+        assert_return (obuffer.channel_count == ocount);
+        for (size_t i = 0; i < ocount; i++)
+          obuffer.data32[i] = oblock (obusid, i);
       }
       processinfo.frames_count = n_frames;
       convert_clap_events (processinfo, input_preferred_dialect & CLAP_NOTE_DIALECT_CLAP);
+      input_view_.update (input_events_, enqueued_events_);
       processinfo.steady_time += processinfo.frames_count;
       const clap_process_status status = clapplugin_->process (clapplugin_, &processinfo);
       (void) status;
@@ -488,6 +568,7 @@ public:
     while (enqueued_events_.size() && (enqueued_events_[0]->empty() || enqueued_events_[0]->back().header.time < nframes)) {
       ClapEventParamS *const pevents = enqueued_events_[0];
       enqueued_events_.erase (enqueued_events_.begin());
+      params_pending_ -= pevents->size();
       for (const auto &e : *pevents)
         need_wakeup |= apply_param_value_event (e);
       main_rt_jobs += RtCall (call_delete<ClapEventParamS>, pevents); // delete in main_thread
@@ -540,8 +621,15 @@ void
 ClapAudioProcessor::convert_clap_events (const clap_process_t &process, const bool as_clapnotes)
 {
   MidiEventInput evinput = midi_event_input();
-  if (input_events_.capacity() < evinput.events_pending())
+  if (evinput.events_pending() == 0) {
+    input_events_.resize (0);
+    return;
+  }
+  if (input_events_.capacity() < evinput.events_pending()) {
     input_events_.reserve (evinput.events_pending() + 128);
+    input_view_.reserve (input_events_.capacity(), input_view_.params.capacity());
+    inputs_capacity_ = input_events_.capacity();
+  }
   input_events_.resize (evinput.events_pending());
   uint j = 0;
   for (const auto &ev : evinput)
@@ -661,6 +749,8 @@ public:
   const clap_plugin_audio_ports *plugin_audio_ports = nullptr;
   const clap_plugin_note_ports *plugin_note_ports = nullptr;
   const clap_plugin_posix_fd_support *plugin_posix_fd_support = nullptr;
+  const clap_plugin_thread_pool *plugin_thread_pool = nullptr;
+  const clap_plugin_latency *plugin_latency = nullptr;
   ClapPluginHandleImpl (const ClapPluginDescriptor &descriptor_, AudioProcessorP aproc) :
     ClapPluginHandle (descriptor_), proc_ (shared_ptr_cast<ClapAudioProcessor> (aproc))
   {
@@ -700,14 +790,13 @@ public:
     plugin_audio_ports = (const clap_plugin_audio_ports*) plugin_get_extension (CLAP_EXT_AUDIO_PORTS);
     plugin_note_ports = (const clap_plugin_note_ports*) plugin_get_extension (CLAP_EXT_NOTE_PORTS);
     plugin_posix_fd_support = (const clap_plugin_posix_fd_support*) plugin_get_extension (CLAP_EXT_POSIX_FD_SUPPORT);
+    plugin_thread_pool = (const clap_plugin_thread_pool*) plugin_get_extension (CLAP_EXT_THREAD_POOL);
     plugin_state = (const clap_plugin_state*) plugin_get_extension (CLAP_EXT_STATE);
     plugin_file_reference = (const clap_plugin_file_reference*) plugin_get_extension (CLAP_EXT_FILE_REFERENCE);
     const clap_plugin_render *plugin_render = nullptr;
     plugin_render = (const clap_plugin_render*) plugin_get_extension (CLAP_EXT_RENDER);
     (void) plugin_render;
-    const clap_plugin_latency *plugin_latency = nullptr;
     plugin_latency = (const clap_plugin_latency*) plugin_get_extension (CLAP_EXT_LATENCY);
-    (void) plugin_latency;
     const clap_plugin_tail *plugin_tail = nullptr;
     plugin_tail = (const clap_plugin_tail*) plugin_get_extension (CLAP_EXT_TAIL);
     (void) plugin_tail;
@@ -931,8 +1020,9 @@ public:
     ClapPluginHandleImplP selfp = shared_ptr_cast<ClapPluginHandleImpl> (this);
     return_unless (clap_activated(), false);
     ClapEventParamS *pevents = convert_param_updates (updates); // allocated in main_thread
-    proc_->engine().async_jobs += [selfp, pevents] () {
-      selfp->proc_->enqueue_events (pevents);
+    ClapEventView *grown = proc_->grow_input_view (pevents->size()); // allocated in main_thread
+    proc_->engine().async_jobs += [selfp, pevents, grown] () {
+      selfp->proc_->enqueue_events (pevents, grown);
     };
     return true;
   }
@@ -962,10 +1052,13 @@ public:
     CDEBUG ("%s: %s: %d", clapid(), __func__, plugin_activated);
     if (plugin_activated) {
       ClapPluginHandleImplP selfp = shared_ptr_cast<ClapPluginHandleImpl> (this);
+      // latency may only change while deactivated
+      const uint latency = plugin_latency && plugin_latency->get ? plugin_latency->get (plugin_) : 0;
+      CDEBUG ("%s: latency: %u", clapid(), latency);
       // synchronize with start_processing
       ScopedSemaphore sem;
-      proc_->engine().async_jobs += [&sem, selfp] () {
-        selfp->proc_->start_processing (&selfp->param_ids_, &selfp->param_infos_[0], selfp->param_infos_.size());
+      proc_->engine().async_jobs += [&sem, selfp, latency] () {
+        selfp->proc_->start_processing (&selfp->param_ids_, &selfp->param_infos_[0], selfp->param_infos_.size(), latency);
         sem.post();
       };
       sem.wait();
@@ -1022,6 +1115,8 @@ public:
     plugin_audio_ports_config = nullptr;
     plugin_audio_ports = nullptr;
     plugin_note_ports = nullptr;
+    plugin_thread_pool = nullptr;
+    plugin_latency = nullptr;
   }
   AudioProcessorP
   audio_processor () override
@@ -1411,7 +1506,7 @@ host_is_main_thread (const clap_host_t *host)
 static bool
 host_is_audio_thread (const clap_host_t *host)
 {
-  return AudioEngine::thread_is_engine();
+  return AudioEngine::thread_is_engine() || AudioEngine::thread_is_worker();
 }
 
 static const clap_host_thread_check host_ext_thread_check = {
@@ -1419,6 +1514,38 @@ static const clap_host_thread_check host_ext_thread_check = {
   .is_audio_thread = host_is_audio_thread,
 };
 
+// == clap_host_latency ==
+static void
+host_latency_changed (const clap_host_t *host)
+{
+  // only allowed during activate(), the latency is queried right after activation
+  CDEBUG ("%s: %s", clapid (host), __func__);
+}
+
+static const clap_host_latency host_ext_latency = {
+  .changed = host_latency_changed,
+};
+
+// == clap_host_thread_pool ==
+static void
+plugin_thread_pool_exec (void *data, uint32 task_index)
+{
+  ClapPluginHandleImpl *handle = (ClapPluginHandleImpl*) data;
+  handle->plugin_thread_pool->exec (handle->plugin_, task_index);
+}
+
+static bool
+host_request_exec (const clap_host_t *host, uint32_t num_tasks)
+{
+  ClapPluginHandleImpl *handle = handle_ptr (host);
+  return_unless (handle && handle->plugin_thread_pool && handle->plugin_thread_pool->exec, false);
+  return handle->proc_->engine().parallel_for (num_tasks, plugin_thread_pool_exec, handle);
+}
+
+static const clap_host_thread_pool host_ext_thread_pool = {
+  .request_exec = host_request_exec,
+};
+
 // == clap_host_audio_ports ==
 static bool
 host_is_rescan_flag_supported (const clap_host_t *host, uint32_t flag)
@@ -1772,6 +1899,8 @@ host_get_extension_mt (const clap_host *host, const char *extension_id)
   if (ext == CLAP_EXT_FILE_REFERENCE)   return &host_ext_file_reference;
   if (ext == CLAP_EXT_TIMER_SUPPORT)    return &host_ext_timer_support;
   if (ext == CLAP_EXT_THREAD_CHECK)     return &host_ext_thread_check;
+  if (ext == CLAP_EXT_THREAD_POOL)      return &host_ext_thread_pool;
+  if (ext == CLAP_EXT_LATENCY)          return &host_ext_latency;
   if (ext == CLAP_EXT_AUDIO_PORTS)      return &host_ext_audio_ports;
   if (ext == CLAP_EXT_PARAMS)           return &host_ext_params;
   if (ext == CLAP_EXT_POSIX_FD_SUPPORT) return &host_ext_posix_fd_support;
@@ -1827,17 +1956,86 @@ ClapPluginDescriptor::entry() const
   return clapfile_.opened() ? clapfile_.pluginentry : nullptr;
 }
 
-void
-ClapPluginDescriptor::add_descriptor (const String &pluginpath, Collection &infos)
+// == CLAP scan cache ==
+struct ClapScanInfo {
+  String id, name, version, vendor, features;
+  String description, url, manual_url, support_url;
+};
+
+struct ClapScanFile {
+  String path;
+  int64  size = 0, mtime = 0;
+  bool   failed = false;               // crashed or timed out during scanning
+  std::vector<ClapScanInfo> plugins;
+};
+
+struct ClapScanCache {
+  String host;
+  std::vector<ClapScanFile> files;
+};
+
+static void
+serialize (ClapScanInfo &info, WritNode &xs)
 {
-  ClapFileHandle *filehandle = new ClapFileHandle (pluginpath);
-  filehandle->open();
-  if (!filehandle->opened()) {
-    filehandle->close();
-    delete filehandle;
-    return;
-  }
-  const clap_plugin_factory *pluginfactory = (const clap_plugin_factory *) filehandle->pluginentry->get_factory (CLAP_PLUGIN_FACTORY_ID);
+  xs["id"] & info.id;
+  xs["name"] & info.name;
+  xs["version"] & info.version;
+  xs["vendor"] & info.vendor;
+  xs["features"] & info.features;
+  xs["description"] & info.description;
+  xs["url"] & info.url;
+  xs["manual_url"] & info.manual_url;
+  xs["support_url"] & info.support_url;
+}
+
+static void
+serialize (ClapScanFile &file, WritNode &xs)
+{
+  xs["path"] & file.path;
+  xs["size"] & file.size;
+  xs["mtime"] & file.mtime;
+  xs["failed"] & file.failed;
+  xs["plugins"] & file.plugins;
+}
+
+static void
+serialize (ClapScanCache &cache, WritNode &xs)
+{
+  xs["host"] & cache.host;
+  xs["files"] & cache.files;
+}
+
+static constexpr uint CLAP_SCAN_TIMEOUT_MS = 15000;
+
+static String
+clap_scan_cache_file()
+{
+  return Path::join (Path::cache_home(), "anklang", "clapscan.json");
+}
+
+/// Identify host versions, cached scan results are discarded if this changes.
+static String
+clap_scan_host()
+{
+  return string_format ("%s clap-%u.%u.%u", ase_version(), CLAP_VERSION_MAJOR, CLAP_VERSION_MINOR, CLAP_VERSION_REVISION);
+}
+
+static bool
+clap_stat_file (ClapScanFile &file)
+{
+  struct stat st = {};
+  return_unless (stat (file.path.c_str(), &st) == 0, false);
+  file.size = st.st_size;
+  file.mtime = st.st_mtim.tv_sec * int64 (1000) + st.st_mtim.tv_nsec / 1000000;
+  return true;
+}
+
+/// Open `clapfile` and query its plugin factory.
+static std::vector<ClapScanInfo>
+scan_clap_file (ClapFileHandle &filehandle)
+{
+  std::vector<ClapScanInfo> infos;
+  const clap_plugin_factory *pluginfactory = (const clap_plugin_factory *) filehandle.pluginentry->get_factory (CLAP_PLUGIN_FACTORY_ID);
   const uint32_t plugincount = !pluginfactory ? 0 : pluginfactory->get_plugin_count (pluginfactory);
   for (size_t i = 0; i < plugincount; i++)
     {
@@ -1849,28 +2047,206 @@ ClapPluginDescriptor::add_descriptor (const String &pluginpath, Collection &info
         CDEBUG ("invalid plugin: %s (%s)", pdesc->id, clapversion);
         continue;
       }
-      ClapPluginDescriptor *descriptor = new ClapPluginDescriptor (*filehandle);
-      descriptor->id = pdesc->id;
-      descriptor->name = pdesc->name ? pdesc->name : pdesc->id;
-      descriptor->version = pdesc->version ? pdesc->version : "0.0.0-unknown";
-      descriptor->vendor = pdesc->vendor ? pdesc->vendor : "";
-      descriptor->url = pdesc->url ? pdesc->url : "";
-      descriptor->manual_url = pdesc->manual_url ? pdesc->manual_url : "";
-      descriptor->support_url = pdesc->support_url ? pdesc->support_url : "";
-      descriptor->description = pdesc->description ? pdesc->description : "";
+      ClapScanInfo info;
+      info.id = pdesc->id;
+      info.name = pdesc->name ? pdesc->name : pdesc->id;
+      info.version = pdesc->version ? pdesc->version : "0.0.0-unknown";
+      info.vendor = pdesc->vendor ? pdesc->vendor : "";
+      info.url = pdesc->url ? pdesc->url : "";
+      info.manual_url = pdesc->manual_url ? pdesc->manual_url : "";
+      info.support_url = pdesc->support_url ? pdesc->support_url : "";
+      info.description = pdesc->description ? pdesc->description : "";
       StringS features;
       if (pdesc->features)
         for (size_t ft = 0; pdesc->features[ft]; ft++)
           if (pdesc->features[ft][0])
             features.push_back (feature_canonify (pdesc->features[ft]));
-      descriptor->features = ":" + string_join (":", features) + ":";
-      infos.push_back (descriptor);
-      CDEBUG ("Plugin: %s %s %s (%s, %s)%s", descriptor->name, descriptor->version,
-              descriptor->vendor.empty() ? "" : "- " + descriptor->vendor,
-              descriptor->id, clapversion,
-              descriptor->features.empty() ? "" : ": " + descriptor->features);
+      info.features = ":" + string_join (":", features) + ":";
+      CDEBUG ("Plugin: %s %s %s (%s, %s)%s", info.name, info.version,
+              info.vendor.empty() ? "" : "- " + info.vendor,
+              info.id, clapversion,
+              info.features.empty() ? "" : ": " + info.features);
+      infos.push_back (std::move (info));
+    }
+  return infos;
+}
+
+/// Scan a single CLAP file and print the results as JSON, used in child processes.
+int
+clap_scan_helper (const String &clapfile)
+{
+  // plugins may print to stdout, so keep the result channel separate
+  const int outfd = dup (1);
+  dup2 (2, 1);
+  ClapScanFile file;
+  file.path = clapfile;
+  ClapFileHandle filehandle (clapfile);
+  filehandle.open();
+  if (filehandle.opened())
+    file.plugins = scan_clap_file (filehandle);
+  filehandle.close();
+  const String json = json_stringify (file);
+  for (size_t n = 0; n < json.size(); )
+    {
+      const ssize_t l = write (outfd, json.data() + n, json.size() - n);
+      if (l < 0 && errno == EINTR)
+        continue;
+      return_unless (l > 0, 1);
+      n += l;
+    }
+  close (outfd);
+  return 0;
+}
+
+/// Scan `files[pending]` in parallel child processes, killing those that exceed CLAP_SCAN_TIMEOUT_MS.
+static void
+clap_scan_files (std::vector<ClapScanFile> &files, const std::vector<size_t> &pending)
+{
+  struct Job { size_t index; pid_t pid; int fd; uint64 deadline; String output; };
+  std::vector<Job> jobs;
+  const String exe = executable_path();
+  const size_t max_jobs = std::clamp (std::thread::hardware_concurrency(), 1u, 8u);
+  size_t next = 0;
+  auto finish = [&] (Job &job, bool timedout) {
+    int status = 0;
+    if (timedout)
+      kill (job.pid, SIGKILL);
+    while (waitpid (job.pid, &status, 0) < 0 && errno == EINTR)
+      ;
+    close (job.fd);
+    ClapScanFile &file = files[job.index];
+    ClapScanFile result;
+    if (!timedout && WIFEXITED (status) && WEXITSTATUS (status) == 0 && json_parse (job.output, result))
+      file.plugins = std::move (result.plugins);
+    else
+      {
+        file.failed = true;
+        warning ("%s: CLAP plugin scan %s", file.path,
+                 timedout ? "timed out" : WIFSIGNALED (status) ? string_format ("crashed: %s", strsignal (WTERMSIG (status))) :
+                 "failed");
+      }
+  };
+  while (next < pending.size() || !jobs.empty())
+    {
+      // spawn scanning processes
+      while (next < pending.size() && jobs.size() < max_jobs)
+        {
+          const size_t index = pending[next++];
+          int fds[2] = { -1, -1 };
+          if (pipe2 (fds, O_CLOEXEC) < 0)
+            {
+              files[index].failed = true;
+              continue;
+            }
+          posix_spawn_file_actions_t actions;
+          posix_spawn_file_actions_init (&actions);
+          posix_spawn_file_actions_adddup2 (&actions, fds[1], 1);
+          const char *argv[] = { exe.c_str(), "--clap-scan", files[index].path.c_str(), nullptr };
+          pid_t pid = -1;
+          const int err = posix_spawn (&pid, exe.c_str(), &actions, nullptr, const_cast<char**> (argv), environ);
+          posix_spawn_file_actions_destroy (&actions);
+          close (fds[1]);
+          if (err)
+            {
+              close (fds[0]);
+              files[index].failed = true;
+              warning ("%s: failed to spawn CLAP scanner: %s", exe, strerror (err));
+              continue;
+            }
+          jobs.push_back ({ index, pid, fds[0], timestamp_realtime() + CLAP_SCAN_TIMEOUT_MS * uint64 (1000), "" });
+        }
+      if (jobs.empty())
+        continue;
+      // read results
+      std::vector<pollfd> pfds;
+      uint64 deadline = ~uint64 (0);
+      for (const Job &job : jobs)
+        {
+          pfds.push_back ({ .fd = job.fd, .events = POLLIN, .revents = 0 });
+          deadline = std::min (deadline, job.deadline);
+        }
+      const uint64 now = timestamp_realtime();
+      const int timeout_ms = deadline > now ? (deadline - now + 999) / 1000 : 0;
+      if (poll (pfds.data(), pfds.size(), timeout_ms) < 0 && errno != EINTR && errno != EAGAIN)
+        {
+          warning ("%s: poll failed: %s", __func__, strerror (errno));
+          for (Job &job : jobs)
+            finish (job, true);
+          while (next < pending.size())
+            files[pending[next++]].mtime = 0;   // force rescan next time
+          return;
+        }
+      for (size_t i = jobs.size(); i-- > 0; )
+        {
+          Job &job = jobs[i];
+          bool done = false, timedout = false;
+          if (pfds[i].revents)
+            {
+              char buffer[4096];
+              const ssize_t l = read (job.fd, buffer, sizeof (buffer));
+              if (l > 0)
+                job.output.append (buffer, l);
+              else if (l == 0 || errno != EINTR)
+                done = true;
+            }
+          if (!done && timestamp_realtime() >= job.deadline)
+            done = timedout = true;
+          if (done)
+            {
+              finish (job, timedout);
+              jobs.erase (jobs.begin() + i);
+            }
+        }
     }
-  filehandle->close();
+}
+
+static ClapPluginDescriptor*
+make_descriptor (ClapFileHandle &filehandle, const ClapScanInfo &info)
+{
+  ClapPluginDescriptor *descriptor = new ClapPluginDescriptor (filehandle);
+  descriptor->id = info.id;
+  descriptor->name = info.name;
+  descriptor->version = info.version;
+  descriptor->vendor = info.vendor;
+  descriptor->url = info.url;
+  descriptor->manual_url = info.manual_url;
+  descriptor->support_url = info.support_url;
+  descriptor->description = info.description;
+  descriptor->features = info.features;
+  return descriptor;
+}
+
+/// Parse a scan cache, results of other host versions are discarded.
+static ClapScanCache
+clap_scan_cache_parse (const String &json)
+{
+  ClapScanCache cache;
+  if (!json_parse (json, cache) || cache.host != clap_scan_host())
+    cache = {};
+  return cache;
+}
+
+/// Stat `paths` into `files` and reuse unchanged entries from `cache`, returns the indices of `files` to scan.
+static std::vector<size_t>
+clap_scan_reuse (const ClapScanCache &cache, const StringS &paths, std::vector<ClapScanFile> &files)
+{
+  std::unordered_map<String,const ClapScanFile*> cached;
+  for (const ClapScanFile &file : cache.files)
+    cached[file.path] = &file;
+  std::vector<size_t> pending;
+  for (const auto &clapfile : paths) {
+    ClapScanFile file;
+    file.path = clapfile;
+    if (!clap_stat_file (file))
+      continue;
+    auto it = cached.find (file.path);
+    if (it != cached.end() && it->second->size == file.size && it->second->mtime == file.mtime)
+      file = *it->second;
+    else
+      pending.push_back (files.size());
+    files.push_back (std::move (file));
+  }
+  return pending;
 }
 
 const ClapPluginDescriptor::Collection&
@@ -1878,8 +2254,26 @@ ClapPluginDescriptor::collect_descriptors ()
 {
   static Collection collection;
   if (collection.empty()) {
-    for (const auto &clapfile : list_clap_files())
-      add_descriptor (clapfile, collection);
+    const String cachefile = clap_scan_cache_file();
+    const ClapScanCache cache = clap_scan_cache_parse (Path::stringread (cachefile));
+    // rescan only new or modified files
+    std::vector<ClapScanFile> files;
+    const std::vector<size_t> pending = clap_scan_reuse (cache, list_clap_files(), files);
+    CDEBUG ("%s: %d cached, %d to scan", cachefile, files.size() - pending.size(), pending.size());
+    if (pending.size())
+      clap_scan_files (files, pending);
+    if (pending.size() || files.size() != cache.files.size()) {
+      ClapScanCache newcache { clap_scan_host(), files };
+      if (!Path::stringwrite (cachefile + ".tmp", json_stringify (newcache), true) ||
+          !Path::rename (cachefile + ".tmp", cachefile))
+        CDEBUG ("%s: failed to write: %s", cachefile, strerror (errno));
+    }
+    for (const ClapScanFile &file : files)
+      if (file.plugins.size()) {
+        ClapFileHandle *filehandle = new ClapFileHandle (file.path);
+        for (const ClapScanInfo &info : file.plugins)
+          collection.push_back (make_descriptor (*filehandle, info));
+      }
   }
   return collection;
 }
@@ -2008,3 +2402,97 @@ ClapPluginHandle::make_clap_handle (const ClapPluginDescriptor &descriptor, Audi
 }
 
 } // Ase
+
+#include "testing.hh"
+
+namespace { // Anon
+using namespace Ase;
+
+TEST_INTEGRITY (clap_scan_cache_tests);
+static void
+clap_scan_cache_tests()
+{
+  const char *tmpdir = getenv ("TMPDIR");
+  const String path = Path::join (tmpdir ? tmpdir : "/tmp", string_format ("clapscan-%u.clap", getpid()));
+  TASSERT (Path::stringwrite (path, "not really a plugin"));
+  ClapScanFile file;
+  file.path = path;
+  TASSERT (clap_stat_file (file));
+  ClapScanInfo info;
+  info.id = "org.example.test";
+  info.name = "Test";
+  info.features = ":audio-effect:";
+  file.plugins.push_back (info);
+  ClapScanCache cache { clap_scan_host(), { file } };
+  // round trip a cache entry
+  cache = clap_scan_cache_parse (json_stringify (cache));
+  TASSERT (cache.files.size() == 1 && cache.files[0].mtime == file.mtime && cache.files[0].plugins.size() == 1);
+  std::vector<ClapScanFile> files;
+  std::vector<size_t> pending = clap_scan_reuse (cache, { path, path + ".missing" }, files);
+  TASSERT (pending.empty() && files.size() == 1);
+  TASSERT (files[0].plugins.size() == 1 && files[0].plugins[0].id == info.id && files[0].plugins[0].features == info.features);
+  // a changed mtime invalidates the entry
+  const struct timespec times[2] = { { 0, UTIME_OMIT }, { 1000000000, 0 } };
+  TASSERT (utimensat (AT_FDCWD, path.c_str(), times, 0) == 0);
+  files.clear();
+  pending = clap_scan_reuse (cache, { path }, files);
+  TASSERT (pending.size() == 1 && files.size() == 1 && files[0].plugins.empty());
+  // results of other host versions are discarded
+  cache.host = "other";
+  TASSERT (clap_scan_cache_parse (json_stringify (cache)).files.empty());
+  unlink (path.c_str());
+}
+
+TEST_BENCHMARK (clap_event_view_bench);
+static void
+clap_event_view_bench()
+{
+  constexpr uint BLOCK = 128, N_NOTES = 64, N_LISTS = 4, N_PARAMS = 16;
+  // stub plugin, walks the input events like a synthesizer would
+  static uint64_t accu = 0;
+  const clap_plugin_t stub = {
+    .process = [] (const clap_plugin_t *plugin, const clap_process_t *process) -> clap_process_status {
+      const clap_input_events_t *in_events = process->in_events;
+      const uint32_t n = in_events->size (in_events);
+      for (uint32_t i = 0; i < n; i++)
+        accu += in_events->get (in_events, i)->time;
+      return CLAP_PROCESS_CONTINUE;
+    },
+  };
+  ClapEventUnionS inputs (N_NOTES);
+  for (uint i = 0; i < N_NOTES; i++)
+    inputs[i].note = clap_event_note_t {
+      .header = { .size = sizeof (clap_event_note_t), .time = i * BLOCK / N_NOTES, .space_id = CLAP_CORE_EVENT_SPACE_ID, .type = CLAP_EVENT_NOTE_ON },
+      .note_id = -1, .port_index = 0, .channel = 0, .key = int16_t (36 + i), .velocity = 0.8,
+    };
+  ClapEventParamS plists[N_LISTS];     // each list is time ordered, like convert_param_updates() output
+  std::vector<ClapEventParamS*> queued;
+  for (uint l = 0; l < N_LISTS; l++) {
+    for (uint i = 0; i < N_PARAMS; i++)
+      plists[l].push_back (clap_event_param_value_t {
+          .header = { .size = sizeof (clap_event_param_value_t), .time = l * BLOCK / N_LISTS + i, .space_id = CLAP_CORE_EVENT_SPACE_ID, .type = CLAP_EVENT_PARAM_VALUE },
+          .param_id = i, .cookie = nullptr, .note_id = -1, .port_index = -1, .channel = -1, .key = -1, .value = 0.5,
+        });
+    queued.push_back (&plists[l]);
+  }
+  ClapEventView view (inputs.capacity(), N_LISTS * N_PARAMS);
+  const clap_process_t process = { .frames_count = BLOCK, .in_events = &view.clap_events };
+  const auto *const events_data = view.events.data(), *const params_data = view.params.data();
+  auto host_block = [&] () {
+    view.update (inputs, queued);
+    stub.process (&stub, &process);
+  };
+  Test::Timer timer (0.15);
+  const double bench_time = timer.benchmark (host_block);
+  TASSERT (view.events.size() == N_NOTES + N_LISTS * N_PARAMS);
+  for (size_t i = 1; i < view.events.size(); i++)
+    TASSERT (view.events[i - 1]->time <= view.events[i]->time);
+  TASSERT (events_data == view.events.data() && params_data == view.params.data()); // no reallocations
+  printerr ("  BENCH    ClapEventView %u notes + %u params:  %11.1f ns/block\n", N_NOTES, N_LISTS * N_PARAMS, bench_time * 1e9);
+  queued.clear();
+  const double notes_time = timer.benchmark (host_block);
+  printerr ("  BENCH    ClapEventView %u notes:              %11.1f ns/block\n", N_NOTES, notes_time * 1e9);
+  TASSERT (accu > 0);
+}
+
+} // Anon
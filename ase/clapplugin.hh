@@ -22,7 +22,6 @@ public:
   void                     close                () const;
   const clap_plugin_entry* entry                () const;
   ClapFileHandle&          file_handle          () const { return clapfile_; }
-  static void              add_descriptor       (const String &pluginpath, Collection &infos);
   static const Collection& collect_descriptors ();
 };
 
@@ -95,6 +94,7 @@ StringS     list_clap_files        ();
 const char* clap_event_type_string (int etype);
 String      clap_event_to_string   (const clap_event_note_t *enote);
 DeviceInfo  clap_device_info       (const ClapPluginDescriptor &descriptor);
+int         clap_scan_helper       (const String &clapfile);
 
 } // Ase
 
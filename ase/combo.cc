@@ -1,7 +1,10 @@
 // This Source Code Form is licensed MPL-2.0: http://mozilla.org/MPL/2.0
 #include "combo.hh"
+#include "audioclip.hh"
+#include "monitor.hh"
 #include "randomhash.hh"
 #include "server.hh"
+#include "main.hh"
 #include "internal.hh"
 
 #define PDEBUG(...)     Ase::debug ("combo", __VA_ARGS__)
@@ -9,6 +12,49 @@
 namespace Ase {
 
 static constexpr OBusId OUT1 = OBusId (1);
+static constexpr OBusId PREFADER = OBusId (2); // chain output before the volume fader
+static constexpr int64 FREEZE_DRIFT = 2; // frames, tolerance for tick rounding
+static constexpr uint FREEZE_TAIL_MS = 2000; // decay after the last clip, recorded for freezing
+
+// == SendDelay ==
+/// Delay for an aux send, compensating latency differences between the sends into a chain.
+/// The ring always records the send output, so delay changes only move the read offset.
+struct AudioChain::SendDelay {
+  static constexpr uint MAX_DELAY = 65536 - 1, RING_MASK = 65536 - 1;
+  std::vector<float> ring[2];
+  uint               delay = 0, pos = 0;
+  alignas (64) float output[2][AUDIO_BLOCK_MAX_RENDER_SIZE];
+  SendDelay()
+  {
+    for (auto &r : ring)
+      r.resize (RING_MASK + 1);
+  }
+  void
+  process (uint n_frames, const float *src[2])
+  {
+    for (size_t c = 0; c < 2; c++)
+      {
+        float *const r = ring[c].data();
+        float *const d = output[c];
+        const float *const s = src[c];
+        uint p = pos;
+        for (uint i = 0; i < n_frames; i++)
+          {
+            r[p] = s[i];
+            d[i] = r[(p - delay) & RING_MASK];
+            p = (p + 1) & RING_MASK;
+          }
+      }
+    pos = (pos + n_frames) & RING_MASK;
+  }
+};
+
+/// Create a send delay for aux_send(), allocates so must not be called in the engine thread.
+AudioChain::SendDelay*
+AudioChain::create_send_delay ()
+{
+  return new SendDelay();
+}
 
 // == Inlet ==
 class AudioChain::Inlet : public AudioProcessor {
@@ -28,6 +74,15 @@ public:
     auto output = add_output_bus ("Output", audio_chain_.ispeakers_);
     (void) output;
   }
+  uint
+  schedule_children() override
+  {
+    // aux send sources must be rendered before the inlet can sum them up
+    uint level = 0;
+    for (const AuxSend &send : audio_chain_.aux_sends_)
+      level = std::max (level, schedule_processor (*send.source));
+    return level;
+  }
   void
   render (uint n_frames) override
   {
@@ -36,8 +91,30 @@ public:
     const uint ni = audio_chain_.n_ichannels (i1);
     const uint no = this->n_ochannels (o1);
     assert_return (ni == no);
-    for (size_t i = 0; i < ni; i++)
-      redirect_oblock (o1, i, audio_chain_.ifloats (i1, i));
+    if (audio_chain_.aux_sends_.empty())
+      {
+        for (size_t i = 0; i < ni; i++)
+          redirect_oblock (o1, i, audio_chain_.ifloats (i1, i));
+        return;
+      }
+    // line up the aux sends, see update_latency()
+    for (const AuxSend &send : audio_chain_.aux_sends_)
+      if (send.delay)
+        {
+          const float *src[2] = { send.source->send_output (0, send.prefader), send.source->send_output (1, send.prefader) };
+          send.delay->process (n_frames, src);
+        }
+    // mix the chain input with all aux sends
+    for (size_t i = 0; i < no; i++)
+      {
+        float *out = oblock (o1, i);
+        fast_copy (n_frames, out, audio_chain_.ifloats (i1, i));
+        for (const AuxSend &send : audio_chain_.aux_sends_)
+          {
+            const float *src = send.delay ? send.delay->output[std::min (i, size_t (1))] : send.source->send_output (i, send.prefader);
+            mix_gain (n_frames, out, src, send.level, send.level);
+          }
+      }
   }
 };
 
@@ -144,10 +221,14 @@ AudioChain::AudioChain (const ProcessorSetup &psetup, SpeakerArrangement iobuses
   assert_return (inlet_ != nullptr);
   probe_block_ = SERVER->telemem_allocate (sizeof (ProbeArray));
   probes_ = new (probe_block_.block_start) ProbeArray{};
+  monitors_.reserve (8);  // see reserve_monitor_ml()
+  aux_sends_.reserve (16);  // see reserve_send_ml()
 }
 
 AudioChain::~AudioChain()
 {
+  for (AuxSend &send : aux_sends_)
+    delete send.delay;
   pm_remove_all_buses (*inlet_);
   inlet_ = nullptr;
   probes_->~ProbeArray();
@@ -164,8 +245,10 @@ AudioChain::initialize (SpeakerArrangement busses)
 {
   auto ibus = add_input_bus ("Input", ispeakers_);
   auto obus = add_output_bus ("Output", ospeakers_);
+  auto pbus = add_output_bus ("Pre-Fader", ospeakers_);
   (void) ibus;
   assert_return (OUT1 == obus);
+  assert_return (PREFADER == pbus);
 }
 
 void
@@ -176,6 +259,14 @@ uint
 AudioChain::schedule_children()
 {
   last_output_ = nullptr;
+  anticipating_ = false;
+  if (frozen_)
+    return 0; // children are bypassed while the frozen recording plays
+  // aux sends are summed in lockstep, so only chains without inputs can be rendered ahead
+  const bool anticipate = anticipate_ && aux_sends_.empty() && engine_.anticipation() > 0 &&
+                          n_ochannels (PREFADER) <= Anticipation::MAX_CHANNELS;
+  if (anticipate)
+    engine_.schedule_anticipation (anticipation_);
   uint level = schedule_processor (*inlet_);
   for (auto procp : processors_)
     {
@@ -184,6 +275,13 @@ AudioChain::schedule_children()
       if (procp->n_obuses())
         last_output_ = procp.get();
     }
+  if (anticipate)
+    {
+      engine_.schedule_anticipation (nullptr);
+      anticipation_->set_source (last_output_, n_ochannels (PREFADER));
+      anticipating_ = true;
+      return 0; // children are rendered by the anticipation thread
+    }
   // last_output_ is only valid during render()
   return level;
 }
@@ -191,44 +289,194 @@ AudioChain::schedule_children()
 void
 AudioChain::render (uint n_frames)
 {
-  // make the last processor output the chain output
-  const size_t nlastchannels = last_output_ ? last_output_->n_ochannels (OUT1) : 0;
+  if (frozen_)
+    {
+      render_frozen (n_frames);
+      render_fader (n_frames);
+      probe_output (n_frames);
+      render_monitors (n_frames);
+      return;
+    }
+  if (anticipating_)
+    render_anticipated (n_frames);
+  else
+    {
+      // make the last processor output the chain output
+      const size_t nlastchannels = last_output_ ? last_output_->n_ochannels (OUT1) : 0;
+      const size_t n_och = n_ochannels (OUT1);
+      for (size_t c = 0; c < n_och; c++)
+        {
+          // an enqueue_children() call is guranteed *before* render(), so last_output_ is valid
+          if (UNLIKELY (!last_output_))
+            redirect_oblock (PREFADER, c, nullptr);
+          else
+            redirect_oblock (PREFADER, c, last_output_->ofloats (OUT1, std::min (c, nlastchannels - 1)));
+        }
+    }
+  render_fader (n_frames);
+  probe_output (n_frames);
+  if (capture_ && !capture_done_)
+    render_capture (n_frames);
+  render_monitors (n_frames);
+  // FIXME: assign obus if no children are present
+}
+
+/// Fetch the pre-fader signal from the blocks that the children rendered ahead of time.
+void
+AudioChain::render_anticipated (uint n_frames)
+{
+  float *buffers[Anticipation::MAX_CHANNELS];
+  const uint n_och = n_ochannels (PREFADER);
+  for (uint c = 0; c < n_och; c++)
+    buffers[c] = oblock (PREFADER, c);
+  anticipation_->pop (n_frames, buffers);
+}
+
+/// Apply the volume fader to the pre-fader signal, gain changes are ramped across the block.
+void
+AudioChain::render_fader (uint n_frames)
+{
   const size_t n_och = n_ochannels (OUT1);
-  std::array<Probe,2> *probes = n_och <= 2 ? probes_ : nullptr;
+  if (fader_gain_ == volume_ && volume_ == 1.0)
+    {
+      for (size_t c = 0; c < n_och; c++)
+        redirect_oblock (OUT1, c, ofloats (PREFADER, c));
+      return;
+    }
   for (size_t c = 0; c < n_och; c++)
+    scale_gain (n_frames, oblock (OUT1, c), ofloats (PREFADER, c), fader_gain_, volume_);
+  fader_gain_ = volume_;
+}
+
+void
+AudioChain::probe_output (uint n_frames)
+{
+  const size_t n_och = n_ochannels (OUT1);
+  return_unless (n_och <= 2);
+  for (size_t c = 0; c < n_och; c++)
+    {
+      const float *cblock = ofloats (OUT1, c);
+      // SPL = 20 * log10 (root_mean_square (p) / p0) dB        ; https://en.wikipedia.org/wiki/Sound_pressure#Sound_pressure_level
+      // const float sqrsig = square_sum (n_frames, cblock) / n_frames; // * 1.0 / p0^2
+      const float sqrsig = square_max (n_frames, cblock);
+      const float log2div = 3.01029995663981; // 20 / log2 (10) / 2.0
+      const float db_spl = ISLIKELY (sqrsig > 0.0) ? log2div * fast_log2 (sqrsig) : -192;
+      (*probes_)[c].dbspl = db_spl;
+    }
+}
+
+void
+AudioChain::render_monitors (uint n_frames)
+{
+  const uint n_och = n_ochannels (OUT1);
+  for (const Monitor &monitor : monitors_)
+    monitor.analyzer->analyze (n_frames, ofloats (OUT1, std::min (monitor.ochannel, n_och - 1)));
+}
+
+/// Write the chain output into capture_ for a playback that starts at the song beginning.
+void
+AudioChain::render_capture (uint n_frames)
+{
+  const AudioTransport &transport = this->transport();
+  const int64 position = transport.sample_from_tick (transport.current_tick);
+  if (!transport.running())
     {
-      // an enqueue_children() call is guranteed *before* render(), so last_output_ is valid
-      if (UNLIKELY (!last_output_))
+      if (freeze_running_)              // playback stopped, recording is done if it covers the content
         {
-          redirect_oblock (OUT1, c, nullptr);
-          if (probes)
-            (*probes)[c].dbspl = -192;
+          const int64 needed = transport.sample_from_tick (freeze_end_tick_) + FREEZE_TAIL_MS * int64 (transport.samplerate) / 1000;
+          if (freeze_frame_ >= needed)
+            capture_->complete();
+          else
+            capture_->discard();        // stopped early, re-armed by the track
+          capture_done_ = true;         // capture_ is released via freeze_release()
+          enotify_enqueue_mt (STATECHANGE);
         }
+      freeze_running_ = false;
+      return;
+    }
+  if (!freeze_running_)
+    {
+      if (position != 0)
+        return;                         // playback must start at the beginning
+      freeze_running_ = true;
+      freeze_frame_ = 0;
+    }
+  else if (std::abs (position - freeze_frame_) > FREEZE_DRIFT)
+    {
+      capture_->discard();              // transport jumped, recording is incomplete
+      capture_done_ = true;
+      freeze_running_ = false;
+      enotify_enqueue_mt (STATECHANGE);
+      return;
+    }
+  const uint n_och = n_ochannels (PREFADER);
+  capture_->write (ofloats (PREFADER, 0), ofloats (PREFADER, std::min (1u, n_och - 1)), n_frames);
+  freeze_frame_ += n_frames;
+}
+
+/// Render the chain output from the frozen_ recording in sync with the transport.
+void
+AudioChain::render_frozen (uint n_frames)
+{
+  float scratch[AUDIO_BLOCK_MAX_RENDER_SIZE];
+  const uint n_och = n_ochannels (PREFADER);
+  float *left = oblock (PREFADER, 0), *right = n_och > 1 ? oblock (PREFADER, 1) : scratch;
+  const AudioTransport &transport = this->transport();
+  const int64 position = transport.sample_from_tick (transport.current_tick);
+  if (!transport.running())
+    {
+      freeze_running_ = false;
+      frozen_->cue (position);          // prefetch for the next start
+      floatfill (left, 0.0, n_frames);
+      floatfill (right, 0.0, n_frames);
+      return;
+    }
+  if (!freeze_running_ || std::abs (position - freeze_frame_) > FREEZE_DRIFT)
+    freeze_frame_ = position;           // transport jumped
+  freeze_running_ = true;
+  frozen_->render (freeze_frame_, n_frames, left, right);
+  freeze_frame_ += n_frames;
+  if (n_och == 1)
+    for (uint i = 0; i < n_frames; i++)
+      left[i] = 0.5 * (left[i] + right[i]);
+}
+
+/// Sum up the latencies of the processors that the chain output passes through.
+void
+AudioChain::update_latency()
+{
+  if (frozen_)
+    return; // the recording carries the latency of the bypassed chain
+  uint latency = 0;
+  for (const AuxSend &send : aux_sends_) // inputs arrive with the latency of the slowest send
+    {
+      AudioProcessor::update_latency (*send.source);
+      latency = std::max (latency, send.source->latency());
+    }
+  for (const AuxSend &send : aux_sends_) // delay the faster sends to line up with the slowest
+    if (send.delay)
+      send.delay->delay = std::min (latency - send.source->latency(), SendDelay::MAX_DELAY);
+  for (auto procp : processors_)
+    {
+      AudioProcessor::update_latency (*procp);
+      if (!procp->n_obuses())
+        continue;
+      if (procp->n_ibuses())
+        latency += procp->latency();
       else
-        {
-          const float *cblock = last_output_->ofloats (OUT1, std::min (c, nlastchannels - 1));
-          redirect_oblock (OUT1, c, cblock);
-          if (probes)
-            {
-              // SPL = 20 * log10 (root_mean_square (p) / p0) dB        ; https://en.wikipedia.org/wiki/Sound_pressure#Sound_pressure_level
-              // const float sqrsig = square_sum (n_frames, cblock) / n_frames; // * 1.0 / p0^2
-              const float sqrsig = square_max (n_frames, cblock);
-              const float log2div = 3.01029995663981; // 20 / log2 (10) / 2.0
-              const float db_spl = ISLIKELY (sqrsig > 0.0) ? log2div * fast_log2 (sqrsig) : -192;
-              (*probes)[c].dbspl = db_spl;
-            }
-        }
+        latency = procp->latency(); // generators start a new signal path
     }
-  // FIXME: assign obus if no children are present
+  set_latency (latency);
 }
 
 /// Reconnect AudioChain child processors at start and after.
 void
 AudioChain::reconnect (size_t index, bool insertion)
 {
-  // clear stale inputs
+  // clear stale main inputs, secondary inputs (e.g. sidechains) are connected by devices
   for (size_t i = index; i < processors_.size(); i++)
-    pm_disconnect_ibuses (*processors_[i]);
+    if (processors_[i]->n_ibuses())
+      pm_disconnect (*processors_[i], IBusId (1));
   // reconnect pairwise
   for (size_t i = index; i < processors_.size(); i++)
     chain_up (*(i ? processors_[i - 1] : inlet_), *processors_[i]);
@@ -279,6 +527,321 @@ AudioChain::run_probes (bool enable)
   return probes_enabled_ ? probes_ : nullptr;
 }
 
+/// Record the chain output into `capture` during the next playback from the song beginning.
+/// Once playback stops, capture->completed() is set and a "state" event is emitted, the
+/// recording is discarded unless it reaches `end_tick` plus a decay tail.
+/// Previous recordings are moved into `released`, so they are destroyed outside the audio thread.
+void
+AudioChain::freeze_capture (AudioClipCaptureP capture, int64 end_tick, FreezeRelease &released)
+{
+  freeze_release (released);
+  capture_ = std::move (capture);
+  capture_done_ = false;
+  freeze_end_tick_ = end_tick;
+}
+
+/// Bypass all children and play back a previously captured recording instead.
+void
+AudioChain::freeze_playback (AudioClipStreamP stream, FreezeRelease &released)
+{
+  assert_return (stream != nullptr);
+  freeze_release (released);
+  frozen_ = std::move (stream);
+  reschedule();
+}
+
+/// Stop freeze recording or playback and render the children again.
+/// The recordings are moved into `released`, to be destroyed outside the audio thread.
+void
+AudioChain::freeze_release (FreezeRelease &released)
+{
+  released.capture = std::move (capture_);
+  capture_ = nullptr;
+  capture_done_ = false;
+  freeze_running_ = false;
+  if (frozen_)
+    {
+      released.stream = std::move (frozen_);
+      frozen_ = nullptr;
+      reschedule();
+    }
+}
+
+/// Account for a new monitor, returns larger storage to be passed to add_monitor() if needed.
+AudioChain::MonitorS*
+AudioChain::reserve_monitor_ml ()
+{
+  assert_return (this_thread_is_ase(), nullptr); // main_loop thread
+  monitors_ml_ += 1;
+  return_unless (monitors_ml_ >= 8 && (monitors_ml_ & (monitors_ml_ - 1)) == 0, nullptr); // grow at powers of 2 beyond the initial reserve
+  MonitorS *storage = new MonitorS();
+  storage->reserve (2 * monitors_ml_);
+  return storage;
+}
+
+/// Account for a removed monitor, must accompany remove_monitor().
+void
+AudioChain::release_monitor_ml ()
+{
+  assert_return (this_thread_is_ase() && monitors_ml_ > 0); // main_loop thread
+  monitors_ml_ -= 1;
+}
+
+/// Analyze output channel `ochannel` with `analyzer` during render().
+/// The `storage` from reserve_monitor_ml() is swapped in and deleted in the main_loop thread.
+void
+AudioChain::add_monitor (uint ochannel, MonitorAnalyzerP analyzer, MonitorS *storage)
+{
+  assert_return (analyzer != nullptr);
+  if (storage)
+    {
+      if (storage->capacity() > monitors_.capacity())
+        {
+          storage->assign (monitors_.begin(), monitors_.end());
+          monitors_.swap (*storage);
+        }
+      main_rt_jobs += RtCall (call_delete<MonitorS>, storage); // delete in main_thread
+    }
+  monitors_.push_back ({ ochannel, analyzer });
+}
+
+/// Stop analyzing the chain output with `analyzer`.
+void
+AudioChain::remove_monitor (const MonitorAnalyzer &analyzer)
+{
+  std::erase_if (monitors_, [&analyzer] (const Monitor &m) { return m.analyzer.get() == &analyzer; });
+}
+
+/// Set the linear gain of the volume fader applied to the chain output.
+void
+AudioChain::set_volume (float gain)
+{
+  volume_ = std::max (0.0f, gain);
+}
+
+/// Account for a new send, returns larger storage to be passed to aux_send() if needed.
+AudioChain::AuxSendS*
+AudioChain::reserve_send_ml ()
+{
+  assert_return (this_thread_is_ase(), nullptr); // main_loop thread
+  aux_sends_ml_ += 1;
+  return_unless (aux_sends_ml_ >= 16 && (aux_sends_ml_ & (aux_sends_ml_ - 1)) == 0, nullptr); // grow at powers of 2 beyond the initial reserve
+  AuxSendS *storage = new AuxSendS();
+  storage->reserve (2 * aux_sends_ml_);
+  return storage;
+}
+
+/// Account for a removed send, must accompany aux_send() with `level == 0`.
+void
+AudioChain::release_send_ml ()
+{
+  assert_return (this_thread_is_ase() && aux_sends_ml_ > 0); // main_loop thread
+  aux_sends_ml_ -= 1;
+}
+
+/// Mix the output of `source` into the chain input at `level`, `level == 0` removes the send.
+/// The source is scheduled for rendering before this chain. A new send takes ownership of
+/// `delay` from create_send_delay() for latency compensation, unused delays are released.
+/// The `storage` from reserve_send_ml() is swapped in and deleted in the main_loop thread.
+void
+AudioChain::aux_send (AudioChainP source, float level, bool prefader, SendDelay *delay, AuxSendS *storage)
+{
+  assert_return (source != nullptr && source.get() != this);
+  if (storage)
+    {
+      if (storage->capacity() > aux_sends_.capacity())
+        {
+          storage->assign (aux_sends_.begin(), aux_sends_.end());
+          aux_sends_.swap (*storage);
+        }
+      main_rt_jobs += RtCall (call_delete<AuxSendS>, storage); // delete in main_thread
+    }
+  auto it = std::find_if (aux_sends_.begin(), aux_sends_.end(), [&source] (const AuxSend &s) { return s.source == source; });
+  if (it != aux_sends_.end() && level > 0)
+    {
+      it->level = level;
+      it->prefader = prefader;
+      if (delay)
+        main_rt_jobs += RtCall (call_delete<SendDelay>, delay); // delete in main_thread
+      return;
+    }
+  if (it != aux_sends_.end())
+    {
+      if (it->delay)
+        main_rt_jobs += RtCall (call_delete<SendDelay>, it->delay); // delete in main_thread
+      aux_sends_.erase (it);
+      reschedule();
+    }
+  else if (level > 0)
+    {
+      aux_sends_.push_back ({ source, level, prefader, delay });
+      reschedule();
+    }
+  else if (delay)
+    main_rt_jobs += RtCall (call_delete<SendDelay>, delay); // delete in main_thread
+}
+
+/// Retrieve the signal of `channel` that is sent to aux buses, only valid after render().
+const float*
+AudioChain::send_output (uint channel, bool prefader) const
+{
+  const OBusId obus = prefader ? PREFADER : OUT1;
+  return ofloats (obus, std::min (channel, n_ochannels (obus) - 1));
+}
+
+/// Render the children ahead of the PCM output on the anticipation thread, for chains without live input.
+/// Chains that receive aux sends are always rendered in lockstep. The chain keeps the first `anticipation`
+/// passed in, it must be allocated with create_anticipation() in the main thread.
+void
+AudioChain::anticipate (bool onoff, AnticipationP anticipation)
+{
+  if (!anticipation_)
+    anticipation_ = anticipation;
+  onoff = onoff && anticipation_;
+  return_unless (onoff != anticipate_);
+  anticipate_ = onoff;
+  reschedule();
+}
+
+/// Allocate the block queue for anticipate(), called in the main thread.
+AnticipationP
+AudioChain::create_anticipation () const
+{
+  return std::make_shared<Anticipation> (engine_, speaker_arrangement_count_channels (ospeakers_));
+}
+
 static const auto audio_chain_id = register_audio_processor<AudioChain>();
 
 } // Ase
+
+// == Testing ==
+#include "testing.hh"
+
+namespace { // Anon
+using namespace Ase;
+
+// Signal that encodes the transport frame, to check that popped blocks line up with the engine
+static float
+anticipation_test_value (int64 frame)
+{
+  return frame & 0xffff;
+}
+
+/// Render the transport frame, on the anticipation thread if the chain renders ahead.
+class AnticipationTestSource : public AudioProcessor {
+  OBusId stereout;
+public:
+  std::atomic<uint> ahead = 0;
+  AnticipationTestSource (const ProcessorSetup &psetup) :
+    AudioProcessor (psetup)
+  {}
+  static void static_info (AudioProcessorInfo &info) {}
+  void
+  initialize (SpeakerArrangement busses) override
+  {
+    stereout = add_output_bus ("Stereo Out", SpeakerArrangement::STEREO);
+  }
+  void reset (uint64 target_stamp) override {}
+  void
+  render (uint n_frames) override
+  {
+    const int64 frame = transport().current_frame;
+    float *left = oblock (stereout, 0), *right = oblock (stereout, 1);
+    for (uint i = 0; i < n_frames; i++)
+      left[i] = right[i] = anticipation_test_value (frame + i);
+    ahead += !AudioEngine::thread_is_engine();
+  }
+};
+
+/// Compare the input with the engine transport frame, silent blocks are underruns.
+class AnticipationTestChecker : public AudioProcessor {
+  IBusId stereoin;
+  OBusId stereout;
+public:
+  std::atomic<uint> checked = 0, mismatches = 0, silent = 0;
+  AnticipationTestChecker (const ProcessorSetup &psetup) :
+    AudioProcessor (psetup)
+  {}
+  static void static_info (AudioProcessorInfo &info) {}
+  void
+  initialize (SpeakerArrangement busses) override
+  {
+    stereoin = add_input_bus ("Stereo In", SpeakerArrangement::STEREO);
+    stereout = add_output_bus ("Stereo Out", SpeakerArrangement::STEREO);
+  }
+  void reset (uint64 target_stamp) override {}
+  void
+  render (uint n_frames) override
+  {
+    const int64 frame = transport().current_frame;
+    const float *left = ifloats (stereoin, 0);
+    uint misses = 0, zeros = 0;
+    for (uint i = 0; i < n_frames; i++)
+      {
+        misses += left[i] != anticipation_test_value (frame + i);
+        zeros += left[i] == 0;
+      }
+    if (zeros == n_frames)
+      silent += 1;
+    else
+      {
+        mismatches += misses;
+        checked += n_frames;
+      }
+    for (uint c = 0; c < 2; c++)
+      redirect_oblock (stereout, c, ifloats (stereoin, c));
+  }
+};
+
+TEST_INTEGRITY (anticipation_tests);
+static void
+anticipation_tests()
+{
+  AudioEngine *engine = main_config.engine;
+  return_unless (engine);
+  auto wait_checked = [] (AnticipationTestChecker &checker, uint n) {
+    const uint64 start_usecs = timestamp_realtime();
+    while (timestamp_realtime() < start_usecs + 3000 * 1000 && checker.checked < n)
+      {
+        usleep (1500);  // give the audio engine some time
+        main_loop->iterate (false);
+      }
+  };
+  const uint old_ms = engine->anticipation_ms();
+  engine->set_anticipation (50);
+  // the source chain renders ahead, its output is checked in lockstep by a bus chain
+  auto source_chain = AudioProcessor::create_processor<AudioChain> (*engine);
+  auto source = AudioProcessor::create_processor<AnticipationTestSource> (*engine);
+  auto bus_chain = AudioProcessor::create_processor<AudioChain> (*engine);
+  auto checker = AudioProcessor::create_processor<AnticipationTestChecker> (*engine);
+  AnticipationP anticipation = source_chain->create_anticipation();
+  engine->async_jobs += [=] () {
+    source_chain->insert (source);
+    bus_chain->insert (checker);
+    bus_chain->aux_send (source_chain, 1.0, true);
+    source_chain->anticipate (true, anticipation);
+    bus_chain->enable_engine_output (true);
+  };
+  // pop: blocks are rendered on the anticipation thread and popped in sync with the engine
+  wait_checked (*checker, 8192);
+  TCMP (checker->checked.load(), >=, 8192u);
+  TCMP (source->ahead.load(), >, 0u);
+  TCMP (checker->mismatches.load(), ==, 0u);
+  TCMP (checker->silent.load(), <=, anticipation->underruns());
+  // rollback: queued blocks are discarded and rendering resumes at the engine transport
+  const uint64 rollbacks = anticipation->rollbacks();
+  const uint checked = checker->checked;
+  anticipation->invalidate_mt();
+  wait_checked (*checker, checked + 8192);
+  TCMP (checker->checked.load(), >=, checked + 8192);
+  TCMP (anticipation->rollbacks(), >, rollbacks);
+  TCMP (checker->mismatches.load(), ==, 0u);
+  engine->async_jobs += [=] () {
+    bus_chain->enable_engine_output (false);
+    bus_chain->aux_send (source_chain, 0, true);
+    source_chain->anticipate (false);
+  };
+  engine->set_anticipation (old_ms);
+}
+
+} // Anon
@@ -29,11 +29,38 @@ class AudioChain : public AudioCombo {
   const SpeakerArrangement ospeakers_ = SpeakerArrangement (0);
   InletP           inlet_;
   AudioProcessor  *last_output_ = nullptr;
+  AudioClipCaptureP capture_;
+  AudioClipStreamP frozen_;
+  int64            freeze_frame_ = 0;
+  int64            freeze_end_tick_ = 0;
+  bool             freeze_running_ = false;
+  bool             capture_done_ = false;
+  void     render_capture    (uint n_frames);
+  void     render_frozen     (uint n_frames);
+  void     probe_output      (uint n_frames);
+  void     render_monitors   (uint n_frames);
+  struct Monitor { uint ochannel; MonitorAnalyzerP analyzer; };
+  using MonitorS = std::vector<Monitor>;
+  MonitorS         monitors_;
+  uint             monitors_ml_ = 0; // monitors added in main_loop thread, sizes monitors_
+public:
+  struct SendDelay;
+  struct AuxSend { AudioChainP source; float level; bool prefader; SendDelay *delay; };
+  using AuxSendS = std::vector<AuxSend>;
+private:
+  AuxSendS         aux_sends_;
+  uint             aux_sends_ml_ = 0; // sends added in main_loop thread, sizes aux_sends_
+  float            volume_ = 1, fader_gain_ = 1;
+  void     render_fader      (uint n_frames);
+  void     render_anticipated (uint n_frames);
+  AnticipationP    anticipation_;   // assigned once via anticipate()
+  bool             anticipate_ = false, anticipating_ = false;
 protected:
   void     initialize        (SpeakerArrangement busses) override;
   void     reset             (uint64 target_stamp) override;
   void     render            (uint n_frames) override;
   uint     schedule_children () override;
+  void     update_latency    () override;
   void     reconnect         (size_t index, bool insertion) override;
   uint     chain_up          (AudioProcessor &pfirst, AudioProcessor &psecond);
 public:
@@ -42,6 +69,22 @@ public:
   struct Probe { float dbspl = -192; };
   using ProbeArray = std::array<Probe,2>;
   ProbeArray* run_probes     (bool enable);
+  struct FreezeRelease { AudioClipCaptureP capture; AudioClipStreamP stream; };
+  void     freeze_capture    (AudioClipCaptureP capture, int64 end_tick, FreezeRelease &released);
+  void     freeze_playback   (AudioClipStreamP stream, FreezeRelease &released);
+  void     freeze_release    (FreezeRelease &released);
+  MonitorS* reserve_monitor_ml ();
+  void     release_monitor_ml ();
+  void     add_monitor       (uint ochannel, MonitorAnalyzerP analyzer, MonitorS *storage);
+  void     remove_monitor    (const MonitorAnalyzer &analyzer);
+  void     set_volume        (float gain);
+  AuxSendS* reserve_send_ml  ();
+  void     release_send_ml   ();
+  void     aux_send          (AudioChainP source, float level, bool prefader, SendDelay *delay = nullptr, AuxSendS *storage = nullptr);
+  static SendDelay* create_send_delay ();
+  const float* send_output   (uint channel, bool prefader) const;
+  void     anticipate        (bool onoff, AnticipationP anticipation = nullptr);
+  AnticipationP create_anticipation () const;
   static void static_info    (AudioProcessorInfo &info);
 private:
   ProbeArray *probes_ = nullptr;
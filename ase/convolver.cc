@@ -0,0 +1,428 @@
+// This Source Code Form is licensed MPL-2.0: http://mozilla.org/MPL/2.0
+#include "convolver.hh"
+#include "simd.hh"
+#include "internal.hh"
+
+namespace Ase {
+
+// == PartitionedConvolver::Stage ==
+/// Uniformly partitioned overlap-save convolution with `n_parts` partitions of the taps starting at `offset`.
+struct PartitionedConvolver::Stage {
+  const uint         partition, offset, n_parts, n_bins;
+  const bool         background;
+  RealFFT            fft;
+  std::vector<float> filter_re, filter_im;      // spectra of the partitions, normalized by the FFT size
+  std::vector<float> fdl_re, fdl_im;            // frequency domain delay line, spectra of the last n_parts windows
+  std::vector<float> acc_re, acc_im;
+  std::vector<float> window;                    // previous and current input partition
+  std::vector<float> fill;                      // input partition being filled by process()
+  std::vector<float> result;                    // inverse FFT, the second half holds the output partition
+  std::vector<float> last;                      // last delivered background output partition
+  uint               fdl_pos = 0;
+  uint64             result_frame = 0;          // output frame of the pending background result
+  bool               pending = false;
+  bool               stale = false;             // result is late, `last` stands in for it
+  bool               restart = false;           // reset() found the stage busy, clear() is due once it is done
+  std::atomic<bool>  busy { false };            // background job is queued or running
+  Stage (uint partition_, uint offset_, uint n_parts_, bool background_, const float *ir, uint ir_length) :
+    partition (partition_), offset (offset_), n_parts (n_parts_), n_bins (partition + 1), background (background_),
+    fft (2 * partition)
+  {
+    filter_re.resize (n_parts * n_bins);
+    filter_im.resize (n_parts * n_bins);
+    fdl_re.resize (n_parts * n_bins);
+    fdl_im.resize (n_parts * n_bins);
+    acc_re.resize (n_bins);
+    acc_im.resize (n_bins);
+    window.resize (2 * partition);
+    fill.resize (partition);
+    result.resize (2 * partition);
+    last.resize (background ? partition : 0);
+    const float scale = 1.0 / (2 * partition);
+    for (uint k = 0; k < n_parts; k++)
+      {
+        std::fill (window.begin(), window.end(), 0.0f);
+        for (uint i = 0; i < partition && offset + k * partition + i < ir_length; i++)
+          window[i] = scale * ir[offset + k * partition + i];
+        fft.forward (window.data(), &filter_re[k * n_bins], &filter_im[k * n_bins]);
+      }
+    reset();
+  }
+  /// Clear the state that a background job works on, only while not busy.
+  void
+  clear()
+  {
+    std::fill (fdl_re.begin(), fdl_re.end(), 0.0f);
+    std::fill (fdl_im.begin(), fdl_im.end(), 0.0f);
+    std::fill (window.begin(), window.end(), 0.0f);
+    std::fill (last.begin(), last.end(), 0.0f);
+    fdl_pos = 0;
+    restart = false;
+  }
+  /// Clear all state, a busy stage discards its job result and is cleared in complete().
+  void
+  reset()
+  {
+    std::fill (fill.begin(), fill.end(), 0.0f);
+    pending = false;
+    stale = false;
+    if (busy.load (std::memory_order_acquire))
+      restart = true;
+    else
+      clear();
+  }
+  /// Shift the filled partition into the input window.
+  void
+  push_input()
+  {
+    std::copy (window.begin() + partition, window.end(), window.begin());
+    std::copy (fill.begin(), fill.end(), window.begin() + partition);
+  }
+  /// Convolve the input window with all partitions, the output partition starts at `result[partition]`.
+  void
+  compute()
+  {
+    fft.forward (window.data(), &fdl_re[fdl_pos * n_bins], &fdl_im[fdl_pos * n_bins]);
+    std::fill (acc_re.begin(), acc_re.end(), 0.0f);
+    std::fill (acc_im.begin(), acc_im.end(), 0.0f);
+    for (uint k = 0, slot = fdl_pos; k < n_parts; k++, slot = slot ? slot - 1 : n_parts - 1)
+      complex_mac (n_bins, acc_re.data(), acc_im.data(), &fdl_re[slot * n_bins], &fdl_im[slot * n_bins],
+                   &filter_re[k * n_bins], &filter_im[k * n_bins]);
+    fdl_pos = fdl_pos + 1 == n_parts ? 0 : fdl_pos + 1;
+    fft.backward (acc_re.data(), acc_im.data(), result.data());
+  }
+};
+
+// == PartitionedConvolver::Channel ==
+struct PartitionedConvolver::Channel {
+  float head[BLOCK] = {};                       // first taps, ordered oldest to newest input
+  float history[2 * BLOCK] = {};                // inputs, duplicated to stay contiguous
+  std::vector<float> ring;                      // output accumulated from all stages
+  std::vector<std::unique_ptr<Stage>> stages;
+  void
+  ring_add (uint64 frame, const float *src, uint n)
+  {
+    const uint mask = ring.size() - 1, pos = frame & mask, n1 = std::min (n, uint (ring.size()) - pos);
+    mix_gain (n1, &ring[pos], src, 1, 1);
+    mix_gain (n - n1, &ring[0], src + n1, 1, 1);
+  }
+};
+
+static inline float
+dot_product (uint n, const float *a, const float *b)
+{
+  float acc[8] = { 0, 0, 0, 0, 0, 0, 0, 0 };    // independent accumulators allow vectorization
+  for (uint i = 0; i < n; i += 8)
+    for (uint j = 0; j < 8; j++)
+      acc[j] += a[i + j] * b[i + j];
+  return ((acc[0] + acc[1]) + (acc[2] + acc[3])) + ((acc[4] + acc[5]) + (acc[6] + acc[7]));
+}
+
+// == PartitionedConvolver ==
+/// Prepare convolution of `n_channels` channels, channel `c` is convolved with `irs[c]` of `ir_length` taps.
+/// An `offline` convolver waits for late background jobs, e.g. to render exact results faster than realtime.
+PartitionedConvolver::PartitionedConvolver (uint n_channels, const float *const *irs, uint ir_length, bool offline) :
+  ir_length_ (ir_length), offline_ (offline)
+{
+  // partitions grow once the preceding stages cover twice the next partition size, so each background job
+  // is started one partition ahead of the first frame it delivers
+  struct Layout { uint partition, offset, n_parts; };
+  std::vector<Layout> layout;
+  for (uint offset = BLOCK, partition = BLOCK; offset < ir_length; )
+    {
+      const uint next = std::min (partition * GROWTH, MAX_PARTITION);
+      const uint end = next > partition ? std::min (ir_length, 2 * next) : ir_length;
+      const uint n_parts = (end - offset + partition - 1) / partition;
+      layout.push_back ({ partition, offset, n_parts });
+      offset += n_parts * partition;
+      partition = next;
+    }
+  n_stages_ = n_channels ? layout.size() : 0;
+  uint64 ring_size = 1;
+  while (ring_size < (layout.empty() ? BLOCK : layout.back().offset + layout.back().partition))
+    ring_size *= 2;
+  ring_mask_ = ring_size - 1;
+  for (uint c = 0; c < n_channels; c++)
+    {
+      std::unique_ptr<Channel> channel = std::make_unique<Channel>();
+      for (uint i = 0; i < BLOCK && i < ir_length; i++)
+        channel->head[BLOCK - 1 - i] = irs[c][i];
+      channel->ring.resize (ring_size);
+      for (const Layout &l : layout)
+        channel->stages.push_back (std::make_unique<Stage> (l.partition, l.offset, l.n_parts, l.partition > BLOCK, irs[c], ir_length));
+      channels_.push_back (std::move (channel));
+    }
+  if (n_stages_ > 1)
+    thread_ = std::thread (&PartitionedConvolver::run, this);
+}
+
+PartitionedConvolver::~PartitionedConvolver ()
+{
+  if (thread_.joinable())
+    {
+      quit_ = true;
+      sem_.post();
+      thread_.join();
+    }
+}
+
+void
+PartitionedConvolver::run ()
+{
+  this_thread_set_name ("Convolver");
+  sched_fast_priority (this_thread_gettid());
+  while (!quit_)
+    {
+      sem_.wait();
+      if (held_)
+        continue;
+      for (uint s = 1; s < n_stages_; s++)      // smaller partitions have closer deadlines
+        for (auto &channel : channels_)
+          {
+            Stage &stage = *channel->stages[s];
+            if (stage.busy.load (std::memory_order_acquire))
+              {
+                stage.compute();
+                stage.busy.store (false, std::memory_order_release);
+                stage.busy.notify_all();
+              }
+          }
+    }
+}
+
+/// Block until all background jobs are done, e.g. to pace processing that runs faster than realtime.
+void
+PartitionedConvolver::wait_background ()
+{
+  for (auto &channel : channels_)
+    for (auto &stage : channel->stages)
+      stage->busy.wait (true, std::memory_order_acquire);
+}
+
+/// Delay background jobs while `onoff` is set, this simulates missed deadlines for testing.
+void
+PartitionedConvolver::hold_background (bool onoff)
+{
+  held_ = onoff;
+  if (!onoff)
+    sem_.post();
+}
+
+/// Clear all inputs and outputs, only offline convolvers wait for background jobs.
+void
+PartitionedConvolver::reset ()
+{
+  if (offline_)
+    wait_background();
+  for (auto &channel : channels_)
+    {
+      std::fill (std::begin (channel->history), std::end (channel->history), 0.0f);
+      std::fill (channel->ring.begin(), channel->ring.end(), 0.0f);
+      for (auto &stage : channel->stages)
+        stage->reset();
+    }
+  hpos_ = 0;
+  frame_ = 0;
+}
+
+// Handle the completion of an input partition of `stage`.
+void
+PartitionedConvolver::complete (uint s)
+{
+  for (auto &channel : channels_)
+    {
+      Stage &stage = *channel->stages[s];
+      const uint64 frame = frame_ - stage.partition + stage.offset;    // output frame of the new input partition
+      if (!stage.background)
+        {
+          stage.push_input();
+          stage.compute();
+          channel->ring_add (frame, &stage.result[stage.partition], stage.partition);
+          continue;
+        }
+      if (offline_)
+        stage.busy.wait (true, std::memory_order_acquire);
+      else if (stage.busy.load (std::memory_order_acquire))
+        {
+          // the previous job missed its deadline, the last output stands in for it and this input partition is skipped
+          if (stage.pending)
+            channel->ring_add (stage.result_frame, stage.last.data(), stage.partition);
+          stage.result_frame = frame;
+          stage.pending = stage.stale = true;
+          overruns_.fetch_add (1, std::memory_order_relaxed);
+          continue;
+        }
+      if (stage.restart)        // the job was started before reset()
+        stage.clear();
+      if (stage.pending && stage.stale)
+        channel->ring_add (stage.result_frame, stage.last.data(), stage.partition);
+      else if (stage.pending)   // the previous job had one partition length of time
+        {
+          std::copy (&stage.result[stage.partition], &stage.result[2 * stage.partition], stage.last.begin());
+          channel->ring_add (stage.result_frame, stage.last.data(), stage.partition);
+        }
+      stage.stale = false;
+      stage.push_input();
+      stage.result_frame = frame;
+      stage.pending = true;
+      stage.busy.store (true, std::memory_order_release);
+    }
+  if (channels_.size() && channels_[0]->stages[s]->background)
+    sem_.post();
+}
+
+/// Convolve `n_frames` of each channel in `input` into `output`, which may be the same buffers.
+void
+PartitionedConvolver::process (const float *const *input, float *const *output, uint n_frames)
+{
+  for (uint offset = 0; offset < n_frames; )
+    {
+      const uint n = std::min (n_frames - offset, uint (BLOCK - frame_ % BLOCK));
+      const uint hpos = hpos_;
+      for (uint c = 0; c < channels_.size(); c++)
+        {
+          Channel &channel = *channels_[c];
+          const float *x = input[c] + offset;
+          float *y = output[c] + offset;
+          for (auto &stage : channel.stages)
+            std::copy (x, x + n, &stage->fill[frame_ % stage->partition]);
+          uint pos = hpos;
+          for (uint i = 0; i < n; i++)
+            {
+              channel.history[pos] = channel.history[pos + BLOCK] = x[i];
+              pos = pos + 1 == BLOCK ? 0 : pos + 1;
+              float &ring = channel.ring[(frame_ + i) & ring_mask_];
+              y[i] = dot_product (BLOCK, channel.head, channel.history + pos) + ring;
+              ring = 0;
+            }
+          hpos_ = pos;
+        }
+      frame_ += n;
+      offset += n;
+      for (uint s = 0; s < n_stages_; s++)
+        if (frame_ % channels_[0]->stages[s]->partition == 0)
+          complete (s);
+    }
+}
+
+} // Ase
+
+// == Testing ==
+#include "testing.hh"
+#include "randomhash.hh"
+
+namespace { // Anon
+using namespace Ase;
+
+TEST_INTEGRITY (partitioned_convolver_tests);
+static void
+partitioned_convolver_tests()
+{
+  // compare against direct convolution, covering all stages with irregular block sizes
+  const uint L = 2 * 2 * PartitionedConvolver::MAX_PARTITION + 777, N = 3 * L;
+  std::vector<float> ir0 (L), ir1 (L), x (N), y0 (N), y1 (N);
+  for (uint i = 0; i < L; i++)
+    {
+      const float decay = std::exp (-5.0 * i / L);
+      ir0[i] = decay * random_frange (-1, 1);
+      ir1[i] = i == 0 || i == L - 1 ? 0.5 : 0;   // dry plus echo of the last tap
+    }
+  for (auto &v : x)
+    v = random_frange (-1, 1);
+  const float *irs[2] = { ir0.data(), ir1.data() };
+  PartitionedConvolver convolver (2, irs, L, true);     // offline, processing is faster than realtime
+  TCMP (convolver.n_stages(), ==, 3u);
+  for (int pass = 0; pass < 2; pass++)
+    {
+      for (uint offset = 0, n = 1; offset < N; offset += n, n = (n * 7 + 3) % 300 + 1)
+        {
+          n = std::min (n, N - offset);
+          const float *in[2] = { &x[offset], &x[offset] };
+          float *out[2] = { &y0[offset], &y1[offset] };
+          convolver.process (in, out, n);
+        }
+      double max_error = 0;
+      for (uint i = 0; i < N; i += 97)    // sampled, direct convolution is slow
+        {
+          double direct = 0;
+          for (uint k = 0; k <= i && k < L; k++)
+            direct += ir0[k] * x[i - k];
+          max_error = std::max (max_error, std::abs (direct - y0[i]));
+        }
+      TCMP (max_error, <, 2e-4);
+      for (uint i = 0; i < N; i++)
+        TCMP (std::abs (y1[i] - 0.5 * x[i] - (i >= L - 1 ? 0.5 * x[i - L + 1] : 0)), <, 1e-5);
+      TCMP (y0[0], ==, ir0[0] * x[0]);    // zero latency
+      convolver.reset();
+    }
+  TCMP (convolver.overruns(), ==, 0u);
+  // realtime convolvers never wait, late background stages are replaced by their last output
+  auto direct = [&] (uint i, uint n_taps) {
+    double sum = 0;
+    for (uint k = 0; k <= i && k < n_taps; k++)
+      sum += ir0[k] * x[i - k];
+    return sum;
+  };
+  PartitionedConvolver realtime (2, irs, L);
+  const uint B = PartitionedConvolver::BLOCK, FOREGROUND = 2 * B * PartitionedConvolver::GROWTH; // taps of head and first stage
+  std::vector<float> z0 (N), z1 (N);
+  auto process = [&] (uint offset, uint n) {
+    const float *in[2] = { &x[offset], &x[offset] };
+    float *out[2] = { &z0[offset], &z1[offset] };
+    realtime.process (in, out, n);
+  };
+  realtime.hold_background (true);      // all background stages miss their deadlines
+  for (uint offset = 0; offset < 4 * PartitionedConvolver::MAX_PARTITION; offset += B)
+    process (offset, B);
+  TCMP (realtime.overruns(), >, 0u);
+  double max_error = 0;
+  for (uint i = 0; i < 4 * PartitionedConvolver::MAX_PARTITION; i += 7)
+    max_error = std::max (max_error, std::abs (direct (i, FOREGROUND) - z0[i]));
+  TCMP (max_error, <, 2e-4);            // only the foreground taps are heard
+  realtime.reset();                     // must not wait for the held jobs
+  realtime.hold_background (false);
+  realtime.wait_background();
+  // paced processing after reset() is exact again
+  const uint64 overruns = realtime.overruns();
+  for (uint offset = 0; offset < N; offset += B)
+    {
+      process (offset, std::min (B, N - offset));
+      realtime.wait_background();
+    }
+  TCMP (realtime.overruns(), ==, overruns);
+  TASSERT (z0 == y0 && z1 == y1);
+  // a late stage in the middle of processing keeps the output bounded, exact output returns
+  realtime.reset();
+  double bound = 0;
+  for (uint i = 0; i < L; i++)
+    bound += std::abs (ir0[i]);
+  const uint late_start = L, late_end = L + 2 * PartitionedConvolver::MAX_PARTITION, exact = late_end + L + 2 * PartitionedConvolver::MAX_PARTITION;
+  for (uint offset = 0; offset < N; offset += B)
+    {
+      realtime.hold_background (offset >= late_start && offset < late_end);
+      process (offset, std::min (B, N - offset));
+      if (offset < late_start || offset >= late_end)
+        realtime.wait_background();
+    }
+  TCMP (realtime.overruns(), >, overruns);
+  max_error = 0;
+  for (uint i = 0; i < N; i++)
+    {
+      TCMP (std::abs (z0[i]), <, bound);
+      if (i >= exact)
+        max_error = std::max (max_error, double (std::abs (z0[i] - y0[i])));
+    }
+  TCMP (max_error, <, 1e-5);
+  // short responses only use the direct head
+  const float echo[3] = { 0, 0, 1 };
+  const float *eirs[1] = { echo };
+  PartitionedConvolver head (1, eirs, 3);
+  TCMP (head.n_stages(), ==, 0u);
+  const float *in[1] = { x.data() };
+  float *out[1] = { y0.data() };
+  head.process (in, out, 100);
+  for (uint i = 0; i < 100; i++)
+    TCMP (y0[i], ==, i >= 2 ? x[i - 2] : 0);
+}
+
+} // Anon
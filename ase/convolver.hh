@@ -0,0 +1,51 @@
+// This Source Code Form is licensed MPL-2.0: http://mozilla.org/MPL/2.0
+#ifndef __ASE_CONVOLVER_HH__
+#define __ASE_CONVOLVER_HH__
+
+#include <ase/fft.hh>
+#include <ase/platform.hh>
+
+namespace Ase {
+
+/// Zero latency convolution of several channels with long impulse responses, using non-uniformly partitioned FFTs.
+/// The first BLOCK taps are applied as direct FIR, the remaining taps are split into uniformly partitioned stages
+/// whose partition sizes grow by GROWTH up to MAX_PARTITION. The smallest stage is computed within process(),
+/// larger stages are handed to a background thread which has one partition length of time to deliver.
+/// If it misses that deadline, process() does not wait but repeats the last output partition of the stage,
+/// see overruns().
+class PartitionedConvolver {
+  struct Stage;
+  struct Channel;
+  std::vector<std::unique_ptr<Channel>> channels_;
+  uint                  n_stages_ = 0;
+  uint                  ir_length_ = 0;
+  uint                  hpos_ = 0;
+  uint64                frame_ = 0;
+  uint64                ring_mask_ = 0;
+  const bool            offline_;
+  std::atomic<uint64>   overruns_ { 0 };
+  std::atomic<bool>     held_ { false };
+  std::atomic<bool>     quit_ { false };
+  ScopedSemaphore       sem_;
+  std::thread           thread_;
+  void run             ();
+  void complete        (uint stage);
+public:
+  static constexpr uint BLOCK = 64;             ///< Length of the direct FIR head and the smallest partition.
+  static constexpr uint GROWTH = 8;             ///< Partition size ratio of consecutive stages.
+  static constexpr uint MAX_PARTITION = 4096;   ///< Largest partition size.
+  explicit PartitionedConvolver (uint n_channels, const float *const *irs, uint ir_length, bool offline = false);
+  /*dtor*/ ~PartitionedConvolver ();
+  void     reset                 ();
+  void     wait_background       ();
+  void     hold_background       (bool onoff);
+  void     process               (const float *const *input, float *const *output, uint n_frames);
+  uint     n_channels            () const       { return channels_.size(); }    ///< Number of channels passed to process().
+  uint     n_stages              () const       { return n_stages_; }           ///< Number of FFT partition stages.
+  uint     ir_length             () const       { return ir_length_; }          ///< Length of the impulse responses.
+  uint64   overruns              () const       { return overruns_.load (std::memory_order_relaxed); } ///< Count missed background deadlines.
+};
+
+} // Ase
+
+#endif // __ASE_CONVOLVER_HH__
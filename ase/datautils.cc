@@ -18,10 +18,8 @@ square_sum (uint n_values, const float *ivalues)
 float
 square_max (uint n_values, const float *ivalues)
 {
-  float accu = 0.0;
-  for (uint i = 0; i < n_values; i++)
-    accu = std::max (accu, ivalues[i] * ivalues[i]);
-  return accu;
+  const float amax = abs_max (n_values, ivalues);
+  return amax * amax;
 }
 
 } // Ase
@@ -3,6 +3,7 @@
 #define __ASE_DATAUTILS_HH__
 
 #include <ase/signalmath.hh>
+#include <ase/simd.hh>
 
 namespace Ase {
 
@@ -55,23 +56,14 @@ template<> inline void
 convert_samples (size_t n, const int16_t *src, float *dst, uint16 byte_order)
 {
   ASE_ASSERT_RETURN (__BYTE_ORDER__ == byte_order); // swapping __BYTE_ORDER__ not implemented
-  const auto bound = dst + n;
-  while (dst < bound)
-    *dst++ = *src++ * (1. / 32768.);
+  int16_to_float (n, dst, src);
 }
 
 template<> inline void
 convert_clip_samples (size_t n, const float *src, int16_t *dst, uint16 byte_order)
 {
   ASE_ASSERT_RETURN (__BYTE_ORDER__ == byte_order); // swapping __BYTE_ORDER__ not implemented
-  static_assert (int16_t (0.99999990F * 32768.F) == 32767);
-  const auto bound = src + n;
-  while (src < bound)
-    {
-      auto v = *src++;
-      v = std::min (0.99999990F, std::max (v, -1.0F));
-      *dst++ = v * 32768.;
-    }
+  float_to_int16 (n, dst, src);
 }
 
 } // Ase
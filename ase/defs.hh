@@ -37,7 +37,10 @@ ASE_STRUCT_DECLS (TelemetrySegment);
 ASE_STRUCT_DECLS (UserNote);
 
 // == Class Forward Declarations ==
+ASE_CLASS_DECLS (Anticipation);
 ASE_CLASS_DECLS (AudioChain);
+ASE_CLASS_DECLS (AudioClipCapture);
+ASE_CLASS_DECLS (AudioClipStream);
 ASE_CLASS_DECLS (AudioCombo);
 ASE_CLASS_DECLS (AudioCombo);
 ASE_CLASS_DECLS (AudioEngineThread);
@@ -53,6 +56,7 @@ ASE_CLASS_DECLS (FileCrawler);
 ASE_CLASS_DECLS (Gadget);
 ASE_CLASS_DECLS (GadgetImpl);
 ASE_CLASS_DECLS (Monitor);
+ASE_CLASS_DECLS (MonitorAnalyzer);
 ASE_CLASS_DECLS (NativeDevice);
 ASE_CLASS_DECLS (NativeDeviceImpl);
 ASE_CLASS_DECLS (Object);
@@ -62,6 +66,8 @@ ASE_CLASS_DECLS (ProjectImpl);
 ASE_CLASS_DECLS (Property);
 ASE_CLASS_DECLS (PropertyImpl);
 ASE_CLASS_DECLS (ResourceCrawler);
+ASE_CLASS_DECLS (SampleLibrary);
+ASE_CLASS_DECLS (SampleLibraryImpl);
 ASE_CLASS_DECLS (Server);
 ASE_CLASS_DECLS (ServerImpl);
 ASE_CLASS_DECLS (SharedBase);
@@ -3,6 +3,7 @@
 #include "nativedevice.hh"
 #include "combo.hh"
 #include "project.hh"
+#include "track.hh"
 #include "jsonipc/jsonipc.hh"
 #include "serialize.hh"
 #include "internal.hh"
@@ -56,6 +57,43 @@ DeviceImpl::_disconnect_remove ()
   engine->async_jobs += j;
 }
 
+/// Connect the output of the `source` track to the SIDECHAIN input bus of the device processor.
+/// The engine schedules the source track before this device, input buffers are shared, not copied.
+bool
+DeviceImpl::set_sidechain (TrackP source)
+{
+  AudioProcessorP proc = _audio_processor();
+  return_unless (proc && proc->n_ibuses() >= size_t (SIDECHAIN), false);
+  TrackImpl *track = dynamic_cast<TrackImpl*> (_track());
+  TrackImplP strack = shared_ptr_cast<TrackImpl> (source);
+  return_unless (track, false);
+  if (source)
+    {
+      return_unless (strack && strack.get() != track && strack->project() == track->project(), false);
+      return_unless (!track->feeds (*strack), false); // avoid feedback loops
+    }
+  return_unless (source != sidechain_, true);
+  AudioProcessorP sproc = strack ? strack->access_device()->_audio_processor() : nullptr;
+  if (sproc)
+    {
+      const BusInfo ibus = proc->bus_info (SIDECHAIN), obus = sproc->bus_info (OBusId (1));
+      return_unless (ibus.n_channels() <= obus.n_channels() ||
+                     (ibus.speakers == SpeakerArrangement::STEREO && obus.speakers == SpeakerArrangement::MONO), false);
+    }
+  sidechain_ = source;
+  auto j = [proc, sproc] () {
+    if (sproc)
+      proc->connect (SIDECHAIN, *sproc, OBusId (1));
+    else
+      proc->disconnect (SIDECHAIN);
+  };
+  proc->engine().async_jobs += j;
+  track->update_anticipation();
+  track->freeze_invalidate();
+  emit_notify ("sidechain");
+  return true;
+}
+
 DeviceInfo
 DeviceImpl::extract_info (const String &aseid, const AudioProcessor::StaticInfo &static_info)
 {
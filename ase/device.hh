@@ -9,6 +9,7 @@ namespace Ase {
 
 class DeviceImpl : public GadgetImpl, public virtual Device {
   bool            activated_ = false;
+  TrackP          sidechain_;
 protected:
   explicit        DeviceImpl           () {} // abstract base
   void            _set_parent          (GadgetImpl *parent) override;
@@ -20,6 +21,9 @@ public:
   bool            gui_visible          () override { return false; }
   void            gui_toggle           () override {}
   void            _disconnect_remove   () override;
+  bool            set_sidechain        (TrackP source) override;
+  TrackP          get_sidechain        () override { return sidechain_; }
+  static constexpr IBusId SIDECHAIN = IBusId (2); ///< Secondary input bus used for sidechains.
   static DeviceInfo extract_info       (const String &aseid, const AudioProcessor::StaticInfo &static_info);
 };
 
@@ -351,6 +351,7 @@ class AlsaPcmDriver : public PcmDriver {
   uint          n_periods_ = 0;
   int           period_size_ = 0;       // count in frames
   int16        *period_buffer_ = nullptr;
+  SampleDither  dither_;                // decorrelates 16 bit quantization from the output signal
   uint          read_write_count_ = 0;
   String        alsadev_;
 public:
@@ -494,10 +495,10 @@ public:
       return_error ("snd_pcm_hw_params_set_access", DEVICE_FORMAT);
     if (snd_pcm_hw_params_set_format (phandle, hparams, SND_PCM_FORMAT_S16_LE) < 0)
       return_error ("snd_pcm_hw_params_set_format", DEVICE_FORMAT);
-    // sample_rate
+    // sample_rate, the engine resamples if the device does not support the requested rate
     uint rate = *mix_freq;
-    if (snd_pcm_hw_params_set_rate (phandle, hparams, rate, 0) < 0 || rate != *mix_freq)
-      return_error ("snd_pcm_hw_params_set_rate", DEVICE_FREQUENCY);
+    if (snd_pcm_hw_params_set_rate_near (phandle, hparams, &rate, nullptr) < 0)
+      return_error ("snd_pcm_hw_params_set_rate_near", DEVICE_FREQUENCY);
     PDEBUG ("SETUP: %s: rate: %d", alsadev_, rate);
     // fragment size
     snd_pcm_uframes_t period_min = 2, period_max = 1048576;
@@ -706,7 +707,7 @@ public:
     size_t n_left = period_size_;       // in frames
     while (n_left)
       {
-        convert_clip_samples (n_left * n_channels_, floats, period_buffer_, __BYTE_ORDER__);
+        float_to_int16 (n_left * n_channels_, period_buffer_, floats, &dither_);
         floats += n_left * n_channels_;
         ssize_t n = 0;                  // in frames
         n = snd_pcm_writei (write_handle_, period_buffer_, n_left);
@@ -845,17 +845,20 @@ public:
     uint frames_read = input_ringbuffer_.read (block_length_, deinterleaved_frames);
     assert_return (frames_read == block_length_, 0);
 
-    for (uint ch = 0; ch < n_channels_; ch++)
-      {
-        const float *src = deinterleaved_frames[ch];
-        float *dest = &values[ch];
+    if (n_channels_ == 2)
+      interleave_stereo (frames_read, values, deinterleaved_frames[0], deinterleaved_frames[1], false);
+    else
+      for (uint ch = 0; ch < n_channels_; ch++)
+        {
+          const float *src = deinterleaved_frames[ch];
+          float *dest = &values[ch];
 
-        for (uint i = 0; i < frames_read; i++)
-          {
-            *dest = src[i];
-            dest += n_channels_;
-          }
-      }
+          for (uint i = 0; i < frames_read; i++)
+            {
+              *dest = src[i];
+              dest += n_channels_;
+            }
+        }
     return block_length_ * n_channels_;
   }
   virtual void
@@ -882,12 +885,16 @@ public:
     float deinterleaved_frame_data[block_length_ * n_channels_];
     const float *deinterleaved_frames[n_channels_];
     for (uint ch = 0; ch < n_channels_; ch++)
-      {
-        float *channel_data = &deinterleaved_frame_data[ch * block_length_];
-        for (uint i = 0; i < block_length_; i++)
-          channel_data[i] = values[ch + i * n_channels_];
-        deinterleaved_frames[ch] = channel_data;
-      }
+      deinterleaved_frames[ch] = &deinterleaved_frame_data[ch * block_length_];
+    if (n_channels_ == 2)
+      deinterleave_stereo (block_length_, deinterleaved_frame_data, deinterleaved_frame_data + block_length_, values);
+    else
+      for (uint ch = 0; ch < n_channels_; ch++)
+        {
+          float *channel_data = &deinterleaved_frame_data[ch * block_length_];
+          for (uint i = 0; i < block_length_; i++)
+            channel_data[i] = values[ch + i * n_channels_];
+        }
 
     // in check_io, we already ensured that there is enough space in the output_ringbuffer
 
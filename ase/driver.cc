@@ -3,6 +3,7 @@
 #include "path.hh"
 #include "platform.hh"
 #include "datautils.hh"
+#include "resampler.hh"
 #include "internal.hh"
 
 #define DDEBUG(...)     Ase::debug ("driver", __VA_ARGS__)
@@ -420,6 +421,103 @@ public:
 
 static const String null_midi_driverid = MidiDriver::register_driver ("null", NullMidiDriver::create, NullMidiDriver::list_drivers);
 
+// == ResamplingPcmDriver ==
+/// Adapter that accepts PCM output at the engine rate and converts it to the rate of a device driver.
+class ResamplingPcmDriver : public PcmDriver {
+  PcmDriverP         driver_;
+  PolyphaseResampler resampler_;
+  uint               mix_freq_ = 0, block_length_ = 0, n_channels_ = 0, driver_block_ = 0;
+  std::vector<float> fifo_;             // interleaved frames at the driver rate
+  size_t             fifo_frames_ = 0;
+public:
+  explicit
+  ResamplingPcmDriver (PcmDriverP driver) :
+    PcmDriver ("resampler", driver->devid()), driver_ (driver)
+  {}
+  bool
+  setup (uint mix_freq, PolyphaseResampler::Quality quality)
+  {
+    n_channels_ = driver_->pcm_n_channels();
+    driver_block_ = driver_->pcm_block_length();
+    return_unless (resampler_.setup (mix_freq, driver_->pcm_mix_freq(), n_channels_, quality), false);
+    mix_freq_ = mix_freq;
+    // engine blocks must be multiples of 8 frames
+    block_length_ = (uint64 (driver_block_) * mix_freq_ / driver_->pcm_mix_freq() + 7) / 8 * 8;
+    fifo_.resize ((driver_block_ + resampler_.max_output (block_length_)) * n_channels_);
+    if (driver_->readable())
+      warning ("%s: refusing PCM capture at %u Hz, input is not resampled", driver_->devid(), driver_->pcm_mix_freq());
+    flags_ = Flags::OPENED | Flags::WRITABLE; // never READABLE
+    return true;
+  }
+  uint pcm_n_channels   () const override       { return n_channels_; }
+  uint pcm_mix_freq     () const override       { return mix_freq_; }
+  uint pcm_block_length () const override       { return block_length_; }
+  void
+  pcm_latency (uint *rlatency, uint *wlatency) const override
+  {
+    uint rl = 0, wl = 0;
+    driver_->pcm_latency (&rl, &wl);
+    const uint driver_freq = driver_->pcm_mix_freq();
+    *rlatency = uint64 (rl) * mix_freq_ / driver_freq;
+    *wlatency = uint64 (wl + driver_block_) * mix_freq_ / driver_freq + resampler_.delay();
+  }
+  void
+  close () override
+  {
+    assert_return (opened());
+    driver_->close();
+    flags_ &= ~size_t (Flags::OPENED | Flags::READABLE | Flags::WRITABLE);
+  }
+  Error
+  open (IODir iodir, const PcmDriverConfig &config) override
+  {
+    return Error::INTERNAL; // constructed via pcm_driver_resampled()
+  }
+  bool
+  pcm_check_io (int64 *timeoutp) override
+  {
+    // pass complete device blocks on, accept more input once a block is missing
+    while (fifo_frames_ >= driver_block_)
+      {
+        if (!driver_->pcm_check_io (timeoutp))
+          return false;
+        driver_->pcm_write (driver_block_ * n_channels_, fifo_.data());
+        fifo_frames_ -= driver_block_;
+        std::copy_n (&fifo_[driver_block_ * n_channels_], fifo_frames_ * n_channels_, fifo_.data());
+      }
+    return true;
+  }
+  void
+  pcm_write (size_t n, const float *values) override
+  {
+    const size_t n_frames = n / n_channels_;
+    assert_return (n_frames <= block_length_ && fifo_frames_ < driver_block_);
+    fifo_frames_ += resampler_.process (n_frames, values, &fifo_[fifo_frames_ * n_channels_]);
+    int64 timeout = 0;
+    pcm_check_io (&timeout);
+  }
+  size_t
+  pcm_read (size_t n, float *values) override
+  {
+    assert_return (readable(), 0); // capture is refused in setup()
+    return 0;
+  }
+};
+
+/// Wrap a PCM output `driver` running at a different rate, so it accepts PCM data at `mix_freq`.
+/// The wrapper is write-only, capture is refused with a warning for a readable `driver`.
+/// Returns `nullptr` if the rates cannot be converted.
+PcmDriverP
+pcm_driver_resampled (PcmDriverP driver, uint mix_freq, int quality)
+{
+  assert_return (driver && driver->opened() && driver->writable(), nullptr);
+  auto resampler = std::make_shared<ResamplingPcmDriver> (driver);
+  if (!resampler->setup (mix_freq, PolyphaseResampler::Quality (CLAMP (quality, 0, 2))))
+    return nullptr;
+  DDEBUG ("RESAMPLER: %s: %u -> %u Hz, block=%u", driver->devid(), mix_freq, driver->pcm_mix_freq(), resampler->pcm_block_length());
+  return resampler;
+}
+
 } // Ase
 
 // == jackdriver.so ==
@@ -113,6 +113,8 @@ public:
 };
 using PcmDriverP = PcmDriver::PcmDriverP;
 
+PcmDriverP pcm_driver_resampled (PcmDriverP driver, uint mix_freq, int quality);
+
 bool* register_driver_loader  (const char *staticwhat, Error (*loader) ());
 void  load_registered_drivers ();
 
@@ -8,6 +8,7 @@
 #include "datautils.hh"
 #include "atomics.hh"
 #include "project.hh"
+#include "track.hh"
 #include "wave.hh"
 #include "main.hh"      // main_loop_autostop_mt
 #include "memory.hh"
@@ -26,6 +27,8 @@ using VoidFunc = std::function<void()>;
 using StartQueue = AsyncBlockingQueue<char>;
 ASE_CLASS_DECLS (EngineMidiInput);
 static void apply_driver_preferences ();
+static void apply_anticipation_preference ();
+static void apply_engine_preferences ();
 
 // == EngineJobImpl ==
 struct EngineJobImpl {
@@ -42,11 +45,363 @@ atomic_next_ptrref (EngineJobImpl *j)
 struct DriverSet {
   PcmDriverP  null_pcm_driver;
   String      pcm_name;
-  PcmDriverP  pcm_driver;
+  PcmDriverP  pcm_device;       // opened device, may run at a different rate
+  PcmDriverP  pcm_driver;       // pcm_device or a resampler that feeds it
+  int         src_quality = -1;
   StringS     midi_names;
   MidiDriverS midi_drivers;
 };
 
+// == Engine CPUs ==
+static constexpr size_t ENGINE_STACK_PREFAULT = 256 * 1024;
+static std::mutex engine_cpus_mutex;
+static std::vector<uint> engine_cpus;                   // MT-Guarded by engine_cpus_mutex, empty if unpinned
+static std::map<int,int> &engine_thread_slots = *new std::map<int,int>(); // tid -> slot, MT-Guarded
+
+static void
+engine_thread_pin_L (int tid, int slot)
+{
+  if (engine_cpus.empty())
+    sched_set_affinity (tid, {});
+  else if (slot < 0)
+    sched_set_affinity (tid, engine_cpus);
+  else
+    sched_set_affinity (tid, { engine_cpus[slot % engine_cpus.size()] });
+}
+
+/// Setup the calling thread for realtime rendering, `slot` selects an engine CPU, -1 floats across all of them.
+static void
+engine_thread_register (int slot)
+{
+  const int tid = this_thread_gettid();
+  sched_fast_priority (tid);
+  stack_prefault (ENGINE_STACK_PREFAULT);
+  std::lock_guard<std::mutex> locker (engine_cpus_mutex);
+  engine_thread_slots[tid] = slot;
+  if (!engine_cpus.empty())
+    engine_thread_pin_L (tid, slot);
+}
+
+static void
+engine_thread_unregister ()
+{
+  std::lock_guard<std::mutex> locker (engine_cpus_mutex);
+  engine_thread_slots.erase (this_thread_gettid());
+}
+
+/// Pin the engine threads to `cpus` and keep all other threads of the process off them.
+/// A list that covers all CPUs is rejected, since it leaves no CPU for the other threads.
+static bool
+engine_cpus_update (const std::vector<uint> &cpus)
+{
+  std::lock_guard<std::mutex> locker (engine_cpus_mutex);
+  return_unless (cpus != engine_cpus, true);
+  std::vector<uint> others;
+  const uint n_cpus = this_thread_online_cpus();
+  for (uint cpu = 0; cpu < n_cpus && !cpus.empty(); cpu++)
+    if (std::find (cpus.begin(), cpus.end(), cpu) == cpus.end())
+      others.push_back (cpu);
+  return_unless (cpus.empty() || !others.empty(), false);
+  engine_cpus = cpus;
+  // threads created later inherit the affinity of the main thread
+  for (int tid : this_process_tids())
+    {
+      auto it = engine_thread_slots.find (tid);
+      if (it != engine_thread_slots.end())
+        engine_thread_pin_L (tid, it->second);
+      else
+        sched_set_affinity (tid, others);
+    }
+  String cpulist;
+  for (uint cpu : cpus)
+    cpulist += string_format ("%s%u", cpulist.empty() ? "" : ",", cpu);
+  EDEBUG ("engine CPUs: %s\n", cpus.empty() ? "all" : cpulist);
+  return true;
+}
+
+/// Number of workers that help the engine thread, one less than the available engine CPUs.
+static uint
+engine_worker_count ()
+{
+  std::lock_guard<std::mutex> locker (engine_cpus_mutex);
+  const uint n_cpus = engine_cpus.empty() ? std::thread::hardware_concurrency() : engine_cpus.size();
+  return n_cpus > 1 ? n_cpus - 1 : 0;
+}
+
+// == EngineWorkers ==
+/// Realtime threads helping the engine thread to execute AudioEngine::parallel_for() tasks.
+class EngineWorkers {
+  static constexpr uint MAX_WORKERS = 15;
+  static constexpr uint SPIN_ROUNDS = 4096;
+  struct alignas (64) Slot {
+    std::atomic<uint32> generation = 0;         // bumped to wake up a worker
+    std::thread        *thread = nullptr;
+  };
+  Slot                              slots_[MAX_WORKERS];
+  uint                              n_workers_ = 0;
+  std::atomic<bool>                 quit_ = false;
+  alignas (64) std::atomic<uint32>  next_ = 0;  // next task index to claim
+  alignas (64) std::atomic<uint32>  pending_ = 0; // workers that have not yet finished the current request
+  uint32                            n_tasks_ = 0;
+  AudioEngine::TaskFunc             task_ = nullptr;
+  void                             *data_ = nullptr;
+  std::atomic<bool>                 paused_ = false; // no requests are issued while set
+  void run_tasks   ();
+  void worker_loop (uint index);
+public:
+  void start        (uint n_workers);
+  void stop         ();
+  uint n_workers    () const    { return n_workers_; }
+  void pause        (bool onoff) { paused_.store (onoff, std::memory_order_release); }
+  bool parallel_for (uint32 n_tasks, AudioEngine::TaskFunc task, void *data);
+};
+
+static thread_local bool engine_worker_thread = false;
+
+void
+EngineWorkers::start (uint n_workers)
+{
+  assert_return (n_workers_ == 0);
+  n_workers = std::min (n_workers, MAX_WORKERS);
+  quit_ = false;
+  for (n_workers_ = 0; n_workers_ < n_workers; n_workers_++)
+    {
+      slots_[n_workers_].generation = 0;
+      slots_[n_workers_].thread = new std::thread (&EngineWorkers::worker_loop, this, n_workers_);
+    }
+}
+
+void
+EngineWorkers::stop()
+{
+  quit_ = true;
+  for (uint i = 0; i < n_workers_; i++)
+    {
+      slots_[i].generation.fetch_add (1, std::memory_order_release);
+      slots_[i].generation.notify_one();
+      slots_[i].thread->join();
+      delete slots_[i].thread;
+      slots_[i].thread = nullptr;
+    }
+  n_workers_ = 0;
+}
+
+void
+EngineWorkers::run_tasks()
+{
+  for (uint32 i = next_.fetch_add (1, std::memory_order_relaxed); i < n_tasks_; i = next_.fetch_add (1, std::memory_order_relaxed))
+    task_ (data_, i);
+}
+
+void
+EngineWorkers::worker_loop (uint index)
+{
+  this_thread_set_name (string_format ("AudioEngine-%u", index + 1)); // max 16 chars
+  engine_thread_register (index + 1);
+  engine_worker_thread = true;
+  Slot &slot = slots_[index];
+  uint32 seen = 0;                              // requests may be issued before we get here
+  for (;;)
+    {
+      slot.generation.wait (seen, std::memory_order_acquire);
+      seen = slot.generation.load (std::memory_order_acquire);
+      if (quit_)
+        break;
+      run_tasks();
+      if (pending_.fetch_sub (1, std::memory_order_acq_rel) == 1)
+        pending_.notify_one();
+    }
+  engine_thread_unregister();
+}
+
+bool
+EngineWorkers::parallel_for (uint32 n_tasks, AudioEngine::TaskFunc task, void *data)
+{
+  return_unless (!paused_.load (std::memory_order_acquire), false);
+  return_unless (n_workers_ > 0 && n_tasks > 0 && !engine_worker_thread, false);
+  // request fields are only rewritten after all woken workers checked out
+  task_ = task;
+  data_ = data;
+  n_tasks_ = n_tasks;
+  next_.store (0, std::memory_order_relaxed);
+  const uint n_wake = std::min (n_workers_, n_tasks - 1);
+  pending_.store (n_wake, std::memory_order_relaxed);
+  for (uint i = 0; i < n_wake; i++)
+    {
+      slots_[i].generation.fetch_add (1, std::memory_order_release);
+      slots_[i].generation.notify_one();
+    }
+  run_tasks();
+  // workers usually finish shortly after us, so spin before blocking
+  for (uint spin = 0; spin < SPIN_ROUNDS && pending_.load (std::memory_order_acquire); spin++)
+    ;
+  for (uint32 p = pending_.load (std::memory_order_acquire); p; p = pending_.load (std::memory_order_acquire))
+    pending_.wait (p, std::memory_order_acquire);
+  return true;
+}
+
+// == EngineAnticipator ==
+/// Thread that renders Anticipation sections ahead of the PCM output.
+/// The engine thread holds it while modifying processors that are rendered ahead.
+class EngineAnticipator {
+  static constexpr uint SPIN_ROUNDS = 4096;
+  std::thread                      *thread_ = nullptr;
+  std::atomic<bool>                 quit_ = false;
+  alignas (64) std::atomic<bool>    hold_ = false;      // engine thread requests exclusive access
+  alignas (64) std::atomic<bool>    busy_ = false;      // rendering in progress
+  alignas (64) std::atomic<uint32>  generation_ = 0;    // bumped to wake up the thread
+  void thread_loop ();
+  bool render_next ();
+public:
+  std::vector<AnticipationP>        anticipations;      // only modified while held
+  void start          ();
+  void stop           ();
+  bool hold           (bool spin);
+  void release        ();
+  bool needs_rollback () const;
+};
+
+void
+EngineAnticipator::start()
+{
+  assert_return (thread_ == nullptr);
+  quit_ = false;
+  thread_ = new std::thread (&EngineAnticipator::thread_loop, this);
+}
+
+void
+EngineAnticipator::stop()
+{
+  assert_return (thread_ != nullptr);
+  quit_ = true;
+  generation_.fetch_add (1, std::memory_order_release);
+  generation_.notify_one();
+  thread_->join();
+  delete thread_;
+  thread_ = nullptr;
+  anticipations.clear();
+}
+
+/// Stop rendering ahead after the current block, returns true once the anticipation thread is idle.
+/// With `spin`, waits briefly for the current block to finish, but never blocks the caller.
+bool
+EngineAnticipator::hold (bool spin)
+{
+  // seq_cst ordering pairs with render_next(), either we see busy_ or it sees hold_
+  hold_.store (true);
+  if (!busy_.load())
+    return true;
+  for (uint i = 0; spin && i < SPIN_ROUNDS; i++)
+    if (!busy_.load())
+      return true;
+  return false;
+}
+
+/// Continue rendering ahead, e.g. after blocks were consumed.
+void
+EngineAnticipator::release()
+{
+  hold_.store (false);
+  return_unless (!anticipations.empty());
+  generation_.fetch_add (1, std::memory_order_release);
+  generation_.notify_one();
+}
+
+bool
+EngineAnticipator::needs_rollback() const
+{
+  for (const AnticipationP &anticipation : anticipations)
+    if (anticipation->invalid_)
+      return true;
+  return false;
+}
+
+bool
+EngineAnticipator::render_next()
+{
+  busy_.store (true);
+  bool rendered = false;
+  if (!hold_.load())
+    {
+      // serve the section with the fewest queued blocks first
+      Anticipation *next = nullptr;
+      for (const AnticipationP &anticipation : anticipations)
+        if (!anticipation->invalid_ && anticipation->has_space() &&
+            (!next || anticipation->pending() < next->pending()))
+          next = anticipation.get();
+      if (next)
+        rendered = next->render_block();
+    }
+  busy_.store (false);
+  return rendered;
+}
+
+void
+EngineAnticipator::thread_loop()
+{
+  this_thread_set_name ("AudioEngine-A"); // max 16 chars
+  engine_thread_register (-1);
+  engine_worker_thread = true;          // audio thread, but must not issue parallel_for()
+  uint32 seen = 0;
+  for (;;)
+    {
+      generation_.wait (seen, std::memory_order_acquire);
+      seen = generation_.load (std::memory_order_acquire);
+      if (quit_)
+        break;
+      while (render_next())
+        ;
+    }
+  engine_thread_unregister();
+}
+
+// == OutputDelay ==
+/// Delay line for an engine output, compensating latency differences between outputs.
+/// The lines are allocated in the main_thread and always hold the recent output, so
+/// the delay can change on the engine thread by moving the read offset only.
+struct OutputDelay {
+  static constexpr uint MAX_DELAY = 65536 - 1, RING_MASK = 65536 - 1;
+  struct Lines {
+    std::vector<float> ring[2];
+    Lines() { for (auto &r : ring) r.resize (RING_MASK + 1); }
+  };
+  AudioProcessor        *proc = nullptr;
+  uint                   delay = 0, pos = 0;
+  uint                   filled = 0;    // frames of proc output held in lines
+  std::unique_ptr<Lines> lines;
+  void
+  setup (AudioProcessor *aproc, uint nframes)
+  {
+    if (proc != aproc)
+      {
+        proc = aproc;
+        filled = 0;     // stale frames are never output
+      }
+    delay = std::min (nframes, MAX_DELAY);
+  }
+  void
+  process (uint n_frames, const float *src[2], float *dst[2])
+  {
+    const uint silent = delay > filled ? std::min (delay - filled, n_frames) : 0;
+    for (size_t c = 0; c < 2; c++)
+      {
+        float *const r = lines->ring[c].data();
+        const float *const s = src[c];
+        float *const d = dst[c];
+        uint p = pos;
+        for (uint i = 0; i < n_frames; i++)
+          {
+            r[p] = s[i];
+            d[i] = r[(p - delay) & RING_MASK];
+            p = (p + 1) & RING_MASK;
+          }
+        floatfill (d, 0.0, silent);
+      }
+    pos = (pos + n_frames) & RING_MASK;
+    filled = std::min (filled + n_frames, RING_MASK + 1);
+  }
+};
+
 // == AudioEngineThread ==
 class AudioEngineThread : public AudioEngine {
 public:
@@ -59,10 +414,19 @@ public:
   std::vector<AudioProcessor*> schedule_;
   EngineMidiInputP             midi_proc_;
   bool                         schedule_invalid_ = true;
+  bool                         latency_invalid_ = true;
+  std::vector<OutputDelay>     odelays_;      // latency compensation for oprocs_
+  bool                         odelay_lines_pending_ = false;
+  alignas (64) float           delayed_[2][MAX_BUFFER_SIZE] = {};
   bool                         output_needsrunning_ = false;
   AtomicIntrusiveStack<EngineJobImpl> async_jobs_, const_jobs_, trash_jobs_;
   const VoidF                  owner_wakeup_;
   std::thread                 *thread_ = nullptr;
+  EngineWorkers                workers_;
+  EngineAnticipator            anticipator_;
+  AnticipationP                sched_target_;   // redirects schedule_add()
+  uint                         anticipation_frames_ = 0;
+  uint                         anticipation_ms_ = 0;    // main_loop thread copy
   MainLoopP                    event_loop_ = MainLoop::create();
   AudioProcessorS              oprocs_;
   ProjectImplP                 project_;
@@ -70,6 +434,7 @@ public:
   FastMemory::Block            transport_block_;
   DriverSet                    driver_set_ml; // accessed by main_loop thread
   std::atomic<uint64>          autostop_ = U64MAX;
+  ThreadUsage                  render_usage_;   // page faults and preemptions during schedule_render()
   struct UserNoteJob {
     std::atomic<UserNoteJob*> next = nullptr;
     UserNote note;
@@ -82,6 +447,7 @@ public:
   void            schedule_add           (AudioProcessor &aproc, uint level);
   void            schedule_queue_update  ();
   void            schedule_render        (uint64 frames);
+  void            update_latencies       ();
   void            enable_output          (AudioProcessor &aproc, bool onoff);
   void            wakeup_thread_mt       ();
   void            capture_start          (const String &filename, bool needsrunning);
@@ -100,12 +466,15 @@ public:
   void            update_driver_set      (DriverSet &dset);
   void            start_threads_ml       ();
   void            stop_threads_ml        ();
+  void            update_workers_ml      (uint n_workers);
   void            create_processors_ml   ();
+  void            create_output_delay_ml ();
   String          engine_stats_string    (uint64_t stats) const;
 };
 
 static std::thread::id audio_engine_thread_id = {};
 const ThreadId &AudioEngine::thread_id = audio_engine_thread_id;
+__thread const AudioTransport *AudioEngine::tls_transport = nullptr;
 
 static inline std::atomic<AudioEngineThread::UserNoteJob*>&
 atomic_next_ptrref (AudioEngineThread::UserNoteJob *j)
@@ -113,44 +482,12 @@ atomic_next_ptrref (AudioEngineThread::UserNoteJob *j)
   return j->next;
 }
 
-template<int ADDING> static void
-interleaved_stereo (const size_t n_frames, float *buffer, AudioProcessor &proc, OBusId obus)
+static void
+interleaved_stereo (const size_t n_frames, float *buffer, AudioProcessor &proc, OBusId obus, bool adding)
 {
-  if (proc.n_ochannels (obus) >= 2)
-    {
-      const float *src0 = proc.ofloats (obus, 0);
-      const float *src1 = proc.ofloats (obus, 1);
-      float *d = buffer, *const b = d + n_frames;
-      do {
-        if_constexpr (ADDING == 0)
-          {
-            *d++ = *src0++;
-            *d++ = *src1++;
-          }
-        else
-          {
-            *d++ += *src0++;
-            *d++ += *src1++;
-          }
-      } while (d < b);
-    }
-  else if (proc.n_ochannels (obus) >= 1)
-    {
-      const float *src = proc.ofloats (obus, 0);
-      float *d = buffer, *const b = d + n_frames;
-      do {
-        if_constexpr (ADDING == 0)
-          {
-            *d++ = *src;
-            *d++ = *src++;
-          }
-        else
-          {
-            *d++ += *src;
-            *d++ += *src++;
-          }
-      } while (d < b);
-    }
+  const uint n_och = proc.n_ochannels (obus);
+  if (n_och >= 1)                       // mono outputs are duplicated
+    interleave_stereo (n_frames, buffer, proc.ofloats (obus, 0), proc.ofloats (obus, n_och >= 2), adding);
 }
 
 void
@@ -162,6 +499,9 @@ AudioEngineThread::schedule_queue_update()
 void
 AudioEngineThread::schedule_clear()
 {
+  for (AnticipationP &anticipation : anticipator_.anticipations)
+    anticipation->schedule_clear();
+  anticipator_.anticipations.clear();
   while (schedule_.size() != 0)
     {
       AudioProcessor *cur = schedule_.back();
@@ -182,6 +522,8 @@ AudioEngineThread::schedule_add (AudioProcessor &aproc, uint level)
 {
   return_unless (0 == (aproc.flags_ & AudioProcessor::SCHEDULED));
   assert_return (aproc.sched_next_ == nullptr);
+  if (sched_target_)
+    return sched_target_->schedule_add (aproc, level);
   if (schedule_.size() <= level)
     schedule_.resize (level + 1);
   aproc.sched_next_ = schedule_[level];
@@ -212,10 +554,17 @@ AudioEngineThread::schedule_render (uint64 frames)
   for (size_t i = 0; i < oprocs_.size(); i++)
     if (oprocs_[i]->n_obuses())
       {
-        if (n++ == 0)
-          interleaved_stereo<0> (buffer_size_ * fixed_n_channels, chbuffer_data_, *oprocs_[i], MAIN_OBUS);
+        AudioProcessor &oproc = *oprocs_[i];
+        const uint n_och = oproc.n_ochannels (MAIN_OBUS);
+        if (i < odelays_.size() && odelays_[i].lines && n_och) // latency compensation
+          {
+            const float *src[2] = { oproc.ofloats (MAIN_OBUS, 0), oproc.ofloats (MAIN_OBUS, n_och >= 2) };
+            float *dst[2] = { delayed_[0], delayed_[1] };
+            odelays_[i].process (frames, src, dst);
+            interleave_stereo (buffer_size_, chbuffer_data_, delayed_[0], delayed_[1], n++ > 0);
+          }
         else
-          interleaved_stereo<1> (buffer_size_ * fixed_n_channels, chbuffer_data_, *oprocs_[i], MAIN_OBUS);
+          interleaved_stereo (buffer_size_, chbuffer_data_, oproc, MAIN_OBUS, n++ > 0);
         static_assert (2 == fixed_n_channels);
       }
   if (n == 0)
@@ -224,6 +573,53 @@ AudioEngineThread::schedule_render (uint64 frames)
   transport_.advance (frames);
 }
 
+/// Recompute output latencies and adjust compensation delays, so all engine outputs line up.
+void
+AudioEngineThread::update_latencies()
+{
+  uint max_latency = 0;
+  for (AudioProcessorP &proc : oprocs_)
+    {
+      proc->update_latency();
+      max_latency = std::max (max_latency, proc->latency());
+    }
+  if (odelays_.size() < oprocs_.size()) // keep excess lines for reuse
+    odelays_.resize (oprocs_.size());
+  bool lines_missing = false;
+  for (size_t i = 0; i < oprocs_.size(); i++)
+    {
+      odelays_[i].setup (oprocs_[i].get(), max_latency - oprocs_[i]->latency());
+      lines_missing |= odelays_[i].delay && !odelays_[i].lines;
+    }
+  if (lines_missing && !odelay_lines_pending_)
+    {
+      odelay_lines_pending_ = true;
+      main_rt_jobs += RtCall (*this, &AudioEngineThread::create_output_delay_ml);
+    }
+  latency_invalid_ = false;
+  EDEBUG ("output latency: %u frames", max_latency);
+}
+
+/// Allocate delay lines for update_latencies(), which must not allocate in the engine thread.
+void
+AudioEngineThread::create_output_delay_ml()
+{
+  assert_return (this_thread_is_ase()); // main_loop thread
+  OutputDelay::Lines *lines = new OutputDelay::Lines();
+  async_jobs += [this, lines] () {
+    odelay_lines_pending_ = false;
+    for (size_t i = 0; i < oprocs_.size() && i < odelays_.size(); i++)
+      if (odelays_[i].delay && !odelays_[i].lines)
+        {
+          odelays_[i].lines.reset (lines);
+          odelays_[i].filled = 0;
+          latency_invalid_ = true;      // request lines for remaining outputs
+          return;
+        }
+    main_rt_jobs += RtCall (call_delete<OutputDelay::Lines>, lines); // delete in main_thread
+  };
+}
+
 void
 AudioEngineThread::enable_output (AudioProcessor &aproc, bool onoff)
 {
@@ -294,11 +690,12 @@ AudioEngineThread::run (StartQueue *sq)
   // FIXME: assert owner_wakeup and free trash
   this_thread_set_name ("AudioEngine-0"); // max 16 chars
   audio_engine_thread_id = std::this_thread::get_id();
-  sched_fast_priority (this_thread_gettid());
+  engine_thread_register (0);
   event_loop_->exec_dispatcher (std::bind (&AudioEngineThread::driver_dispatcher, this, std::placeholders::_1));
   sq->push ('R'); // StartQueue becomes invalid after this call
   sq = nullptr;
   event_loop_->run();
+  engine_thread_unregister();
 }
 
 bool
@@ -359,21 +756,40 @@ AudioEngineThread::driver_dispatcher (const LoopState &state)
       pcm_check_write (true);
       if (render_stamp_ <= write_stamp_)
         {
-          process_jobs (async_jobs_); // apply pending modifications before render
-          if (schedule_invalid_)
+          // modifications are deferred while the anticipation thread renders ahead
+          const bool modify = !async_jobs_.empty() || schedule_invalid_ || latency_invalid_ || anticipator_.needs_rollback();
+          const bool deferred = modify && !anticipator_.hold (true);
+          if (modify && !deferred)
             {
-              schedule_clear();
-              for (AudioProcessorP &proc : oprocs_)
-                proc->schedule_processor();
-              schedule_invalid_ = false;
+              process_jobs (async_jobs_); // apply pending modifications before render
+              if (schedule_invalid_)
+                {
+                  schedule_clear();
+                  for (AudioProcessorP &proc : oprocs_)
+                    proc->schedule_processor();
+                  schedule_invalid_ = false;
+                  latency_invalid_ = true;
+                }
+              if (latency_invalid_)
+                update_latencies();
+              for (AnticipationP &anticipation : anticipator_.anticipations)
+                if (anticipation->invalid_)
+                  anticipation->rollback (buffer_size_);
             }
           if (render_stamp_ <= write_stamp_) // async jobs may have adjusted stamps
-            schedule_render (buffer_size_);
+            {
+              const ThreadUsage usage = this_thread_usage();
+              schedule_render (buffer_size_);
+              render_usage_ = render_usage_ + (this_thread_usage() - usage);
+            }
           pcm_check_write (true); // minimize drop outs
+          if (!deferred)
+            anticipator_.release(); // refill consumed blocks
         }
-      if (!const_jobs_.empty()) {   // owner may be blocking for const_jobs_ execution
+      if (!const_jobs_.empty() && anticipator_.hold (true)) { // owner may be blocking for const_jobs_ execution
         process_jobs (async_jobs_); // apply pending modifications first
         process_jobs (const_jobs_);
+        anticipator_.release();
       }
       if (ipc_pending())
         owner_wakeup_(); // owner needs to ipc_dispatch()
@@ -438,11 +854,15 @@ AudioEngineThread::start_threads_ml()
   update_drivers ("null", 0, {}); // create drivers
   null_pcm_driver_ = driver_set_ml.null_pcm_driver;
   schedule_queue_update();
+  apply_engine_preferences(); // pin threads before they are created
+  workers_.start (engine_worker_count());
+  anticipator_.start();
   StartQueue start_queue;
   thread_ = new std::thread (&AudioEngineThread::run, this, &start_queue);
   const char reply = start_queue.pop(); // synchronize with thread start
   assert_return (reply == 'R');
   apply_driver_preferences();
+  apply_anticipation_preference();
 }
 
 void
@@ -452,12 +872,26 @@ AudioEngineThread::stop_threads_ml()
   assert_return (thread_ != nullptr);
   event_loop_->quit (0);
   thread_->join();
+  anticipator_.stop();
+  workers_.stop();
   audio_engine_thread_id = {};
   auto oldthread = thread_;
   thread_ = nullptr;
   delete oldthread;
 }
 
+void
+AudioEngineThread::update_workers_ml (uint n_workers)
+{
+  assert_return (this_thread_is_ase()); // main_loop thread
+  return_unless (thread_ && n_workers != workers_.n_workers());
+  // once the engine thread executed this job, it renders without workers until they are resumed
+  synchronized_jobs += [this] () { workers_.pause (true); };
+  workers_.stop();
+  workers_.start (n_workers);
+  workers_.pause (false);
+}
+
 void
 AudioEngineThread::add_job_mt (EngineJobImpl *job, const AudioEngine::JobQueue *jobqueue)
 {
@@ -528,6 +962,8 @@ AudioEngineThread::engine_stats_string (uint64_t stats) const
     });
     s += string_format ("%s: %s (MUST_SCHEDULE)\n", pinfo.label, oprocs_[i]->debug_name());
   }
+  s += string_format ("Render page faults: %d minor, %d major; preemptions: %d\n",
+                      render_usage_.minor_faults, render_usage_.major_faults, render_usage_.involuntary_switches);
   return s;
 }
 
@@ -540,7 +976,10 @@ AudioEngineThread::get_project ()
 AudioEngineThread::~AudioEngineThread ()
 {
   FastMemory::Block transport_block = transport_block_; // keep alive until after ~AudioEngine
-  main_jobs += [transport_block] () { ServerImpl::instancep()->telemem_release (transport_block); };
+  main_jobs += [transport_block] () {
+    static_cast<AudioTransport*> (transport_block.block_start)->~AudioTransport();
+    ServerImpl::instancep()->telemem_release (transport_block);
+  };
 }
 
 AudioEngineThread::AudioEngineThread (const VoidF &owner_wakeup, uint sample_rate, SpeakerArrangement speakerarrangement,
@@ -550,6 +989,7 @@ AudioEngineThread::AudioEngineThread (const VoidF &owner_wakeup, uint sample_rat
 {
   render_stamp_ = MAX_BUFFER_SIZE; // enforce non-0 start offset for all modules
   oprocs_.reserve (16);
+  odelays_.reserve (16);
   assert_return (transport_.samplerate == 48000);
 }
 
@@ -603,6 +1043,13 @@ AudioEngine::schedule_queue_update()
   impl.schedule_queue_update();
 }
 
+void
+AudioEngine::latency_changed()
+{
+  AudioEngineThread &impl = static_cast<AudioEngineThread&> (*this);
+  impl.latency_invalid_ = true;
+}
+
 void
 AudioEngine::schedule_add (AudioProcessor &aproc, uint level)
 {
@@ -617,6 +1064,73 @@ AudioEngine::enable_output (AudioProcessor &aproc, bool onoff)
   return impl.enable_output (aproc, onoff);
 }
 
+/// Execute `task (data, index)` for `n_tasks` indices, in parallel on the engine worker threads.
+/// Must be called from the engine thread, returns after all tasks completed or false if no workers are available.
+bool
+AudioEngine::parallel_for (uint32 n_tasks, TaskFunc task, void *data)
+{
+  return_unless (thread_is_engine(), false);
+  AudioEngineThread &impl = static_cast<AudioEngineThread&> (*this);
+  return impl.workers_.parallel_for (n_tasks, task, data);
+}
+
+/// Number of frames that Anticipation sections are rendered ahead of the PCM output, 0 disables anticipation.
+uint
+AudioEngine::anticipation () const
+{
+  const AudioEngineThread &impl = static_cast<const AudioEngineThread&> (*this);
+  return impl.anticipation_frames_;
+}
+
+/// Direct schedule_processor() calls into `anticipation` (until called with nullptr) and render it ahead of time.
+void
+AudioEngine::schedule_anticipation (AnticipationP anticipation)
+{
+  assert_return (thread_is_engine());
+  AudioEngineThread &impl = static_cast<AudioEngineThread&> (*this);
+  std::vector<AnticipationP> &anticipations = impl.anticipator_.anticipations;
+  if (anticipation && std::find (anticipations.begin(), anticipations.end(), anticipation) == anticipations.end())
+    anticipations.push_back (anticipation);
+  impl.sched_target_ = anticipation;
+}
+
+/// Render tracks without live input up to `ms` milliseconds ahead of the PCM output, 0 disables anticipation.
+void
+AudioEngine::set_anticipation (uint ms)
+{
+  AudioEngineThread *impl = static_cast<AudioEngineThread*> (this);
+  ms = std::min (ms, Anticipation::MAX_MS);
+  return_unless (ms != impl->anticipation_ms_);
+  impl->anticipation_ms_ = ms;
+  const uint frames = uint64 (ms) * sample_rate() / 1000;
+  async_jobs += [impl, frames] () {
+    return_unless (frames != impl->anticipation_frames_);
+    impl->anticipation_frames_ = frames;
+    for (AnticipationP &anticipation : impl->anticipator_.anticipations)
+      anticipation->invalidate_mt();
+    impl->schedule_queue_update();
+  };
+  // tracks allocate their Anticipation storage on demand
+  if (ProjectImplP project = impl->project_)
+    for (TrackP track : project->all_tracks())
+      shared_ptr_cast<TrackImpl> (track)->update_anticipation();
+}
+
+/// Milliseconds of audio rendered ahead of the PCM output, as set via set_anticipation().
+uint
+AudioEngine::anticipation_ms () const
+{
+  const AudioEngineThread &impl = static_cast<const AudioEngineThread&> (*this);
+  return impl.anticipation_ms_;
+}
+
+/// Check if the current thread is one of the engine worker threads.
+bool
+AudioEngine::thread_is_worker()
+{
+  return engine_worker_thread;
+}
+
 void
 AudioEngine::start_threads()
 {
@@ -692,6 +1206,157 @@ AudioEngine::get_project ()
   return impl.get_project();
 }
 
+// == Anticipation ==
+Anticipation::Anticipation (AudioEngine &engine, uint n_channels) :
+  engine_ (engine), transport_ (engine.speaker_arrangement(), engine.sample_rate()), stamp_ (engine.frame_counter())
+{
+  // rollback() and render_block() run in audio threads, so storage for MAX_MS is allocated up front
+  const uint max_frames = uint64 (MAX_MS) * engine.sample_rate() / 1000;
+  max_channels_ = std::clamp (n_channels, 1u, MAX_CHANNELS);
+  samples_.resize (max_channels_ * (max_frames + AUDIO_BLOCK_MAX_RENDER_SIZE));
+  blocks_.resize (max_frames / 32 + 1);         // limits the queue length for tiny blocks
+  schedule_.reserve (32);
+  transport_.tempo_map.reserve (TempoMap::MAX_CHANGES + 1); // copied from the engine transport in rollback()
+}
+
+/// Assign the processor whose main output is queued, called while scheduling.
+void
+Anticipation::set_source (AudioProcessor *source, uint n_channels)
+{
+  n_channels = std::min (n_channels, max_channels_);
+  if (source != source_ || n_channels != n_channels_)
+    invalid_ = true;
+  source_ = source;
+  n_channels_ = n_channels;
+}
+
+void
+Anticipation::schedule_clear ()
+{
+  while (schedule_.size() != 0)
+    {
+      AudioProcessor *cur = schedule_.back();
+      schedule_.pop_back();
+      while (cur)
+        {
+          AudioProcessor *const proc = cur;
+          cur = proc->sched_next_;
+          proc->flags_ &= ~AudioProcessor::SCHEDULED;
+          proc->sched_next_ = nullptr;
+        }
+    }
+}
+
+void
+Anticipation::schedule_add (AudioProcessor &aproc, uint level)
+{
+  if (schedule_.size() <= level)
+    schedule_.resize (level + 1);
+  aproc.sched_next_ = schedule_[level];
+  schedule_[level] = &aproc;
+  aproc.flags_ |= AudioProcessor::SCHEDULED;
+  if (aproc.render_stamp_ != stamp_)
+    aproc.reset_state (stamp_); // processors render on the anticipation timeline
+}
+
+/// Render and queue the next block with the anticipation transport, returns false if the queue is full.
+bool
+Anticipation::render_block ()
+{
+  const uint64 head = head_.load (std::memory_order_relaxed);
+  return_unless (head - tail_.load (std::memory_order_acquire) < n_blocks_, false);
+  const uint slot = head % n_blocks_;
+  blocks_[slot] = { transport_.current_frame, transport_.current_tick, transport_.running() };
+  stamp_ += block_size_;
+  AudioEngine::tls_transport = &transport_;
+  for (AudioProcessor *proc : schedule_)
+    while (proc)
+      {
+        proc->render_block (stamp_);
+        proc = proc->sched_next_;
+      }
+  AudioEngine::tls_transport = nullptr;
+  float *samples = &samples_[slot * n_channels_ * block_size_];
+  const uint n_och = source_ ? source_->n_ochannels (OBusId (1)) : 0;
+  for (uint c = 0; c < n_channels_; c++, samples += block_size_)
+    if (n_och)
+      fast_copy (block_size_, samples, source_->ofloats (OBusId (1), std::min (c, n_och - 1)));
+    else
+      floatfill (samples, 0.0, block_size_);
+  transport_.advance (block_size_);
+  head_.store (head + 1, std::memory_order_release);
+  return true;
+}
+
+/// Discard queued blocks and restart rendering at the current engine transport position.
+void
+Anticipation::rollback (uint block_size)
+{
+  invalid_ = false;
+  head_ = 0;
+  tail_ = 0;
+  block_size_ = block_size;
+  // the queue length is limited by the preallocated storage
+  const uint n_frames = samples_.size() / std::max (1u, n_channels_);
+  n_blocks_ = std::min ({ (engine_.anticipation() + block_size - 1) / block_size, n_frames / block_size, uint (blocks_.size()) });
+  n_blocks_ = std::max (1u, n_blocks_);
+  transport_.assign (engine_.transport_);
+  rollbacks_.fetch_add (1, std::memory_order_relaxed);
+  // processors that follow the transport, e.g. clip playback, need to rewind
+  AudioEngine::tls_transport = &transport_;
+  for (AudioProcessor *proc : schedule_)
+    while (proc)
+      {
+        proc->rollback();
+        proc = proc->sched_next_;
+      }
+  AudioEngine::tls_transport = nullptr;
+}
+
+/// Fetch the next `n_frames` of the anticipated output, renders synchronously if no valid block is queued.
+/// If the anticipation thread is still busy, the block is popped as silence, see underruns().
+void
+Anticipation::pop (uint n_frames, float *const *buffers)
+{
+  const AudioTransport &transport = engine_.transport_;
+  uint64 tail = tail_.load (std::memory_order_relaxed);
+  auto queued = [&] () {
+    if (n_frames != block_size_ || tail >= head_.load (std::memory_order_acquire))
+      return false;
+    const Block &block = blocks_[tail % n_blocks_];
+    return block.frame == transport.current_frame && block.tick == transport.current_tick && block.running == transport.running();
+  };
+  if (!queued())
+    {
+      // underrun or transport jump, needs exclusive access until the engine block is done
+      AudioEngineThread &impl = static_cast<AudioEngineThread&> (engine_);
+      if (!impl.anticipator_.hold (true))
+        {
+          // never wait for the anticipation thread, a later pop() catches up via rollback()
+          for (uint c = 0; c < n_channels_; c++)
+            floatfill (buffers[c], 0.0, n_frames);
+          underruns_.fetch_add (1, std::memory_order_relaxed);
+          return;
+        }
+      tail = tail_.load (std::memory_order_relaxed);
+      if (!queued())
+        {
+          const bool in_sync = n_frames == block_size_ && tail == head_ &&
+                               transport_.current_frame == transport.current_frame &&
+                               transport_.current_tick == transport.current_tick &&
+                               transport_.running() == transport.running();
+          if (!in_sync || invalid_)
+            rollback (n_frames);
+          render_block();
+          tail = tail_.load (std::memory_order_relaxed);
+        }
+    }
+  const float *samples = &samples_[(tail % n_blocks_) * n_channels_ * block_size_];
+  for (uint c = 0; c < n_channels_; c++)
+    fast_copy (n_frames, buffers[c], samples + c * block_size_);
+  tail_.store (tail + 1, std::memory_order_release);
+}
+
 AudioEngine::JobQueue::JobQueue (AudioEngine &aet) :
   queue_tag_ (ptrdiff_t (this) - ptrdiff_t (&aet))
 {
@@ -707,7 +1372,7 @@ AudioEngine::JobQueue::operator+= (const std::function<void()> &job)
 }
 
 bool
-AudioEngine::update_drivers (const String &pcm_name, uint latency_ms, const StringS &midi_prefs)
+AudioEngine::update_drivers (const String &pcm_name, uint latency_ms, const StringS &midi_prefs, int src_quality)
 {
   AudioEngineThread &engine_thread = static_cast<AudioEngineThread&> (*this);
   DriverSet &dset = engine_thread.driver_set_ml;
@@ -738,6 +1403,24 @@ AudioEngine::update_drivers (const String &pcm_name, uint latency_ms, const Stri
       engine_thread.queue_user_note ("driver.pcm", UserNote::CLEAR, errmsg);
       printerr ("%s\n", string_replace (errmsg, "\n", " "));
     }
+    dset.pcm_device = dset.pcm_driver;
+    dset.src_quality = -1;
+  }
+  // PCM sample rate conversion, the engine always renders at FIXED_SAMPLE_RATE
+  if (src_quality != dset.src_quality) {
+    must_update++;
+    dset.src_quality = src_quality;
+    dset.pcm_driver = dset.pcm_device;
+    if (dset.pcm_device->pcm_mix_freq() != FIXED_SAMPLE_RATE) {
+      dset.pcm_driver = pcm_driver_resampled (dset.pcm_device, FIXED_SAMPLE_RATE, src_quality);
+      if (!dset.pcm_driver) {
+        dset.pcm_driver = dset.null_pcm_driver;
+        const String errmsg = string_format ("# Audio I/O Error\n" "Failed to convert sample rate of audio device:\n" "%s:\n" "%u Hz",
+                                             dset.pcm_name, dset.pcm_device->pcm_mix_freq());
+        engine_thread.queue_user_note ("driver.pcm", UserNote::CLEAR, errmsg);
+        printerr ("%s\n", string_replace (errmsg, "\n", " "));
+      }
+    }
   }
   // Deduplicate MIDI Drivers
   StringS midis = midi_prefs;
@@ -792,7 +1475,6 @@ class EngineMidiInput : public AudioProcessor {
   {
     MidiEventOutput &estream = midi_event_output();
     estream.clear();
-    estream.reserve (256);
   }
   void
   render (uint n_frames) override
@@ -919,6 +1601,49 @@ static Preference synth_latency_pref =
         String ("descr=") + _("Processing duration between input and output of a single sample, smaller values increase CPU load"), } },
     [] (const CString&,const Value&) { apply_driver_preferences(); });
 
+static Preference anticipation_pref =
+  Preference ({
+      "driver.pcm.anticipation", _("Render Ahead"), "", 0, "ms",
+      MinMaxStep { 0, 1000, 10 }, STANDARD + String ("step=10"), {
+        String ("descr=") + _("Duration that tracks without live input are rendered ahead of the audio output, "
+                              "allows small PCM latencies for heavy projects, 0 disables rendering ahead"), } },
+    [] (const CString&,const Value&) { apply_anticipation_preference(); });
+
+static Preference engine_cpus_pref =
+  Preference ({
+      "driver.engine.cpus", _("Engine CPUs"), "", "", "",
+      {}, STANDARD, {
+        String ("descr=") + _("CPUs reserved for the audio engine threads, e.g. '2-5', other threads are kept off these CPUs, "
+                              "empty to run on all CPUs"), } },
+    [] (const CString&,const Value&) { apply_engine_preferences(); });
+
+static Preference lock_memory_pref =
+  Preference ({
+      "driver.engine.lock_memory", _("Lock Engine Memory"), "", false, "",
+      {}, STANDARD, {
+        String ("descr=") + _("Lock the process memory into RAM to avoid page faults during rendering, "
+                              "requires a sufficient RLIMIT_MEMLOCK"), } },
+    [] (const CString&,const Value&) { apply_engine_preferences(); });
+
+static ChoiceS
+resampler_pref_list_choices (const CString &ident)
+{
+  static ChoiceS choices;
+  if (choices.empty()) {
+    choices += { "low", _("Low"), _("Short filters, lowest CPU load and latency") };
+    choices += { "medium", _("Medium"), _("Transparent for most material") };
+    choices += { "high", _("High"), _("Long filters, highest stopband attenuation") };
+  }
+  return choices;
+}
+
+static Preference resampler_pref =
+  Preference ({
+      "driver.pcm.resampler", _("Resampling Quality"), "", "medium", "",
+      { resampler_pref_list_choices }, STANDARD, {
+        String ("descr=") + _("Quality of the sample rate conversion for audio devices that do not run at 48kHz"), } },
+    [] (const CString&,const Value&) { apply_driver_preferences(); });
+
 static Preference midi1_driver_pref =
   Preference ({
       "driver.midi1.devid", _("MIDI Controller (1)"), "", "auto", "ms",
@@ -951,8 +1676,34 @@ apply_driver_preferences ()
   main_loop->exec_once (97, &engine_driver_set_timerid,
                         []() {
                           StringS midis = { midi1_driver_pref.gets(), midi2_driver_pref.gets(), midi3_driver_pref.gets(), midi4_driver_pref.gets(), };
-                          main_config.engine->update_drivers (pcm_driver_pref.gets(), synth_latency_pref.getn(), midis);
+                          const String src = resampler_pref.gets();
+                          const int src_quality = src == "low" ? 0 : src == "high" ? 2 : 1;
+                          main_config.engine->update_drivers (pcm_driver_pref.gets(), synth_latency_pref.getn(), midis, src_quality);
                         });
 }
 
+static void
+apply_anticipation_preference ()
+{
+  main_config.engine->set_anticipation (anticipation_pref.getn());
+}
+
+static void
+apply_engine_preferences ()
+{
+  static bool memory_locked = false;
+  if (lock_memory_pref.getb() != memory_locked)
+    {
+      if (memory_lock_all (!memory_locked))
+        memory_locked = !memory_locked;
+      else
+        warning ("failed to %s engine memory, check RLIMIT_MEMLOCK", memory_locked ? "unlock" : "lock");
+    }
+  fast_mem_prefault();
+  if (!engine_cpus_update (sched_parse_cpus (engine_cpus_pref.gets())))
+    warning ("engine CPUs '%s' leave no CPU for other threads, ignoring", engine_cpus_pref.gets());
+  if (main_config.engine)
+    static_cast<AudioEngineThread*> (main_config.engine)->update_workers_ml (engine_worker_count());
+}
+
 } // Ase
@@ -5,10 +5,12 @@
 #include <ase/transport.hh>
 #include <ase/platform.hh>
 #include <atomic>
+#include <optional>
 
 namespace Ase {
 
 class AudioEngineThread;
+class EngineAnticipator;
 
 /** Main handle for AudioProcessor administration and audio rendering.
  * Use make_audio_engine() to create a new engine and start_threads() to run
@@ -21,14 +23,17 @@ class AudioEngineThread;
 class AudioEngine : VirtualBase {
 protected:
   friend class AudioProcessor;
+  friend class Anticipation;
   std::atomic<size_t> processor_count_ alignas (64) = 0;
   std::atomic<uint64_t> render_stamp_ = 0;
   AudioTransport     &transport_;
+  static __thread const AudioTransport *tls_transport;
   explicit AudioEngine           (AudioEngineThread&, AudioTransport&);
   virtual ~AudioEngine           ();
   void     enable_output         (AudioProcessor &aproc, bool onoff);
   void     schedule_queue_update ();
   void     schedule_add          (AudioProcessor &aproc, uint level);
+  void     latency_changed       ();
 public:
   // Owner-Thread API
   void            start_threads    ();
@@ -39,10 +44,12 @@ public:
   AudioProcessorP get_event_source ();
   void            set_project      (ProjectImplP project);
   ProjectImplP    get_project      ();
+  void            set_anticipation (uint ms);
+  uint            anticipation_ms  () const;
   // MT-Safe API
   uint64_t               frame_counter       () const           { return render_stamp_; }
   uint64_t               block_size          () const;
-  const AudioTransport&  transport           () const           { return transport_; }
+  const AudioTransport&  transport           () const           { return ASE_UNLIKELY (tls_transport) ? *tls_transport : transport_; }
   uint                   sample_rate         () const ASE_CONST { return transport().samplerate; }
   uint                   nyquist             () const ASE_CONST { return transport().nyquist; }
   double                 inyquist            () const ASE_CONST { return transport().inyquist; }
@@ -50,10 +57,16 @@ public:
   void                   set_autostop        (uint64_t nsamples);
   void                   queue_capture_start (CallbackS&, const String &filename, bool needsrunning);
   void                   queue_capture_stop  (CallbackS&);
-  bool                   update_drivers      (const String &pcm, uint latency_ms, const StringS &midis);
+  bool                   update_drivers      (const String &pcm, uint latency_ms, const StringS &midis, int src_quality = 1);
   String                 engine_stats        (uint64_t stats) const;
   static bool            thread_is_engine    () { return std::this_thread::get_id() == thread_id; }
+  static bool            thread_is_worker    ();
   static const ThreadId &thread_id;
+  // Engine-Thread API
+  using TaskFunc = void (*) (void *data, uint32 index);
+  bool                   parallel_for        (uint32 n_tasks, TaskFunc task, void *data);
+  uint                   anticipation        () const;
+  void                   schedule_anticipation (AnticipationP anticipation);
   // JobQueues
   class JobQueue {
     friend class AudioEngine;
@@ -68,6 +81,44 @@ protected:
   JobQueue               synchronized_jobs;
 };
 
+/** Signal graph section that is rendered ahead of the PCM output on the engine anticipation thread.
+ * The output of a source processor is queued in blocks of the engine block size and consumed in
+ * lockstep with the PCM output via pop(). Queued blocks are discarded (rolled back) when the transport
+ * jumps or after invalidate_mt(), rendering then resumes from the current transport position.
+ * All storage is allocated in the main thread upon construction, for up to MAX_MS of audio.
+ */
+class Anticipation {
+  friend class AudioEngineThread;
+  friend class EngineAnticipator;
+  struct Block { int64 frame = 0, tick = 0; bool running = false; };
+  AudioEngine                  &engine_;
+  std::vector<AudioProcessor*>  schedule_;
+  AudioTransport                transport_;     // transport at the end of the queued blocks
+  AudioProcessor               *source_ = nullptr;
+  uint64                        stamp_ = 0;
+  uint                          n_channels_ = 0, block_size_ = 0, n_blocks_ = 0, max_channels_ = 0;
+  std::vector<float>            samples_;       // preallocated for MAX_MS, see Anticipation()
+  std::vector<Block>            blocks_;
+  alignas (64) std::atomic<uint64> head_ = 0;   // blocks rendered ahead
+  alignas (64) std::atomic<uint64> tail_ = 0;   // blocks consumed by pop()
+  std::atomic<bool>             invalid_ = true;
+  std::atomic<uint64>           underruns_ = 0, rollbacks_ = 0;
+  uint64   pending        () const      { return head_.load (std::memory_order_acquire) - tail_.load (std::memory_order_relaxed); }
+  void     schedule_clear ();
+  void     schedule_add   (AudioProcessor &aproc, uint level);
+  bool     render_block   ();
+  void     rollback       (uint block_size);
+  bool     has_space      () const      { return head_.load (std::memory_order_relaxed) - tail_.load (std::memory_order_acquire) < n_blocks_; }
+public:
+  static constexpr uint MAX_CHANNELS = 8, MAX_MS = 1000;
+  explicit Anticipation   (AudioEngine &engine, uint n_channels);
+  void     set_source     (AudioProcessor *source, uint n_channels);
+  void     pop            (uint n_frames, float *const *buffers);
+  void     invalidate_mt  ()            { invalid_ = true; }
+  uint64   underruns      () const      { return underruns_.load (std::memory_order_relaxed); } ///< Count blocks popped as silence.
+  uint64   rollbacks      () const      { return rollbacks_.load (std::memory_order_relaxed); } ///< Count queue restarts.
+};
+
 AudioEngine& make_audio_engine (const VoidF &owner_wakeup, uint sample_rate, SpeakerArrangement speakerarrangement);
 
 /// Helper to modify const struct contents, e.g. asyn job lambda members.
@@ -0,0 +1,140 @@
+// This Source Code Form is licensed MPL-2.0: http://mozilla.org/MPL/2.0
+#include "fft.hh"
+#include "simd.hh"
+#include "internal.hh"
+#include <cmath>
+
+namespace Ase {
+
+// == RealFFT ==
+/// Create a transform of `n` real samples, see setup().
+RealFFT::RealFFT (uint n)
+{
+  if (n)
+    setup (n);
+}
+
+/// Configure the transform size, `n` must be a power of 2 and at least 2.
+void
+RealFFT::setup (uint n)
+{
+  assert_return (n >= 2 && (n & (n - 1)) == 0);
+  n_ = n;
+  const uint m = n / 2;
+  twr_.resize (std::max (1u, m / 2));
+  twi_.resize (twr_.size());
+  for (uint k = 0; k < twr_.size(); k++)
+    {
+      twr_[k] = std::cos (-2 * M_PI * k / m);
+      twi_[k] = std::sin (-2 * M_PI * k / m);
+    }
+  pwr_.resize (m + 1);
+  pwi_.resize (m + 1);
+  for (uint k = 0; k <= m; k++)
+    {
+      pwr_[k] = std::cos (-2 * M_PI * k / n);
+      pwi_[k] = std::sin (-2 * M_PI * k / n);
+    }
+  ar_.resize (m);
+  ai_.resize (m);
+  br_.resize (m);
+  bi_.resize (m);
+}
+
+// Unnormalized complex DFT of size n_ / 2 in `re`, `im`, using `tre`, `tim` as scratch.
+void
+RealFFT::complex_fft (float *re, float *im, float *tre, float *tim)
+{
+  const uint m = n_ / 2;
+  float *const ore = re, *const oim = im;
+  for (uint s = 1; s < m; s *= 2)       // Stockham autosort, passes alternate between both buffers
+    {
+      simd_sample_kernels->fft_pass (m / s, s, re, im, tre, tim, twr_.data(), twi_.data());
+      std::swap (re, tre);
+      std::swap (im, tim);
+    }
+  if (re != ore)
+    {
+      std::copy (re, re + m, ore);
+      std::copy (im, im + m, oim);
+    }
+}
+
+/// Transform size() samples from `input` into n_bins() complex values at `re` and `im`.
+void
+RealFFT::forward (const float *input, float *re, float *im)
+{
+  const uint m = n_ / 2;
+  float *zr = ar_.data(), *zi = ai_.data();
+  deinterleave_stereo (m, zr, zi, input);       // even samples are real, odd samples imaginary
+  complex_fft (zr, zi, br_.data(), bi_.data());
+  for (uint k = 0; k <= m; k++)
+    {
+      // split into the spectra of even and odd samples, then combine into the real spectrum
+      const uint j = k % m, c = (m - k) % m;
+      const float er = 0.5f * (zr[j] + zr[c]), ei = 0.5f * (zi[j] - zi[c]);
+      const float odr = 0.5f * (zi[j] + zi[c]), odi = -0.5f * (zr[j] - zr[c]);
+      re[k] = er + pwr_[k] * odr - pwi_[k] * odi;
+      im[k] = ei + pwr_[k] * odi + pwi_[k] * odr;
+    }
+}
+
+/// Transform n_bins() complex values from `re` and `im` into size() samples, the output is scaled by size().
+void
+RealFFT::backward (const float *re, const float *im, float *output)
+{
+  const uint m = n_ / 2;
+  float *zr = ar_.data(), *zi = ai_.data();
+  for (uint k = 0; k < m; k++)
+    {
+      const float er = re[k] + re[m - k], ei = im[k] - im[m - k];
+      const float dr = re[k] - re[m - k], di = im[k] + im[m - k];
+      const float odr = dr * pwr_[k] + di * pwi_[k], odi = di * pwr_[k] - dr * pwi_[k];
+      zr[k] = er - odi;
+      zi[k] = ei + odr;
+    }
+  complex_fft (zi, zr, bi_.data(), br_.data()); // inverse transform by swapping real and imaginary parts
+  interleave_stereo (m, output, zr, zi, false);
+}
+
+} // Ase
+
+// == Testing ==
+#include "testing.hh"
+#include "randomhash.hh"
+
+namespace { // Anon
+using namespace Ase;
+
+TEST_INTEGRITY (real_fft_tests);
+static void
+real_fft_tests()
+{
+  for (uint n : { 2, 4, 8, 16, 64, 512, 2048 })
+    {
+      RealFFT fft (n);
+      TCMP (fft.n_bins(), ==, n / 2 + 1);
+      std::vector<float> x (n), y (n), re (fft.n_bins()), im (fft.n_bins());
+      for (auto &v : x)
+        v = random_frange (-1, 1);
+      fft.forward (x.data(), re.data(), im.data());
+      // compare against the naive DFT
+      for (uint k = 0; k < fft.n_bins(); k++)
+        {
+          double dr = 0, di = 0;
+          for (uint i = 0; i < n; i++)
+            {
+              dr += x[i] * std::cos (-2 * M_PI * i * k / n);
+              di += x[i] * std::sin (-2 * M_PI * i * k / n);
+            }
+          TCMP (std::abs (re[k] - dr), <, 1e-4 * std::sqrt (n));
+          TCMP (std::abs (im[k] - di), <, 1e-4 * std::sqrt (n));
+        }
+      // round trip
+      fft.backward (re.data(), im.data(), y.data());
+      for (uint i = 0; i < n; i++)
+        TCMP (std::abs (y[i] / n - x[i]), <, 1e-5);
+    }
+}
+
+} // Anon
@@ -0,0 +1,28 @@
+// This Source Code Form is licensed MPL-2.0: http://mozilla.org/MPL/2.0
+#ifndef __ASE_FFT_HH__
+#define __ASE_FFT_HH__
+
+#include <ase/defs.hh>
+
+namespace Ase {
+
+/// Fast Fourier transform of real signals with power of 2 sizes, spectra are stored as split complex arrays.
+class RealFFT {
+public:
+  explicit RealFFT  (uint n = 0);
+  void     setup    (uint n);
+  void     forward  (const float *input, float *re, float *im);
+  void     backward (const float *re, const float *im, float *output);
+  uint     size     () const    { return n_; }                          ///< Number of real samples per transform.
+  uint     n_bins   () const    { return n_ ? n_ / 2 + 1 : 0; }         ///< Number of spectrum bins, DC to Nyquist.
+private:
+  uint n_ = 0;
+  std::vector<float> twr_, twi_;        // twiddles of the n_ / 2 point complex FFT
+  std::vector<float> pwr_, pwi_;        // exp (-2πi k / n_) for the real to complex split
+  std::vector<float> ar_, ai_, br_, bi_;
+  void complex_fft (float *re, float *im, float *tre, float *tim);
+};
+
+} // Ase
+
+#endif // __ASE_FFT_HH__
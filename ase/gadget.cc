@@ -81,6 +81,7 @@ GadgetImpl::serialize (WritNode &xs)
   // Serializable
   Serializable::serialize (xs);
   // properties
+  ValueR loaded;
   for (PropertyP p : access_properties())
     {
       const String hints = p->hints();
@@ -95,9 +96,11 @@ GadgetImpl::serialize (WritNode &xs)
         {
           Value v;
           xs[p->ident()] & v;
-          p->set_value (v);
+          loaded.push_back ({ p->ident(), std::move (v) });
         }
     }
+  if (loaded.size())
+    set_values (loaded);        // devices apply all values at once
   // data
   if (xs.in_save())
     {
@@ -159,6 +162,24 @@ GadgetImpl::access_properties ()
   return { begin (props_), end (props_) };
 }
 
+PropertyP
+GadgetImpl::access_property (String ident)
+{
+  if (props_.empty())
+    create_properties();
+  if (props_.empty()) // access_properties() may be overridden
+    return Gadget::access_property (ident);
+  if (props_indexed_ != props_.size())
+    {
+      props_index_.clear();
+      for (size_t i = 0; i < props_.size(); i++)
+        props_index_.emplace (props_[i]->ident(), i); // first property wins, like the linear search
+      props_indexed_ = props_.size();
+    }
+  auto it = props_index_.find (ident);
+  return it != props_index_.end() ? props_[it->second] : nullptr;
+}
+
 // == Gadget ==
 ProjectImpl*
 Gadget::_project() const
@@ -203,6 +224,29 @@ Gadget::set_value (String ident, const Value &v)
   return prop && prop->set_value (v);
 }
 
+ValueR
+Gadget::get_values (const StringS &idents)
+{
+  ValueR values;
+  for (const String &ident : idents)
+    if (PropertyP prop = access_property (ident))
+      values[ident] = prop->get_value();
+  return values;
+}
+
+/// Assign all `values`, returns false if any value could not be assigned.
+bool
+Gadget::set_values (const ValueR &values)
+{
+  bool all_assigned = true;
+  for (const ValueField &field : values)
+    {
+      PropertyP prop = field.value ? access_property (field.name) : nullptr;
+      all_assigned &= prop && prop->set_value (*field.value);
+    }
+  return all_assigned;
+}
+
 PropertyBag
 GadgetImpl::property_bag ()
 {
@@ -13,6 +13,8 @@ class GadgetImpl : public ObjectImpl, public CustomDataContainer, public virtual
   GadgetImpl *parent_ = nullptr;
   uint64_t    gadget_flags_ = 0;
   ValueR      session_data_;
+  std::unordered_map<String,size_t> props_index_; // ident -> props_ index
+  size_t      props_indexed_ = 0;
 protected:
   PropertyImplS props_;
   enum : uint64_t { GADGET_DESTROYED = 0x1, DEVICE_ACTIVE = 0x2, MASTER_TRACK = 0x4 };
@@ -31,6 +33,7 @@ public:
   String         name              () const override;
   void           name              (String newname) override;
   PropertyS      access_properties () override;
+  PropertyP      access_property   (String ident) override;
   bool           set_data          (const String &key, const Value &v) override;
   Value          get_data          (const String &key) const override;
 };
@@ -4,6 +4,7 @@
 #include "platform.hh"
 #include "internal.hh"
 #include <sys/poll.h>
+#include <sys/epoll.h>
 #include <errno.h>
 #include <atomic>
 #include <unistd.h>
@@ -23,6 +24,12 @@ enum {
   NEEDS_DISPATCH,
 };
 
+enum {
+  WATCH_NONE          = 0,      // prepare() and check() on every iteration
+  WATCH_TIMER,                  // expiration tracked in EventLoop::timer_heap_
+  WATCH_POLLFD,                 // descriptor registered with MainLoop::epollfd_
+};
+
 // == PollFD invariants ==
 static_assert (PollFD::IN     == POLLIN);
 static_assert (PollFD::PRI    == POLLPRI);
@@ -41,6 +48,15 @@ static_assert (offsetof (PollFD, events)       == offsetof (struct pollfd, event
 static_assert (sizeof (((PollFD*) 0)->events)  == sizeof (((struct pollfd*) 0)->events));
 static_assert (offsetof (PollFD, revents)      == offsetof (struct pollfd, revents));
 static_assert (sizeof (((PollFD*) 0)->revents) == sizeof (((struct pollfd*) 0)->revents));
+static_assert (PollFD::IN     == uint (EPOLLIN));
+static_assert (PollFD::PRI    == uint (EPOLLPRI));
+static_assert (PollFD::OUT    == uint (EPOLLOUT));
+static_assert (PollFD::RDNORM == uint (EPOLLRDNORM));
+static_assert (PollFD::RDBAND == uint (EPOLLRDBAND));
+static_assert (PollFD::WRNORM == uint (EPOLLWRNORM));
+static_assert (PollFD::WRBAND == uint (EPOLLWRBAND));
+static_assert (PollFD::ERR    == uint (EPOLLERR));
+static_assert (PollFD::HUP    == uint (EPOLLHUP));
 
 // === Stupid ID allocator ===
 static volatile int global_id_counter = 65536;
@@ -126,7 +142,7 @@ struct QuickSourcePArray : public QuickArray<EventSourceP*> {
 
 // === EventLoop ===
 EventLoop::EventLoop (MainLoop &main) :
-  main_loop_ (&main), dispatch_priority_ (0), primary_ (false)
+  main_loop_ (&main), timer_usecs_ (0), dispatch_priority_ (0), primary_ (false)
 {
   poll_sources_.reserve (7);
   // we cannot *use* main_loop_ yet, because we might be called from within MainLoop::MainLoop(), see SubLoop()
@@ -207,6 +223,7 @@ EventLoop::add (EventSourceP source, int priority)
   {
     std::lock_guard<std::mutex> locker (main_loop_->mutex());
     sources_.push_back (source);
+    watch_source_L (source);
   }
   wakeup();
   return source->id_;
@@ -217,6 +234,7 @@ EventLoop::remove_source_Lm (EventSourceP source)
 {
   std::mutex &LOCK = main_loop_->mutex();
   assert_return (source->loop_ == this);
+  unwatch_source_L (source);
   source->loop_ = NULL;
   source->loop_state_ = WAITING;
   auto pos = find (sources_.begin(), sources_.end(), source);
@@ -285,6 +303,7 @@ EventLoop::exec_once (uint delay_ms, uint *once_id, const VoidSlot &vfunc, int p
         warn_id = *once_id;
     }
     sources_.push_back (source);
+    watch_source_L (source);
     *once_id = source->id_;
   }
   if (warn_id)
@@ -293,6 +312,159 @@ EventLoop::exec_once (uint delay_ms, uint *once_id, const VoidSlot &vfunc, int p
   return true;
 }
 
+/* Sources that can describe their readiness through a single PollFD or a single
+ * expiration time are "watched": their descriptor is registered persistently with
+ * the main loop's epoll instance, or their expiration is kept in a per loop timer
+ * heap. Watched sources are only visited once they become ready, so iteration cost
+ * scales with the number of ready sources instead of the number of added sources.
+ * All other sources remain "generic" and are prepared and checked every iteration.
+ */
+void
+EventLoop::watch_source_L (const EventSourceP &source)
+{
+  source->watched_ = WATCH_NONE;
+  uint64 expiration_usecs = 0;
+  if (!source->may_recurse_ && source->watch_timer (&expiration_usecs))
+    {
+      source->watched_ = WATCH_TIMER;
+      source->heap_usecs_ = expiration_usecs;
+      timer_heap_push_L (source);
+      return;
+    }
+  if (!source->may_recurse_ && main_loop_->epoll_add_L (source))
+    {
+      source->watched_ = WATCH_POLLFD;
+      return;
+    }
+  generic_sources_.push_back (source);
+}
+
+void
+EventLoop::unwatch_source_L (const EventSourceP &source)
+{
+  if (source->watched_ == WATCH_NONE)
+    {
+      auto pos = std::find (generic_sources_.begin(), generic_sources_.end(), source);
+      if (pos != generic_sources_.end())
+        generic_sources_.erase (pos);
+      return;
+    }
+  if (source->watched_ == WATCH_TIMER && source->heap_index_ < timer_heap_.size() &&
+      timer_heap_[source->heap_index_] == source)
+    timer_heap_erase_L (*source);
+  if (source->watched_ == WATCH_POLLFD)
+    main_loop_->epoll_remove_L (*source);
+  source->watched_ = WATCH_NONE;
+  auto pos = std::find (ready_sources_.begin(), ready_sources_.end(), source);
+  if (pos != ready_sources_.end())
+    ready_sources_.erase (pos);
+}
+
+/// Re-enable a watched source after dispatching, demote it to a generic source if it cannot be watched anymore.
+void
+EventLoop::rewatch_source_L (const EventSourceP &source)
+{
+  uint64 expiration_usecs = 0;
+  if (source->watched_ == WATCH_TIMER && source->watch_timer (&expiration_usecs))
+    {
+      source->heap_usecs_ = expiration_usecs;
+      timer_heap_push_L (source);
+      return;
+    }
+  if (source->watched_ == WATCH_POLLFD && main_loop_->epoll_rearm_L (source))
+    return;
+  unwatch_source_L (source);
+  generic_sources_.push_back (source);
+}
+
+/// Flag a watched source for dispatching and add it to the current iteration.
+void
+EventLoop::ready_source_L (const EventSourceP &source)
+{
+  if (source->loop_state_ == NEEDS_DISPATCH)
+    return;
+  source->loop_state_ = NEEDS_DISPATCH;
+  dispatch_priority_ = std::max (dispatch_priority_, source->priority_); // upgrade dispatch priority
+  ready_sources_.push_back (source);
+  poll_sources_.push_back (source);
+}
+
+void
+EventLoop::expire_timers_L (LoopState &state)
+{
+  const uint64 now = state.current_time_usecs;
+  if (UNLIKELY (now < timer_usecs_) && !timer_heap_.empty())
+    {
+      // clock warped back in time, let prepare() adjust expirations and rebuild the heap
+      SourceList timers;
+      timers.swap (timer_heap_);
+      for (auto &source : timers)
+        {
+          int64 timeout = -1;
+          source->prepare (state, &timeout);
+          source->watch_timer (&source->heap_usecs_);
+          timer_heap_push_L (source);
+        }
+    }
+  timer_usecs_ = now;
+  while (!timer_heap_.empty() && timer_heap_[0]->heap_usecs_ <= now)
+    {
+      EventSourceP source = timer_heap_[0];
+      timer_heap_erase_L (*source);
+      ready_source_L (source);
+    }
+}
+
+void
+EventLoop::timer_heap_push_L (const EventSourceP &source)
+{
+  source->heap_index_ = timer_heap_.size();
+  timer_heap_.push_back (source);
+  timer_heap_sift_L (source->heap_index_);
+}
+
+void
+EventLoop::timer_heap_erase_L (EventSource &source)
+{
+  const uint index = source.heap_index_;
+  source.heap_index_ = 4294967295U; // UINT_MAX
+  EventSourceP last = std::move (timer_heap_.back());
+  timer_heap_.pop_back();
+  if (index < timer_heap_.size())
+    {
+      last->heap_index_ = index;
+      timer_heap_[index] = std::move (last);
+      timer_heap_sift_L (index);
+    }
+}
+
+/// Restore the min-heap property of `timer_heap_` for the element at `index`.
+void
+EventLoop::timer_heap_sift_L (uint index)
+{
+  EventSourceP source = std::move (timer_heap_[index]);
+  const uint64 usecs = source->heap_usecs_;
+  while (index > 0 && timer_heap_[(index - 1) / 2]->heap_usecs_ > usecs)
+    {
+      const uint parent = (index - 1) / 2;
+      timer_heap_[index] = std::move (timer_heap_[parent]);
+      timer_heap_[index]->heap_index_ = index;
+      index = parent;
+    }
+  for (size_t child = 2 * index + 1; child < timer_heap_.size(); child = 2 * index + 1)
+    {
+      if (child + 1 < timer_heap_.size() && timer_heap_[child + 1]->heap_usecs_ < timer_heap_[child]->heap_usecs_)
+        child++;
+      if (timer_heap_[child]->heap_usecs_ >= usecs)
+        break;
+      timer_heap_[index] = std::move (timer_heap_[child]);
+      timer_heap_[index]->heap_index_ = index;
+      index = child;
+    }
+  source->heap_index_ = index;
+  timer_heap_[index] = std::move (source);
+}
+
 /* void EventLoop::change_priority (EventSource *source, int priority) {
  * // ensure that source belongs to this
  * // reset all source->pfds[].idx = UINT_MAX
@@ -351,12 +523,15 @@ EventLoop::wakeup ()
 // === MainLoop ===
 MainLoop::MainLoop() :
   EventLoop (*this), // sets *this as MainLoop on self
-  rr_index_ (0), running_ (false), has_quit_ (false), quit_code_ (0), gcontext_ (NULL)
+  rr_index_ (0), running_ (false), has_quit_ (false), quit_code_ (0), gcontext_ (NULL), epollfd_ (-1)
 {
   std::lock_guard<std::mutex> locker (main_loop_->mutex());
   const int err = eventfd_.open();
   if (err < 0)
     fatal_error ("MainLoop: failed to create wakeup pipe: %s", strerror (-err));
+  epollfd_ = epoll_create1 (EPOLL_CLOEXEC);
+  if (epollfd_ < 0)
+    warning ("MainLoop: failed to create epoll instance: %s", strerror());  // all PollFD sources remain generic
   // has_quit_ and eventfd_ need to be setup here, so calling quit() before run() works
 }
 
@@ -380,6 +555,9 @@ MainLoop::~MainLoop()
   if (main_loop_)
     kill_loops_Lm();
   assert_return (loops_.empty() == true);
+  if (epollfd_ >= 0)
+    close (epollfd_);
+  epollfd_ = -1;
 }
 
 void
@@ -389,6 +567,73 @@ MainLoop::wakeup_poll()
     eventfd_.wakeup();
 }
 
+bool
+MainLoop::epoll_add_L (const EventSourceP &source)
+{
+  PollFD *pfd = source->watch_pollfd();
+  return_unless (epollfd_ >= 0 && pfd && pfd->fd >= 0, false);
+  if (epoll_sources_.count (pfd->fd))
+    return false;       // descriptor is shared by several sources, or pending removal
+  struct epoll_event event = {};
+  event.events = pfd->events | EPOLLONESHOT; // disarmed until rearmed after dispatching
+  event.data.fd = pfd->fd;
+  if (epoll_ctl (epollfd_, EPOLL_CTL_ADD, pfd->fd, &event) < 0)
+    return false;       // e.g. EPERM for regular files
+  source->watch_fd_ = pfd->fd;
+  epoll_sources_[pfd->fd] = source;
+  return true;
+}
+
+bool
+MainLoop::epoll_rearm_L (const EventSourceP &source)
+{
+  PollFD *pfd = source->watch_pollfd();
+  return_unless (pfd && pfd->fd >= 0, false);
+  struct epoll_event event = {};
+  event.events = pfd->events | EPOLLONESHOT;
+  event.data.fd = pfd->fd;
+  if (pfd->fd == source->watch_fd_ && epoll_ctl (epollfd_, EPOLL_CTL_MOD, pfd->fd, &event) == 0)
+    return true;
+  // descriptor was changed or closed by the dispatcher
+  epoll_remove_L (*source);
+  return epoll_add_L (source);
+}
+
+void
+MainLoop::epoll_remove_L (EventSource &source)
+{
+  auto it = epoll_sources_.find (source.watch_fd_);
+  if (it != epoll_sources_.end() && it->second.get() == &source)
+    {
+      epoll_ctl (epollfd_, EPOLL_CTL_DEL, source.watch_fd_, nullptr); // fails harmlessly for closed descriptors
+      epoll_sources_.erase (it);
+    }
+  source.watch_fd_ = -1;
+}
+
+void
+MainLoop::epoll_collect_L ()
+{
+  struct epoll_event events[64];
+  int n;
+  do
+    n = epoll_wait (epollfd_, events, ARRAY_SIZE (events), 0);
+  while (n < 0 && errno == EINTR);
+  for (int i = 0; i < n; i++)
+    {
+      auto it = epoll_sources_.find (events[i].data.fd);
+      if (it == epoll_sources_.end())
+        continue;
+      const EventSourceP &source = it->second;
+      PollFD *pfd = source->watch_pollfd();
+      if (source->loop_ && pfd)
+        {
+          pfd->revents = events[i].events;
+          source->loop_->ready_source_L (source);
+        }
+    }
+}
+
 void
 MainLoop::add_loop_L (EventLoop &loop)
 {
@@ -605,7 +850,8 @@ EventLoop::collect_sources_Lm (LoopState &state)
   QuickSourcePArray poll_candidates (ARRAY_SIZE (arraymem), arraymem);
   // determine dispatch priority & collect sources for preparing
   dispatch_priority_ = UNDEFINED_PRIORITY; // initially, consider sources at *all* priorities
-  for (SourceList::iterator lit = sources_.begin(); lit != sources_.end(); lit++)
+  for (SourceList *list : { &generic_sources_, &ready_sources_ }) // watched sources are only seen once ready
+  for (SourceList::iterator lit = list->begin(); lit != list->end(); lit++)
     {
       EventSource &source = **lit;
       if (UNLIKELY (!state.seen_primary && source.primary_))
@@ -638,11 +884,17 @@ bool
 EventLoop::prepare_sources_Lm (LoopState &state, QuickPfdArray &pfda)
 {
   std::mutex &LOCK = main_loop_->mutex();
+  // flag expired timers
+  expire_timers_L (state);
+  if (!timer_heap_.empty())
+    state.timeout_usecs = std::min (state.timeout_usecs, int64 (std::min (timer_heap_[0]->heap_usecs_ - state.current_time_usecs,
+                                                                           uint64 (2147483647)))); // INT_MAX
   // prepare sources, up to NEEDS_DISPATCH priority
-  for (auto lit = poll_sources_.begin(); lit != poll_sources_.end(); lit++)
+  for (size_t i = 0; i < poll_sources_.size(); i++)
     {
-      EventSource &source = **lit;
-      if (source.loop_ != this) // test undestroyed
+      EventSource &source = *poll_sources_[i];
+      if (source.loop_ != this || // test undestroyed
+          source.watched_)        // watched sources are only polled when ready
         continue;
       int64 timeout = -1;
       LOCK.unlock();
@@ -678,12 +930,15 @@ bool
 EventLoop::check_sources_Lm (LoopState &state, const QuickPfdArray &pfda)
 {
   std::mutex &LOCK = main_loop_->mutex();
+  // flag timers that expired during poll
+  expire_timers_L (state);
   // check polled sources
-  for (auto lit = poll_sources_.begin(); lit != poll_sources_.end(); lit++)
+  for (size_t i = 0; i < poll_sources_.size(); i++)
     {
-      EventSource &source = **lit;
-      if (source.loop_ != this && // test undestroyed
-          source.loop_state_ != PREPARED)
+      EventSource &source = *poll_sources_[i];
+      if (source.watched_ ||
+          (source.loop_ != this && // test undestroyed
+           source.loop_state_ != PREPARED))
         continue; // only check prepared sources
       uint npfds = source.n_pfds();
       for (uint i = 0; i < npfds; i++)
@@ -732,6 +987,12 @@ EventLoop::dispatch_source_Lm (LoopState &state)
   // dispatch single source
   if (dispatch_source)
     {
+      if (dispatch_source->watched_)
+        {
+          auto pos = std::find (ready_sources_.begin(), ready_sources_.end(), dispatch_source);
+          if (pos != ready_sources_.end())
+            ready_sources_.erase (pos);
+        }
       dispatch_source->loop_state_ = WAITING;
       const bool old_was_dispatching = dispatch_source->was_dispatching_;
       dispatch_source->was_dispatching_ = dispatch_source->dispatching_;
@@ -743,6 +1004,8 @@ EventLoop::dispatch_source_Lm (LoopState &state)
       dispatch_source->was_dispatching_ = old_was_dispatching;
       if (dispatch_source->loop_ == this && !keep_alive)
         remove_source_Lm (dispatch_source);
+      else if (dispatch_source->loop_ == this && dispatch_source->watched_ && dispatch_source->loop_state_ == WAITING)
+        rewatch_source_L (dispatch_source);
     }
 }
 
@@ -757,6 +1020,10 @@ MainLoop::iterate_loops_Lm (LoopState &state, bool may_block, bool may_dispatch)
   const PollFD wakeup = { eventfd_.inputfd(), PollFD::IN, 0 };
   const uint wakeup_idx = 0; // wakeup_idx = pfda.size();
   pfda.push (wakeup);
+  // poll persistent registrations of watched sources
+  const PollFD epoll_pfd = { epollfd_, PollFD::IN, 0 };
+  const uint epoll_idx = 1; // epoll_idx = pfda.size();
+  pfda.push (epoll_pfd);
   // create pollable loop list
   const size_t nrloops = loops_.size(); // number of Ase loops, *without* gcontext_
   EventLoopP loops[nrloops];
@@ -820,6 +1087,8 @@ MainLoop::iterate_loops_Lm (LoopState &state, bool may_block, bool may_dispatch)
     eventfd_.flush(); // restart queueing wakeups, possibly triggered by dispatching
   // check
   state.phase = state.CHECK;
+  if (presult > 0 && epollfd_ >= 0 && pfda[epoll_idx].revents)
+    epoll_collect_L();
   state.current_time_usecs = timestamp_realtime();
   int16 max_dispatch_priority = -32768;
   for (size_t i = 0; i < nrloops; i++)
@@ -910,9 +1179,27 @@ EventSource::EventSource () :
   may_recurse_ (0),
   dispatching_ (0),
   was_dispatching_ (0),
-  primary_ (0)
+  primary_ (0),
+  watched_ (0),
+  watch_fd_ (-1),
+  heap_index_ (4294967295U), // UINT_MAX
+  heap_usecs_ (0)
 {}
 
+/// Sources whose readiness solely depends on an expiration time may provide it here, to be kept in a timer heap.
+bool
+EventSource::watch_timer (uint64 *expiration_usecs)
+{
+  return false;
+}
+
+/// Sources whose readiness solely depends on the `revents` of a single PollFD may provide it here, for persistent registration.
+PollFD*
+EventSource::watch_pollfd ()
+{
+  return nullptr;
+}
+
 uint
 EventSource::n_pfds ()
 {
@@ -1133,6 +1420,13 @@ TimedSource::check (const LoopState &state)
   return state.current_time_usecs >= expiration_usecs_;
 }
 
+bool
+TimedSource::watch_timer (uint64 *expiration_usecs)
+{
+  *expiration_usecs = expiration_usecs_;
+  return true;
+}
+
 bool
 TimedSource::dispatch (const LoopState &state)
 {
@@ -1241,6 +1535,12 @@ PollFDSource::dispatch (const LoopState &state)
   return keep_alive;
 }
 
+PollFD*
+PollFDSource::watch_pollfd ()
+{
+  return n_pfds() == 1 ? &pfd_ : nullptr;
+}
+
 void
 PollFDSource::destroy()
 {
@@ -1260,6 +1560,45 @@ PollFDSource::~PollFDSource ()
 
 } // Ase
 
+#include "testing.hh"
+
+TEST_INTEGRITY (eventloop_watch_tests);
+static void
+eventloop_watch_tests()
+{
+  using namespace Ase;
+  MainLoopP loop = MainLoop::create();
+  // timers dispatch in expiration order, removed timers never
+  String order;
+  loop->exec_timer ([&order] () { order += "c"; }, 30);
+  loop->exec_timer ([&order] () { order += "a"; }, 10);
+  const uint xid = loop->exec_timer ([&order] () { order += "x"; }, 15);
+  loop->exec_timer ([&order] () { order += "b"; }, 20);
+  loop->remove (xid);
+  // repeating timers are rescheduled
+  uint count = 0;
+  loop->exec_timer ([&count] () { return ++count < 3; }, 1, 1);
+  // IO handlers are rearmed after each dispatch
+  int fds[2];
+  TASSERT (pipe (fds) == 0);
+  String received;
+  loop->exec_io_handler ([&received] (PollFD &pfd) {
+    char c;
+    if (read (pfd.fd, &c, 1) == 1)
+      received += c;
+    return received.size() < 3;
+  }, fds[0], "r");
+  TASSERT (write (fds[1], "xyz", 3) == 3);
+  const uint64 deadline = timestamp_realtime() + 5000000;
+  while ((order.size() < 3 || count < 3 || received.size() < 3) && timestamp_realtime() < deadline)
+    loop->iterate (true);
+  TCMP (order, ==, "abc");
+  TCMP (count, ==, 3u);
+  TCMP (received, ==, "xyz");
+  close (fds[1]);
+  loop->destroy_loop();
+}
+
 // == Loop Description ==
 /*! @page eventloops    Event Loops and Event Sources
   Ase <a href="http://en.wikipedia.org/wiki/Event_loop">event loops</a>
@@ -1296,4 +1635,9 @@ PollFDSource::~PollFDSource ()
   @li Fourth, the source is dispatched if it returened true from either prepare() or check(). If multiple sources are
   ready to be dispatched, the entire process may be repeated several times (after dispatching other sources),
   starting with a new call to prepare() before a particular source is finally dispatched.
+  @li Sources that depend only on an expiration time (see Ase::TimedSource) or a single PollFD (see Ase::PollFDSource)
+  are watched instead: their expiration is kept in a timer heap and their descriptor is registered persistently
+  with epoll(7), so they are skipped by prepare() and check() until they become ready.
+  Watched sources are not dispatched recursively, so Ase::EventSource::may_recurse() needs to be set before adding
+  a source that relies on recursion.
  */
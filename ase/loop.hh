@@ -3,6 +3,7 @@
 #define __ASE_LOOP_HH__
 
 #include <ase/utils.hh>
+#include <unordered_map>
 
 namespace Ase {
 
@@ -60,7 +61,11 @@ protected:
   typedef std::vector<EventSourceP> SourceList;
   MainLoop     *main_loop_;
   SourceList    sources_;
+  SourceList    generic_sources_;       // sources needing prepare() and check() per iteration
+  SourceList    ready_sources_;         // watched sources flagged by epoll or the timer heap
+  SourceList    timer_heap_;            // watched timers, min-heap on EventSource.heap_usecs_
   std::vector<EventSourceP> poll_sources_;
+  uint64        timer_usecs_;
   int16         dispatch_priority_;
   bool          primary_;
   explicit      EventLoop           (MainLoop&);
@@ -69,6 +74,14 @@ protected:
   EventSourceP& find_source_L       (uint id);
   bool          has_primary_L       (void);
   void          remove_source_Lm    (EventSourceP source);
+  void          watch_source_L      (const EventSourceP &source);
+  void          unwatch_source_L    (const EventSourceP &source);
+  void          rewatch_source_L    (const EventSourceP &source);
+  void          ready_source_L      (const EventSourceP &source);
+  void          expire_timers_L     (LoopState&);
+  void          timer_heap_push_L   (const EventSourceP &source);
+  void          timer_heap_erase_L  (EventSource &source);
+  void          timer_heap_sift_L   (uint index);
   void          kill_sources_Lm     (void);
   void          unpoll_sources_U    ();
   void          collect_sources_Lm  (LoopState&);
@@ -137,7 +150,13 @@ class MainLoop : public EventLoop
   int8                  has_quit_;
   int16                 quit_code_;
   GlibGMainContext     *gcontext_;
+  int                   epollfd_;
+  std::unordered_map<int,EventSourceP> epoll_sources_; // watched sources by descriptor
   bool                  finishable_L        ();
+  bool                  epoll_add_L         (const EventSourceP &source);    ///< Register PollFD of a watched source.
+  bool                  epoll_rearm_L       (const EventSourceP &source);    ///< Re-enable PollFD after dispatching.
+  void                  epoll_remove_L      (EventSource &source);
+  void                  epoll_collect_L     ();                 ///< Flag sources of ready epoll registrations.
   void                  wakeup_poll         ();                 ///< Wakeup main loop from polling.
   void                  add_loop_L          (EventLoop &loop);  ///< Adds a sub loop to this main loop.
   void                  kill_loop_Lm        (EventLoop &loop);  ///< Destroy a sub loop and all its sources.
@@ -173,6 +192,7 @@ struct LoopState {
 class EventSource /// EventLoop source for callback execution.
 {
   friend       class EventLoop;
+  friend       class MainLoop;
   ASE_CLASS_NON_COPYABLE (EventSource);
 protected:
   EventLoop   *loop_;
@@ -187,7 +207,13 @@ protected:
   uint         dispatching_ : 1;
   uint         was_dispatching_ : 1;
   uint         primary_ : 1;
+  uint         watched_ : 2;
+  int          watch_fd_;
+  uint         heap_index_;
+  uint64       heap_usecs_;
   uint         n_pfds      ();
+  virtual bool    watch_timer  (uint64 *expiration_usecs);     ///< Provide expiration, if readiness only depends on a timeout.
+  virtual PollFD* watch_pollfd ();                             ///< Provide PollFD, if readiness only depends on a single descriptor.
   explicit     EventSource ();
   uint         source_id   () { return loop_ ? id_ : 0; }
   virtual     ~EventSource ();
@@ -266,6 +292,7 @@ protected:
   virtual bool prepare      (const LoopState &state, int64 *timeout_usecs_p);
   virtual bool check        (const LoopState &state);
   virtual bool dispatch     (const LoopState &state);
+  virtual bool watch_timer  (uint64 *expiration_usecs);
   explicit     TimedSource  (const BoolSlot &slot, uint initial_interval_msecs, uint repeat_interval_msecs);
   explicit     TimedSource  (const VoidSlot &slot, uint initial_interval_msecs, uint repeat_interval_msecs);
 public:
@@ -287,6 +314,7 @@ protected:
   virtual bool  check           (const LoopState &state);
   virtual bool  dispatch        (const LoopState &state);
   virtual void  destroy         ();
+  virtual PollFD* watch_pollfd  ();
   PollFD        pfd_;
   uint          never_close_ : 1;      // 'C'
 private:
@@ -9,6 +9,8 @@
 #include "project.hh"
 #include "loft.hh"
 #include "compress.hh"
+#include "clapplugin.hh"
+#include "nativedevice.hh"
 #include "internal.hh"
 #include "testing.hh"
 
@@ -384,6 +386,10 @@ main (int argc, char *argv[])
   using namespace Ase;
   using namespace AnsiColors;
 
+  // scan CLAP plugins in a crash isolated child process, before any setup
+  if (argc == 3 && strcmp (argv[1], "--clap-scan") == 0)
+    return clap_scan_helper (argv[2]);
+
   // setup thread identifier
   TaskRegistry::setup_ase ("AnklangMainProc");
   // use malloc to serve allocations via sbrk only (avoid mmap)
@@ -575,9 +581,11 @@ main (int argc, char *argv[])
 
   // halt audio engine, join its threads, dispatch cleanups
   audio_engine.set_project (nullptr);
+  clear_device_pool();
   audio_engine.stop_threads();
   main_loop->iterate_pending();
   main_config_.engine = nullptr;
+  TrackImpl::freeze_cleanup();
 
   return exitcode;
 }
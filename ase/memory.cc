@@ -1,18 +1,16 @@
 // This Source Code Form is licensed MPL-2.0: http://mozilla.org/MPL/2.0
 #include "memory.hh"
 #include "ase/internal.hh"
+#include "ase/atomics.hh"
 #include <ase/testing.hh>
 #include <sys/mman.h>
 #include <unistd.h>     // _SC_PAGESIZE
 #include <shared_mutex>
 #include <atomic>
+#include <thread>
+#include <array>
 
 #define MEM_ALIGN(addr, alignment)      (alignment * size_t ((size_t (addr) + alignment - 1) / alignment))
-#ifdef  NDEBUG
-#define CHECK_FREE_OVERLAPS             0       // avoid paranoid check
-#else
-#define CHECK_FREE_OVERLAPS             1       // slow check to catch overlaps from invalid release_ext
-#endif
 
 inline constexpr size_t MINIMUM_ARENA_SIZE = 4 * 1024 * 1024;
 inline constexpr size_t MINIMUM_HUGEPAGE = 2 * 1024 * 1024;
@@ -138,19 +136,37 @@ struct Extent32 {
 };
 
 // SequentialFitAllocator
+/* Free extents are kept in segregated doubly linked lists whose links are stored inside the free
+ * memory itself, so allocating and releasing never calls into the system allocator. Size classes
+ * subdivide each power of 2 into 8 ranges and a class bitmap yields the first non-empty class that
+ * is large enough. Boundary bits mark the first and last granule of each free extent and the last
+ * 4 bytes of a free extent hold its start, so coalescing is O(1). Free memory is kept zeroed apart
+ * from the list heads and start tags.
+ */
 struct SequentialFitAllocator {
+  static constexpr uint32 NONE = ~0u;
+  static constexpr uint   SL_BITS = 3;
+  static constexpr uint   N_CLASSES = 256;
+  struct FreeHead {
+    uint32 length, prev, next;
+  };
   HugePageP             blob;
-  std::vector<Extent32> extents; // free list
   const uint32          mem_alignment;
+  std::array<uint32,N_CLASSES>      heads;              // first free extent per size class
+  std::array<uint64,N_CLASSES / 64> nonempty = {};      // bitmap of classes with free extents
+  std::vector<uint64>   head_bits, tail_bits;           // first and last granule of free extents
+  size_t                n_free = 0;
   SequentialFitAllocator (HugePageP newblob, uint32 alignment) :
     blob (newblob), mem_alignment (alignment)
   {
     assert_return (size() > 0);
     assert_return (mem_alignment <= blob->alignment());
+    assert_return (mem_alignment >= sizeof (FreeHead) + sizeof (uint32));
     assert_return ((size_t (blob->mem()) & (blob->alignment() - 1)) == 0);
-    if (size() >= 1024 * 1024)
-      extents.reserve (1024);
     assert_return (size() <= 4294967295);
+    heads.fill (NONE);
+    head_bits.resize (n_granules() / 64 + 1);
+    tail_bits.resize (n_granules() / 64 + 1);
     Extent32 area { 0, uint32_t (size()) };
     area.zero (blob->mem());
     release_ext (area);
@@ -161,7 +177,6 @@ struct SequentialFitAllocator {
     const size_t s = sum();
     if (s != blob->size())
       warning ("%s:%s: deleting area while bytes are unreleased: %zd", __FILE__, __func__, blob->size() - s);
-    extents.clear();
   }
   char*
   memory () const
@@ -177,74 +192,126 @@ struct SequentialFitAllocator {
   sum () const
   {
     size_t s = 0;
-    for (const auto b : extents)
-      s += b.length;
+    for (uint32 start : heads)
+      for (uint32 e = start; e != NONE; e = free_head (e).next)
+        s += free_head (e).length;
     return s;
   }
+  size_t
+  n_extents () const
+  {
+    return n_free;
+  }
+  uint32
+  n_granules () const
+  {
+    return size() / mem_alignment;
+  }
+  FreeHead&
+  free_head (uint32 start) const
+  {
+    return *reinterpret_cast<FreeHead*> (blob->mem() + start);
+  }
+  uint32&
+  start_tag (uint32 end) const  // stored in the last bytes of a free extent ending at `end`
+  {
+    return *reinterpret_cast<uint32*> (blob->mem() + end - sizeof (uint32));
+  }
+  static bool
+  test_bit (const std::vector<uint64> &bits, uint32 i)
+  {
+    return bits[i >> 6] & (uint64 (1) << (i & 63));
+  }
+  static void
+  assign_bit (std::vector<uint64> &bits, uint32 i, bool v)
+  {
+    if (v)
+      bits[i >> 6] |= uint64 (1) << (i & 63);
+    else
+      bits[i >> 6] &= ~(uint64 (1) << (i & 63));
+  }
+  static uint
+  size_class (uint32 granules)
+  {
+    if (granules < (2u << SL_BITS))
+      return granules;          // small sizes map linearly
+    const uint l = 31 - __builtin_clz (granules);
+    return ((l - SL_BITS + 1) << SL_BITS) + ((granules >> (l - SL_BITS)) & ((1u << SL_BITS) - 1));
+  }
+  void
+  link (uint32 start, uint32 length)
+  {
+    const uint c = size_class (length / mem_alignment);
+    free_head (start) = { length, NONE, heads[c] };
+    if (heads[c] != NONE)
+      free_head (heads[c]).prev = start;
+    heads[c] = start;
+    nonempty[c >> 6] |= uint64 (1) << (c & 63);
+    start_tag (start + length) = start;
+    assign_bit (head_bits, start / mem_alignment, true);
+    assign_bit (tail_bits, (start + length) / mem_alignment - 1, true);
+    n_free++;
+  }
+  uint32
+  unlink (uint32 start)
+  {
+    FreeHead &h = free_head (start);
+    const uint32 length = h.length;
+    const uint c = size_class (length / mem_alignment);
+    if (h.prev != NONE)
+      free_head (h.prev).next = h.next;
+    else
+      heads[c] = h.next;
+    if (h.next != NONE)
+      free_head (h.next).prev = h.prev;
+    if (heads[c] == NONE)
+      nonempty[c >> 6] &= ~(uint64 (1) << (c & 63));
+    assign_bit (head_bits, start / mem_alignment, false);
+    assign_bit (tail_bits, (start + length) / mem_alignment - 1, false);
+    h = {};                     // keep released memory zeroed
+    start_tag (start + length) = 0;
+    n_free--;
+    return length;
+  }
   void
   release_ext (const Extent32 &ext)
   {
     assert_return (ext.length > 0);
     assert_return (ext.start + ext.length <= blob->size());
+    assert_return (((ext.start | ext.length) & (mem_alignment - 1)) == 0);
+    const uint32 first = ext.start / mem_alignment, last = (ext.start + ext.length) / mem_alignment - 1;
+    assert_return (!test_bit (head_bits, first) && !test_bit (tail_bits, last));  // overlaps existing
     ext.zero (blob->mem());
-    ssize_t overlaps_existing = -1, before = -1, after = -1;
-    for (size_t i = 0; i < extents.size(); i++)
-      if (ext.start == extents[i].start + extents[i].length)
-        {
-          after = i;
-          if (UNLIKELY (before >= 0))
-            break;
-        }
-      else if (ext.start + ext.length == extents[i].start)
-        {
-          before = i;
-          if (UNLIKELY (after >= 0))
-            break;
-        }
-      else if (CHECK_FREE_OVERLAPS &&
-               ext.start + ext.length > extents[i].start &&
-               ext.start < extents[i].start + extents[i].length)
-        overlaps_existing = i;
-    assert_return (overlaps_existing == -1);
-    // merge with existing extents
-    if (after >= 0)
+    uint32 start = ext.start, length = ext.length;
+    if (first > 0 && test_bit (tail_bits, first - 1))   // merge preceding extent
       {
-        extents[after].length += ext.length;
-        if (before >= 0)
-          {
-            extents[after].length += extents[before].length;
-            extents.erase (extents.begin() + before);
-          }
-        return;
+        const uint32 before = start_tag (start);
+        length += unlink (before);
+        start = before;
       }
-    if (before >= 0)
-      {
-        extents[before].length += ext.length;
-        extents[before].start = ext.start;
-        return;
-      }
-    // add isolated block to free list
-    extents.push_back (ext);
+    if (last + 1 < n_granules() && test_bit (head_bits, last + 1))      // merge succeeding extent
+      length += unlink (ext.start + ext.length);
+    link (start, length);
   }
-  ssize_t
-  best_fit (size_t length) const
+  uint32
+  good_fit (uint32 length) const
   {
-    ssize_t candidate = -1;
-    for (size_t j = 0; j < extents.size(); j++)
+    // first extent from the smallest class whose extents all fit, the lowest class requires a scan
+    const uint32 granules = length / mem_alignment;
+    uint32 rounded = granules;
+    if (granules >= (2u << SL_BITS))
+      rounded += (1u << (31 - __builtin_clz (granules) - SL_BITS)) - 1;
+    const uint c = size_class (rounded);
+    for (uint w = c >> 6; w < nonempty.size(); w++)
       {
-        const size_t i = extents.size() - 1 - j; // recent blocks are at the end
-        if (ISLIKELY (length > extents[i].length))
-          continue;                                     // profiled, ISLIKELY saves ~7%
-        if (ISLIKELY (length == extents[i].length))     // profiled, ISLIKELY saves ~20%
-          return i;
-        // length < extents[i].length
-        if (ISLIKELY (candidate < 0) or                 // profiled, ISLIKELY saves ~20%
-            ISLIKELY (extents[i].length < extents[candidate].length) or
-            (ISLIKELY (extents[i].length == extents[candidate].length) and
-             ISLIKELY (extents[i].start < extents[candidate].start)))
-          candidate = i;
+        const uint64 bits = w == c >> 6 ? nonempty[w] & (~uint64 (0) << (c & 63)) : nonempty[w];
+        if (bits)
+          return heads[w * 64 + __builtin_ctzll (bits)];
       }
-    return candidate;
+    for (uint32 e = heads[size_class (granules)]; e != NONE; e = free_head (e).next)
+      if (free_head (e).length >= length)
+        return e;
+    return NONE;
   }
   bool
   alloc_ext (Extent32 &ext)
@@ -253,44 +320,17 @@ struct SequentialFitAllocator {
     assert_return (ext.length > 0, false);
     const uint32 aligned_length = MEM_ALIGN (ext.length, mem_alignment);
     // find block
-    const ssize_t candidate = best_fit (aligned_length);
-    if (candidate < 0)
+    const uint32 candidate = good_fit (aligned_length);
+    if (candidate == NONE)
       return false;     // OOM
     // allocate from start of larger block (to facilitate future Arena growth)
-    ext.start = extents[candidate].start;
+    const uint32 length = unlink (candidate);
+    ext.start = candidate;
     ext.length = aligned_length;
-    if (UNLIKELY (extents[candidate].length > aligned_length))
-      {
-        extents[candidate].start += aligned_length;
-        extents[candidate].length -= aligned_length;
-      }
-    else // unlist if block wasn't larger
-      {
-        // extents.erase (extents.begin() + candidate);
-        extents[candidate] = extents.back();
-        extents.resize (extents.size() - 1);
-      }
+    if (UNLIKELY (length > aligned_length))
+      link (candidate + aligned_length, length - aligned_length);       // relist remainder
     return true;
   }
-#if 0 // only needed for deferred coalescing which rarely speeds things up
-  void
-  coalesce_extents()
-  {
-    if (extents.size())
-      {
-        auto isless_start = [] (const Extent32 &a, const Extent32 &b) -> bool {
-          return a.start < b.start;
-        };
-        std::sort (extents.begin(), extents.end(), isless_start);
-        for (size_t i = extents.size() - 1; i > 0; i--)
-          if (extents[i-1].start + extents[i-1].length == extents[i].start) // adjacent
-            {
-              extents[i-1].length += extents[i].length;
-              extents.erase (extents.begin() + i);
-            }
-      }
-  }
-#endif
 };
 
 struct Allocator : SequentialFitAllocator {
@@ -523,12 +563,238 @@ mm_info_pop_mt (void *block_start) // MT-Safe
   return {};
 }
 
+// == Magazines ==
+/* Small blocks are served from per-thread magazines, see Bonwick & Adams, "Magazines and Vmem".
+ * A magazine is a fixed size stack of free blocks of one size class, each thread has one
+ * loaded magazine per size class and allocates or frees without locks or atomics as long
+ * as the loaded magazine is non-empty (alloc) or non-full (free).
+ * Full magazines are exchanged against an empty one (or vice versa) through a lock-free
+ * depot, only refilling from slabs takes the fast_mem_mutex, once per MAGAZINE_CAPACITY blocks.
+ * Size class blocks are carved from 2MB slab arenas that are aligned to their size, so the
+ * slab (and thus size class) of a block is found with a lock-free lookup on free.
+ * Like Loft, blocks that once entered a size class are never given back to the arenas.
+ */
+inline constexpr size_t MAGAZINE_BLOCK_LIMIT = 4096;    // serve blocks up to this size from magazines
+inline constexpr size_t MAGAZINE_CLASSES = MAGAZINE_BLOCK_LIMIT / cache_line_size;
+inline constexpr size_t MAGAZINE_CAPACITY = 30;         // sizeof (Magazine) == 256
+inline constexpr size_t SLAB_ARENA_SIZE = MINIMUM_HUGEPAGE;
+inline constexpr size_t SLAB_SIZE = 64 * 1024;
+inline constexpr size_t SLAB_TABLE_BITS = 10;
+inline constexpr size_t SLAB_TABLE_SIZE = 1 << SLAB_TABLE_BITS;
+static_assert (SLAB_SIZE >= MAGAZINE_BLOCK_LIMIT && SLAB_ARENA_SIZE % SLAB_SIZE == 0);
+
+struct alignas (cache_line_size) Magazine {
+  Atomic<Magazine*> intr_ptr_ = nullptr;        // atomic intrusive pointer for MpmcStack
+  uint32            count = 0;
+  void             *blocks[MAGAZINE_CAPACITY] = {};
+};
+
+struct MagazineDepot {
+  std::array<MpmcStack<Magazine>,MAGAZINE_CLASSES> full;
+  MpmcStack<Magazine>                               empty;
+};
+static MagazineDepot &magazine_depot = *new MagazineDepot(); // never destroyed, threads may still exit
+
+struct SlabArena {
+  HugePageP blob;
+  uintptr_t base = 0;
+  uint32    next_slab = 0;
+  uint8     slab_class[SLAB_ARENA_SIZE / SLAB_SIZE] = {};
+};
+static std::atomic<SlabArena*> slab_arena_table[SLAB_TABLE_SIZE] = {};
+static size_t     slab_arena_count = 0;         // MT-Guarded by fast_mem_mutex
+static SlabArena *slab_arena_current = nullptr; // MT-Guarded by fast_mem_mutex
+struct SlabCursor { char *next = nullptr, *end = nullptr; };
+static SlabCursor slab_cursors[MAGAZINE_CLASSES]; // MT-Guarded by fast_mem_mutex
+
+static inline uint32
+magazine_class (size_t size)
+{
+  return (size + (size == 0) - 1) / cache_line_size;
+}
+
+static inline size_t
+slab_arena_hash (uintptr_t base)
+{
+  const uint64_t M = 11400714819323198487ull; // golden ratio, rounded up to next odd
+  return (uint64_t (base / SLAB_ARENA_SIZE) * M) >> (64 - SLAB_TABLE_BITS);
+}
+
+static SlabArena*
+slab_arena_lookup (const void *ptr) // MT-Safe, lock-free
+{
+  const uintptr_t base = uintptr_t (ptr) & ~uintptr_t (SLAB_ARENA_SIZE - 1);
+  for (size_t i = slab_arena_hash (base), n = 0; n < SLAB_TABLE_SIZE; i = (i + 1) & (SLAB_TABLE_SIZE - 1), n++)
+    {
+      SlabArena *sarena = slab_arena_table[i].load (std::memory_order_acquire);
+      if (!sarena || sarena->base == base)
+        return sarena;
+    }
+  return nullptr;
+}
+
+static char*
+slab_carve_L (uint32 klass)
+{
+  if (!slab_arena_current || slab_arena_current->next_slab >= SLAB_ARENA_SIZE / SLAB_SIZE)
+    {
+      if (slab_arena_count >= SLAB_TABLE_SIZE / 2)
+        return nullptr; // keep the lookup table sparse, serve from FastMemory::Arena instead
+      HugePageP blob = HugePage::allocate (SLAB_ARENA_SIZE, SLAB_ARENA_SIZE);
+      if (!blob || !blob->mem() || blob->size() != SLAB_ARENA_SIZE)
+        return nullptr;
+      memset (blob->mem(), 0, blob->size());
+      SlabArena *sarena = new SlabArena();
+      sarena->blob = blob;
+      sarena->base = uintptr_t (blob->mem());
+      size_t i = slab_arena_hash (sarena->base);
+      while (slab_arena_table[i].load())
+        i = (i + 1) & (SLAB_TABLE_SIZE - 1);
+      slab_arena_table[i].store (sarena, std::memory_order_release);
+      slab_arena_count++;
+      slab_arena_current = sarena;
+    }
+  const uint32 index = slab_arena_current->next_slab++;
+  slab_arena_current->slab_class[index] = klass;
+  return slab_arena_current->blob->mem() + index * SLAB_SIZE;
+}
+
+static Magazine*
+magazine_new_empty()
+{
+  Magazine *mag = magazine_depot.empty.pop();
+  if (!mag)
+    mag = new Magazine(); // non-reclaimable, recycled through magazine_depot.empty
+  return mag;
+}
+
+static Magazine*
+magazine_refill (uint32 klass)
+{
+  Magazine *mag = magazine_new_empty();
+  const size_t bsize = (klass + 1) * cache_line_size;
+  std::lock_guard<std::mutex> locker (fast_mem_mutex);
+  SlabCursor &cursor = slab_cursors[klass];
+  while (mag->count < MAGAZINE_CAPACITY)
+    {
+      if (cursor.next + bsize > cursor.end)
+        {
+          char *slab = slab_carve_L (klass);
+          if (!slab)
+            break;
+          cursor.next = slab;
+          cursor.end = slab + SLAB_SIZE;
+        }
+      mag->blocks[mag->count++] = cursor.next;
+      cursor.next += bsize;
+    }
+  if (mag->count)
+    return mag;
+  magazine_depot.empty.push (mag);
+  return nullptr;
+}
+
+/// Per-thread magazines, trivially destructible to remain accessible during thread exit.
+struct ThreadMagazines {
+  Magazine *loaded[MAGAZINE_CLASSES];
+  bool      registered, exited;
+};
+static thread_local ThreadMagazines thread_magazines;
+
+static void
+thread_magazines_flush()
+{
+  ThreadMagazines &tm = thread_magazines;
+  for (uint32 klass = 0; klass < MAGAZINE_CLASSES; klass++)
+    if (Magazine *mag = tm.loaded[klass]; mag)
+      {
+        tm.loaded[klass] = nullptr;
+        if (mag->count)
+          magazine_depot.full[klass].push (mag);
+        else
+          magazine_depot.empty.push (mag);
+      }
+  tm.registered = false;
+  tm.exited = true;
+}
+
+static inline ThreadMagazines*
+thread_magazines_get()
+{
+  ThreadMagazines &tm = thread_magazines;
+  if (ISLIKELY (tm.registered))
+    return &tm;
+  if (tm.exited)
+    return nullptr;     // thread is exiting, bypass the thread cache
+  struct Flusher { ~Flusher() { thread_magazines_flush(); } };
+  static thread_local Flusher flusher;
+  (void) flusher;       // ODR-use to register the per-thread destructor
+  tm.registered = true;
+  return &tm;
+}
+
+static void*
+magazine_alloc (uint32 klass) // MT-Safe
+{
+  ThreadMagazines *tm = thread_magazines_get();
+  Magazine *mag = tm ? tm->loaded[klass] : nullptr;
+  if (ISLIKELY (mag && mag->count))
+    return mag->blocks[--mag->count];
+  // exchange empty magazine against a full one
+  Magazine *full = magazine_depot.full[klass].pop();
+  if (!full)
+    full = magazine_refill (klass);
+  if (!full)
+    return nullptr;
+  void *const ptr = full->blocks[--full->count];
+  if (!tm)              // no thread cache, hand back right away
+    {
+      if (full->count)
+        magazine_depot.full[klass].push (full);
+      else
+        magazine_depot.empty.push (full);
+      return ptr;
+    }
+  if (mag)
+    magazine_depot.empty.push (mag);
+  tm->loaded[klass] = full;
+  return ptr;
+}
+
+static void
+magazine_free (void *mem, uint32 klass) // MT-Safe
+{
+  memset (__builtin_assume_aligned (mem, cache_line_size), 0, (klass + 1) * cache_line_size);
+  ThreadMagazines *tm = thread_magazines_get();
+  Magazine *mag = tm ? tm->loaded[klass] : nullptr;
+  if (ISLIKELY (mag && mag->count < MAGAZINE_CAPACITY))
+    {
+      mag->blocks[mag->count++] = mem;
+      return;
+    }
+  // batch return full magazine to the depot, continue with an empty one
+  if (mag)
+    magazine_depot.full[klass].push (mag);
+  Magazine *fresh = magazine_new_empty();
+  fresh->blocks[fresh->count++] = mem;
+  if (tm)
+    tm->loaded[klass] = fresh;
+  else
+    magazine_depot.full[klass].push (fresh);
+}
+
 } // FastMemory
 
 // == aligned malloc/calloc/free ==
 void*
 fast_mem_alloc (size_t size)
 {
+  if (ISLIKELY (size <= FastMemory::MAGAZINE_BLOCK_LIMIT))
+    {
+      void *const ptr = FastMemory::magazine_alloc (FastMemory::magazine_class (size));
+      if (ISLIKELY (ptr != nullptr))
+        return ptr;
+    }
   std::unique_lock<std::mutex> shortlock (FastMemory::fast_mem_mutex);
   FastMemory::ArenaBlock ab = FastMemory::fast_mem_allocate_aligned_block_L (size); // MT-Guarded
   shortlock.unlock();
@@ -544,6 +810,14 @@ void
 fast_mem_free (void *mem)
 {
   return_unless (mem);
+  if (FastMemory::SlabArena *sarena = FastMemory::slab_arena_lookup (mem); sarena)
+    {
+      const size_t offset = uintptr_t (mem) - sarena->base;
+      const uint32 klass = sarena->slab_class[offset / FastMemory::SLAB_SIZE];
+      if (UNLIKELY ((offset % FastMemory::SLAB_SIZE) % ((klass + 1) * FastMemory::cache_line_size) != 0))
+        fatal_error ("%s: invalid memory pointer: %p\n", __func__, mem);
+      return FastMemory::magazine_free (mem, klass);
+    }
   FastMemory::ArenaBlock ab = FastMemory::mm_info_pop_mt (mem);
   if (!ab.block_start)
     fatal_error ("%s: invalid memory pointer: %p\n", __func__, mem);
@@ -551,6 +825,14 @@ fast_mem_free (void *mem)
   FastMemory::fast_mem_arenas[ab.arena_index].release (ab.block()); // MT-Guarded
 }
 
+void
+fast_mem_prefault ()
+{
+  std::lock_guard<std::mutex> locker (FastMemory::fast_mem_mutex);
+  for (const FastMemory::Arena &arena : FastMemory::fast_mem_arenas)
+    memory_prefault ((void*) arena.location(), arena.reserved());
+}
+
 // == CString ==
 #ifndef NDEBUG
 static CString cstring_early_test = "NULL"; // initialization must preceede cstring_globals
@@ -564,14 +846,42 @@ class CStringTable {
     bool operator() (const String *a, const String *b) const noexcept   { return *a == *b; }
   };
   using StrPtrMap = std::unordered_map<const String*,uint,StrPtrHash,StrPtrEqual>;
-  StrPtrMap                  quarks_;
-  std::vector<const String*> strings_;
-  std::shared_mutex          mutex_;
+  // Append-only string vector, chunk `k` holds `FIRST_CHUNK << k` entries and is never moved,
+  // so quark -> string lookups are wait-free once a quark is published via `size_`.
+  static constexpr uint FIRST_CHUNK_BITS = 10;
+  static constexpr uint N_CHUNKS = 32 - FIRST_CHUNK_BITS;
+  std::atomic<const String**> chunks_[N_CHUNKS] = {};
+  std::atomic<uint>           size_ = 0;
+  StrPtrMap                   quarks_;
+  std::shared_mutex           mutex_;
+  static uint
+  chunk_index (uint quark, uint *offset)
+  {
+    const uint64 v = uint64 (quark) + (1 << FIRST_CHUNK_BITS);
+    const uint k = 63 - __builtin_clzll (v) - FIRST_CHUNK_BITS;
+    *offset = v - (uint64 (1) << (k + FIRST_CHUNK_BITS));
+    return k;
+  }
+  void
+  append_L (const String *string)
+  {
+    const uint quark = size_.load (std::memory_order_relaxed);
+    uint offset;
+    const uint k = chunk_index (quark, &offset);
+    const String **chunk = chunks_[k].load (std::memory_order_relaxed);
+    if (!chunk)
+      {
+        chunk = new const String*[size_t (1) << (k + FIRST_CHUNK_BITS)] ();
+        chunks_[k].store (chunk, std::memory_order_relaxed); // published by size_
+      }
+    chunk[offset] = string;
+    quarks_[string] = quark;
+    size_.store (quark + 1, std::memory_order_release);
+  }
   CStringTable()
   {
     static String empty_string;
-    strings_ = { &empty_string }; // ID==0
-    quarks_[&empty_string] = 0;
+    append_L (&empty_string); // ID==0
   }
 public:
   uint                 add    (const String &s) noexcept;
@@ -583,32 +893,39 @@ public:
 uint
 CStringTable::add (const String &s) noexcept
 {
+  {
+    const std::shared_lock slock (mutex_);
+    auto it = quarks_.find (&s);
+    if (it != quarks_.end()) [[likely]]
+      return it->second;
+  }
   const std::unique_lock ulock (mutex_);
   auto it = quarks_.find (&s);
-  if (it != quarks_.end()) [[likely]]
+  if (it != quarks_.end())
     return it->second;
-  const uint quark = strings_.size();
-  strings_.push_back (new String (s));
-  quarks_[strings_.back()] = quark;
+  const uint quark = size_.load (std::memory_order_relaxed);
+  append_L (new String (s));
   return quark;
 }
 
 uint
 CStringTable::find (const String &s) noexcept
 {
-  const std::unique_lock ulock (mutex_);
+  const std::shared_lock slock (mutex_);
   auto it = quarks_.find (&s);
   if (it == quarks_.end()) return 0;
   return it->second;
 }
 
+/// Wait-free lookup of the string for `quark`.
 const String&
 CStringTable::lookup (uint quark) noexcept
 {
-  const std::unique_lock ulock (mutex_);
-  if (quark < strings_.size()) [[likely]]
-    return *strings_[quark];
-  return *strings_[0]; // empty_string;
+  if (quark >= size_.load (std::memory_order_acquire)) [[unlikely]]
+    quark = 0; // empty_string;
+  uint offset;
+  const uint k = chunk_index (quark, &offset);
+  return *chunks_[k].load (std::memory_order_relaxed)[offset];
 }
 
 /// Assign a std::string to a CString, after deduplication, its memory is never released.
@@ -713,6 +1030,23 @@ aligned_allocator_tests()
   fma.release_ext (s1);
   fma.release_ext (s4);
   assert_return (fma.sum() == asz);
+  assert_return (fma.n_extents() == 1);
+  // release in random order, check coalescing
+  std::vector<Extent32> exts;
+  for (size_t i = 0; i < asz / 64; i++)
+    {
+      Extent32 e (64);
+      success = fma.alloc_ext (e);
+      assert_return (success);
+      exts.push_back (e);
+    }
+  assert_return (fma.sum() == 0 && fma.n_extents() == 0);
+  for (size_t i = exts.size() - 1; i > 0; i--)
+    std::swap (exts[i], exts[random_irange (0, i + 1)]);
+  for (const auto &e : exts)
+    fma.release_ext (e);
+  assert_return (fma.sum() == asz);
+  assert_return (fma.n_extents() == 1);
   // test general purpose allocations exceeding a single FastMemory::Arena
   std::vector<void*> ptrs;
   size_t sum = 0;
@@ -728,6 +1062,32 @@ aligned_allocator_tests()
       fast_mem_free (ptrs.back());
       ptrs.pop_back();
     }
+  // test cross-thread release of magazine blocks, released blocks must be zeroed
+  for (size_t i = 0; i < 4096; i++)
+    ptrs.push_back (nullptr);
+  std::thread producer ([&ptrs] () {
+    for (size_t i = 0; i < ptrs.size(); i++)
+      {
+        const size_t sz = 1 + i % FastMemory::MAGAZINE_BLOCK_LIMIT;
+        char *mem = (char*) fast_mem_alloc (sz);
+        assert_return (mem && 0 == (uintptr_t (mem) & (FastMemory::cache_line_size - 1)));
+        assert_return (mem[0] == 0 && mem[sz - 1] == 0);
+        mem[0] = mem[sz - 1] = 1;
+        ptrs[i] = mem;
+      }
+  });
+  producer.join();
+  for (void *mem : ptrs)
+    fast_mem_free (mem);
+  for (size_t i = 0; i < ptrs.size(); i++)
+    {
+      const size_t sz = 1 + i % FastMemory::MAGAZINE_BLOCK_LIMIT;
+      char *mem = (char*) fast_mem_alloc (sz);
+      assert_return (mem[0] == 0 && mem[sz - 1] == 0);
+      ptrs[i] = mem;
+    }
+  for (void *mem : ptrs)
+    fast_mem_free (mem);
 }
 
 TEST_INTEGRITY (memory_cstring_tests);
@@ -824,6 +1184,17 @@ memory_cstring_tests()
   assert_return (a != bc);
   assert_return (ac != b);
   assert_return ("foo" == CString::temp_quark_impl (CString::temp_quark_impl ("foo")));
+  // span several chunks of the quark table, concurrent readers
+  CStringS cstrings;
+  for (size_t i = 0; i < 5000; i++)
+    cstrings.push_back (string_format ("memory_cstring_tests-%u", i));
+  std::thread reader ([&cstrings] () {
+    for (size_t i = 0; i < cstrings.size(); i++)
+      assert_return (cstrings[i] == string_format ("memory_cstring_tests-%u", i));
+  });
+  for (size_t i = 0; i < cstrings.size(); i++)
+    assert_return (CString::lookup (string_format ("memory_cstring_tests-%u", i)) == cstrings[i]);
+  reader.join();
 }
 
 } // Anon
@@ -18,6 +18,8 @@ inline constexpr size_t cache_line_size = 64;
 void*   fast_mem_alloc  (size_t size);
 // Free a memory block allocated with aligned_malloc(), MT-Safe.
 void    fast_mem_free   (void *mem);
+// Populate the pages of all fast memory arenas to avoid page faults during allocations, MT-Safe.
+void    fast_mem_prefault ();
 
 /// Array with cache-line-alignment containing a fixed numer of PODs.
 template<typename T, size_t ALIGNMENT = FastMemory::cache_line_size>
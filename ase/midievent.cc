@@ -174,8 +174,30 @@ make_param_value (uint param, double pvalue)
 }
 
 // == MidiEventOutput ==
-MidiEventOutput::MidiEventOutput ()
-{}
+MidiEventOutput::MidiEventOutput (uint32 capacity)
+{
+  reserve (capacity);
+}
+
+MidiEventOutput::~MidiEventOutput ()
+{
+  if (events_)
+    fast_mem_free (events_);
+}
+
+/// Grow the capacity to at least `n` events, must not be called during rendering.
+void
+MidiEventOutput::reserve (size_t n)
+{
+  return_unless (n > capacity_);
+  MidiEvent *events = (MidiEvent*) fast_mem_alloc (n * sizeof (MidiEvent));
+  if (size_)
+    memcpy ((void*) events, events_, size_ * sizeof (MidiEvent));
+  if (events_)
+    fast_mem_free (events_);
+  events_ = events;
+  capacity_ = n;
+}
 
 /// Append an MidiEvent with conscutive `frame` time stamp.
 void
@@ -190,12 +212,18 @@ MidiEventOutput::append (int16_t frame, const MidiEvent &event)
 bool
 MidiEventOutput::append_unsorted (int16_t frame, const MidiEvent &event)
 {
+  const uint32 limit = event.type == MidiEvent::NOTE_OFF ? capacity_ : capacity_ - capacity_ / 32;
+  if (size_ >= limit) [[unlikely]]
+    {
+      dropped_++;
+      return false;
+    }
   // we discard timing information by ignoring negative frame offsets here (#26)
   // when we implement recording, we might want to preserve the exact timestamp
   frame = std::max<int16_t> (frame, 0);
-  const int64_t last_event_stamp = !events_.empty() ? events_.back().frame : 0;
-  events_.push_back (event);
-  events_.back().frame = frame;
+  const int64_t last_event_stamp = size_ ? events_[size_ - 1].frame : 0;
+  MidiEvent *mevent = new (events_ + size_++) MidiEvent (event);
+  mevent->frame = frame;
   return frame < last_event_stamp;
 }
 
@@ -203,7 +231,7 @@ MidiEventOutput::append_unsorted (int16_t frame, const MidiEvent &event)
 void
 MidiEventOutput::ensure_order ()
 {
-  fixed_sort (events_.begin(), events_.end(), [] (const MidiEvent &a, const MidiEvent &b) -> bool {
+  fixed_sort (events_, events_ + size_, [] (const MidiEvent &a, const MidiEvent &b) -> bool {
     return a.frame < b.frame;
   });
 }
@@ -212,7 +240,65 @@ MidiEventOutput::ensure_order ()
 int64_t
 MidiEventOutput::last_frame () const
 {
-  return !events_.empty() ? events_.back().frame : 0;
+  return size_ ? events_[size_ - 1].frame : 0;
 }
 
 } // Ase
+
+// == Testing ==
+#include "testing.hh"
+
+namespace { // Anon
+using namespace Ase;
+
+TEST_INTEGRITY (midi_event_output_tests);
+static void
+midi_event_output_tests()
+{
+  // stress streams with 10k events per block, merged in order
+  constexpr uint N_EVENTS = 10000, BLOCK = 256;
+  constexpr uint CAPACITY = N_EVENTS + N_EVENTS / 16;
+  MidiEventOutput a (CAPACITY), b (CAPACITY);
+  for (uint block = 0; block < 8; block++)
+    {
+      a.clear();
+      b.clear();
+      TASSERT (a.empty() && b.empty());
+      bool must_sort = false;
+      for (uint i = 0; i < N_EVENTS; i++)
+        {
+          a.append (i * BLOCK / N_EVENTS, make_note_on (0, i & 0x7f, 1));
+          must_sort |= b.append_unsorted ((N_EVENTS - 1 - i) * BLOCK / N_EVENTS, make_note_off (0, i & 0x7f, 1));
+        }
+      TASSERT (must_sort);
+      b.ensure_order();
+      MidiEventReader<2> reader ({ a.range(), b.range() });
+      TCMP (reader.events_pending(), ==, 2 * N_EVENTS);
+      uint last = 0, n = 0;
+      for (const MidiEvent &event : reader)
+        {
+          TCMP (event.frame, >=, last);
+          last = event.frame;
+          n++;
+        }
+      TCMP (n, ==, 2 * N_EVENTS);
+      TCMP (last, ==, BLOCK - 1);
+    }
+  TCMP (a.capacity(), ==, CAPACITY);
+  TCMP (a.dropped(), ==, 0u);
+  // overflowing streams keep a reserve for NOTE_OFF events
+  MidiEventOutput c (64);
+  for (uint i = 0; i < 100; i++)
+    c.append (i, make_note_on (0, 60, 1));
+  TCMP (c.size(), ==, 62u);
+  for (uint i = 0; i < 4; i++)
+    c.append (100, make_note_off (0, 60, 0));
+  TCMP (c.size(), ==, 64u);
+  TCMP (c.dropped(), ==, 40u);
+  TASSERT (c.end()[-1].type == MidiEvent::NOTE_OFF);
+  MidiEventOutput d (0);
+  d.append (0, make_note_off (0, 60, 0));
+  TASSERT (d.empty() && d.dropped() == 1);
+}
+
+} // Anon
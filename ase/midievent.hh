@@ -92,46 +92,72 @@ MidiEvent make_program     (uint16 chnl, uint prgrm);
 MidiEvent make_pitch_bend  (uint16 chnl, float val);
 MidiEvent make_param_value (uint param, double pvalue);
 
+/// A contiguous range of MidiEvent structures, as consumed by MidiEventReader.
+struct MidiEventRange {
+  const MidiEvent *first = nullptr, *last = nullptr;
+  const MidiEvent* begin () const noexcept { return first; }
+  const MidiEvent* end   () const noexcept { return last; }
+};
+
 /// A stream of writable MidiEvent structures.
+/// Events are bump allocated from a fixed capacity block of fast memory, so appending
+/// never allocates during rendering and clear() resets the stream in O(1).
+/// Events exceeding the capacity are dropped and counted, the last 1/32 of the capacity
+/// is reserved for NOTE_OFF events to avoid hanging notes.
 class MidiEventOutput {
-  std::vector<MidiEvent> events_; // TODO: use O(1) allocator
+  MidiEvent *events_ = nullptr;
+  uint32     size_ = 0, capacity_ = 0;
+  size_t     dropped_ = 0;
+  ASE_CLASS_NON_COPYABLE (MidiEventOutput);
 public:
-  explicit         MidiEventOutput ();
+  static constexpr uint32 DEFAULT_CAPACITY = 4096;
+  explicit         MidiEventOutput (uint32 capacity = DEFAULT_CAPACITY);
+  /*dtor*/        ~MidiEventOutput ();
   void             append          (int16_t frame, const MidiEvent &event);
-  const MidiEvent* begin           () const noexcept { return &*events_.begin(); }
-  const MidiEvent* end             () const noexcept { return &*events_.end(); }
-  size_t           size            () const noexcept { return events_.size(); }
-  bool             empty           () const noexcept { return events_.empty(); }
-  void             clear           () noexcept       { events_.clear(); }
+  const MidiEvent* begin           () const noexcept { return events_; }
+  const MidiEvent* end             () const noexcept { return events_ + size_; }
+  size_t           size            () const noexcept { return size_; }
+  bool             empty           () const noexcept { return size_ == 0; }
+  void             clear           () noexcept       { size_ = 0; } // MidiEvent needs no destruction
   bool             append_unsorted (int16_t frame, const MidiEvent &event);
   void             ensure_order    ();
   int64_t          last_frame      () const ASE_PURE;
-  size_t           capacity        () const noexcept    { return events_.capacity(); }
-  void             reserve         (size_t n)           { events_.reserve (n); }
-  std::vector<MidiEvent>
-  const&           vector          () { return events_; }
+  size_t           capacity        () const noexcept    { return capacity_; }
+  size_t           dropped         () const noexcept    { return dropped_; } ///< Events discarded due to overflow.
+  void             reserve         (size_t n);
+  MidiEventRange   range           () const noexcept    { return { begin(), end() }; }
 };
 
 /// An in-order MidiEvent reader for multiple MidiEvent sources.
 template<size_t MAXQUEUES>
-class MidiEventReader : QueueMultiplexer<MAXQUEUES,std::vector<MidiEvent>::const_iterator> {
-  using Base = QueueMultiplexer<MAXQUEUES,std::vector<MidiEvent>::const_iterator>;
+class MidiEventReader : QueueMultiplexer<MAXQUEUES,const MidiEvent*> {
+  using Base = QueueMultiplexer<MAXQUEUES,const MidiEvent*>;
   ASE_CLASS_NON_COPYABLE (MidiEventReader);
 public:
   using iterator = typename Base::iterator;
-  using Base::assign;
   size_t   events_pending  () const { return this->count_pending(); }
   iterator begin           ()       { return this->Base::begin(); }
   iterator end             ()       { return this->Base::end(); }
-  using VectorArray = std::array<const std::vector<MidiEvent>*, MAXQUEUES>;
-  /*ctor*/ MidiEventReader (const VectorArray &midi_event_vector_array = VectorArray());
+  using RangeArray = std::array<MidiEventRange, MAXQUEUES>;
+  /*ctor*/ MidiEventReader (const RangeArray &midi_event_ranges = RangeArray());
+  bool     assign          (const RangeArray &midi_event_ranges);
 };
 
 // == MidiEventReader ==
 template<size_t MAXQUEUES>
-MidiEventReader<MAXQUEUES>::MidiEventReader (const VectorArray &midi_event_vector_array)
+MidiEventReader<MAXQUEUES>::MidiEventReader (const RangeArray &midi_event_ranges)
+{
+  assign (midi_event_ranges);
+}
+
+/// Start reading from `midi_event_ranges`, returns if any events are pending.
+template<size_t MAXQUEUES> bool
+MidiEventReader<MAXQUEUES>::assign (const RangeArray &midi_event_ranges)
 {
-  assign (midi_event_vector_array);
+  std::array<const MidiEventRange*, MAXQUEUES> queues;
+  for (size_t i = 0; i < MAXQUEUES; i++)
+    queues[i] = &midi_event_ranges[i];
+  return this->Base::assign (queues);
 }
 
 inline int
@@ -13,6 +13,7 @@ namespace MidiLib {
 struct TickEvent {
   int64_t tick;
   MidiEvent event;
+  int64_t on_tick = 0;  // NOTE_ON tick of a NOTE_OFF event
 };
 template<ssize_t DIR>
 struct CmpTickEvents {
@@ -116,13 +117,32 @@ public:
       }
   }
   void
+  rollback () override
+  {
+    // notes started before the rolled back position keep sounding, notes started
+    // later are released right away and generated again when the clip continues
+    const int64 tick = transport().current_tick;
+    for (TickEvent &tnote : future_stack)
+      if (tnote.on_tick >= tick)
+        tnote.tick = tick;
+    std::sort (future_stack.begin(), future_stack.end(), [] (const TickEvent &a, const TickEvent &b) { return a.tick > b.tick; });
+    position_->tick = -M52MAX;
+    if (feed_ && position_->current >= 0 && generator_start_ >= 0)
+      feed_->generators[position_->current].jumpto (tick - generator_start_);
+  }
+  void
   render (uint n_frames) override
   {
     const AudioTransport &transport = this->transport();
     MidiEventInput evinput = midi_event_input(); // treat MIDI input as MIDI through
     MidiEventOutput &evout = midi_event_output(); // needs prepare_event_output()
     const int64 begin_tick = transport.current_tick;
-    const int64 end_tick = transport.current_tick + transport.sample_to_tick (n_frames);
+    const int64 end_tick = transport.block_end_tick (n_frames);
+    const int64 begin_sample = transport.sample_from_tick (begin_tick);
+    // block frame of a tick, accounts for tempo changes within the block
+    auto tick_frame = [&transport, begin_sample, n_frames] (int64 tick) {
+      return CLAMP (transport.sample_from_tick (tick) - begin_sample, 0, int64 (n_frames) - 1);
+    };
     const int64 bpm = transport.current_bpm;
     // flush NOTE_OFF events
     if (ASE_UNLIKELY (must_flush || bpm <= 0))
@@ -145,7 +165,7 @@ public:
       {
         TickEvent tnote = future_stack.back();
         future_stack.pop_back();
-        const int64 frame = transport.sample_from_tick (tnote.tick - begin_tick);
+        const int64 frame = tick_frame (tnote.tick);
         assert_paranoid (frame >= 0 && frame <= 4095);
         MDEBUG ("POP: t=%d ev=%s f=%d\n", tnote.tick, tnote.event.to_string(), frame);
         evout.append_unsorted (frame, tnote.event);
@@ -165,12 +185,15 @@ public:
         while (position_->current >= 0 &&
                generator_start_ + feed_->generators[position_->current].play_position() < end_tick)
           {
-            // handler for incoming events
-            auto qevent = [begin_tick, end_tick, &transport, &evout, this] (int64 cliptick, MidiEvent &event) {
+            // handler for incoming events, NOTE_OFF follows its NOTE_ON
+            int64 on_tick = 0;
+            auto qevent = [end_tick, &tick_frame, &evout, &on_tick, this] (int64 cliptick, MidiEvent &event) {
               const int64 etick = generator_start_ + cliptick; // Generator tick to Engine tick
+              if (event.type == MidiEvent::NOTE_ON)
+                on_tick = etick;
               if (etick < end_tick)
                 {
-                  const int64 frame = transport.sample_from_tick (etick - begin_tick);
+                  const int64 frame = tick_frame (etick);
                   assert_paranoid (frame >= 0 && frame <= 4095);
                   // interleave with earlier MIDI through events
                   evout.append_unsorted (frame, event);
@@ -178,9 +201,9 @@ public:
                 }
               else
                 {
-                  TickEvent future_event { etick, event };
+                  TickEvent future_event { etick, event, on_tick };
                   Aux::insert_sorted (future_stack, future_event, backward_cmp_ticks);
-                  MDEBUG ("FUT: t=%d ev=%s f=%d\n", etick, event.to_string(), transport.sample_from_tick (etick - begin_tick));
+                  MDEBUG ("FUT: t=%d ev=%s\n", etick, event.to_string());
                 }
             };
             // generate events for this block
@@ -1,42 +1,395 @@
 // This Source Code Form is licensed MPL-2.0: http://mozilla.org/MPL/2.0
 #include "monitor.hh"
 #include "track.hh"
+#include "combo.hh"
+#include "server.hh"
+#include "engine.hh"
+#include "datautils.hh"
 #include "jsonipc/jsonipc.hh"
 #include "internal.hh"
 
 namespace Ase {
 
+// == MonitorAnalyzer ==
+// ITU-R BS.1770-4 Annex 2, polyphase FIR for 4x oversampling true-peak measurements
+static constexpr float true_peak_coeffs[4][12] = {
+  {  0.0017089843750,  0.0109863281250, -0.0196533203125,  0.0332031250000, -0.0594482421875,  0.1373291015625,
+     0.9721679687500, -0.1022949218750,  0.0476074218750, -0.0266113281250,  0.0148925781250, -0.0083007812500 },
+  { -0.0291748046875,  0.0292968750000, -0.0517578125000,  0.0891113281250, -0.1665039062500,  0.4650878906250,
+     0.7797851562500, -0.2003173828125,  0.1015625000000, -0.0582275390625,  0.0330810546875, -0.0189208984375 },
+  { -0.0189208984375,  0.0330810546875, -0.0582275390625,  0.1015625000000, -0.2003173828125,  0.7797851562500,
+     0.4650878906250, -0.1665039062500,  0.0891113281250, -0.0517578125000,  0.0292968750000, -0.0291748046875 },
+  { -0.0083007812500,  0.0148925781250, -0.0266113281250,  0.0476074218750, -0.1022949218750,  0.9721679687500,
+     0.1373291015625, -0.0594482421875,  0.0332031250000, -0.0196533203125,  0.0109863281250,  0.0017089843750 },
+};
+
+// Twiddle factors, bit reversal and window for the spectrum FFT, shared by all analyzers.
+struct FftTables {
+  std::complex<float> twiddles[MonitorAnalyzer::FFT_SIZE / 2];
+  uint16              bitrev[MonitorAnalyzer::FFT_SIZE];
+  float               window[MonitorAnalyzer::FFT_SIZE];
+  FftTables()
+  {
+    constexpr uint N = MonitorAnalyzer::FFT_SIZE;
+    for (uint i = 0; i < N / 2; i++)
+      twiddles[i] = std::polar (1.0f, float (-2.0 * M_PI * i / N));
+    for (uint i = 0, j = 0; i < N; i++)
+      {
+        bitrev[i] = j;
+        uint bit = N >> 1;
+        for (; j & bit; bit >>= 1)
+          j ^= bit;
+        j |= bit;
+      }
+    double wsum = 0;
+    for (uint i = 0; i < N; i++)
+      wsum += window[i] = 0.5 - 0.5 * cos (2.0 * M_PI * i / N);   // Hann
+    for (uint i = 0; i < N; i++)
+      window[i] *= 2.0 / wsum;                                          // 0dB for full scale sines
+  }
+  static const FftTables&
+  the()
+  {
+    static const FftTables &tables = *new FftTables();
+    return tables;
+  }
+};
+
+static inline float
+power2db (double power)
+{
+  return power > 1e-19 ? 10.0 * log10 (power) : -192;
+}
+
+/// Setup analysis at `samplerate`, results are written to `telemetry`.
+MonitorAnalyzer::MonitorAnalyzer (uint samplerate, Telemetry *telemetry) :
+  telemetry_ (telemetry), samplerate_ (samplerate)
+{
+  static std::atomic<uint> analyzer_counter = 0;
+  frame_size_ = samplerate_ / 50;                               // 20ms frames
+  lufs_window_ = std::min (LUFS_WINDOW_MAX, (samplerate_ * 4 / 10 + frame_size_ / 2) / frame_size_);
+  spectrum_interval_ = 3;                                       // ca 16 updates per second
+  spectrum_countdown_ = analyzer_counter++ % spectrum_interval_; // stagger FFTs of many monitors
+  // K-weighting filters, ITU-R BS.1770-4 coefficients generalized for any sample rate
+  const double fs = samplerate_;
+  {
+    const double f0 = 1681.974450955533, G = 3.999843853973347, Q = 0.7071752369554196;
+    const double K = tan (M_PI * f0 / fs), Vh = pow (10.0, G / 20.0), Vb = pow (Vh, 0.4996667741545416);
+    const double a0 = 1.0 + K / Q + K * K;
+    kshelf_.b0 = (Vh + Vb * K / Q + K * K) / a0;
+    kshelf_.b1 = 2.0 * (K * K - Vh) / a0;
+    kshelf_.b2 = (Vh - Vb * K / Q + K * K) / a0;
+    kshelf_.a1 = 2.0 * (K * K - 1.0) / a0;
+    kshelf_.a2 = (1.0 - K / Q + K * K) / a0;
+  }
+  {
+    const double f0 = 38.13547087602444, Q = 0.5003270373238773;
+    const double K = tan (M_PI * f0 / fs), a0 = 1.0 + K / Q + K * K;
+    khighpass_.b0 = 1;
+    khighpass_.b1 = -2;
+    khighpass_.b2 = 1;
+    khighpass_.a1 = 2.0 * (K * K - 1.0) / a0;
+    khighpass_.a2 = (1.0 - K / Q + K * K) / a0;
+  }
+  // logarithmic spectrum bands from 20Hz to nyquist
+  const double bin_hz = fs / FFT_SIZE, lo = log (20.0), hi = log (fs / 2);
+  for (uint b = 0; b <= SPECTRUM_BANDS; b++)
+    {
+      const uint bin = exp (lo + (hi - lo) * b / SPECTRUM_BANDS) / bin_hz + 0.5;
+      band_bins_[b] = CLAMP (bin, b ? band_bins_[b - 1] + 1 : 1, FFT_SIZE / 2);
+    }
+  FftTables::the();                                             // initialize outside the engine thread
+}
+
+/// Configure the probes to calculate, must be called from the engine thread.
+void
+MonitorAnalyzer::features (const ProbeFeatures &pf)
+{
+  features_ = pf;
+}
+
+/// Analyze `n_frames` of `samples`, publishes new telemetry values once per frame_size().
+void
+MonitorAnalyzer::analyze (uint n_frames, const float *samples)
+{
+  assert_return (n_frames <= AUDIO_BLOCK_MAX_RENDER_SIZE);
+  if (features_.probe_range)
+    true_peak (n_frames, samples);
+  if (features_.probe_fft)
+    for (uint i = 0; i < n_frames; i++)
+      {
+        fft_ring_[fft_pos_] = samples[i];
+        fft_pos_ = (fft_pos_ + 1) & (FFT_SIZE - 1);
+      }
+  uint i = 0;
+  while (i < n_frames)
+    {
+      const uint n = std::min (n_frames - i, frame_size_ - frame_pos_);
+      const float *x = samples + i;
+      if (features_.probe_range)
+        peak_ = std::max (peak_, abs_max (n, x));
+      if (features_.probe_energy)
+        {
+          float sqsum = 0;
+          for (uint j = 0; j < n; j++)
+            sqsum += x[j] * x[j];
+          square_sum_ += sqsum;
+          double ksum = 0;
+          for (uint j = 0; j < n; j++)
+            {
+              const double k = khighpass_.process (kshelf_.process (x[j]));
+              ksum += k * k;
+            }
+          kweighted_sum_ += ksum;
+        }
+      i += n;
+      frame_pos_ += n;
+      if (frame_pos_ >= frame_size_)
+        publish();
+    }
+}
+
+// Calculate the 4x oversampled peak of a block and merge it into true_peak_.
+void
+MonitorAnalyzer::true_peak (uint n_frames, const float *samples)
+{
+  constexpr uint H = TP_TAPS - 1;
+  float *xbuf = tp_buffer_;                                     // H history samples, then n_frames new samples
+  fast_copy (n_frames, xbuf + H, samples);
+  float tpmax = 0;
+  for (uint p = 0; p < TP_PHASES; p++)
+    {
+      float *y = tp_output_;
+      floatfill (y, 0.0, n_frames);
+      for (uint k = 0; k < TP_TAPS; k++)
+        {
+          const float c = true_peak_coeffs[p][TP_TAPS - 1 - k];
+          const float *xk = xbuf + k;
+          for (uint j = 0; j < n_frames; j++)                  // vectorizable multiply-add
+            y[j] += c * xk[j];
+        }
+      tpmax = std::max (tpmax, abs_max (n_frames, y));
+    }
+  std::copy (xbuf + n_frames, xbuf + n_frames + H, xbuf);
+  true_peak_ = std::max (true_peak_, tpmax);
+}
+
+// Write frame results into telemetry memory.
+void
+MonitorAnalyzer::publish ()
+{
+  Telemetry &t = *telemetry_;
+  if (features_.probe_range)
+    {
+      t.peak_db = power2db (peak_ * peak_);
+      t.true_peak_db = power2db (true_peak_ * true_peak_);
+    }
+  if (features_.probe_energy)
+    {
+      t.rms_db = power2db (square_sum_ / frame_pos_);
+      lufs_frames_[lufs_index_] = kweighted_sum_;
+      lufs_index_ = (lufs_index_ + 1) % lufs_window_;
+      double ksum = 0;
+      for (uint i = 0; i < lufs_window_; i++)
+        ksum += lufs_frames_[i];
+      t.lufs_momentary = -0.691 + power2db (ksum / (lufs_window_ * frame_size_));
+    }
+  __atomic_store_n (&t.frame_counter, t.frame_counter + 1, __ATOMIC_RELEASE);
+  peak_ = 0;
+  true_peak_ = 0;
+  square_sum_ = 0;
+  kweighted_sum_ = 0;
+  frame_pos_ = 0;
+  if (features_.probe_fft)
+    {
+      if (spectrum_countdown_ == 0)
+        {
+          spectrum_countdown_ = spectrum_interval_;
+          spectrum();
+        }
+      spectrum_countdown_--;
+    }
+}
+
+// Calculate spectrum bands from the last FFT_SIZE samples.
+void
+MonitorAnalyzer::spectrum ()
+{
+  constexpr uint N = FFT_SIZE;
+  const FftTables &tables = FftTables::the();
+  std::complex<float> *d = fft_data_;
+  for (uint i = 0; i < N; i++)
+    d[tables.bitrev[i]] = fft_ring_[(fft_pos_ + i) & (N - 1)] * tables.window[i];
+  for (uint len = 2; len <= N; len <<= 1)                       // iterative radix-2 decimation in time
+    {
+      const uint half = len >> 1, tstep = N / len;
+      for (uint i = 0; i < N; i += len)
+        for (uint j = 0; j < half; j++)
+          {
+            const std::complex<float> t = tables.twiddles[j * tstep] * d[i + j + half];
+            d[i + j + half] = d[i + j] - t;
+            d[i + j] += t;
+          }
+    }
+  Telemetry &t = *telemetry_;
+  __atomic_store_n (&t.spectrum_counter, t.spectrum_counter + 1, __ATOMIC_RELEASE);     // odd, updating
+  for (uint b = 0; b < SPECTRUM_BANDS; b++)
+    {
+      float pmax = 0;
+      for (uint k = band_bins_[b]; k < band_bins_[b + 1]; k++)
+        pmax = std::max (pmax, std::norm (d[k]));
+      t.spectrum[b] = power2db (pmax);
+    }
+  __atomic_store_n (&t.spectrum_counter, t.spectrum_counter + 1, __ATOMIC_RELEASE);     // even, done
+}
+
 // == MonitorImpl ==
 JSONIPC_INHERIT (MonitorImpl, Monitor);
 
-MonitorImpl::MonitorImpl()
-{}
+MonitorImpl::MonitorImpl (DeviceP output, int32 ochannel) :
+  output_ (output), ochannel_ (ochannel)
+{
+  features_.probe_range = true;
+  features_.probe_energy = true;
+  auto chain = std::dynamic_pointer_cast<AudioChain> (output_->_audio_processor());
+  assert_return (chain);
+  telemetry_block_ = SERVER->telemem_allocate (sizeof (MonitorAnalyzer::Telemetry));
+  telemetry_ = new (telemetry_block_.block_start) MonitorAnalyzer::Telemetry();
+  analyzer_ = std::make_shared<MonitorAnalyzer> (chain->engine().sample_rate(), telemetry_);
+  analyzer_->features (features_);
+  auto job = [chain, analyzer = analyzer_, ochannel, storage = chain->reserve_monitor_ml()] () {
+    chain->add_monitor (ochannel, analyzer, storage);
+  };
+  chain->engine().async_jobs += job;
+}
 
 MonitorImpl::~MonitorImpl()
-{}
+{
+  return_unless (analyzer_);
+  auto chain = std::dynamic_pointer_cast<AudioChain> (output_->_audio_processor());
+  FastMemory::Block telemetry_block = telemetry_block_;
+  auto deferred_release = [telemetry_block] (void*) {
+    SERVER->telemem_release (telemetry_block);          // analyzer is not used anymore
+  };
+  std::shared_ptr<void> atjobdtor = { nullptr, deferred_release };
+  chain->release_monitor_ml();
+  auto job = [chain, analyzer = analyzer_, atjobdtor] () {
+    chain->remove_monitor (*analyzer);
+  };
+  chain->engine().async_jobs += job;
+  // once job is processed, dtor runs in mainthread
+}
 
 DeviceP
-MonitorImpl::get_output () // TODO: implement
+MonitorImpl::get_output ()
 {
-  return nullptr;
+  return output_;
 }
 
 int32
-MonitorImpl::get_ochannel () // TODO: implement
+MonitorImpl::get_ochannel ()
 {
-  return -1;
+  return ochannel_;
 }
 
 int64
-MonitorImpl::get_mix_freq () // TODO: implement
+MonitorImpl::get_mix_freq ()
 {
-  return 0;
+  return output_->_audio_processor()->engine().sample_rate();
 }
 
 int64
-MonitorImpl::get_frame_duration () // TODO: implement
+MonitorImpl::get_frame_duration ()
 {
-  return 0;
+  return_unless (analyzer_, 0);
+  return analyzer_->frame_size() * int64 (1000000) / get_mix_freq();
+}
+
+void
+MonitorImpl::set_probe_features (ProbeFeatures pf)
+{
+  return_unless (analyzer_);
+  features_ = pf;
+  auto job = [analyzer = analyzer_, pf] () {
+    analyzer->features (pf);
+  };
+  output_->_audio_processor()->engine().async_jobs += job;
+}
+
+ProbeFeatures
+MonitorImpl::get_probe_features ()
+{
+  return features_;
+}
+
+TelemetryFieldS
+MonitorImpl::telemetry () const
+{
+  TelemetryFieldS v;
+  return_unless (telemetry_, v);
+  v.push_back (telemetry_field ("peak_db", &telemetry_->peak_db));
+  v.push_back (telemetry_field ("rms_db", &telemetry_->rms_db));
+  v.push_back (telemetry_field ("true_peak_db", &telemetry_->true_peak_db));
+  v.push_back (telemetry_field ("lufs_momentary", &telemetry_->lufs_momentary));
+  v.push_back (telemetry_field ("frame_counter", &telemetry_->frame_counter));
+  v.push_back (telemetry_field ("spectrum_counter", &telemetry_->spectrum_counter));
+  TelemetryField spectrum = telemetry_field ("spectrum", &telemetry_->spectrum[0]);
+  spectrum.length = sizeof (telemetry_->spectrum);
+  v.push_back (spectrum);
+  return v;
 }
 
 } // Ase
+
+// == Tests ==
+#include "testing.hh"
+
+namespace { // Anon
+using namespace Ase;
+
+TEST_INTEGRITY (monitor_analyzer_tests);
+static void
+monitor_analyzer_tests()
+{
+  const uint rate = 48000;
+  MonitorAnalyzer::Telemetry telemetry;
+  MonitorAnalyzer analyzer (rate, &telemetry);
+  ProbeFeatures pf = { .probe_range = true, .probe_energy = true, .probe_samples = false, .probe_fft = true };
+  analyzer.features (pf);
+  // -20dBFS sine at fs/4 with 45° phase, sample peaks are 3dB below the true peak
+  const double amp = 0.1;
+  float block[AUDIO_BLOCK_MAX_RENDER_SIZE];
+  int64 t = 0;
+  for (uint b = 0; b < 2 * rate / 256; b++)
+    {
+      for (uint i = 0; i < 256; i++, t++)
+        block[i] = amp * sin (M_PI / 2 * t + M_PI / 4);
+      analyzer.analyze (256, block);
+    }
+  TCMP (telemetry.frame_counter, ==, 2 * 50);
+  TCMP (std::abs (telemetry.peak_db + 23.01), <, 0.05);
+  TCMP (std::abs (telemetry.true_peak_db + 20.0), <, 0.2);
+  TCMP (std::abs (telemetry.rms_db + 23.01), <, 0.05);
+  // 997Hz sine reads -3.01 LUFS at 0dBFS in a single channel (ITU-R BS.1770-4)
+  MonitorAnalyzer loudness (rate, &telemetry);
+  loudness.features (pf);
+  t = 0;
+  for (uint b = 0; b < rate / 1024; b++)
+    {
+      for (uint i = 0; i < 1024; i++, t++)
+        block[i] = amp * sin (2 * M_PI * 997 * t / rate);
+      loudness.analyze (1024, block);
+    }
+  TCMP (std::abs (telemetry.lufs_momentary + 23.01), <, 0.1);
+  TCMP (telemetry.spectrum_counter % 2, ==, 0);
+  TCMP (telemetry.spectrum_counter, >, 0);
+  uint loudest = 0;
+  for (uint b = 0; b < MonitorAnalyzer::SPECTRUM_BANDS; b++)
+    if (telemetry.spectrum[b] > telemetry.spectrum[loudest])
+      loudest = b;
+  TCMP (std::abs (telemetry.spectrum[loudest] + 20.0), <, 1.5);
+  TCMP (telemetry.spectrum[0], <, -80);                         // 20Hz
+  TCMP (telemetry.spectrum[MonitorAnalyzer::SPECTRUM_BANDS - 1], <, -80); // nyquist
+}
+
+} // Anon
@@ -3,19 +3,77 @@
 #define __ASE_MONITOR_HH__
 
 #include <ase/gadget.hh>
+#include <ase/memory.hh>
+#include <complex>
+#include <atomic>
 
 namespace Ase {
 
+/// Engine side signal analysis of a Monitor, results are published lock-free into telemetry memory.
+class MonitorAnalyzer {
+public:
+  static constexpr uint SPECTRUM_BANDS = 64;
+  static constexpr uint FFT_SIZE = 1024;
+  /// Analysis results, located in telemetry memory and updated once per frame.
+  struct Telemetry {
+    float  peak_db = -192;              ///< Sample peak of the last frame.
+    float  rms_db = -192;               ///< Root mean square level of the last frame.
+    float  true_peak_db = -192;         ///< 4x oversampled peak of the last frame (ITU-R BS.1770-4).
+    float  lufs_momentary = -192;       ///< K-weighted loudness of the last 400ms.
+    int32  frame_counter = 0;           ///< Incremented after the level fields have been updated.
+    int32  spectrum_counter = 0;        ///< Odd while `spectrum` is being updated.
+    float  spectrum[SPECTRUM_BANDS] {}; ///< Logarithmically spaced spectrum bands in dB.
+  };
+  explicit      MonitorAnalyzer (uint samplerate, Telemetry *telemetry);
+  uint          frame_size      () const        { return frame_size_; }
+  void          features        (const ProbeFeatures &pf);
+  void          analyze         (uint n_frames, const float *samples);
+private:
+  static constexpr uint TP_PHASES = 4, TP_TAPS = 12;
+  static constexpr uint LUFS_WINDOW_MAX = 64;
+  struct Biquad {
+    double b0 = 1, b1 = 0, b2 = 0, a1 = 0, a2 = 0, z1 = 0, z2 = 0;
+    double process (double x) { const double y = b0 * x + z1; z1 = b1 * x - a1 * y + z2; z2 = b2 * x - a2 * y; return y; }
+  };
+  Telemetry    *telemetry_ = nullptr;
+  ProbeFeatures features_ {};
+  uint          samplerate_ = 0;
+  uint          frame_size_ = 0, frame_pos_ = 0;
+  float         peak_ = 0, true_peak_ = 0;
+  double        square_sum_ = 0, kweighted_sum_ = 0;
+  Biquad        kshelf_, khighpass_;
+  double        lufs_frames_[LUFS_WINDOW_MAX] {};
+  uint          lufs_window_ = 0, lufs_index_ = 0;
+  float         tp_buffer_[TP_TAPS - 1 + AUDIO_BLOCK_MAX_RENDER_SIZE] {};
+  float         tp_output_[AUDIO_BLOCK_MAX_RENDER_SIZE] {};
+  float         fft_ring_[FFT_SIZE] {};
+  uint          fft_pos_ = 0, spectrum_interval_ = 0, spectrum_countdown_ = 0;
+  std::complex<float> fft_data_[FFT_SIZE];
+  uint16        band_bins_[SPECTRUM_BANDS + 1] {};
+  void          true_peak       (uint n_frames, const float *samples);
+  void          publish         ();
+  void          spectrum        ();
+};
+
 class MonitorImpl : public GadgetImpl, public virtual Monitor {
+  DeviceP           output_;
+  int32             ochannel_ = -1;
+  ProbeFeatures     features_ {};
+  MonitorAnalyzerP  analyzer_;
+  MonitorAnalyzer::Telemetry *telemetry_ = nullptr;
+  FastMemory::Block telemetry_block_;
   ASE_DEFINE_MAKE_SHARED (MonitorImpl);
   friend class TrackImpl;
   virtual ~MonitorImpl        ();
 public:
-  explicit MonitorImpl        ();
-  DeviceP  get_output         () override;
-  int32    get_ochannel       () override;
-  int64    get_mix_freq       () override;
-  int64    get_frame_duration () override;
+  explicit MonitorImpl        (DeviceP output, int32 ochannel);
+  DeviceP         get_output         () override;
+  int32           get_ochannel       () override;
+  int64           get_mix_freq       () override;
+  int64           get_frame_duration () override;
+  void            set_probe_features (ProbeFeatures pf) override;
+  ProbeFeatures   get_probe_features () override;
+  TelemetryFieldS telemetry          () const override;
 };
 using MonitorImplP = std::shared_ptr<MonitorImpl>;
 
@@ -3,8 +3,10 @@
 #include "clapdevice.hh"
 #include "combo.hh"
 #include "project.hh"
+#include "track.hh"
 #include "jsonipc/jsonipc.hh"
 #include "serialize.hh"
+#include "main.hh"
 #include "internal.hh"
 
 namespace Ase {
@@ -51,6 +53,18 @@ NativeDeviceImpl::access_properties ()
   return proc_->access_properties();
 }
 
+PropertyP
+NativeDeviceImpl::access_property (String ident)
+{
+  return proc_->access_property (ident);
+}
+
+bool
+NativeDeviceImpl::set_values (const ValueR &values)
+{
+  return proc_->set_property_values (values);
+}
+
 void
 NativeDeviceImpl::_set_event_source (AudioProcessorP esource)
 {
@@ -129,6 +143,8 @@ NativeDeviceImpl::remove_device (Device &sub)
       proc_->engine().async_jobs += j;
       // once job is processed, dtor runs in mainthread
     }
+  if (TrackImpl *track = dynamic_cast<TrackImpl*> (_track()))
+    track->freeze_invalidate();
 }
 
 DeviceP
@@ -156,6 +172,8 @@ NativeDeviceImpl::insert_device (const String &uri, Device *sibling, const Devic
         assert_return (size_t (cpos) == pos);
       };
       proc_->engine().async_jobs += j;
+      if (TrackImpl *track = dynamic_cast<TrackImpl*> (_track()))
+        track->freeze_invalidate();
     }
   return devicep;
 }
@@ -223,19 +241,117 @@ NativeDevice::list_device_types ()
   return iseq;
 }
 
-DeviceP
-create_processor_device (AudioEngine &engine, const String &uri, bool engineproducer)
+static DeviceP
+create_device_instance (AudioEngine &engine, const String &uri)
 {
-  DeviceP devicep;
   if (string_startswith (uri, "CLAP:"))
-    devicep = ClapDeviceImpl::create_clap_device (engine, uri);
-  else // assume string_startswith (uri, "Ase:")
+    return ClapDeviceImpl::create_clap_device (engine, uri);
+  // assume string_startswith (uri, "Ase:")
+  struct NativeDeviceImpl2 : NativeDeviceImpl {
+    using NativeDeviceImpl::create_native_device;
+  };
+  return NativeDeviceImpl2::create_native_device (engine, uri);
+}
+
+// == DevicePool ==
+/// Spare devices of the most recently inserted user device types, constructed and initialized
+/// while the main loop is idle, so inserting a device does not stall IPC handling.
+struct DevicePool {
+  static constexpr uint MAX_TYPES = 4;
+  static constexpr uint REFILL_DELAY_MS = 500;
+  struct Spare {
+    String       uri;
+    AudioEngine *engine = nullptr;
+    DeviceP      devicep;       // initialized device without parent, or nullptr
+  };
+  std::vector<Spare> spares;    // most recently used first
+  uint               refill_id = 0;
+  bool    refill ();
+  DeviceP take   (AudioEngine &engine, const String &uri);
+  void    clear  ();
+  static bool poolable (const String &uri);
+};
+static DevicePool &device_pool = *new DevicePool();
+
+/// Create one missing spare device, returns if more are missing.
+bool
+DevicePool::refill ()
+{
+  auto needs_spare = [] (const Spare &spare) { return !spare.devicep; };
+  auto it = std::find_if (spares.begin(), spares.end(), needs_spare);
+  if (it != spares.end())
     {
-      struct NativeDeviceImpl2 : NativeDeviceImpl {
-        using NativeDeviceImpl::create_native_device;
-      };
-      devicep = NativeDeviceImpl2::create_native_device (engine, uri);
+      it->devicep = create_device_instance (*it->engine, it->uri);
+      if (!it->devicep)
+        spares.erase (it);      // creation failed, do not retry
+    }
+  const bool more = std::any_of (spares.begin(), spares.end(), needs_spare);
+  if (!more)
+    refill_id = 0;
+  return more;
+}
+
+/// Take the spare device for `uri` if any, and schedule creation of a new spare.
+DeviceP
+DevicePool::take (AudioEngine &engine, const String &uri)
+{
+  assert_return (this_thread_is_ase(), nullptr);
+  Spare spare { uri, &engine, nullptr };
+  auto it = std::find_if (spares.begin(), spares.end(), [&] (const Spare &s) { return s.uri == uri && s.engine == &engine; });
+  if (it != spares.end())
+    {
+      spare.devicep = std::move (it->devicep);
+      spares.erase (it);
     }
+  DeviceP devicep = spare.devicep;
+  spare.devicep = nullptr;
+  spares.insert (spares.begin(), spare);
+  if (spares.size() > MAX_TYPES)
+    spares.resize (MAX_TYPES);
+  if (!refill_id && main_loop)
+    refill_id = main_loop->exec_timer ([this] () { return refill(); }, REFILL_DELAY_MS, REFILL_DELAY_MS / 10, EventLoop::PRIORITY_IDLE);
+  return devicep;
+}
+
+/// Release all spare devices and stop refilling.
+void
+DevicePool::clear ()
+{
+  main_loop->clear_source (&refill_id);
+  spares.clear();
+}
+
+/// Only devices that users insert are pooled, e.g. not AudioChain objects of tracks.
+bool
+DevicePool::poolable (const String &uri)
+{
+  if (string_startswith (uri, "CLAP:"))
+    return true;
+  bool listed = false;
+  AudioProcessor::registry_foreach ([&] (const String &aseid, AudioProcessor::StaticInfo static_info) {
+    if (listed || aseid != uri)
+      return;
+    AudioProcessorInfo pinfo;
+    static_info (pinfo);
+    listed = !pinfo.label.empty() && !pinfo.category.empty(); // see list_device_types()
+  });
+  return listed;
+}
+
+/// Release the spare devices held for device insertion, needed before the engine or project shuts down.
+void
+clear_device_pool ()
+{
+  assert_return (this_thread_is_ase());
+  device_pool.clear();
+}
+
+DeviceP
+create_processor_device (AudioEngine &engine, const String &uri, bool engineproducer)
+{
+  DeviceP devicep = DevicePool::poolable (uri) ? device_pool.take (engine, uri) : nullptr;
+  if (!devicep)
+    devicep = create_device_instance (engine, uri);
   return_unless (devicep, nullptr);
   AudioProcessorP procp = devicep->_audio_processor();
   if (procp) {
@@ -24,6 +24,8 @@ protected:
   explicit             NativeDeviceImpl   (const String &aseid, AudioProcessor::StaticInfo, AudioProcessorP);
 public:
   PropertyS            access_properties  () override;
+  PropertyP            access_property    (String ident) override;
+  bool                 set_values         (const ValueR &values) override;
   AudioProcessorP      _audio_processor   () const override { return proc_; }
   AudioComboP          audio_combo        () const          { return combo_; }
   bool                 is_combo_device    () override       { return combo_ != nullptr; }
@@ -39,6 +41,7 @@ public:
 };
 
 DeviceP create_processor_device (AudioEngine &engine, const String &uri, bool engineproducer);
+void    clear_device_pool       ();
 
 } // Ase
 
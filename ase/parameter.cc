@@ -481,7 +481,8 @@ static String3
 make_nick3 (const String &label)
 {
   // split words
-  const StringS words = Re::findall (R"(\b\w+)", label); // TODO: allow Re caching
+  static const Re::Pattern word_pattern (R"(\b\w+)");
+  const StringS words = word_pattern.findall (label);
 
   // single word nick, give precedence to digits
   if (words.size() == 1) {
@@ -15,6 +15,9 @@
 #include <sys/wait.h>
 #include <sys/time.h>
 #include <sys/resource.h>
+#include <sys/mman.h>
+#include <sched.h>
+#include <dirent.h>
 #include <sys/syscall.h>        // SYS_gettid
 #include <semaphore.h>
 #include <stdarg.h>
@@ -297,6 +300,7 @@ struct CPUInfo {
   uint x86_mmx : 1, x86_mmxext : 1, x86_3dnow : 1, x86_3dnowext : 1;
   uint x86_sse : 1, x86_sse2   : 1, x86_sse3  : 1, x86_ssse3    : 1;
   uint x86_cx16 : 1, x86_sse4_1 : 1, x86_sse4_2 : 1, x86_rdrand : 1;
+  uint x86_avx : 1, x86_avx2 : 1, x86_fma : 1, x86_avx512f : 1;
 };
 
 static jmp_buf cpu_info_jmp_buf;
@@ -363,6 +367,14 @@ cpu_info_sigill_handler (int dummy)
 #  define x86_cpuid(input, count, eax, ebx, ecx, edx)  do {} while (0)
 #endif
 
+#if     defined __i386__ || defined __x86_64__ || defined __amd64__
+/* read extended control register, XCR0 holds the register states saved by the OS */
+#  define x86_xgetbv(index, eax, edx) \
+  __asm__ __volatile__ ("xgetbv" : "=a" (eax), "=d" (edx) : "c" (index))
+#else
+#  define x86_xgetbv(index, eax, edx)           do {} while (0)
+#endif
+
 static bool
 get_x86_cpu_features (CPUInfo *ci)
 {
@@ -374,7 +386,8 @@ get_x86_cpu_features (CPUInfo *ci)
   /* query intel CPUID range */
   unsigned int eax = 0, ebx = 0, ecx = 0, edx = 0;
   x86_cpuid (0, 0, eax, ebx, ecx, edx);
-  unsigned int v_ebx = ebx, v_ecx = ecx, v_edx = edx;
+  unsigned int v_eax = eax, v_ebx = ebx, v_ecx = ecx, v_edx = edx;
+  unsigned int xcr0 = 0;
   char *vendor = ci->cpu_vendor;
   *((unsigned int*) &vendor[0]) = ebx;
   *((unsigned int*) &vendor[4]) = edx;
@@ -395,6 +408,18 @@ get_x86_cpu_features (CPUInfo *ci)
         ci->x86_sse4_2 = true;
       if (ecx & (1 << 30))
         ci->x86_rdrand = true;
+      if (ecx & (1 << 27))      /* OSXSAVE, the OS manages extended register states */
+        {
+          unsigned int xcr0_high = 0;
+          x86_xgetbv (0, xcr0, xcr0_high);
+          (void) xcr0_high;
+        }
+      if ((ecx & (1 << 28)) && (xcr0 & 0x06) == 0x06)   /* AVX with XMM and YMM state */
+        {
+          ci->x86_avx = true;
+          if (ecx & (1 << 12))
+            ci->x86_fma = true;
+        }
       if (edx & (1 << 0))
         ci->x86_fpu = true;
       if (edx & (1 << 4))
@@ -415,6 +440,16 @@ get_x86_cpu_features (CPUInfo *ci)
        */
     }
 
+  /* query structured extended feature flags */
+  if (v_eax >= 7 && ci->x86_avx)
+    {
+      x86_cpuid (7, 0, eax, ebx, ecx, edx);
+      if (ebx & (1 << 5))
+        ci->x86_avx2 = true;
+      if ((ebx & (1 << 16)) && (xcr0 & 0xe6) == 0xe6) /* AVX-512 with opmask and ZMM state */
+        ci->x86_avx512f = true;
+    }
+
   /* query extended CPUID range */
   x86_cpuid (0x80000000, 0, eax, ebx, ecx, edx);
   if (eax >= 0x80000001 &&      /* may query extended feature information */
@@ -472,7 +507,7 @@ cpu_arch ()
  * a number of flag words describing CPU features plus a trailing space.
  * This allows checks for CPU features via a simple string search for
  * " FEATURE ".
- * @return Example: "4 AMD64 GenuineIntel FPU TSC HTT CMPXCHG16B MMX MMXEXT SSESYS SSE SSE2 SSE3 SSSE3 SSE4.1 SSE4.2 "
+ * @return Example: "4 AMD64 GenuineIntel FPU TSC HTT CMPXCHG16B MMX MMXEXT SSESYS SSE SSE2 SSE3 SSSE3 SSE4.1 SSE4.2 AVX FMA AVX2 "
  */
 String
 cpu_info()
@@ -520,6 +555,15 @@ cpu_info()
       info += " SSE4.2";
     if (cpu_info.x86_rdrand)
       info += " rdrand";
+    // AVX flags
+    if (cpu_info.x86_avx)
+      info += " AVX";
+    if (cpu_info.x86_fma)
+      info += " FMA";
+    if (cpu_info.x86_avx2)
+      info += " AVX2";
+    if (cpu_info.x86_avx512f)
+      info += " AVX512F";
     // 3DNOW flags
     if (cpu_info.x86_3dnow)
       info += " 3DNOW";
@@ -952,6 +996,123 @@ sched_fast_priority (int tid)
   return emsg.empty();
 }
 
+/// Restrict thread `tid` to run on `cpus`, an empty list allows all CPUs.
+bool
+sched_set_affinity (int tid, const std::vector<uint> &cpus)
+{
+#ifdef  __linux__
+  cpu_set_t cpuset;
+  CPU_ZERO (&cpuset);
+  const uint n_cpus = std::min (this_thread_online_cpus(), CPU_SETSIZE);
+  for (uint cpu = 0; cpu < n_cpus; cpu++)
+    if (cpus.empty() || std::find (cpus.begin(), cpus.end(), cpu) != cpus.end())
+      CPU_SET (cpu, &cpuset);
+  if (sched_setaffinity (tid, sizeof (cpuset), &cpuset) == 0)
+    return true;
+  PDEBUG ("sched_setaffinity(%d) failed: %s", tid, strerror (errno));
+#endif
+  return false;
+}
+
+/// Parse a CPU list like "2,4-7" as used by taskset(1), CPUs that are not online are skipped.
+std::vector<uint>
+sched_parse_cpus (const String &cpulist)
+{
+  std::vector<uint> cpus;
+  const uint n_cpus = this_thread_online_cpus();
+  for (const String &range : string_split_any (cpulist, ", "))
+    {
+      const size_t dash = range.find ('-');
+      const String first = range.substr (0, dash);
+      const String last = dash == range.npos ? first : range.substr (dash + 1);
+      if (first.empty() || last.empty() || first.find_first_not_of ("0123456789") != first.npos ||
+          last.find_first_not_of ("0123456789") != last.npos)
+        continue;
+      for (uint64 cpu = string_to_uint (first); cpu <= string_to_uint (last) && cpu < n_cpus; cpu++)
+        if (std::find (cpus.begin(), cpus.end(), cpu) == cpus.end())
+          cpus.push_back (cpu);
+    }
+  return cpus;
+}
+
+/// List the thread IDs of the current process.
+std::vector<int>
+this_process_tids ()
+{
+  std::vector<int> tids;
+  if (DIR *dir = opendir ("/proc/self/task"))
+    {
+      while (const dirent *entry = readdir (dir))
+        if (entry->d_name[0] >= '0' && entry->d_name[0] <= '9')
+          tids.push_back (string_to_int (entry->d_name));
+      closedir (dir);
+    }
+  return tids;
+}
+
+ThreadUsage
+ThreadUsage::operator- (const ThreadUsage &b) const
+{
+  return { minor_faults - b.minor_faults, major_faults - b.major_faults,
+           voluntary_switches - b.voluntary_switches, involuntary_switches - b.involuntary_switches };
+}
+
+ThreadUsage
+ThreadUsage::operator+ (const ThreadUsage &b) const
+{
+  return { minor_faults + b.minor_faults, major_faults + b.major_faults,
+           voluntary_switches + b.voluntary_switches, involuntary_switches + b.involuntary_switches };
+}
+
+/// Retrieve the page fault and context switch counters of the calling thread.
+ThreadUsage
+this_thread_usage ()
+{
+  ThreadUsage usage;
+#ifdef  RUSAGE_THREAD
+  struct rusage ru;
+  if (getrusage (RUSAGE_THREAD, &ru) == 0)
+    usage = { ru.ru_minflt, ru.ru_majflt, ru.ru_nvcsw, ru.ru_nivcsw };
+#endif
+  return usage;
+}
+
+// == Memory Locking ==
+/// Lock all current and future pages of the process into RAM, or unlock them.
+bool
+memory_lock_all (bool onoff)
+{
+  const int ret = onoff ? mlockall (MCL_CURRENT | MCL_FUTURE) : munlockall();
+  if (ret == 0)
+    return true;
+  PDEBUG ("%s failed: %s", onoff ? "mlockall" : "munlockall", strerror (errno));
+  return false;
+}
+
+/// Populate the pages of a writable memory area, so first accesses do not page fault.
+void
+memory_prefault (void *start, size_t length)
+{
+#ifdef  MADV_POPULATE_WRITE
+  if (madvise (start, length, MADV_POPULATE_WRITE) == 0)
+    return;
+#endif
+  const size_t pagesize = sysconf (_SC_PAGESIZE);
+  char *const mem = (char*) (uintptr_t (start) & ~uintptr_t (pagesize - 1));
+  for (size_t i = 0; mem + i < (char*) start + length; i += pagesize)
+    __atomic_fetch_add (mem + i, 0, __ATOMIC_RELAXED); // write access that preserves concurrently used memory
+}
+
+/// Touch `length` bytes of stack below the caller, so later calls do not page fault.
+void
+stack_prefault (size_t length)
+{
+  char *stack = (char*) alloca (length);
+  const size_t pagesize = sysconf (_SC_PAGESIZE);
+  for (size_t i = 0; i < length; i += pagesize)
+    ((volatile char*) stack)[i] = 0;
+}
+
 // == TaskStatus ==
 TaskStatus::TaskStatus (int pid, int tid) :
   process_id (pid), task_id (tid >= 0 ? tid : pid), state (UNKNOWN), processor (-1), priority (0),
@@ -1246,4 +1407,37 @@ ase_test_timestamps()
   TASSERT (b1 < b2);
 }
 
+TEST_INTEGRITY (ase_test_sched_cpus);
+static void
+ase_test_sched_cpus()
+{
+  const uint n_cpus = this_thread_online_cpus();
+  TCMP (sched_parse_cpus ("").size(), ==, 0u);
+  TCMP (sched_parse_cpus ("x,-,3-").size(), ==, 0u);
+  std::vector<uint> cpus = sched_parse_cpus ("0");
+  TASSERT (cpus.size() == 1 && cpus[0] == 0);
+  cpus = sched_parse_cpus ("0-1,0, 1");
+  TCMP (cpus.size(), ==, std::min (2u, n_cpus));
+  TCMP (sched_parse_cpus (string_format ("%u-%u", n_cpus, n_cpus + 9)).size(), ==, 0u); // offline
+#ifdef  __linux__
+  // read back the affinity applied by sched_set_affinity()
+  const int tid = this_thread_gettid();
+  cpu_set_t saved, cpuset;
+  TCMP (sched_getaffinity (tid, sizeof (saved), &saved), ==, 0);
+  uint cpu = 0;
+  while (cpu < n_cpus && !CPU_ISSET (cpu, &saved))
+    cpu++;
+  TCMP (cpu, <, n_cpus);
+  TASSERT (sched_set_affinity (tid, { cpu }));
+  TCMP (sched_getaffinity (tid, sizeof (cpuset), &cpuset), ==, 0);
+  TCMP (CPU_COUNT (&cpuset), ==, 1);
+  TASSERT (CPU_ISSET (cpu, &cpuset));
+  TCMP (sched_getcpu(), ==, int (cpu));
+  TASSERT (sched_set_affinity (tid, {})); // all online CPUs
+  TCMP (sched_getaffinity (tid, sizeof (cpuset), &cpuset), ==, 0);
+  TCMP (CPU_COUNT (&cpuset), >=, CPU_COUNT (&saved));
+  TCMP (sched_setaffinity (tid, sizeof (saved), &saved), ==, 0);
+#endif
+}
+
 } // Anon
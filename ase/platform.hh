@@ -129,6 +129,25 @@ public:
 int  sched_get_priority  (int tid);
 bool sched_set_priority  (int tid, int nicelevel);
 bool sched_fast_priority (int tid);
+bool sched_set_affinity  (int tid, const std::vector<uint> &cpus);
+std::vector<uint> sched_parse_cpus   (const String &cpulist);
+std::vector<int>  this_process_tids  ();
+
+/// Resource usage counters of a thread, see getrusage(2).
+struct ThreadUsage {
+  int64 minor_faults = 0;               ///< Page faults serviced without I/O.
+  int64 major_faults = 0;               ///< Page faults that required I/O.
+  int64 voluntary_switches = 0;         ///< Context switches due to blocking.
+  int64 involuntary_switches = 0;       ///< Context switches due to preemption.
+  ThreadUsage operator- (const ThreadUsage &b) const;
+  ThreadUsage operator+ (const ThreadUsage &b) const;
+};
+ThreadUsage this_thread_usage ();
+
+// == Memory Locking ==
+bool memory_lock_all     (bool onoff);
+void memory_prefault     (void *start, size_t length);
+void stack_prefault      (size_t length);
 
 // == Thread Status ==
 /// Acquire information about a task (process or thread) at runtime.
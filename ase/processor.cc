@@ -2,6 +2,7 @@
 #include "processor.hh"
 #include "combo.hh"
 #include "device.hh"
+#include "track.hh"
 #include "main.hh"      // feature_toggle_find
 #include "utils.hh"
 #include "engine.hh"
@@ -45,6 +46,7 @@ AudioParams::clear()
 {
   changed = false;
   count = 0;
+  idents.clear();
   delete[] ids;
   ids = nullptr;
   delete[] values;
@@ -84,6 +86,10 @@ AudioParams::install (const AudioParams::Map &params)
     new_parameters[i++] = p;
   parameters = new_parameters;
   assert_return (i == count);
+  // idents
+  idents.reserve (count);
+  for (i = 0; i < count; i++)
+    idents[parameters[i]->cident] = i;
   // values
   values = new double[count] ();                // value-initialized per ISO C++03 5.3.4[expr.new]/15
   for (size_t i = 0; i < count; i++)
@@ -226,9 +232,9 @@ AudioProcessor::find_param (const String &identifier) const -> MaybeParamId
   auto ident = CString::lookup (identifier);
   if (ident.empty())
     return { ParamId (0), false };
-  for (size_t idx = 0; idx < params_.count; idx++)
-    if (params_.parameters[idx]->cident == ident)
-      return { ParamId (params_.ids[idx]), true };
+  auto it = params_.idents.find (ident);
+  if (it != params_.idents.end())
+    return { ParamId (params_.ids[it->second]), true };
   return std::make_pair (ParamId (0), false);
 }
 
@@ -433,6 +439,16 @@ AudioProcessor::initialize (SpeakerArrangement busses)
   assert_return (n_ibuses() + n_obuses() == 0);
 }
 
+/// Report the processing delay in sample frames, must be called from the render thread.
+/// Engine outputs with less latency are delayed accordingly to keep them aligned.
+void
+AudioProcessor::set_latency (uint nframes)
+{
+  return_unless (latency_ != nframes);
+  latency_ = nframes;
+  engine_.latency_changed();
+}
+
 /// Request recreation of the audio engine rendering schedule.
 void
 AudioProcessor::reschedule ()
@@ -842,16 +858,19 @@ AudioProcessor::render_block (uint64 target_stamp)
 AudioProcessor::MidiEventInput
 AudioProcessor::midi_event_input()
 {
-  MidiEventInput::VectorArray mev_array{};
+  MidiEventInput::RangeArray mev_array{};
   size_t n = 0;
   if (estreams_ && estreams_->oproc && estreams_->oproc->estreams_)
-    mev_array[n++] = &estreams_->oproc->estreams_->midi_event_output.vector();
+    mev_array[n++] = estreams_->oproc->estreams_->midi_event_output.range();
   if (render_context_->render_events)
-    mev_array[n++] = render_context_->render_events;
+    {
+      const MidiEventVector &render_events = *render_context_->render_events;
+      mev_array[n++] = { render_events.data(), render_events.data() + render_events.size() };
+    }
   return MidiEventInput (mev_array);
 }
 
-static const MidiEventOutput empty_event_output; // dummy
+static const MidiEventOutput empty_event_output (0); // dummy, drops all events
 
 /// Access the current output EventStream during render(), needs prepare_event_output().
 MidiEventOutput&
@@ -979,10 +998,15 @@ public:
     else
       return value;
   }
-  bool
-  set_value (const Value &value) override
+  uint32_t
+  param_id () const
+  {
+    return id_;
+  }
+  /// Convert `value` into a parameter value and keep it as get_value() result until the engine applied it.
+  double
+  inflight_value (const Value &value)
   {
-    PropertyP thisp = shared_ptr_cast<Property> (this); // thisp keeps this alive during lambda
     const AudioProcessorP proc = device_->_audio_processor();
     double v;
     if (parameter_->is_text())
@@ -991,11 +1015,20 @@ public:
       v = proc->param_value_from_text (id_, value.as_string());
     else
       v = value.as_double();
-    proc->send_param (id_, v);
     inflight_value_ = v;
     inflight_stamp_ = proc->engine().frame_counter();
     inflight_stamp_ += 2 * proc->engine().block_size(); // wait until after the *next* job queue has been processed
+    return v;
+  }
+  bool
+  set_value (const Value &value) override
+  {
+    PropertyP thisp = shared_ptr_cast<Property> (this); // thisp keeps this alive during lambda
+    const AudioProcessorP proc = device_->_audio_processor();
+    proc->send_param (id_, inflight_value (value));
     emit_notify (parameter_->ident());
+    if (TrackImpl *track = dynamic_cast<TrackImpl*> (device_->_track()))
+      track->freeze_invalidate (device_.get());
     return true;
   }
   double
@@ -1052,22 +1085,91 @@ public:
 PropertyS
 AudioProcessor::access_properties () const
 {
-  DeviceP devp = get_device();
-  assert_return (devp, {});
   PropertyS props;
   props.reserve (params_.count);
   for (size_t idx = 0; idx < params_.count; idx++) {
-    const uint32_t id = params_.ids[idx];
-    ParameterC parameterp = params_.parameters[idx];
-    assert_return (parameterp != nullptr, {});
-    PropertyP prop = weak_ptr_fetch_or_create<Property> (params_.wprops[idx], [&] () {
-      return std::make_shared<AudioPropertyImpl> (devp, id, parameterp);
-    });
+    PropertyP prop = access_property_index (idx);
+    assert_return (prop != nullptr, {});
     props.push_back (prop);
   }
   return props;
 }
 
+/// Retrieve (or create) the Property handle for the parameter at `idx`.
+PropertyP
+AudioProcessor::access_property_index (size_t idx) const
+{
+  assert_return (idx < params_.count, nullptr);
+  DeviceP devp = get_device();
+  assert_return (devp, nullptr);
+  const uint32_t id = params_.ids[idx];
+  ParameterC parameterp = params_.parameters[idx];
+  assert_return (parameterp != nullptr, nullptr);
+  return weak_ptr_fetch_or_create<Property> (params_.wprops[idx], [&] () {
+    return std::make_shared<AudioPropertyImpl> (devp, id, parameterp);
+  });
+}
+
+/// Retrieve (or create) the Property handle for parameter `ident`, uses a hashed lookup.
+PropertyP
+AudioProcessor::access_property (const String &ident) const
+{
+  const CString cident = CString::lookup (ident);
+  return_unless (!cident.empty(), nullptr);
+  auto it = params_.idents.find (cident);
+  return_unless (it != params_.idents.end(), nullptr);
+  return access_property_index (it->second);
+}
+
+/// Assign many property values with a single update of the engine side parameters.
+/// Change notifications are coalesced and emitted once the engine applied the values.
+/// Returns false if any value could not be assigned.
+bool
+AudioProcessor::set_property_values (const ValueR &values)
+{
+  assert_return (this_thread_is_ase(), false); // main_loop thread
+  bool all_assigned = true;
+  std::vector<std::pair<uint32_t,double>> updates;
+  updates.reserve (values.size());
+  for (const ValueField &field : values)
+    {
+      PropertyP prop = field.value ? access_property (field.name) : nullptr;
+      AudioPropertyImpl *aprop = dynamic_cast<AudioPropertyImpl*> (prop.get());
+      if (!aprop || !string_option_check (aprop->hints(), "w"))
+        {
+          all_assigned = false;
+          continue;
+        }
+      const uint32_t id = aprop->param_id();
+      double v = aprop->inflight_value (*field.value);
+      if (ParameterC parameter = this->parameter (id))
+        v = parameter->dconstrain (v);
+      updates.push_back ({ id, v });
+    }
+  return_unless (updates.size(), all_assigned);
+  modify_t0events ([&] (std::vector<MidiEvent> &t0events) {
+    std::unordered_map<uint32_t,size_t> pending;     // reassign previous send_param events
+    for (size_t i = 0; i < t0events.size(); i++)
+      if (t0events[i].type == MidiEvent::PARAM_VALUE)
+        pending[t0events[i].param] = i;
+    for (const auto &[id, v] : updates)
+      {
+        auto it = pending.find (id);
+        if (it != pending.end())
+          t0events[it->second].pvalue = v;
+        else
+          {
+            pending[id] = t0events.size();
+            t0events.push_back (make_param_value (id, v));
+          }
+      }
+  });
+  DeviceP devicep = get_device();
+  if (TrackImpl *track = devicep ? dynamic_cast<TrackImpl*> (devicep->_track()) : nullptr)
+    track->freeze_invalidate (devicep.get());
+  return all_assigned;
+}
+
 // == enotify_queue ==
 static AudioProcessor        *const enotify_queue_tail = (AudioProcessor*) ptrdiff_t (-1);
 static std::atomic<AudioProcessor*> enotify_queue_head { enotify_queue_tail };
@@ -1119,6 +1221,8 @@ AudioProcessor::enotify_dispatch ()
             devicep->emit_event ("sub", "insert");
           if (nflags & REMOVAL)
             devicep->emit_event ("sub", "remove");
+          if (nflags & STATECHANGE)
+            devicep->emit_event ("state", "change");
           if (nflags & PARAMCHANGE)
             for (size_t blockoffset = 0; blockoffset < current->params_.count; blockoffset += 64)
               if (current->params_.bits[blockoffset >> 6]) {
@@ -60,6 +60,7 @@ struct AudioParams final {
   std::weak_ptr<Property> *wprops = nullptr;
   uint32                   count = 0;
   bool                     changed = false;
+  std::unordered_map<CString,uint32_t> idents; // parameter ident -> index
   void          clear   ();
   void          install (const Map &params);
   ssize_t       index   (uint32_t id) const;
@@ -82,6 +83,7 @@ class AudioProcessor : public std::enable_shared_from_this<AudioProcessor>, publ
   friend class DeviceImpl;
   friend class NativeDeviceImpl;
   friend class AudioEngineThread;
+  friend class Anticipation;
   struct OConnection {
     AudioProcessor *proc = nullptr; IBusId ibusid = {};
     bool operator== (const OConnection &o) const { return proc == o.proc && ibusid == o.ibusid; }
@@ -103,6 +105,7 @@ protected:
          INSERTION     = 1 << 6,
          REMOVAL       = 1 << 7,
          ENGINE_OUTPUT = 1 << 8,
+         STATECHANGE   = 1 << 9,
   };
   std::atomic<uint32>      flags_ = 0;
 private:
@@ -114,6 +117,7 @@ private:
   EventStreams            *estreams_ = nullptr;
   AtomicBits              *atomic_bits_ = nullptr;
   uint64_t                 render_stamp_ = 0;
+  uint32                   latency_ = 0;
   using MidiEventVector = std::vector<MidiEvent>;
   using MidiEventVectorAP = std::atomic<MidiEventVector*>;
   MidiEventVectorAP        t0events_ = nullptr;
@@ -133,6 +137,9 @@ private:
   virtual void       render             (uint n_frames) = 0;
   virtual void       reset              (uint64 target_stamp) = 0;
   PropertyS          access_properties  () const;
+  PropertyP          access_property    (const String &ident) const;
+  PropertyP          access_property_index (size_t idx) const;
+  bool               set_property_values (const ValueR &values);
 public:
   struct ProcessorSetup {
     CString      aseid;
@@ -148,6 +155,10 @@ protected:
   uint          schedule_processor ();
   void          reschedule        ();
   virtual uint  schedule_children () { return 0; }
+  virtual void  rollback          () {} // discard state rendered ahead of transport(), see Anticipation
+  void          set_latency       (uint nframes);
+  virtual void  update_latency    () {}
+  static void   update_latency    (AudioProcessor &p)   { p.update_latency(); }
   static uint   schedule_processor (AudioProcessor &p)  { return p.schedule_processor(); }
   // Parameters
   void          install_params    (const AudioParams::Map &params);
@@ -209,6 +220,7 @@ public:
   double              get_normalized        (Id32 paramid);
   bool                set_normalized        (Id32 paramid, double normalized);
   bool                is_initialized        () const;
+  uint                latency               () const;
   uint                text_param_to_quark   (uint32_t paramid, const String &text);
   String              text_param_from_quark (uint32_t paramid, uint vint);
   // Buses
@@ -247,7 +259,7 @@ private:
   std::atomic<AudioProcessor*> nqueue_next_ { nullptr }; ///< No notifications queued while == nullptr
   AudioProcessorP              nqueue_guard_;            ///< Only used while nqueue_next_ != nullptr
   std::weak_ptr<Device>        device_;
-  static constexpr uint32 NOTIFYMASK = PARAMCHANGE | BUSCONNECT | BUSDISCONNECT | INSERTION | REMOVAL;
+  static constexpr uint32 NOTIFYMASK = PARAMCHANGE | BUSCONNECT | BUSDISCONNECT | INSERTION | REMOVAL | STATECHANGE;
   static __thread uint64  tls_timestamp;
 };
 
@@ -276,6 +288,7 @@ protected:
   static auto pm_remove_all_buses    (AudioProcessor &p)       { return p.remove_all_buses(); }
   static auto pm_disconnect_ibuses   (AudioProcessor &p)       { return p.disconnect_ibuses(); }
   static auto pm_disconnect_obuses   (AudioProcessor &p)       { return p.disconnect_obuses(); }
+  static auto pm_disconnect          (AudioProcessor &p, IBusId i) { return p.disconnect (i); }
   static auto pm_connect             (AudioProcessor &p, IBusId i, AudioProcessor &d, OBusId o)
                                      { return p.connect (i, d, o); }
   static auto pm_connect_event_input (AudioProcessor &oproc, AudioProcessor &iproc)
@@ -427,6 +440,13 @@ AudioProcessor::engine () const
   return engine_;
 }
 
+/// Processing delay in sample frames between input and output, see set_latency().
+inline uint
+AudioProcessor::latency () const
+{
+  return latency_;
+}
+
 /// Sample rate mixing frequency in Hz as unsigned, used for render().
 inline const AudioTransport&
 AudioProcessor::transport () const
@@ -9,6 +9,7 @@
 #include "serialize.hh"
 #include "storage.hh"
 #include "server.hh"
+#include "nativedevice.hh"
 #include "internal.hh"
 
 #define UDEBUG(...)     Ase::debug ("undo", __VA_ARGS__)
@@ -61,6 +62,7 @@ ProjectImpl::ProjectImpl()
   if (tracks_.empty())
     create_track (); // ensure Master track
   tick_sig_.set_bpm (120);
+  tempo_map_.set_bpm (120);
 
   if (0)
     autoplay_timer_ = main_loop->exec_timer ([this] () {
@@ -114,6 +116,7 @@ ProjectImpl::_deactivate ()
   for (auto trackit = tracks_.rbegin(); trackit != tracks_.rend(); ++trackit)
     (*trackit)->_deactivate();
   DeviceImpl::_deactivate();
+  clear_device_pool();  // spares hold engine processors and plugin instances
 }
 
 static bool
@@ -407,6 +410,17 @@ ProjectImpl::serialize (WritNode &xs)
     xs["filehashes"] & storage_->asset_hashes;
   // serrialize children
   DeviceImpl::serialize (xs);
+  // tempo changes, the initial tempo is the "bpm" property
+  if (xs.in_save())
+    for (size_t i = 1; i < tempo_map_.size(); i++)
+      {
+        WritNode xc = xs["tempo_changes"].push();
+        xc["tick"] << tempo_map_[i].tick;
+        xc["bpm"] << tempo_map_[i].bpm;
+      }
+  if (xs.in_load())
+    for (auto &xc : xs["tempo_changes"].to_nodes())
+      set_tempo_change (xc["tick"].as_int(), xc["bpm"].as_double());
   // load tracks
   if (xs.in_load())
     for (auto &xc : xs["tracks"].to_nodes())
@@ -416,6 +430,27 @@ ProjectImpl::serialize (WritNode &xs)
           trackp = shared_ptr_cast<TrackImpl> (create_track());
         xc & *trackp;
       }
+  // aux sends refer to tracks by index
+  if (xs.in_load())
+    for (auto &xc : xs["aux_sends"].to_nodes())
+      {
+        const int64 track = xc["track"].as_int(), bus = xc["bus"].as_int();
+        if (track < 0 || bus < 0 || size_t (std::max (track, bus)) >= tracks_.size())
+          continue;
+        bool prefader = false;
+        xc["prefader"] & prefader;
+        tracks_[track]->set_send (tracks_[bus], xc["level"].as_double(), prefader);
+      }
+  if (xs.in_load())
+    for (auto &xc : xs["sidechains"].to_nodes())
+      {
+        const int64 track = xc["track"].as_int(), device = xc["device"].as_int(), source = xc["source"].as_int();
+        if (track < 0 || source < 0 || size_t (std::max (track, source)) >= tracks_.size())
+          continue;
+        DeviceS devices = tracks_[track]->list_chain_devices();
+        if (device >= 0 && size_t (device) < devices.size())
+          devices[device]->set_sidechain (tracks_[source]);
+      }
   // save tracks
   if (xs.in_save())
     {
@@ -426,6 +461,27 @@ ProjectImpl::serialize (WritNode &xs)
           if (trackp == tracks_.back())           // master_track
             xc.front ("mastertrack") << true;
         }
+      for (size_t i = 0; i < tracks_.size(); i++)
+        for (auto &send : tracks_[i]->sends_)
+          {
+            WritNode xc = xs["aux_sends"].push();
+            xc["track"] << int64 (i);
+            xc["bus"] << int64 (track_index (*send.bus));
+            xc["level"] << send.level;
+            xc["prefader"] & send.prefader;
+          }
+      for (size_t i = 0; i < tracks_.size(); i++)
+        {
+          const DeviceS devices = tracks_[i]->list_chain_devices();
+          for (size_t j = 0; j < devices.size(); j++)
+            if (TrackP source = devices[j]->get_sidechain())
+              {
+                WritNode xc = xs["sidechains"].push();
+                xc["track"] << int64 (i);
+                xc["device"] << int64 (j);
+                xc["source"] << int64 (track_index (*source));
+              }
+        }
       // store external reference hashes *after* all other objects
       if (storage_ && storage_->asset_hashes.size())
         xs["filehashes"] & storage_->asset_hashes;
@@ -634,11 +690,24 @@ ProjectImpl::set_bpm (double bpm)
   bpm = CLAMP (bpm, MIN_BPM, MAX_BPM);
   return_unless (tick_sig_.bpm() != bpm, false);
   tick_sig_.set_bpm (bpm);
+  tempo_map_.set_bpm (bpm);
   update_tempo();
   emit_notify ("bpm");
   return true;
 }
 
+/// Schedule a tempo change to `bpm` at `tick`, a `bpm` of 0 removes the tempo change at `tick`.
+bool
+ProjectImpl::set_tempo_change (int64 tick, double bpm)
+{
+  if (tick <= 0)
+    return bpm > 0 && set_bpm (bpm);
+  return_unless (tempo_map_.set_change (tick, bpm), false);
+  update_tempo();
+  emit_notify ("tempo_map");
+  return true;
+}
+
 bool
 ProjectImpl::set_numerator (uint8 numerator)
 {
@@ -669,9 +738,10 @@ ProjectImpl::update_tempo ()
   AudioProcessorP proc = master_processor();
   return_unless (proc);
   const TickSignature tsig (tick_sig_);
-  auto job = [proc, tsig] () {
+  auto job = [proc, tsig, tmap = tempo_map_] () mutable {
     AudioTransport &transport = const_cast<AudioTransport&> (proc->engine().transport());
     transport.tempo (tsig);
+    transport.swap_tempo_map (tmap); // old map is destroyed with the job in the main thread
   };
   proc->engine().async_jobs += job;
 }
@@ -702,13 +772,14 @@ ProjectImpl::start_playback (double autostop)
   for (auto track : tracks_)
     track->queue_cmd (*queuep, track->START);
   const TickSignature tsig (tick_sig_);
-  auto job = [proc, queuep, tsig, autostop] () {
+  auto job = [proc, queuep, tsig, tmap = tempo_map_, autostop] () mutable {
     AudioEngine &engine = proc->engine();
     const double udmax = 18446744073709549568.0; // max double exactly matching an uint64_t
     const uint64_t s = autostop > udmax ? udmax : autostop * engine.sample_rate();
     engine.set_autostop (s);
     AudioTransport &transport = const_cast<AudioTransport&> (engine.transport());
     transport.tempo (tsig);
+    transport.swap_tempo_map (tmap);
     transport.running (true);
     for (const auto &cmd : *queuep)
       cmd();
@@ -769,6 +840,13 @@ ProjectImpl::remove_track (Track &child)
   clear_undo(); // TODO: implement undo for remove_track
   if (!Aux::erase_first (tracks_, [track] (TrackP t) { return t == track; }))
     return false;
+  for (auto &other : tracks_)
+    {
+      other->set_send (track, 0, false);
+      for (DeviceP &device : other->list_chain_devices())
+        if (device->get_sidechain() == track)
+          device->set_sidechain (nullptr);
+    }
   // destroy Track
   track->_set_parent (nullptr);
   emit_event ("track", "remove");
@@ -22,6 +22,7 @@ class ProjectImpl final : public DeviceImpl, public virtual Project {
   std::vector<TrackImplP> tracks_;
   ASE_DEFINE_MAKE_SHARED (ProjectImpl);
   TickSignature tick_sig_;
+  TempoMap tempo_map_;
   MusicalTuning musical_tuning_ = MusicalTuning::OD_12_TET;
   uint autoplay_timer_ = 0;
   uint undo_scopes_open_ = 0;
@@ -63,6 +64,8 @@ public:
   void                 start_playback    () override    { start_playback (D64MAX); }
   void                 stop_playback     () override;
   bool                 set_bpm           (double bpm);
+  bool                 set_tempo_change  (int64 tick, double bpm);
+  const TempoMap&      tempo_map         () const       { return tempo_map_; }
   bool                 set_numerator     (uint8 numerator);
   bool                 set_denominator   (uint8 denominator);
   bool                 is_playing        () override;
@@ -2,6 +2,9 @@
 #include "regex.hh"
 #include "internal.hh"
 #include <regex>
+#include <list>
+#include <unordered_map>
+#include <cstring>
 
 namespace Ase {
 
@@ -18,25 +21,138 @@ regex_flags (Re::Flags flags, bool d = false)
   return o;
 }
 
-/// Find `regex` in `input` and return match position >= 0 or return < 0 otherwise.
+// == Pattern cache ==
+/// Compiled regex, or plain literal if the pattern contains no special characters.
+struct Re::Pattern::Compiled {
+  std::regex rex;
+  String     literal;
+  String     prefix;    // literal that every match starts with, used to skip std::regex_search attempts
+};
+
+static constexpr const char REGEX_SPECIALS[] = R"(\^$.|?*+()[]{})";
+
+static bool
+regex_is_literal (const String &regex, Re::Flags flags)
+{
+  if (regex.empty() || (flags & Re::I))
+    return false;
+  for (const char c : regex)
+    if (!c || strchr (REGEX_SPECIALS, c))
+      return false;
+  return true;
+}
+
+// Find the literal that starts every match of `regex`, after leading word boundaries.
+static String
+regex_literal_prefix (const String &regex, Re::Flags flags)
+{
+  if ((flags & Re::I) || regex.find ('|') != String::npos)
+    return "";
+  size_t i = 0;
+  if (!(flags & Re::ERE))
+    while (regex.compare (i, 2, R"(\b)") == 0)
+      i += 2;
+  size_t j = i;
+  while (j < regex.size() && regex[j] && !strchr (REGEX_SPECIALS, regex[j]))
+    j++;
+  if (j > i && j < regex.size() && strchr ("?*+{", regex[j]))
+    j--; // quantified last character
+  return regex.substr (i, j - i);
+}
+
+/// Lookup compiled `regex` in an LRU cache, compile and add it if missing.
+Re::Pattern::CompiledP
+Re::Pattern::compile (const String &regex, Flags flags, bool subs)
+{
+  constexpr size_t CAPACITY = 256;
+  struct Cache {
+    using Entry = std::pair<String,CompiledP>;
+    std::mutex mutex;
+    std::list<Entry> lru; // most recently used first
+    std::unordered_map<String,std::list<Entry>::iterator> map;
+  };
+  static Cache &cache = *new Cache();
+  String key = regex;
+  key += char (subs);
+  key.append ((const char*) &flags, sizeof (flags));
+  {
+    std::lock_guard<std::mutex> locker (cache.mutex);
+    auto it = cache.map.find (key);
+    if (it != cache.map.end())
+      {
+        cache.lru.splice (cache.lru.begin(), cache.lru, it->second);
+        return it->second->second;
+      }
+  }
+  // compile unlocked, may throw std::regex_error
+  auto compiled = std::make_shared<Compiled>();
+  if (!subs && regex_is_literal (regex, flags))
+    compiled->literal = regex;
+  else
+    {
+      compiled->rex = std::regex (regex, regex_flags (flags, subs));
+      compiled->prefix = regex_literal_prefix (regex, flags);
+    }
+  std::lock_guard<std::mutex> locker (cache.mutex);
+  auto it = cache.map.find (key);
+  if (it != cache.map.end()) // compiled concurrently
+    return it->second->second;
+  cache.lru.emplace_front (key, compiled);
+  cache.map[key] = cache.lru.begin();
+  if (cache.lru.size() > CAPACITY)
+    {
+      cache.map.erase (cache.lru.back().first);
+      cache.lru.pop_back();
+    }
+  return compiled;
+}
+
+// == Pattern ==
+/// Compile `regex` once for use with multiple inputs, compilations are shared via a cache.
+Re::Pattern::Pattern (const String &regex, Flags flags) :
+  compiled_ (compile (regex, flags, false)), regex_ (regex), flags_ (flags)
+{}
+
+/// Find pattern in `input` and return match position >= 0 or return < 0 otherwise.
 ssize_t
-Re::search (const String &regex, const String &input, Flags flags)
+Re::Pattern::search (const String &input) const
 {
-  std::regex rex (regex, regex_flags (flags));
+  if (!compiled_->literal.empty())
+    {
+      const size_t pos = input.find (compiled_->literal);
+      return pos == String::npos ? -1 : pos;
+    }
   std::smatch m;
-  if (std::regex_search (input, m, rex))
+  const String &prefix = compiled_->prefix;
+  if (!prefix.empty())
+    {
+      // only attempt anchored matches where the prefix occours
+      for (size_t pos = input.find (prefix); pos != String::npos; pos = input.find (prefix, pos + 1))
+        if (std::regex_search (input.begin() + pos, input.end(), m, compiled_->rex,
+                               std::regex_constants::match_continuous |
+                               (pos ? std::regex_constants::match_prev_avail : std::regex_constants::match_default)))
+          return pos;
+      return -1;
+    }
+  if (std::regex_search (input, m, compiled_->rex))
     return m.position();
   return -1;
 }
 
-/// Find `regex` in `input` and return non-overlapping matches.
+/// Find pattern in `input` and return non-overlapping matches.
 StringS
-Re::findall (const String &regex, const String &input, Flags flags)
+Re::Pattern::findall (const String &input) const
 {
-  std::regex rex (regex, regex_flags (flags));
-  std::sregex_iterator itb = std::sregex_iterator (input.begin(), input.end(), rex);
-  std::sregex_iterator ite = std::sregex_iterator();
   StringS all;
+  const String &literal = compiled_->literal;
+  if (!literal.empty())
+    {
+      for (size_t pos = input.find (literal); pos != String::npos; pos = input.find (literal, pos + literal.size()))
+        all.push_back (literal);
+      return all;
+    }
+  std::sregex_iterator itb = std::sregex_iterator (input.begin(), input.end(), compiled_->rex);
+  std::sregex_iterator ite = std::sregex_iterator();
   for (std::sregex_iterator it = itb; it != ite; ++it) {
     std::smatch match = *it;
     all.push_back (match.str());
@@ -44,13 +160,30 @@ Re::findall (const String &regex, const String &input, Flags flags)
   return all;
 }
 
-/// Substitute `regex` in `input` with `subst` up to `count` times.
+/// Substitute pattern in `input` with `subst` up to `count` times.
 String
-Re::subn (const String &regex, const String &subst, const String &input, uint count, Flags flags)
+Re::Pattern::subn (const String &subst, const String &input, uint count) const
 {
+  const String &literal = compiled_->literal;
+  if (!literal.empty())
+    {
+      size_t pos = input.find (literal);
+      return_unless (pos != String::npos, input);
+      String result;
+      size_t last = 0;
+      for (; pos != String::npos; pos = input.find (literal, last))
+        {
+          result.append (input, last, pos - last);
+          result += subst;
+          last = pos + literal.size();
+          if (count-- == 1)
+            break;
+        }
+      result.append (input, last);
+      return result;
+    }
   const std::sregex_iterator end = std::sregex_iterator();
-  std::regex rex (regex, regex_flags (flags));
-  std::sregex_iterator matchiter = std::sregex_iterator (input.begin(), input.end(), rex);
+  std::sregex_iterator matchiter = std::sregex_iterator (input.begin(), input.end(), compiled_->rex);
   const size_t n = std::distance (matchiter, end); // number of matches
   return_unless (n, input);
   std::string result;
@@ -70,12 +203,42 @@ Re::subn (const String &regex, const String &subst, const String &input, uint co
   return result;
 }
 
+/// Substitute pattern in `input` by `sbref` with backreferences `$00…$99` or `$&`.
+String
+Re::Pattern::sub (const String &sbref, const String &input) const
+{
+  CompiledP compiled = compile (regex_, flags_, true); // needs subexpressions
+  return std::regex_replace (input, compiled->rex, sbref);
+}
+
+// == Re ==
+/// Find `regex` in `input` and return match position >= 0 or return < 0 otherwise.
+ssize_t
+Re::search (const String &regex, const String &input, Flags flags)
+{
+  return Pattern (regex, flags).search (input);
+}
+
+/// Find `regex` in `input` and return non-overlapping matches.
+StringS
+Re::findall (const String &regex, const String &input, Flags flags)
+{
+  return Pattern (regex, flags).findall (input);
+}
+
+/// Substitute `regex` in `input` with `subst` up to `count` times.
+String
+Re::subn (const String &regex, const String &subst, const String &input, uint count, Flags flags)
+{
+  return Pattern (regex, flags).subn (subst, input, count);
+}
+
 /// Substitute `regex` in `input` by `sbref` with backreferences `$00…$99` or `$&`.
 String
 Re::sub (const String &regex, const String &sbref, const String &input, Flags flags)
 {
-  std::regex rex (regex, regex_flags (flags, true));
-  return std::regex_replace (input, rex, sbref);
+  Pattern::CompiledP compiled = Pattern::compile (regex, flags, true);
+  return std::regex_replace (input, compiled->rex, sbref);
 }
 
 } // Ase
@@ -106,6 +269,23 @@ regex_tests()
   u = "abc abc abc Abc"; v = Re::subn (R"(\bA\b)", "-", u);              TCMP (v, ==, "abc abc abc Abc");
   u = "a 1 0 2 b 3n 4 Z";  v = Re::sub (R"(([a-zA-Z]) ([0-9]+\b))", "$1$2", u);  TCMP (v, ==, "a1 0 2 b 3n4 Z");
   u = "abc 123 abc Abc"; ss = Re::findall (R"(\b\w)", u); TCMP (ss, ==, cstrings_to_vector ("a", "1", "a", "A", nullptr));
+  // literal patterns
+  k = Re::search ("c a", "abc abc");                                    TCMP (k, ==, 2);
+  k = Re::search (R"(\bbc)", "abc bc");                                 TCMP (k, ==, 4);
+  k = Re::search (R"(\bab?c)", "xac abd ac");                           TCMP (k, ==, 8);
+  k = Re::search (R"(ab*c\b)", "abbcd ac");                             TCMP (k, ==, 6);
+  u = "abababa"; ss = Re::findall ("aba", u);                           TCMP (ss, ==, cstrings_to_vector ("aba", "aba", nullptr));
+  u = "abc abc abc Abc"; v = Re::subn ("bc", "-", u, 3);                TCMP (v, ==, "a- a- a- Abc");
+  u = "abc abc abc Abc"; v = Re::subn ("bc ", "", u);                   TCMP (v, ==, "aaaAbc");
+  // precompiled patterns
+  const Re::Pattern word (R"(\b\w+)"), digits (R"(([a-z]+)([0-9]+))", Re::ERE);
+  ss = word.findall ("Ab Cd 12");                                       TCMP (ss, ==, cstrings_to_vector ("Ab", "Cd", "12", nullptr));
+  k = word.search ("  x");                                              TCMP (k, ==, 2);
+  v = digits.sub ("$2$1", "abc123 de45");                               TCMP (v, ==, "123abc 45de");
+  v = digits.subn ("#", "abc123 de45", 1);                              TCMP (v, ==, "# de45");
+  for (size_t i = 0; i < 300; i++) // exceed cache capacity
+    TCMP (Re::search (string_format ("x%u\\b", i), string_format ("ax%u", i)), ==, 1);
+  ss = word.findall ("Ef");                                             TCMP (ss, ==, cstrings_to_vector ("Ef", nullptr));
 }
 
 } // Anon
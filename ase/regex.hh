@@ -20,6 +20,24 @@ public:
   static ssize_t search  (const String &regex, const String &input, Flags = DEFAULT);
   static String  subn    (const String &regex, const String &subst, const String &input, uint count = 0, Flags = DEFAULT);
   static String  sub     (const String &regex, const String &sbref, const String &input, Flags = DEFAULT);
+  class Pattern;
+};
+
+/// Precompiled regular expression handle for repeated matching.
+class Re::Pattern final {
+  friend class Re;
+  struct Compiled;
+  using CompiledP = std::shared_ptr<const Compiled>;
+  CompiledP    compiled_;
+  const String regex_;
+  const Flags  flags_;
+  static CompiledP compile (const String &regex, Flags flags, bool subs);
+public:
+  explicit Pattern (const String &regex, Flags = DEFAULT);
+  StringS  findall (const String &input) const;
+  ssize_t  search  (const String &input) const;
+  String   subn    (const String &subst, const String &input, uint count = 0) const;
+  String   sub     (const String &sbref, const String &input) const;
 };
 extern constexpr inline Re::Flags operator| (Re::Flags a, Re::Flags b) { return Re::Flags (int32_t (a) | int32_t (b)); }
 
@@ -0,0 +1,167 @@
+// This Source Code Form is licensed MPL-2.0: http://mozilla.org/MPL/2.0
+#include "resampler.hh"
+#include "internal.hh"
+#include <numeric>
+#include <cmath>
+
+namespace Ase {
+
+// == PolyphaseResampler ==
+static inline float
+dot_product (uint n, const float *a, const float *b)
+{
+  float acc[4] = { 0, 0, 0, 0 };        // independent accumulators allow vectorization
+  uint i = 0;
+  for (; i + 4 <= n; i += 4)
+    for (uint j = 0; j < 4; j++)
+      acc[j] += a[i + j] * b[i + j];
+  for (; i < n; i++)
+    acc[0] += a[i] * b[i];
+  return (acc[0] + acc[1]) + (acc[2] + acc[3]);
+}
+
+/// Configure conversion from `input_rate` to `output_rate`, returns false for ratios that need too many phases.
+bool
+PolyphaseResampler::setup (uint input_rate, uint output_rate, uint n_channels, Quality quality)
+{
+  assert_return (input_rate > 0 && output_rate > 0 && n_channels > 0, false);
+  const uint g = std::gcd (input_rate, output_rate);
+  return_unless (output_rate / g <= MAX_PHASES, false);
+  input_rate_ = input_rate;
+  output_rate_ = output_rate;
+  n_channels_ = n_channels;
+  up_ = output_rate / g;
+  down_ = input_rate / g;
+  double rolloff, beta;
+  switch (quality)
+    {
+    case LOW:    n_taps_ = 16; rolloff = 0.80; beta = 6.0;  break;
+    case MEDIUM: n_taps_ = 32; rolloff = 0.88; beta = 8.0;  break;
+    default:
+    case HIGH:   n_taps_ = 64; rolloff = 0.92; beta = 10.0; break;
+    }
+  if (up_ == down_)
+    n_taps_ = 1;                        // 1:1, pass through with a unit impulse
+  // windowed sinc prototype at the upsampled rate
+  const uint length = n_taps_ * up_;
+  const double cutoff = 0.5 * rolloff * std::min (input_rate, output_rate) / (double (input_rate) * up_);
+  const double center = 0.5 * (length - 1), ibeta = 1.0 / std::cyl_bessel_i (0.0, beta);
+  std::vector<double> proto (length);
+  for (uint k = 0; k < length; k++)
+    {
+      const double t = k - center, x = 2 * cutoff * t;
+      const double sinc = std::abs (x) < 1e-12 ? 1.0 : std::sin (M_PI * x) / (M_PI * x);
+      const double r = length > 1 ? t / (0.5 * length) : 0;
+      const double kaiser = std::cyl_bessel_i (0.0, beta * std::sqrt (std::max (0.0, 1 - r * r))) * ibeta;
+      proto[k] = sinc * kaiser;
+    }
+  // split into phases, coefficient j weights input i - (n_taps_ - 1 - j) for output phase p
+  coeffs_.assign (up_ * n_taps_, 0);
+  for (uint p = 0; p < up_; p++)
+    {
+      double sum = 0;
+      for (uint k = 0; k < n_taps_; k++)
+        sum += proto[p + k * up_];
+      for (uint k = 0; k < n_taps_; k++)        // normalize each phase to unity DC gain
+        coeffs_[p * n_taps_ + n_taps_ - 1 - k] = proto[p + k * up_] / sum;
+    }
+  history_.resize (n_channels_ * 2 * n_taps_);
+  reset();
+  return true;
+}
+
+/// Clear the filter history.
+void
+PolyphaseResampler::reset ()
+{
+  std::fill (history_.begin(), history_.end(), 0.0f);
+  phase_ = 0;
+  hpos_ = 0;
+}
+
+/// Upper bound for the number of output frames produced from `n_input_frames`.
+size_t
+PolyphaseResampler::max_output (size_t n_input_frames) const
+{
+  return (n_input_frames * up_ + down_ - 1) / down_ + 1;
+}
+
+/// Convert `n_input_frames` interleaved frames, returns the number of interleaved frames written to `output`.
+size_t
+PolyphaseResampler::process (size_t n_input_frames, const float *input, float *output)
+{
+  const uint N = n_taps_, C = n_channels_;
+  float *const history = history_.data();
+  size_t n_output = 0;
+  for (size_t i = 0; i < n_input_frames; i++)
+    {
+      for (uint c = 0; c < C; c++)
+        {
+          float *h = history + c * 2 * N;
+          h[hpos_] = h[hpos_ + N] = input[i * C + c];
+        }
+      hpos_ = hpos_ + 1 == N ? 0 : hpos_ + 1;
+      for (; phase_ < up_; phase_ += down_)
+        {
+          const float *coeffs = &coeffs_[phase_ * N];
+          for (uint c = 0; c < C; c++)
+            output[n_output * C + c] = dot_product (N, coeffs, history + c * 2 * N + hpos_);
+          n_output++;
+        }
+      phase_ -= up_;
+    }
+  return n_output;
+}
+
+} // Ase
+
+// == Testing ==
+#include "testing.hh"
+
+namespace { // Anon
+using namespace Ase;
+
+static double
+resampler_sine_error (uint irate, uint orate, PolyphaseResampler::Quality quality, double freq)
+{
+  PolyphaseResampler resampler;
+  TASSERT (resampler.setup (irate, orate, 2, quality));
+  const uint n_in = irate / 10;
+  std::vector<float> input (n_in * 2), output (resampler.max_output (n_in) * 2);
+  for (uint i = 0; i < n_in; i++)
+    input[i * 2] = input[i * 2 + 1] = 0.5 * std::sin (2 * M_PI * freq * i / irate);
+  size_t n_out = 0;
+  for (uint offset = 0, n = 1; offset < n_in; offset += n, n = std::min (n * 3 + 1, n_in - offset))
+    n_out += resampler.process (n, &input[offset * 2], &output[n_out * 2]);
+  TCMP (n_out, ==, size_t (orate / 10));
+  const uint up = orate / std::gcd (irate, orate);
+  const double delay = (resampler.delay() - 0.5 / up) / irate; // group delay of the linear phase filter
+  double max_error = 0;
+  for (size_t n = resampler.max_output (resampler.delay() * 2); n < n_out; n++)
+    {
+      const double expected = 0.5 * std::sin (2 * M_PI * freq * (n / double (orate) - delay));
+      max_error = std::max (max_error, std::abs (output[n * 2] - expected));
+      TCMP (output[n * 2], ==, output[n * 2 + 1]);
+    }
+  return max_error;
+}
+
+TEST_INTEGRITY (polyphase_resampler_tests);
+static void
+polyphase_resampler_tests()
+{
+  TCMP (resampler_sine_error (48000, 44100, PolyphaseResampler::MEDIUM, 997), <, 0.001);
+  TCMP (resampler_sine_error (48000, 44100, PolyphaseResampler::HIGH, 15000), <, 0.001);
+  TCMP (resampler_sine_error (48000, 96000, PolyphaseResampler::MEDIUM, 1000), <, 0.001);
+  TCMP (resampler_sine_error (48000, 32000, PolyphaseResampler::LOW, 440), <, 0.01);
+  PolyphaseResampler resampler;
+  TASSERT (resampler.setup (48000, 48000, 1, PolyphaseResampler::HIGH));
+  const float values[] = { 0.5, -0.25, 1, 0 };
+  float output[4];
+  TCMP (resampler.process (4, values, output), ==, 4u);
+  for (uint i = 0; i < 4; i++)
+    TCMP (output[i], ==, values[i]);
+  TASSERT (!resampler.setup (48000, 47999, 2, PolyphaseResampler::LOW)); // too many phases
+}
+
+} // Anon
@@ -0,0 +1,36 @@
+// This Source Code Form is licensed MPL-2.0: http://mozilla.org/MPL/2.0
+#ifndef __ASE_RESAMPLER_HH__
+#define __ASE_RESAMPLER_HH__
+
+#include <ase/defs.hh>
+
+namespace Ase {
+
+/// Rational polyphase sample rate converter for interleaved audio, using a Kaiser windowed sinc prototype.
+class PolyphaseResampler {
+public:
+  enum Quality {
+    LOW,        ///< 16 taps per phase, lowest CPU load and latency.
+    MEDIUM,     ///< 32 taps per phase, 80dB stopband.
+    HIGH,       ///< 64 taps per phase, 100dB stopband.
+  };
+  static constexpr uint MAX_PHASES = 4096;
+  bool   setup          (uint input_rate, uint output_rate, uint n_channels, Quality quality);
+  void   reset          ();
+  size_t process        (size_t n_input_frames, const float *input, float *output);
+  size_t max_output     (size_t n_input_frames) const;
+  uint   delay          () const        { return n_taps_ / 2; } ///< Filter delay in input frames.
+  uint   n_channels     () const        { return n_channels_; }
+  uint   input_rate     () const        { return input_rate_; }
+  uint   output_rate    () const        { return output_rate_; }
+private:
+  uint   input_rate_ = 0, output_rate_ = 0, n_channels_ = 0;
+  uint   up_ = 1, down_ = 1, n_taps_ = 0;
+  uint   phase_ = 0, hpos_ = 0;
+  std::vector<float> coeffs_;   // up_ phases of n_taps_ coefficients, ordered oldest to newest input
+  std::vector<float> history_;  // per channel 2 * n_taps_ inputs, window duplicated to stay contiguous
+};
+
+} // Ase
+
+#endif // __ASE_RESAMPLER_HH__
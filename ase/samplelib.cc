@@ -0,0 +1,856 @@
+// This Source Code Form is licensed MPL-2.0: http://mozilla.org/MPL/2.0
+#include "samplelib.hh"
+#include "jsonipc/jsonipc.hh"
+#include "levenshtein.hh"
+#include "properties.hh"
+#include "platform.hh"
+#include "unicode.hh"
+#include "path.hh"
+#include "main.hh"
+#include "internal.hh"
+#include "external/libsndfile/include/sndfile.h"
+#include <condition_variable>
+#include <unordered_set>
+#include <sys/inotify.h>
+#include <sys/stat.h>
+#include <dirent.h>
+#include <fcntl.h>
+#include <deque>
+#include <numeric>
+
+#define SDEBUG(...)     Ase::debug ("samplelib", __VA_ARGS__)
+
+namespace Ase {
+
+// == SampleEntry ==
+namespace { // Anon
+struct SampleEntry {
+  String name;                  // file system encoding
+  int64  size = 0;
+  int64  mtime = 0;             // milliseconds
+  int64  n_frames = 0;
+  int32  sample_rate = 0;
+  int32  n_channels = 0;
+  bool   is_dir = false;
+  bool
+  operator< (const SampleEntry &o) const
+  {
+    return is_dir != o.is_dir ? is_dir : name < o.name; // folders first
+  }
+  bool
+  same (const SampleEntry &o) const
+  {
+    return name == o.name && is_dir == o.is_dir && size == o.size && mtime == o.mtime;
+  }
+};
+
+struct SampleFolder {
+  int64                    mtime = 0;
+  int                      wd = -1;     // inotify watch descriptor
+  std::vector<SampleEntry> entries;     // sorted, folders first
+};
+using SampleFolderMap = std::unordered_map<String,SampleFolder>;
+} // Anon
+
+static constexpr const char INDEX_HEADER[] = "# Anklang sample library index v1\n";
+static constexpr uint32     INOTIFY_MASK = IN_CREATE | IN_DELETE | IN_MOVED_FROM | IN_MOVED_TO | IN_CLOSE_WRITE | IN_ONLYDIR;
+static constexpr uint       RESCAN_DELAY_MS = 250;
+
+static int64
+stat_mtime_ms (const struct stat &st)
+{
+  return st.st_mtim.tv_sec * int64 (1000) + st.st_mtim.tv_nsec / 1000000;
+}
+
+static String
+folder_path (const String &dir, const String &name)
+{
+  return dir == "/" ? dir + name : dir + "/" + name;
+}
+
+static bool
+is_audio_file (const char *name)
+{
+  static const char *const extensions[] = {
+    ".wav", ".flac", ".ogg", ".opus", ".mp3", ".aif", ".aiff", ".aifc", ".w64", ".caf", ".au", ".snd",
+  };
+  const char *dot = strrchr (name, '.');
+  return_unless (dot, false);
+  for (const char *ext : extensions)
+    if (strcasecmp (dot, ext) == 0)
+      return true;
+  return false;
+}
+
+static void
+read_audio_info (const String &filename, SampleEntry &entry)
+{
+  SF_INFO info = { 0, };
+  SNDFILE *sndfile = sf_open (filename.c_str(), SFM_READ, &info);
+  if (!sndfile)
+    {
+      SDEBUG ("%s: %s", filename, sf_strerror (nullptr));
+      return;
+    }
+  entry.n_frames = info.frames;
+  entry.sample_rate = info.samplerate;
+  entry.n_channels = info.channels;
+  sf_close (sndfile);
+}
+
+/// Read folder entries, audio information of unchanged files is reused from `old`.
+static bool
+scan_folder (const String &dirpath, const std::vector<SampleEntry> &old, SampleFolder &folder)
+{
+  DIR *dir = opendir (dirpath.c_str());
+  if (!dir)
+    {
+      SDEBUG ("%s: opendir: %s", dirpath, strerror (errno));
+      return false;
+    }
+  const int dfd = dirfd (dir);
+  struct stat st = {};
+  if (fstat (dfd, &st) == 0)
+    folder.mtime = stat_mtime_ms (st);
+  for (const struct dirent *de = readdir (dir); de; de = readdir (dir))
+    {
+      if (de->d_name[0] == '.' ||                               // skip hidden files, "." and ".."
+          strpbrk (de->d_name, "\t\n"))                         // not representable in the index file
+        continue;
+      const bool maybe_dir = de->d_type == DT_DIR || de->d_type == DT_LNK || de->d_type == DT_UNKNOWN;
+      if (!maybe_dir && !is_audio_file (de->d_name))
+        continue;
+      if (fstatat (dfd, de->d_name, &st, AT_NO_AUTOMOUNT) != 0)
+        continue;
+      SampleEntry e;
+      e.is_dir = S_ISDIR (st.st_mode);
+      if (!e.is_dir && !(S_ISREG (st.st_mode) && is_audio_file (de->d_name)))
+        continue;
+      e.name = de->d_name;
+      e.size = st.st_size;
+      e.mtime = stat_mtime_ms (st);
+      if (e.is_dir)
+        {
+          struct stat lst = {};                                 // symlinked folders are not descended to avoid cycles
+          if (de->d_type == DT_LNK || (de->d_type == DT_UNKNOWN && fstatat (dfd, de->d_name, &lst, AT_SYMLINK_NOFOLLOW) == 0 &&
+                                       S_ISLNK (lst.st_mode)))
+            continue;
+        }
+      else
+        {
+          auto it = std::lower_bound (old.begin(), old.end(), e);
+          if (it != old.end() && it->same (e))
+            e = *it;
+          else
+            read_audio_info (folder_path (dirpath, e.name), e);
+        }
+      folder.entries.push_back (std::move (e));
+    }
+  closedir (dir);
+  std::sort (folder.entries.begin(), folder.entries.end());
+  return true;
+}
+
+// == Index file ==
+static String
+index_filename ()
+{
+  return Path::join (Path::cache_home(), "anklang", "samplelib.index");
+}
+
+static String
+serialize_index (const SampleFolderMap &folders)
+{
+  String s = INDEX_HEADER;
+  for (const auto &[path, folder] : folders)
+    {
+      s += string_format ("D\t%d\t%s\n", folder.mtime, path);
+      for (const SampleEntry &e : folder.entries)
+        s += string_format ("%c\t%d\t%d\t%d\t%d\t%d\t%s\n", e.is_dir ? 'd' : 'f',
+                            e.size, e.mtime, e.n_frames, e.sample_rate, e.n_channels, e.name);
+    }
+  return s;
+}
+
+static int64
+parse_field (const char *&p)
+{
+  char *end = nullptr;
+  const int64 v = strtoll (p, &end, 10);
+  p = *end == '\t' ? end + 1 : end;
+  return v;
+}
+
+static SampleFolderMap
+parse_index (const String &data)
+{
+  SampleFolderMap folders;
+  return_unless (string_startswith (data, INDEX_HEADER), folders);
+  SampleFolder *folder = nullptr;
+  for (size_t pos = strlen (INDEX_HEADER), eol; pos < data.size(); pos = eol + 1)
+    {
+      eol = data.find ('\n', pos);
+      if (eol == String::npos)
+        break;                                                  // truncated
+      const char *p = data.c_str() + pos, *const line = p;
+      if (line[0] == 'D' && line[1] == '\t')
+        {
+          p += 2;
+          const int64 mtime = parse_field (p);
+          folder = &folders[String (p, data.c_str() + eol)];
+          folder->mtime = mtime;
+        }
+      else if (folder && (line[0] == 'd' || line[0] == 'f') && line[1] == '\t')
+        {
+          p += 2;
+          SampleEntry e;
+          e.is_dir = line[0] == 'd';
+          e.size = parse_field (p);
+          e.mtime = parse_field (p);
+          e.n_frames = parse_field (p);
+          e.sample_rate = parse_field (p);
+          e.n_channels = parse_field (p);
+          e.name.assign (p, data.c_str() + eol);
+          folder->entries.push_back (std::move (e));
+        }
+    }
+  for (auto &it : folders)
+    std::sort (it.second.entries.begin(), it.second.entries.end());
+  return folders;
+}
+
+// == Fuzzy matching ==
+static inline bool
+is_word_char (char c)
+{
+  return (c & 0x80) || isalnum (uint8 (c));                     // treat UTF-8 sequences as word characters
+}
+
+static bool
+shares_bigram (const String &word, const char *s, size_t l)
+{
+  return_unless (word.size() >= 2 && l >= 2, true);
+  for (size_t i = 0; i + 1 < l; i++)
+    for (size_t j = 0; j + 1 < word.size(); j++)
+      if (s[i] == word[j] && s[i + 1] == word[j + 1])
+        return true;
+  return false;
+}
+
+/// Edit distance between lower case `word` and the word characters `s` of length `l`, INFINITY if too distant.
+static float
+fuzzy_token_distance (const String &word, const char *s, size_t l)
+{
+  const size_t max_distance = std::max (size_t (1), word.size() / 3);
+  if (l == 0 || l + max_distance < word.size() || l > word.size() + max_distance || !shares_bigram (word, s, l))
+    return INFINITY;
+  const float d = damerau_levenshtein_distance (word, String (s, l), 1, 1, 1, 1);
+  return d <= max_distance ? d : INFINITY;
+}
+
+/// Rank how well a lower case `word` matches lower case `name`, smaller is better.
+static float
+fuzzy_word_score (const String &word, const String &name)
+{
+  const size_t pos = name.find (word);
+  if (pos != String::npos)                                      // substring match, prefer prefixes and short names
+    return (pos ? 0.25 : 0) + std::min (0.5, 0.005 * (name.size() - word.size()));
+  float best = INFINITY;
+  for (size_t i = 0, j; i < name.size(); i = j)
+    {
+      while (i < name.size() && !is_word_char (name[i]))
+        i++;
+      for (j = i; j < name.size() && is_word_char (name[j]); j++)
+        ;
+      best = std::min (best, fuzzy_token_distance (word, name.data() + i, j - i));
+    }
+  return 1 + best;
+}
+
+static void
+ascii_tolower (String &s)
+{
+  for (char &c : s)
+    if (c >= 'A' && c <= 'Z')
+      c += 'a' - 'A';
+}
+
+/// Split lower cased `query` at white space.
+static StringS
+query_words (const String &query)
+{
+  StringS words;
+  String lquery = query;
+  ascii_tolower (lquery);
+  for (const String &w : string_split_any (lquery, " \t\n"))
+    if (!w.empty())
+      words.push_back (w);
+  return words;
+}
+
+static float
+fuzzy_score (const StringS &words, const String &lname)
+{
+  float score = 0;
+  for (const String &w : words)
+    {
+      score += fuzzy_word_score (w, lname);
+      if (score == INFINITY)
+        break;
+    }
+  return score;
+}
+
+// == SearchIndex ==
+namespace { // Anon
+/// Immutable snapshot of the sample files, maps the word tokens of lower cased names to the files using them.
+struct SearchIndex {
+  struct File { uint32 dir; SampleEntry entry; };
+  StringS                          dirs;
+  std::vector<File>                files;
+  StringS                          tokens;      // distinct runs of word characters
+  std::vector<std::vector<uint32>> postings;    // sorted file indices per token
+};
+using SearchIndexP = std::shared_ptr<const SearchIndex>;
+} // Anon
+
+/// Call `fun (begin, length)` for every run of word characters in `s`.
+template<class F> static void
+for_each_token (const String &s, const F &fun)
+{
+  for (size_t i = 0, j; i < s.size(); i = j)
+    {
+      while (i < s.size() && !is_word_char (s[i]))
+        i++;
+      for (j = i; j < s.size() && is_word_char (s[j]); j++)
+        ;
+      if (j > i)
+        fun (i, j - i);
+    }
+}
+
+static SearchIndexP
+build_search_index (const SampleFolderMap &folders)
+{
+  auto sindex = std::make_shared<SearchIndex>();
+  std::unordered_map<String,uint32> token_ids;
+  String lname;
+  for (const auto &[dir, folder] : folders)
+    {
+      const uint32 dir_id = sindex->dirs.size();
+      sindex->dirs.push_back (dir);
+      for (const SampleEntry &e : folder.entries)
+        if (!e.is_dir)
+          {
+            const uint32 file_id = sindex->files.size();
+            sindex->files.push_back ({ dir_id, e });
+            lname = e.name;
+            ascii_tolower (lname);
+            for_each_token (lname, [&] (size_t i, size_t l) {
+              const auto [it, inserted] = token_ids.emplace (lname.substr (i, l), sindex->tokens.size());
+              if (inserted)
+                {
+                  sindex->tokens.push_back (it->first);
+                  sindex->postings.emplace_back();
+                }
+              std::vector<uint32> &files = sindex->postings[it->second];
+              if (files.empty() || files.back() != file_id)
+                files.push_back (file_id);
+            });
+          }
+    }
+  return sindex;
+}
+
+/// Sorted indices of all files with a finite fuzzy_word_score() for lower case `word`.
+static std::vector<uint32>
+search_candidates (const SearchIndex &sindex, const String &word)
+{
+  // substring matches lie within a single token, unless `word` spans non-word characters,
+  // in that case its longest run of word characters is part of a token
+  size_t run_start = 0, run_length = 0;
+  for_each_token (word, [&] (size_t i, size_t l) {
+    if (l > run_length)
+      run_start = i, run_length = l;
+  });
+  std::vector<uint32> files;
+  if (run_length == 0)
+    {
+      files.resize (sindex.files.size());
+      std::iota (files.begin(), files.end(), 0);
+      return files;
+    }
+  const String run = word.substr (run_start, run_length);
+  for (size_t t = 0; t < sindex.tokens.size(); t++)
+    {
+      const String &token = sindex.tokens[t];
+      if (token.find (run) != String::npos || fuzzy_token_distance (word, token.data(), token.size()) < INFINITY)
+        files.insert (files.end(), sindex.postings[t].begin(), sindex.postings[t].end());
+    }
+  std::sort (files.begin(), files.end());
+  files.erase (std::unique (files.begin(), files.end()), files.end());
+  return files;
+}
+
+/// Best `count` matches for lower case `words`, ordered by fuzzy_score().
+static std::vector<const SearchIndex::File*>
+search_files (const SearchIndex &sindex, const StringS &words, size_t count)
+{
+  std::vector<const SearchIndex::File*> result;
+  return_unless (!words.empty() && count > 0, result);
+  std::vector<uint32> candidates = search_candidates (sindex, words[0]);
+  for (size_t w = 1; w < words.size() && !candidates.empty(); w++)
+    {
+      const std::vector<uint32> more = search_candidates (sindex, words[w]);
+      std::vector<uint32> both;
+      std::set_intersection (candidates.begin(), candidates.end(), more.begin(), more.end(), std::back_inserter (both));
+      candidates.swap (both);
+    }
+  struct Hit { float score; const SearchIndex::File *file; };
+  std::vector<Hit> hits;
+  String lname;
+  for (uint32 id : candidates)
+    {
+      lname = sindex.files[id].entry.name;
+      ascii_tolower (lname);
+      const float score = fuzzy_score (words, lname);
+      if (score < INFINITY)
+        hits.push_back ({ score, &sindex.files[id] });
+    }
+  const size_t n = std::min (count, hits.size());
+  std::partial_sort (hits.begin(), hits.begin() + n, hits.end(), [] (const Hit &a, const Hit &b) {
+    return a.score < b.score || (a.score == b.score && a.file->entry.name < b.file->entry.name);
+  });
+  result.reserve (n);
+  for (size_t i = 0; i < n; i++)
+    result.push_back (hits[i].file);
+  return result;
+}
+
+// == SampleLibraryImpl::Index ==
+struct SampleLibraryImpl::Index {
+  struct Job { String dir; bool recursive = false; };
+  std::mutex                     mutex;
+  std::condition_variable        cond;
+  StringS                        roots;
+  SampleFolderMap                folders;       // indexed by absolute path in file system encoding
+  SearchIndexP                   search_index;  // snapshot of folders, rebuilt after crawls
+  std::unordered_map<int,String> watches;       // inotify watch descriptor -> folder
+  std::unordered_set<String>     visited;       // folders seen during a full crawl
+  std::unordered_set<String>     dirty;         // folders with pending change notifications
+  std::deque<Job>                jobs;
+  uint                           n_busy = 0;
+  uint                           n_workers = 0;
+  uint                           rescan_id = 0;
+  int                            inotify_fd = -1;
+  bool                           loaded = false;
+  bool                           full_crawl = false;
+  bool                           modified = false;
+  bool                           search_stale = false;
+  void
+  start_full_crawl_L()
+  {
+    full_crawl = true;
+    visited.clear();
+    for (const String &root : roots)
+      jobs.push_back ({ root, true });
+    cond.notify_all();
+  }
+  void
+  erase_folder_L (const String &path)
+  {
+    const String prefix = path == "/" ? path : path + "/";
+    for (auto it = folders.begin(); it != folders.end(); )
+      if (it->first == path || string_startswith (it->first, prefix))
+        {
+          if (it->second.wd >= 0)
+            {
+              inotify_rm_watch (inotify_fd, it->second.wd);
+              watches.erase (it->second.wd);
+            }
+          it = folders.erase (it);
+          modified = search_stale = true;
+        }
+      else
+        ++it;
+  }
+  void
+  update_folder_L (const Job &job, bool found, SampleFolder &&folder, int wd)
+  {
+    if (full_crawl)
+      visited.insert (job.dir);
+    if (!found)
+      {
+        erase_folder_L (job.dir);
+        return;
+      }
+    SampleFolder &slot = folders[job.dir];
+    if (slot.wd >= 0 && slot.wd != wd)
+      watches.erase (slot.wd);
+    folder.wd = wd;
+    if (wd >= 0)
+      watches[wd] = job.dir;
+    for (const SampleEntry &e : folder.entries)
+      if (!e.is_dir)
+        break;                                                  // folders come first
+      else if (job.recursive || !folders.count (folder_path (job.dir, e.name)))
+        jobs.push_back ({ folder_path (job.dir, e.name), true });
+    for (const SampleEntry &e : slot.entries)
+      if (e.is_dir && !std::binary_search (folder.entries.begin(), folder.entries.end(), e))
+        erase_folder_L (folder_path (job.dir, e.name));
+    if (slot.mtime != folder.mtime || slot.entries.size() != folder.entries.size() ||
+        !std::equal (slot.entries.begin(), slot.entries.end(), folder.entries.begin(),
+                     [] (const SampleEntry &a, const SampleEntry &b) { return a.same (b); }))
+      modified = search_stale = true;
+    slot = std::move (folder);
+    cond.notify_all();
+  }
+};
+
+// == SampleLibraryImpl ==
+JSONIPC_INHERIT (SampleLibraryImpl, SampleLibrary);
+
+static Preference sample_paths_pref =
+  Preference ({
+      "library.sample_paths", _("Sample Library"), "", "", "",
+      {}, STANDARD, {
+        String ("descr=") + _("Search path of folders to index as sample library, separated by ':'"), } },
+    [] (const CString&,const Value&) {
+      SampleLibraryImpl::instancep()->set_roots (Path::searchpath_split (sample_paths_pref.gets()));
+    });
+
+SampleLibraryImpl::SampleLibraryImpl() :
+  index_ (*new Index())
+{
+  index_.inotify_fd = inotify_init1 (IN_NONBLOCK | IN_CLOEXEC);
+  if (index_.inotify_fd < 0)
+    SDEBUG ("inotify_init1: %s", strerror (errno));
+  else if (main_loop)
+    main_loop->exec_io_handler ([this] (PollFD &pfd) { inotify_io(); return true; }, index_.inotify_fd, "r");
+}
+
+SampleLibraryImplP
+SampleLibraryImpl::instancep ()
+{
+  static SampleLibraryImplP *sptr = [] () {
+    SampleLibraryImplP *sptr = new SampleLibraryImplP (SampleLibraryImpl::make_shared());
+    (*sptr)->set_roots (Path::searchpath_split (sample_paths_pref.gets()));
+    return sptr;
+  } ();
+  return *sptr;
+}
+
+/// Assign the folders to index, starts a full crawl after loading the persistent index.
+void
+SampleLibraryImpl::set_roots (const StringS &fsdirs)
+{
+  Index &ix = index_;
+  StringS roots;
+  for (String dir : fsdirs)
+    {
+      dir = Path::abspath (Path::expand_tilde (dir));
+      while (dir.size() > 1 && dir.back() == '/')
+        dir.pop_back();
+      if (Path::check (dir, "d"))
+        roots.push_back (dir);
+    }
+  {
+    std::lock_guard<std::mutex> locker (ix.mutex);
+    return_unless (roots != ix.roots || !ix.loaded);
+    ix.roots = roots;
+    if (!ix.loaded)
+      {
+        ix.loaded = true;
+        ix.jobs.push_back ({ "", false });                      // empty dir: load index, then crawl
+        ix.cond.notify_all();
+      }
+    else
+      ix.start_full_crawl_L();
+    const uint n_workers = std::clamp (std::thread::hardware_concurrency(), 1u, 4u);
+    for (; ix.n_workers < n_workers; ix.n_workers++)
+      std::thread ([this] () { worker_loop(); }).detach();
+  }
+  emit_notify ("indexing");
+}
+
+void
+SampleLibraryImpl::worker_loop ()
+{
+  this_thread_set_name ("AseSampleIndex");
+  Index &ix = index_;
+  std::unique_lock<std::mutex> lock (ix.mutex);
+  for (;;)
+    {
+      ix.cond.wait (lock, [&ix] () { return !ix.jobs.empty(); });
+      const Index::Job job = ix.jobs.front();
+      ix.jobs.pop_front();
+      ix.n_busy++;
+      if (job.dir.empty())
+        {
+          lock.unlock();
+          String data = Path::stringread (index_filename());
+          SampleFolderMap folders = parse_index (data);
+          data.clear();
+          SearchIndexP sindex = build_search_index (folders);
+          lock.lock();
+          SDEBUG ("loaded %d folders from: %s", folders.size(), index_filename());
+          ix.folders = std::move (folders);
+          ix.search_index = std::move (sindex);
+          ix.start_full_crawl_L();
+        }
+      else
+        {
+          std::vector<SampleEntry> old;
+          auto it = ix.folders.find (job.dir);
+          if (it != ix.folders.end())
+            old = it->second.entries;
+          lock.unlock();
+          SampleFolder folder;
+          const bool found = scan_folder (job.dir, old, folder);
+          const int wd = found && ix.inotify_fd >= 0 ? inotify_add_watch (ix.inotify_fd, job.dir.c_str(), INOTIFY_MASK) : -1;
+          lock.lock();
+          ix.update_folder_L (job, found, std::move (folder), wd);
+        }
+      ix.n_busy--;
+      if (ix.jobs.empty() && ix.n_busy == 0)
+        crawl_done_L (lock);
+    }
+}
+
+void
+SampleLibraryImpl::crawl_done_L (std::unique_lock<std::mutex> &lock)
+{
+  Index &ix = index_;
+  if (ix.full_crawl)
+    {
+      StringS stale;
+      for (const auto &it : ix.folders)
+        if (!ix.visited.count (it.first))
+          stale.push_back (it.first);
+      for (const String &path : stale)
+        ix.erase_folder_L (path);
+      ix.full_crawl = false;
+      ix.visited.clear();
+    }
+  if (ix.search_stale)
+    {
+      ix.search_stale = false;
+      const SampleFolderMap folders = ix.folders;
+      ix.n_busy++;                                              // keep indexing() true while building
+      lock.unlock();
+      SearchIndexP sindex = build_search_index (folders);
+      lock.lock();
+      ix.n_busy--;
+      ix.search_index.swap (sindex);
+    }
+  if (ix.modified)
+    {
+      ix.modified = false;
+      const String data = serialize_index (ix.folders);
+      ix.n_busy++;                                              // keep indexing() true while saving
+      lock.unlock();
+      const String filename = index_filename(), tmpname = filename + ".tmp";
+      if (!Path::stringwrite (tmpname, data, true) || !Path::rename (tmpname, filename))
+        warning ("%s: failed to write sample index: %s", filename, strerror (errno));
+      lock.lock();
+      ix.n_busy--;
+      if (!ix.jobs.empty() || ix.n_busy)
+        return;                                                 // new jobs arrived meanwhile
+    }
+  if (main_loop)
+    main_loop->exec_callback ([] () { SampleLibraryImpl::instancep()->emit_notify ("indexing"); });
+}
+
+void
+SampleLibraryImpl::inotify_io ()
+{
+  Index &ix = index_;
+  alignas (struct inotify_event) char buffer[16384];
+  bool overflow = false;
+  std::lock_guard<std::mutex> locker (ix.mutex);
+  ssize_t n;
+  while ((n = read (ix.inotify_fd, buffer, sizeof (buffer))) > 0)
+    for (const char *p = buffer; p < buffer + n; )
+      {
+        const struct inotify_event *ev = (const struct inotify_event*) p;
+        p += sizeof (struct inotify_event) + ev->len;
+        if (ev->mask & IN_Q_OVERFLOW)
+          overflow = true;
+        auto it = ix.watches.find (ev->wd);
+        if (it == ix.watches.end())
+          continue;
+        if (ev->mask & IN_IGNORED)                              // folder vanished, parent gets rescanned
+          {
+            auto fit = ix.folders.find (it->second);
+            if (fit != ix.folders.end())
+              fit->second.wd = -1;
+            ix.watches.erase (it);
+            continue;
+          }
+        ix.dirty.insert (it->second);
+      }
+  if (overflow)                                                 // lost events, compare everything
+    {
+      SDEBUG ("inotify queue overflow");
+      ix.dirty.clear();
+      ix.start_full_crawl_L();
+      main_loop->exec_callback ([this] () { emit_notify ("indexing"); });
+    }
+  else if (!ix.dirty.empty())
+    main_loop->exec_once (RESCAN_DELAY_MS, &ix.rescan_id, [this] () { rescan_dirty(); });
+}
+
+void
+SampleLibraryImpl::rescan_dirty ()
+{
+  Index &ix = index_;
+  {
+    std::lock_guard<std::mutex> locker (ix.mutex);
+    for (const String &dir : ix.dirty)
+      ix.jobs.push_back ({ dir, false });
+    ix.dirty.clear();
+    ix.cond.notify_all();
+  }
+  emit_notify ("indexing");
+}
+
+bool
+SampleLibraryImpl::indexing ()
+{
+  Index &ix = index_;
+  std::lock_guard<std::mutex> locker (ix.mutex);
+  return !ix.jobs.empty() || ix.n_busy;
+}
+
+static String
+folder_key (const String &utf8dir)
+{
+  String dir = decodefs (utf8dir);
+  while (dir.size() > 1 && dir.back() == '/')
+    dir.pop_back();
+  return dir;
+}
+
+static Resource
+make_resource (const String &dir, const SampleEntry &e)
+{
+  Resource r;
+  r.type = e.is_dir ? ResourceType::FOLDER : ResourceType::FILE;
+  r.label = displayfs (encodefs (e.name));
+  r.uri = encodefs (folder_path (dir, e.name));
+  r.size = e.is_dir ? -1 : e.size;
+  r.mtime = e.mtime;
+  r.n_frames = e.n_frames;
+  r.sample_rate = e.sample_rate;
+  r.n_channels = e.n_channels;
+  return r;
+}
+
+int64
+SampleLibraryImpl::count_entries (const String &utf8dir)
+{
+  Index &ix = index_;
+  const String dir = folder_key (utf8dir);
+  std::lock_guard<std::mutex> locker (ix.mutex);
+  auto it = ix.folders.find (dir);
+  return it != ix.folders.end() ? it->second.entries.size() : 0;
+}
+
+ResourceS
+SampleLibraryImpl::list_entries (const String &utf8dir, int64 offset, int64 count)
+{
+  Index &ix = index_;
+  const String dir = folder_key (utf8dir);
+  ResourceS rs;
+  std::lock_guard<std::mutex> locker (ix.mutex);
+  auto it = ix.folders.find (dir);
+  return_unless (it != ix.folders.end(), rs);
+  const std::vector<SampleEntry> &entries = it->second.entries;
+  const size_t start = std::clamp<int64> (offset, 0, entries.size());
+  const size_t end = count < 0 ? entries.size() : std::min<int64> (entries.size(), start + count);
+  rs.reserve (end - start);
+  for (size_t i = start; i < end; i++)
+    rs.push_back (make_resource (dir, entries[i]));
+  return rs;
+}
+
+ResourceS
+SampleLibraryImpl::search (const String &query, int64 count)
+{
+  Index &ix = index_;
+  ResourceS rs;
+  const StringS words = query_words (query);
+  return_unless (!words.empty() && count > 0, rs);
+  SearchIndexP sindex;
+  {
+    std::lock_guard<std::mutex> locker (ix.mutex);
+    sindex = ix.search_index;                                   // search without blocking the crawl
+  }
+  return_unless (sindex, rs);
+  for (const SearchIndex::File *file : search_files (*sindex, words, count))
+    rs.push_back (make_resource (sindex->dirs[file->dir], file->entry));
+  return rs;
+}
+
+} // Ase
+
+#include "testing.hh"
+
+namespace { // Anon
+using namespace Ase;
+
+TEST_INTEGRITY (samplelib_tests);
+static void
+samplelib_tests()
+{
+  const StringS words = query_words ("Kick  808");
+  TASSERT (words.size() == 2 && words[0] == "kick" && words[1] == "808");
+  TASSERT (fuzzy_word_score ("kick", "kick_808.wav") < fuzzy_word_score ("kick", "big_kick.wav"));
+  TASSERT (fuzzy_word_score ("kick", "big_kick.wav") < 1);
+  TASSERT (fuzzy_word_score ("kikc", "big_kick.wav") == 2);   // transposition
+  TASSERT (fuzzy_word_score ("snare", "big_kick.wav") == INFINITY);
+  TASSERT (fuzzy_score (words, "kick_808.wav") < fuzzy_score (query_words ("kick 909"), "kick_808.wav"));
+  TASSERT (fuzzy_score (query_words ("snare 808"), "kick_808.wav") == INFINITY);
+  TASSERT (is_audio_file ("Loop.FLAC") && !is_audio_file ("notes.txt") && !is_audio_file ("wav"));
+  SampleFolderMap folders;
+  SampleFolder &f = folders["/samples/drums"];
+  f.mtime = 1700000000123;
+  f.entries.push_back ({ "snare 1.wav", 4096, 1700000000999, 1000, 48000, 2, false });
+  f.entries.push_back ({ "loops", 0, 1700000000001, 0, 0, 0, true });
+  std::sort (f.entries.begin(), f.entries.end());
+  TASSERT (f.entries[0].is_dir);
+  folders["/samples"].entries.push_back ({ "drums", 0, 5, 0, 0, 0, true });
+  const SampleFolderMap copy = parse_index (serialize_index (folders));
+  TASSERT (copy.size() == 2);
+  const SampleFolder &g = copy.at ("/samples/drums");
+  TASSERT (g.mtime == f.mtime && g.entries.size() == 2);
+  TASSERT (g.entries[0].same (f.entries[0]) && g.entries[1].same (f.entries[1]));
+  TASSERT (g.entries[1].n_frames == 1000 && g.entries[1].sample_rate == 48000 && g.entries[1].n_channels == 2);
+  TASSERT (parse_index ("garbage\nD\t0\t/x\n").empty());
+  // token index candidates agree with a full scan
+  SampleFolder &h = folders["/samples/more"];
+  for (const char *name : { "Big_Kick.wav", "kick_808.wav", "kick-909.flac", "hihat open.wav", "snare_808 tight.wav", "Kikc.ogg" })
+    h.entries.push_back ({ name, 1, 1, 1, 44100, 1, false });
+  const SearchIndexP sindex = build_search_index (folders);
+  TASSERT (sindex->files.size() == 7);
+  for (const char *query : { "kick", "kikc", "ck_8", "808", "kick 808", "snar tight", "-", "open hat", "zzz" })
+    {
+      const StringS qwords = query_words (query);
+      std::vector<std::pair<float,String>> scan;
+      for (const auto &file : sindex->files)
+        {
+          String lname = file.entry.name;
+          ascii_tolower (lname);
+          if (fuzzy_score (qwords, lname) < INFINITY)
+            scan.push_back ({ fuzzy_score (qwords, lname), file.entry.name });
+        }
+      std::sort (scan.begin(), scan.end());
+      const auto found = search_files (*sindex, qwords, 99);
+      TASSERT (found.size() == scan.size());
+      for (size_t i = 0; i < found.size(); i++)
+        TASSERT (found[i]->entry.name == scan[i].second);
+    }
+  TASSERT (search_files (*sindex, query_words ("kick 808"), 99).front()->entry.name == "kick_808.wav");
+}
+
+} // Anon
@@ -0,0 +1,29 @@
+// This Source Code Form is licensed MPL-2.0: http://mozilla.org/MPL/2.0
+#ifndef __ASE_SAMPLELIB_HH__
+#define __ASE_SAMPLELIB_HH__
+
+#include <ase/object.hh>
+
+namespace Ase {
+
+class SampleLibraryImpl final : public ObjectImpl, public virtual SampleLibrary {
+  struct Index;
+  Index &index_;
+  SampleLibraryImpl ();
+  void      worker_loop   ();
+  void      crawl_done_L  (std::unique_lock<std::mutex> &lock);
+  void      inotify_io    ();
+  void      rescan_dirty  ();
+public:
+  ASE_DEFINE_MAKE_SHARED (SampleLibraryImpl);
+  static SampleLibraryImplP instancep ();
+  void      set_roots     (const StringS &fsdirs);
+  bool      indexing      () override;
+  int64     count_entries (const String &utf8dir) override;
+  ResourceS list_entries  (const String &utf8dir, int64 offset, int64 count) override;
+  ResourceS search        (const String &query, int64 count) override;
+};
+
+} // Ase
+
+#endif // __ASE_SAMPLELIB_HH__
@@ -2,6 +2,7 @@
 #include "server.hh"
 #include "jsonipc/jsonipc.hh"
 #include "crawler.hh"
+#include "samplelib.hh"
 #include "platform.hh"
 #include "properties.hh"
 #include "serialize.hh"
@@ -176,6 +177,12 @@ Server::url_crawler (const String &url)
   return nullptr;
 }
 
+SampleLibraryP
+Server::sample_library ()
+{
+  return SampleLibraryImpl::instancep();
+}
+
 String
 Server::engine_stats ()
 {
@@ -0,0 +1,527 @@
+// This Source Code Form is licensed MPL-2.0: http://mozilla.org/MPL/2.0
+#include "simd.hh"
+#include "platform.hh"
+#include "internal.hh"
+#include <cstring>
+#include <utility>
+
+// Vector arguments only occur in kernels that are inlined into their per instruction set entry points
+#pragma GCC diagnostic ignored "-Wpsabi"
+
+namespace Ase {
+
+// == Vector Types ==
+template<size_t W> struct VectorTypes;
+template<> struct VectorTypes<4> {
+  typedef float  F __attribute__ ((vector_size (16)));
+  typedef int32  I __attribute__ ((vector_size (16)));
+  typedef uint32 U __attribute__ ((vector_size (16)));
+  typedef int16  S __attribute__ ((vector_size (8)));
+};
+template<> struct VectorTypes<8> {
+  typedef float  F __attribute__ ((vector_size (32)));
+  typedef int32  I __attribute__ ((vector_size (32)));
+  typedef uint32 U __attribute__ ((vector_size (32)));
+  typedef int16  S __attribute__ ((vector_size (16)));
+};
+template<> struct VectorTypes<16> {
+  typedef float  F __attribute__ ((vector_size (64)));
+  typedef int32  I __attribute__ ((vector_size (64)));
+  typedef uint32 U __attribute__ ((vector_size (64)));
+  typedef int16  S __attribute__ ((vector_size (32)));
+};
+template<size_t W> using VF = typename VectorTypes<W>::F;
+template<size_t W> using VI = typename VectorTypes<W>::I;
+template<size_t W> using VU = typename VectorTypes<W>::U;
+template<size_t W> using VS = typename VectorTypes<W>::S;
+
+template<class V> static inline V
+vload (const void *p)
+{
+  V v;
+  memcpy (&v, p, sizeof (v));           // unaligned load
+  return v;
+}
+
+template<class V> static inline void
+vstore (void *p, const V &v)
+{
+  memcpy (p, &v, sizeof (v));           // unaligned store
+}
+
+template<size_t W> static inline VF<W>
+vsplat (float f)
+{
+  return VF<W>{} + f;
+}
+
+template<size_t W> static inline VF<W>
+viota ()
+{
+  VF<W> v;
+  for (size_t j = 0; j < W; j++)
+    v[j] = j;
+  return v;
+}
+
+// Interleave lanes OFFSET.. of a and b
+template<size_t W, size_t OFFSET, size_t ...I> static inline VF<W>
+vzip (VF<W> a, VF<W> b, std::index_sequence<I...>)
+{
+  return __builtin_shufflevector (a, b, (OFFSET + I / 2 + (I & 1) * W)...);
+}
+
+// Gather even (ODD=0) or odd (ODD=1) lanes of the concatenation of a and b
+template<size_t W, size_t ODD, size_t ...I> static inline VF<W>
+vunzip (VF<W> a, VF<W> b, std::index_sequence<I...>)
+{
+  return __builtin_shufflevector (a, b, (2 * I + ODD)...);
+}
+
+// == Kernels ==
+// Each kernel is a template over the vector width W, W == 1 is the scalar fallback.
+// The scalar loops also handle the remainder of vectorized loops.
+
+template<size_t W, bool ADDING> static void
+mix_kernel (size_t n, float *dst, const float *src, float gain0, float gain1)
+{
+  const float step = n ? (gain1 - gain0) / n : 0;
+  size_t i = 0;
+  if constexpr (W > 1)
+    {
+      const VF<W> iota = viota<W>();
+      for (; i + W <= n; i += W)
+        {
+          const VF<W> v = (gain0 + step * (iota + float (i))) * vload<VF<W>> (src + i);
+          if constexpr (ADDING)
+            vstore (dst + i, vload<VF<W>> (dst + i) + v);
+          else
+            vstore (dst + i, v);
+        }
+    }
+  for (; i < n; i++)
+    {
+      const float v = (gain0 + step * float (i)) * src[i];
+      dst[i] = ADDING ? dst[i] + v : v;
+    }
+}
+
+template<size_t W, bool ADDING> static void
+interleave2_kernel (size_t n_frames, float *dst, const float *src0, const float *src1)
+{
+  size_t i = 0;
+  if constexpr (W > 1)
+    for (; i + W <= n_frames; i += W)
+      {
+        const VF<W> a = vload<VF<W>> (src0 + i), b = vload<VF<W>> (src1 + i);
+        VF<W> lo = vzip<W, 0> (a, b, std::make_index_sequence<W>());
+        VF<W> hi = vzip<W, W / 2> (a, b, std::make_index_sequence<W>());
+        if constexpr (ADDING)
+          {
+            lo += vload<VF<W>> (dst + 2 * i);
+            hi += vload<VF<W>> (dst + 2 * i + W);
+          }
+        vstore (dst + 2 * i, lo);
+        vstore (dst + 2 * i + W, hi);
+      }
+  for (; i < n_frames; i++)
+    if (ADDING)
+      {
+        dst[2 * i] += src0[i];
+        dst[2 * i + 1] += src1[i];
+      }
+    else
+      {
+        dst[2 * i] = src0[i];
+        dst[2 * i + 1] = src1[i];
+      }
+}
+
+template<size_t W> static void
+deinterleave2_kernel (size_t n_frames, float *dst0, float *dst1, const float *src)
+{
+  size_t i = 0;
+  if constexpr (W > 1)
+    for (; i + W <= n_frames; i += W)
+      {
+        const VF<W> a = vload<VF<W>> (src + 2 * i), b = vload<VF<W>> (src + 2 * i + W);
+        vstore (dst0 + i, vunzip<W, 0> (a, b, std::make_index_sequence<W>()));
+        vstore (dst1 + i, vunzip<W, 1> (a, b, std::make_index_sequence<W>()));
+      }
+  for (; i < n_frames; i++)
+    {
+      dst0[i] = src[2 * i];
+      dst1[i] = src[2 * i + 1];
+    }
+}
+
+SampleDither::SampleDither (uint32 seed)
+{
+  for (uint j = 0; j < LANES; j++)
+    {
+      seed = seed * 1664525 + 1013904223;       // distinct xorshift seeds per lane
+      state[j] = seed | 1;
+    }
+}
+
+// Triangular noise in (-1,+1) from the sum of two 16 bit uniform values, works on scalars and vectors.
+template<class U> static inline auto
+tpdf_noise (U &state)
+{
+  state ^= state << 13;                 // xorshift32
+  state ^= state >> 17;
+  state ^= state << 5;
+  return (state & 0xffff) + (state >> 16);
+}
+
+static constexpr float DITHER_SCALE = 1.0 / 65536, DITHER_OFFSET = 65535.0 / 65536;
+static constexpr float CLIP_MAX = 0.99999990F;
+static_assert (int16 (CLIP_MAX * 32768.F) == 32767);
+
+template<size_t W> static void
+to_int16_kernel (size_t n, int16 *dst, const float *src, SampleDither *dither)
+{
+  size_t i = 0;
+  if constexpr (W > 1)
+    {
+      if (dither)
+        {
+          // round to nearest by truncating positive values, src + noise is clipped to [-32768,32767]
+          const VF<W> vmin = vsplat<W> (-32768), vmax = vsplat<W> (32767);
+          VU<W> state = vload<VU<W>> (dither->state);
+          for (; i + W <= n; i += W)
+            {
+              const VI<W> r = VI<W> (tpdf_noise (state));
+              const VF<W> noise = __builtin_convertvector (r, VF<W>) * DITHER_SCALE - DITHER_OFFSET;
+              VF<W> v = vload<VF<W>> (src + i) * 32768.F + noise;
+              v = v < vmin ? vmin : v;
+              v = v > vmax ? vmax : v;
+              const VI<W> s = __builtin_convertvector (v + 32768.5F, VI<W>) - 32768;
+              vstore (dst + i, __builtin_convertvector (s, VS<W>));
+            }
+          vstore (dither->state, state);
+        }
+      else
+        {
+          const VF<W> vmin = vsplat<W> (-1), vmax = vsplat<W> (CLIP_MAX);
+          for (; i + W <= n; i += W)
+            {
+              VF<W> v = vload<VF<W>> (src + i);
+              v = v < vmin ? vmin : v;
+              v = v > vmax ? vmax : v;
+              const VI<W> s = __builtin_convertvector (v * 32768.F, VI<W>);
+              vstore (dst + i, __builtin_convertvector (s, VS<W>));
+            }
+        }
+    }
+  if (dither)
+    for (; i < n; i++)
+      {
+        const float noise = int32 (tpdf_noise (dither->state[0])) * DITHER_SCALE - DITHER_OFFSET;
+        const float v = std::min (32767.F, std::max (src[i] * 32768.F + noise, -32768.F));
+        dst[i] = int32 (v + 32768.5F) - 32768;
+      }
+  else
+    for (; i < n; i++)
+      dst[i] = std::min (CLIP_MAX, std::max (src[i], -1.0F)) * 32768.F;
+}
+
+template<size_t W> static void
+from_int16_kernel (size_t n, float *dst, const int16 *src)
+{
+  size_t i = 0;
+  if constexpr (W > 1)
+    for (; i + W <= n; i += W)
+      {
+        const VI<W> s = __builtin_convertvector (vload<VS<W>> (src + i), VI<W>);
+        vstore (dst + i, __builtin_convertvector (s, VF<W>) * (1.F / 32768.F));
+      }
+  for (; i < n; i++)
+    dst[i] = src[i] * (1.F / 32768.F);
+}
+
+template<size_t W> static float
+abs_max_kernel (size_t n, const float *src)
+{
+  float amax = 0;
+  size_t i = 0;
+  if constexpr (W > 1)
+    {
+      VF<W> vmax = {};
+      for (; i + W <= n; i += W)
+        {
+          VF<W> v = vload<VF<W>> (src + i);
+          v = v < 0.F ? -v : v;
+          vmax = v > vmax ? v : vmax;
+        }
+      for (size_t j = 0; j < W; j++)
+        amax = std::max (amax, vmax[j]);
+    }
+  for (; i < n; i++)
+    amax = std::max (amax, std::abs (src[i]));
+  return amax;
+}
+
+// One radix-2 pass of a split complex Stockham FFT, `n * stride` is the transform size.
+// Butterflies combine x[q + stride * p] and x[q + stride * (p + n/2)] into y[q + stride * 2p] and
+// y[q + stride * (2p + 1)], twiddled by w[p * stride], vectors run along q or along p for stride 1.
+template<size_t W> static void
+fft_pass_kernel (size_t n, size_t s, const float *xr, const float *xi, float *yr, float *yi, const float *wr, const float *wi)
+{
+  const size_t m = n / 2;
+  size_t p0 = 0;
+  if constexpr (W > 1)
+    {
+      if (s >= W)
+        {
+          for (size_t p = 0; p < m; p++)
+            {
+              const VF<W> vwr = vsplat<W> (wr[p * s]), vwi = vsplat<W> (wi[p * s]);
+              for (size_t q = 0; q < s; q += W)
+                {
+                  const size_t a = q + s * p, b = a + s * m, c = q + s * 2 * p, d = c + s;
+                  const VF<W> ar = vload<VF<W>> (xr + a), ai = vload<VF<W>> (xi + a);
+                  const VF<W> br = vload<VF<W>> (xr + b), bi = vload<VF<W>> (xi + b);
+                  const VF<W> dr = ar - br, di = ai - bi;
+                  vstore (yr + c, ar + br);
+                  vstore (yi + c, ai + bi);
+                  vstore (yr + d, dr * vwr - di * vwi);
+                  vstore (yi + d, dr * vwi + di * vwr);
+                }
+            }
+          return;
+        }
+      if constexpr (W > 4)
+        if (s >= 4)
+          return fft_pass_kernel<W / 2> (n, s, xr, xi, yr, yi, wr, wi);
+      if (s == 1)
+        for (; p0 + W <= m; p0 += W)
+          {
+            const VF<W> ar = vload<VF<W>> (xr + p0), ai = vload<VF<W>> (xi + p0);
+            const VF<W> br = vload<VF<W>> (xr + p0 + m), bi = vload<VF<W>> (xi + p0 + m);
+            const VF<W> vwr = vload<VF<W>> (wr + p0), vwi = vload<VF<W>> (wi + p0);
+            const VF<W> sr = ar + br, si = ai + bi, dr = ar - br, di = ai - bi;
+            const VF<W> tr = dr * vwr - di * vwi, ti = dr * vwi + di * vwr;
+            vstore (yr + 2 * p0, vzip<W, 0> (sr, tr, std::make_index_sequence<W>()));
+            vstore (yr + 2 * p0 + W, vzip<W, W / 2> (sr, tr, std::make_index_sequence<W>()));
+            vstore (yi + 2 * p0, vzip<W, 0> (si, ti, std::make_index_sequence<W>()));
+            vstore (yi + 2 * p0 + W, vzip<W, W / 2> (si, ti, std::make_index_sequence<W>()));
+          }
+    }
+  for (size_t p = p0; p < m; p++)
+    {
+      const float vwr = wr[p * s], vwi = wi[p * s];
+      for (size_t q = 0; q < s; q++)
+        {
+          const size_t a = q + s * p, b = a + s * m, c = q + s * 2 * p, d = c + s;
+          const float ar = xr[a], ai = xi[a], br = xr[b], bi = xi[b];
+          const float dr = ar - br, di = ai - bi;
+          yr[c] = ar + br;
+          yi[c] = ai + bi;
+          yr[d] = dr * vwr - di * vwi;
+          yi[d] = dr * vwi + di * vwr;
+        }
+    }
+}
+
+template<size_t W> static void
+complex_mac_kernel (size_t n, float *accr, float *acci, const float *ar, const float *ai, const float *br, const float *bi)
+{
+  size_t i = 0;
+  if constexpr (W > 1)
+    for (; i + W <= n; i += W)
+      {
+        const VF<W> var = vload<VF<W>> (ar + i), vai = vload<VF<W>> (ai + i);
+        const VF<W> vbr = vload<VF<W>> (br + i), vbi = vload<VF<W>> (bi + i);
+        vstore (accr + i, vload<VF<W>> (accr + i) + (var * vbr - vai * vbi));
+        vstore (acci + i, vload<VF<W>> (acci + i) + (var * vbi + vai * vbr));
+      }
+  for (; i < n; i++)
+    {
+      accr[i] += ar[i] * br[i] - ai[i] * bi[i];
+      acci[i] += ar[i] * bi[i] + ai[i] * br[i];
+    }
+}
+
+// == Kernel Tables ==
+// Entry points for vector width W, the kernels are flattened into functions with target specific code generation.
+#define ASE_SAMPLE_KERNELS(LEVEL, NAME, W, ...)                                                             \
+  static __VA_ARGS__ void k_mix (size_t n, float *d, const float *s, float g0, float g1)                    \
+  { mix_kernel<W, true> (n, d, s, g0, g1); }                                                                \
+  static __VA_ARGS__ void k_scale (size_t n, float *d, const float *s, float g0, float g1)                  \
+  { mix_kernel<W, false> (n, d, s, g0, g1); }                                                               \
+  static __VA_ARGS__ void k_interleave2 (size_t n, float *d, const float *s0, const float *s1)              \
+  { interleave2_kernel<W, false> (n, d, s0, s1); }                                                          \
+  static __VA_ARGS__ void k_interleave2_add (size_t n, float *d, const float *s0, const float *s1)          \
+  { interleave2_kernel<W, true> (n, d, s0, s1); }                                                           \
+  static __VA_ARGS__ void k_deinterleave2 (size_t n, float *d0, float *d1, const float *s)                  \
+  { deinterleave2_kernel<W> (n, d0, d1, s); }                                                               \
+  static __VA_ARGS__ void k_to_int16 (size_t n, int16 *d, const float *s, SampleDither *dither)             \
+  { to_int16_kernel<W> (n, d, s, dither); }                                                                 \
+  static __VA_ARGS__ void k_from_int16 (size_t n, float *d, const int16 *s)                                 \
+  { from_int16_kernel<W> (n, d, s); }                                                                       \
+  static __VA_ARGS__ float k_abs_max (size_t n, const float *s)                                             \
+  { return abs_max_kernel<W> (n, s); }                                                                      \
+  static __VA_ARGS__ void k_fft_pass (size_t n, size_t s, const float *xr, const float *xi,                 \
+                                      float *yr, float *yi, const float *wr, const float *wi)               \
+  { fft_pass_kernel<W> (n, s, xr, xi, yr, yi, wr, wi); }                                                    \
+  static __VA_ARGS__ void k_complex_mac (size_t n, float *dr, float *di, const float *ar, const float *ai,  \
+                                         const float *br, const float *bi)                                  \
+  { complex_mac_kernel<W> (n, dr, di, ar, ai, br, bi); }                                                    \
+  static constexpr SampleKernels kernels = { LEVEL, NAME, k_mix, k_scale, k_interleave2, k_interleave2_add, \
+                                             k_deinterleave2, k_to_int16, k_from_int16, k_abs_max,          \
+                                             k_fft_pass, k_complex_mac };
+
+namespace SimdScalar {
+ASE_SAMPLE_KERNELS (SimdLevel::SCALAR, "SCALAR", 1);
+} // SimdScalar
+
+#if defined __x86_64__ || defined __amd64__
+namespace SimdSse2 {
+ASE_SAMPLE_KERNELS (SimdLevel::SSE2, "SSE2", 4, __attribute__ ((flatten)));
+} // SimdSse2
+namespace SimdAvx2 {
+ASE_SAMPLE_KERNELS (SimdLevel::AVX2, "AVX2", 8, __attribute__ ((flatten, target ("avx2"))));
+} // SimdAvx2
+namespace SimdAvx512 {
+ASE_SAMPLE_KERNELS (SimdLevel::AVX512, "AVX512", 16, __attribute__ ((flatten, target ("avx512f"))));
+} // SimdAvx512
+#endif // __x86_64__
+
+#undef ASE_SAMPLE_KERNELS
+
+const SampleKernels*
+simd_kernels (SimdLevel level)
+{
+  switch (level)
+    {
+    case SimdLevel::SCALAR:     return &SimdScalar::kernels;
+#if defined __x86_64__ || defined __amd64__
+    case SimdLevel::SSE2:       return &SimdSse2::kernels; // part of AMD64
+    case SimdLevel::AVX2:
+      return strstr (cpu_info().c_str(), " AVX2 ") ? &SimdAvx2::kernels : nullptr;
+    case SimdLevel::AVX512:
+      return strstr (cpu_info().c_str(), " AVX512F ") ? &SimdAvx512::kernels : nullptr;
+#endif // __x86_64__
+    default:                    return nullptr;
+    }
+}
+
+const SampleKernels *simd_sample_kernels = &SimdScalar::kernels;
+
+static const SampleKernels*
+simd_select_kernels()
+{
+  for (SimdLevel level : { SimdLevel::AVX512, SimdLevel::AVX2, SimdLevel::SSE2 })
+    if (const SampleKernels *kernels = simd_kernels (level))
+      return kernels;
+  return &SimdScalar::kernels;
+}
+
+[[maybe_unused]] static bool simd_initialized = (simd_sample_kernels = simd_select_kernels(), true);
+
+} // Ase
+
+// == Testing ==
+#include "testing.hh"
+#include "randomhash.hh"
+
+namespace { // Anon
+using namespace Ase;
+
+TEST_INTEGRITY (simd_kernel_tests);
+static void
+simd_kernel_tests()
+{
+  constexpr size_t N = 301;             // covers vector loops and remainders
+  const SampleKernels &scalar = *simd_kernels (SimdLevel::SCALAR);
+  std::vector<float> a (2 * N), b (2 * N), x (2 * N), y (2 * N), u (2 * N), v (2 * N);
+  std::vector<int16> s (N), t (N);
+  for (size_t i = 0; i < 2 * N; i++)
+    {
+      a[i] = random_frange (-1.5, 1.5);
+      b[i] = random_frange (-1, 1);
+    }
+  a[17] = -1.75;                        // absolute maximum
+  a[18] = CLIP_MAX;
+  for (SimdLevel level : { SimdLevel::SCALAR, SimdLevel::SSE2, SimdLevel::AVX2, SimdLevel::AVX512 })
+    {
+      const SampleKernels *kernels = simd_kernels (level);
+      if (!kernels)
+        continue;
+      TASSERT (kernels->level == level);
+      for (size_t n : { N, N - 1, size_t (7), size_t (0) })
+        {
+          // gain ramps
+          x = b;
+          y = b;
+          scalar.mix (n, x.data(), a.data(), 0.25, 1.5);
+          kernels->mix (n, y.data(), a.data(), 0.25, 1.5);
+          for (size_t i = 0; i < n; i++)
+            TCMP (std::abs (x[i] - y[i]), <, 1e-6);
+          scalar.scale (n, x.data(), a.data(), 1, 0);
+          kernels->scale (n, y.data(), a.data(), 1, 0);
+          for (size_t i = 0; i < n; i++)
+            TCMP (std::abs (x[i] - y[i]), <, 1e-6);
+          if (n)
+            TCMP (x[0], ==, a[0]);
+          // interleaving must be exact
+          kernels->interleave2 (n, x.data(), a.data(), b.data());
+          for (size_t i = 0; i < n; i++)
+            TASSERT (x[2 * i] == a[i] && x[2 * i + 1] == b[i]);
+          y = b;
+          kernels->interleave2_add (n, y.data(), a.data(), a.data());
+          for (size_t i = 0; i < n; i++)
+            TASSERT (y[2 * i] == b[2 * i] + a[i] && y[2 * i + 1] == b[2 * i + 1] + a[i]);
+          kernels->deinterleave2 (n, u.data(), v.data(), x.data());
+          for (size_t i = 0; i < n; i++)
+            TASSERT (u[i] == a[i] && v[i] == b[i]);
+          // integer conversion
+          scalar.to_int16 (n, s.data(), a.data(), nullptr);
+          kernels->to_int16 (n, t.data(), a.data(), nullptr);
+          for (size_t i = 0; i < n; i++)
+            TCMP (s[i], ==, t[i]);
+          kernels->from_int16 (n, u.data(), t.data());
+          for (size_t i = 0; i < n; i++)
+            TCMP (u[i], ==, t[i] / 32768.F);
+          SampleDither dither;
+          kernels->to_int16 (n, t.data(), a.data(), &dither);
+          for (size_t i = 0; i < n; i++)
+            TCMP (std::abs (t[i] - std::clamp (a[i] * 32768.F, -32768.F, 32767.F)), <=, 1.5);
+          // peak scan
+          TCMP (kernels->abs_max (n, a.data()), ==, scalar.abs_max (n, a.data()));
+        }
+      TCMP (kernels->abs_max (N, a.data()), ==, 1.75);
+      const float clip[] = { 1.5, -1.5, 0.5, -0.5 };
+      kernels->to_int16 (4, t.data(), clip, nullptr);
+      TASSERT (t[0] == 32767 && t[1] == -32768 && t[2] == 16384 && t[3] == -16384);
+      // fft passes of all strides and split complex multiply-accumulate
+      for (size_t s = 1; s < 256; s *= 2)
+        {
+          scalar.fft_pass (256 / s, s, a.data(), b.data(), x.data(), y.data(), a.data() + 300, b.data() + 300);
+          kernels->fft_pass (256 / s, s, a.data(), b.data(), u.data(), v.data(), a.data() + 300, b.data() + 300);
+          for (size_t i = 0; i < 256; i++)
+            TASSERT (std::abs (x[i] - u[i]) < 1e-5 && std::abs (y[i] - v[i]) < 1e-5);
+        }
+      x = b;
+      y = a;
+      u = b;
+      v = a;
+      scalar.complex_mac (N, x.data(), y.data(), a.data(), b.data(), a.data() + N, b.data() + N);
+      kernels->complex_mac (N, u.data(), v.data(), a.data(), b.data(), a.data() + N, b.data() + N);
+      for (size_t i = 0; i < N; i++)
+        TASSERT (std::abs (x[i] - u[i]) < 1e-5 && std::abs (y[i] - v[i]) < 1e-5);
+    }
+  // dither must decorrelate the quantization error from the signal
+  const float tiny = 0.25 / 32768;      // a quarter LSB vanishes without dither
+  std::vector<float> dc (4096, tiny);
+  std::vector<int16> q (dc.size());
+  SampleDither dither;
+  float_to_int16 (q.size(), q.data(), dc.data(), &dither);
+  double sum = 0;
+  for (int16 i : q)
+    sum += i;
+  TCMP (std::abs (sum / q.size() - 0.25), <, 0.05);
+}
+
+} // Anon
@@ -0,0 +1,104 @@
+// This Source Code Form is licensed MPL-2.0: http://mozilla.org/MPL/2.0
+#ifndef __ASE_SIMD_HH__
+#define __ASE_SIMD_HH__
+
+#include <ase/cxxaux.hh>
+
+namespace Ase {
+
+/// Instruction set levels of the SampleKernels, in ascending order.
+enum class SimdLevel { SCALAR, SSE2, AVX2, AVX512 };
+
+/// State of the TPDF noise generator used to dither float to integer sample conversions.
+struct SampleDither {
+  static constexpr uint LANES = 16;
+  alignas (64) uint32 state[LANES];
+  explicit SampleDither (uint32 seed = 2463534242);
+};
+
+/// Table of sample processing kernels compiled for one instruction set, see simd_kernels().
+struct SampleKernels {
+  SimdLevel   level;
+  const char *name;
+  void  (*mix)             (size_t n, float *dst, const float *src, float gain0, float gain1);
+  void  (*scale)           (size_t n, float *dst, const float *src, float gain0, float gain1);
+  void  (*interleave2)     (size_t n_frames, float *dst, const float *src0, const float *src1);
+  void  (*interleave2_add) (size_t n_frames, float *dst, const float *src0, const float *src1);
+  void  (*deinterleave2)   (size_t n_frames, float *dst0, float *dst1, const float *src);
+  void  (*to_int16)        (size_t n, int16 *dst, const float *src, SampleDither *dither);
+  void  (*from_int16)      (size_t n, float *dst, const int16 *src);
+  float (*abs_max)         (size_t n, const float *src);
+  void  (*fft_pass)        (size_t n, size_t stride, const float *xre, const float *xim, float *yre, float *yim,
+                            const float *wre, const float *wim);
+  void  (*complex_mac)     (size_t n, float *accre, float *accim, const float *are, const float *aim,
+                            const float *bre, const float *bim);
+};
+
+/// Kernels for the widest instruction set supported by the CPU, selected at startup.
+extern const SampleKernels *simd_sample_kernels;
+
+/// Retrieve the kernels compiled for `level`, returns nullptr if the CPU lacks support.
+const SampleKernels* simd_kernels (SimdLevel level);
+
+/// Mix `src` into `dst`, the gain ramps linearly from `gain0` towards `gain1` across `n` values.
+inline void
+mix_gain (size_t n, float *dst, const float *src, float gain0, float gain1)
+{
+  simd_sample_kernels->mix (n, dst, src, gain0, gain1);
+}
+
+/// Assign `src` to `dst`, the gain ramps linearly from `gain0` towards `gain1` across `n` values.
+inline void
+scale_gain (size_t n, float *dst, const float *src, float gain0, float gain1)
+{
+  simd_sample_kernels->scale (n, dst, src, gain0, gain1);
+}
+
+/// Interleave two channels into `n_frames` stereo frames, adds to the contents of `dst` if `adding`.
+inline void
+interleave_stereo (size_t n_frames, float *dst, const float *left, const float *right, bool adding)
+{
+  if (adding)
+    simd_sample_kernels->interleave2_add (n_frames, dst, left, right);
+  else
+    simd_sample_kernels->interleave2 (n_frames, dst, left, right);
+}
+
+/// Split `n_frames` stereo frames into two channels.
+inline void
+deinterleave_stereo (size_t n_frames, float *left, float *right, const float *src)
+{
+  simd_sample_kernels->deinterleave2 (n_frames, left, right, src);
+}
+
+/// Convert float samples to 16 bit with clipping, applies TPDF dither if `dither` is given.
+inline void
+float_to_int16 (size_t n, int16 *dst, const float *src, SampleDither *dither = nullptr)
+{
+  simd_sample_kernels->to_int16 (n, dst, src, dither);
+}
+
+/// Convert 16 bit samples to float.
+inline void
+int16_to_float (size_t n, float *dst, const int16 *src)
+{
+  simd_sample_kernels->from_int16 (n, dst, src);
+}
+
+/// Find the maximum absolute value in a block of floats.
+inline float
+abs_max (size_t n, const float *src)
+{
+  return simd_sample_kernels->abs_max (n, src);
+}
+
+/// Accumulate the products of `n` split complex values, `acc += a * b`.
+inline void
+complex_mac (size_t n, float *accre, float *accim, const float *are, const float *aim, const float *bre, const float *bim)
+{
+  simd_sample_kernels->complex_mac (n, accre, accim, are, aim, bre, bim);
+}
+
+} // Ase
+
+#endif // __ASE_SIMD_HH__
@@ -3,8 +3,24 @@
 #include "../unicode.hh"
 #include "../memory.hh"
 #include "../loft.hh"
+#include "../regex.hh"
+#include "../audioclip.hh"
+#include "../wave.hh"
+#include "../path.hh"
+#include "../platform.hh"
+#include "../transport.hh"
+#include "../monitor.hh"
+#include "../resampler.hh"
+#include "../simd.hh"
+#include "../midievent.hh"
+#include "../convolver.hh"
+#include "devices/blepsynth/bleposc.hh"
+#include "devices/blepsynth/wavetableosc.hh"
+#include "../randomhash.hh"
 #include "../internal.hh"
 #include <cmath>
+#include <thread>
+#include <regex>
 
 #include <glib.h>
 
@@ -157,6 +173,362 @@ utf8_strlen_bench_ascii()
   utf8_strlen_bench (big, "(ascii)");
 }
 
+// == CString Tests ==
+TEST_BENCHMARK (cstring_lookup_bench);
+static void
+cstring_lookup_bench()
+{
+  using Ase::CString;
+  constexpr size_t N_STRINGS = 1024, N_LOOKUPS = 65536;
+  Ase::CStringS cstrings;
+  for (size_t i = 0; i < N_STRINGS; i++)
+    cstrings.push_back (Ase::string_format ("cstring_lookup_bench-%u", i));
+  const size_t n_threads = std::max (2u, std::min (8u, std::thread::hardware_concurrency()));
+  auto lookup_loop = [&] () {
+    size_t accu = 0;
+    for (size_t j = 0; j < N_LOOKUPS; j++)
+      {
+        const CString &a = cstrings[j % N_STRINGS], &b = cstrings[(j * 7) % N_STRINGS];
+        accu += a.size() + (a <=> b == 0) + a.c_str()[0];
+      }
+    TASSERT (accu > N_LOOKUPS);
+  };
+  auto loop_mt = [&] () {
+    std::vector<std::thread> threads;
+    for (size_t t = 0; t < n_threads; t++)
+      threads.push_back (std::thread (lookup_loop));
+    for (auto &thread : threads)
+      thread.join();
+  };
+  Ase::Test::Timer timer (MAXTIME);
+  const double bench_time = timer.benchmark (loop_mt);
+  Ase::printerr ("  BENCH    CString lookups:              %11.1f MLookups/s (%u threads)\n",
+                 n_threads * N_LOOKUPS / bench_time / M, n_threads);
+}
+
+// == Regex Tests ==
+TEST_BENCHMARK (regex_search_bench);
+static void
+regex_search_bench()
+{
+  using namespace Ase;
+  const String input = "Mozilla/5.0 (X11; Linux x86_64) AppleWebKit/537.36 (KHTML, like Gecko) Chrome/120.0 Safari/537.36";
+  const String regex = R"(\bSafari/)";
+  constexpr size_t N_SEARCHES = 64;
+  size_t accu = 0;
+  auto loop_std_regex = [&] () {           // compile per call, like Re::search used to
+    for (size_t j = 0; j < N_SEARCHES; j++)
+      {
+        std::regex rex (regex, std::regex::ECMAScript | std::regex::nosubs);
+        std::smatch m;
+        accu += std::regex_search (input, m, rex);
+      }
+  };
+  auto loop_re_search = [&] () {
+    for (size_t j = 0; j < N_SEARCHES; j++)
+      accu += Re::search (regex, input) >= 0;
+  };
+  const Re::Pattern pattern (regex);
+  auto loop_re_pattern = [&] () {
+    for (size_t j = 0; j < N_SEARCHES; j++)
+      accu += pattern.search (input) >= 0;
+  };
+  const Re::Pattern literal ("Safari/");
+  auto loop_re_literal = [&] () {
+    for (size_t j = 0; j < N_SEARCHES; j++)
+      accu += literal.search (input) >= 0;
+  };
+  Test::Timer timer (MAXTIME);
+  double bench_time = timer.benchmark (loop_std_regex);
+  printerr ("  BENCH    std::regex compile+search:    %11.1f KSearches/s\n", N_SEARCHES / bench_time / 1000);
+  bench_time = timer.benchmark (loop_re_search);
+  printerr ("  BENCH    Re::search (cached):          %11.1f KSearches/s\n", N_SEARCHES / bench_time / 1000);
+  bench_time = timer.benchmark (loop_re_pattern);
+  printerr ("  BENCH    Re::Pattern::search:          %11.1f KSearches/s\n", N_SEARCHES / bench_time / 1000);
+  bench_time = timer.benchmark (loop_re_literal);
+  printerr ("  BENCH    Re::Pattern::search (literal):%11.1f KSearches/s\n", N_SEARCHES / bench_time / 1000);
+  TASSERT (accu > 0);
+}
+
+// == AudioClipStream Tests ==
+TEST_BENCHMARK (audioclip_stream_bench);
+static void
+audioclip_stream_bench()
+{
+  using namespace Ase;
+  constexpr uint N_FILES = 8, N_STREAMS = 64, N_SECONDS = 20, RATE = 48000, B = 256;
+  const String dir = Path::check ("/dev/shm", "dw") ? "/dev/shm" : "/tmp";
+  StringS files;
+  std::vector<float> frames (2 * RATE);
+  for (uint i = 0; i < N_FILES; i++)
+    {
+      const bool flac = i & 1;
+      files.push_back (Path::join (dir, string_format ("audioclip_stream_bench-%u-%u.%s", getpid(), i, flac ? "flac" : "wav")));
+      WaveWriterP writer = flac ? wave_writer_create_flac (RATE, 2, files.back(), 0664, 0) : wave_writer_create_wav (RATE, 2, files.back());
+      TASSERT (writer);
+      for (uint s = 0; s < N_SECONDS; s++)
+        {
+          for (uint j = 0; j < RATE; j++)
+            frames[2 * j] = frames[2 * j + 1] = 0.5 * std::sin ((s * RATE + j) * (i + 1) * 0.001);
+          TASSERT (writer->write (frames.data(), RATE));
+        }
+      TASSERT (writer->close());
+    }
+  std::vector<AudioClipStreamP> streams;
+  for (uint i = 0; i < N_STREAMS; i++)
+    {
+      streams.push_back (AudioClipStream::create());
+      streams.back()->load (CString::temp_quark_impl (CString (files[i % N_FILES])));
+    }
+  for (auto &stream : streams)
+    while (!stream->ready())
+      usleep (1000);
+  float left[B], right[B];
+  uint64 stalls = 0;
+  const uint64 start = timestamp_benchmark();
+  for (int64 f = 0; f < N_SECONDS * RATE; f += B)
+    for (auto &stream : streams)
+      while (stream->render (f, B, left, right) < B)
+        {
+          stalls++;
+          std::this_thread::yield();
+        }
+  const double secs = (timestamp_benchmark() - start) * 0.000000001;
+  printerr ("  BENCH    AudioClipStream x%u:          %11.1f x realtime (%u stalls)\n",
+            N_STREAMS, N_SECONDS / secs, stalls);
+  for (auto &stream : streams)
+    stream->close();
+  for (const auto &file : files)
+    unlink (file.c_str());
+}
+
+// == TempoMap Tests ==
+TEST_BENCHMARK (tempo_map_bench);
+static void
+tempo_map_bench()
+{
+  using namespace Ase;
+  constexpr uint N_CHANGES = 256, N_BLOCKS = 4096, N_RANDOM = 65536;
+  TempoMap tmap (48000, 120);
+  for (uint i = 1; i <= N_CHANGES; i++)
+    tmap.set_change (i * TRANSPORT_PPQN, 60 + (i * 37) % 180);
+  const int64 last_sample = tmap[tmap.size() - 1].sample;
+  int64 accu = 0;
+  auto loop_cursor = [&] () {   // per block advancing and in-block conversions, like the engine
+    size_t cursor = 0;
+    double tick = 0;
+    for (uint b = 0; b < N_BLOCKS; b++)
+      {
+        const int64 begin = tmap.sample_from_tick (tick, cursor);
+        tick = tmap.tick_after (tick, last_sample / N_BLOCKS, &cursor);
+        accu += tmap.sample_from_tick (tick, cursor) - begin;
+      }
+  };
+  std::vector<int64> samples (N_RANDOM);
+  for (uint i = 0; i < N_RANDOM; i++)
+    samples[i] = random_irange (0, last_sample);
+  auto loop_random = [&] () {   // O(log n) lookups without hint
+    for (uint i = 0; i < N_RANDOM; i++)
+      accu += tmap.sample_from_tick (tmap.sample_to_tick (samples[i]));
+  };
+  Test::Timer timer (MAXTIME);
+  double bench_time = timer.benchmark (loop_cursor);
+  printerr ("  BENCH    TempoMap cursor blocks:       %11.1f MConversions/s\n", 3 * N_BLOCKS / bench_time / M);
+  bench_time = timer.benchmark (loop_random);
+  printerr ("  BENCH    TempoMap random lookups:      %11.1f MConversions/s (%u changes)\n", 2 * N_RANDOM / bench_time / M, N_CHANGES);
+  TASSERT (accu != 0);
+}
+
+// == MonitorAnalyzer Tests ==
+TEST_BENCHMARK (monitor_analyzer_bench);
+static void
+monitor_analyzer_bench()
+{
+  using namespace Ase;
+  constexpr uint N_MONITORS = 128, RATE = 48000, B = 256;
+  std::vector<MonitorAnalyzer::Telemetry> telemetry (N_MONITORS);
+  std::vector<std::unique_ptr<MonitorAnalyzer>> analyzers;
+  const ProbeFeatures pf = { .probe_range = true, .probe_energy = true, .probe_samples = false, .probe_fft = true };
+  for (uint i = 0; i < N_MONITORS; i++)
+    {
+      analyzers.emplace_back (std::make_unique<MonitorAnalyzer> (RATE, &telemetry[i]));
+      analyzers.back()->features (pf);
+    }
+  float block[B];
+  for (uint i = 0; i < B; i++)
+    block[i] = 0.5 * std::sin (i * 0.1);
+  auto loop_second = [&] () {
+    for (uint f = 0; f < RATE; f += B)
+      for (auto &analyzer : analyzers)
+        analyzer->analyze (B, block);
+  };
+  Test::Timer timer (MAXTIME);
+  const double bench_time = timer.benchmark (loop_second);
+  printerr ("  BENCH    MonitorAnalyzer x%u:          %11.1f x realtime\n", N_MONITORS, 1.0 / bench_time);
+  TASSERT (telemetry[0].frame_counter > 0);
+}
+
+// == PolyphaseResampler Tests ==
+TEST_BENCHMARK (polyphase_resampler_bench);
+static void
+polyphase_resampler_bench()
+{
+  using namespace Ase;
+  constexpr uint RATE = 48000, BLOCK = 256, CHANNELS = 2;
+  const char *const names[] = { "low", "medium", "high" };
+  std::vector<float> input (BLOCK * CHANNELS), output (BLOCK * CHANNELS * 2);
+  for (uint i = 0; i < BLOCK; i++)
+    input[i * 2] = input[i * 2 + 1] = std::sin (i * 0.1);
+  for (uint q = PolyphaseResampler::LOW; q <= PolyphaseResampler::HIGH; q++)
+    {
+      PolyphaseResampler resampler;
+      TASSERT (resampler.setup (RATE, 44100, CHANNELS, PolyphaseResampler::Quality (q)));
+      size_t accu = 0;
+      auto loop_second = [&] () {       // one second of engine output, as written to a PCM driver
+        for (uint f = 0; f < RATE; f += BLOCK)
+          accu += resampler.process (BLOCK, input.data(), output.data());
+      };
+      Test::Timer timer (MAXTIME);
+      const double bench_time = timer.benchmark (loop_second);
+      printerr ("  BENCH    Resampler 48k->44.1k %-6s:  %11.1f ns/sample per channel (%.1f%% CPU per channel)\n",
+                names[q], bench_time * 1e9 / RATE / CHANNELS, bench_time * 100 / CHANNELS);
+      TASSERT (accu > 0);
+    }
+}
+
+// == SampleKernels Tests ==
+TEST_BENCHMARK (simd_sample_kernels_bench);
+static void
+simd_sample_kernels_bench()
+{
+  using namespace Ase;
+  constexpr uint N = 256, BLOCKS = 4096; // engine block size
+  std::vector<float> left (N), right (N), frames (2 * N);
+  std::vector<int16> pcm (2 * N);
+  for (uint i = 0; i < N; i++)
+    {
+      left[i] = 0.5 * std::sin (i * 0.1);
+      right[i] = 0.5 * std::cos (i * 0.1);
+    }
+  for (SimdLevel level : { SimdLevel::SCALAR, SimdLevel::SSE2, SimdLevel::AVX2, SimdLevel::AVX512 })
+    {
+      const SampleKernels *kernels = simd_kernels (level);
+      if (!kernels)
+        continue;
+      SampleDither dither;
+      float accu = 0;
+      auto loop_mix = [&] () {
+        for (uint b = 0; b < BLOCKS; b++)
+          kernels->mix (N, left.data(), right.data(), 0.5, -0.5);
+      };
+      auto loop_interleave = [&] () {
+        for (uint b = 0; b < BLOCKS; b++)
+          {
+            kernels->interleave2 (N, frames.data(), left.data(), right.data());
+            kernels->deinterleave2 (N, left.data(), right.data(), frames.data());
+          }
+      };
+      auto loop_int16 = [&] () {
+        for (uint b = 0; b < BLOCKS; b++)
+          {
+            kernels->to_int16 (2 * N, pcm.data(), frames.data(), &dither);
+            kernels->from_int16 (2 * N, frames.data(), pcm.data());
+          }
+      };
+      auto loop_peak = [&] () {
+        for (uint b = 0; b < BLOCKS; b++)
+          accu += kernels->abs_max (2 * N, frames.data());
+      };
+      Test::Timer timer (MAXTIME);
+      double bench_time = timer.benchmark (loop_mix);
+      printerr ("  BENCH    %-6s mix with gain ramp:    %11.1f MSamples/s\n", kernels->name, N * BLOCKS / bench_time / M);
+      bench_time = timer.benchmark (loop_interleave);
+      printerr ("  BENCH    %-6s (de)interleave:        %11.1f MFrames/s\n", kernels->name, 2 * N * BLOCKS / bench_time / M);
+      bench_time = timer.benchmark (loop_int16);
+      printerr ("  BENCH    %-6s int16 dither+convert:  %11.1f MSamples/s\n", kernels->name, 4 * N * BLOCKS / bench_time / M);
+      bench_time = timer.benchmark (loop_peak);
+      printerr ("  BENCH    %-6s peak scan:             %11.1f MSamples/s\n", kernels->name, 2 * N * BLOCKS / bench_time / M);
+      TASSERT (accu >= 0);
+    }
+}
+
+// == PartitionedConvolver Tests ==
+TEST_BENCHMARK (partitioned_convolver_bench);
+static void
+partitioned_convolver_bench()
+{
+  using namespace Ase;
+  constexpr uint RATE = 48000, IR_LENGTH = 5 * RATE, BLOCK = 64, FIR_TAPS = IR_LENGTH / 100;
+  std::vector<float> ir0 (IR_LENGTH), ir1 (IR_LENGTH), left (BLOCK), right (BLOCK), history (2 * FIR_TAPS);
+  for (uint i = 0; i < IR_LENGTH; i++)
+    {
+      const float decay = std::exp (-7.0 * i / IR_LENGTH);
+      ir0[i] = decay * random_frange (-1, 1);
+      ir1[i] = decay * random_frange (-1, 1);
+    }
+  const float *irs[2] = { ir0.data(), ir1.data() };
+  PartitionedConvolver convolver (2, irs, IR_LENGTH, true);
+  float accu = 0;
+  auto loop_second = [&] () {           // one second of stereo engine blocks
+    for (uint f = 0; f < RATE; f += BLOCK)
+      {
+        for (uint i = 0; i < BLOCK; i++)
+          left[i] = right[i] = std::sin ((f + i) * 0.01);
+        float *channels[2] = { left.data(), right.data() };
+        convolver.process (channels, channels, BLOCK);
+        accu += left[0] + right[0];
+      }
+  };
+  auto loop_direct = [&] () {           // direct FIR with a hundredth of the taps, per second and channel
+    for (uint f = 0, pos = 0; f < RATE; f++, pos = pos + 1 == FIR_TAPS ? 0 : pos + 1)
+      {
+        history[pos] = history[pos + FIR_TAPS] = std::sin (f * 0.01);
+        float sum = 0;
+        for (uint k = 0; k < FIR_TAPS; k++)
+          sum += ir0[k] * history[pos + 1 + k];
+        accu += sum;
+      }
+  };
+  Test::Timer timer (MAXTIME);
+  const double bench_time = timer.benchmark (loop_second);
+  printerr ("  BENCH    Convolver 5s stereo IR 64 frames: %8.2f%% CPU (%u stages)\n",
+            bench_time * 100, convolver.n_stages());
+  const double direct_time = timer.benchmark (loop_direct) * 2 * IR_LENGTH / FIR_TAPS;
+  printerr ("  BENCH    Direct FIR 5s stereo IR:          %8.2f%% CPU (extrapolated, %.0fx partitioned)\n",
+            direct_time * 100, direct_time / bench_time);
+  TASSERT (std::isfinite (accu));
+}
+
+// == MidiEventOutput Tests ==
+TEST_BENCHMARK (midi_event_output_bench);
+static void
+midi_event_output_bench()
+{
+  using namespace Ase;
+  constexpr uint N_EVENTS = 1024, BLOCK = 256, BLOCKS = 1024;
+  MidiEventOutput notes, params;
+  uint64 accu = 0;
+  auto loop_blocks = [&] () {   // produce and merge two event streams per engine block
+    for (uint b = 0; b < BLOCKS; b++)
+      {
+        notes.clear();
+        params.clear();
+        for (uint i = 0; i < N_EVENTS; i++)
+          {
+            notes.append (i * BLOCK / N_EVENTS, make_note_on (0, i & 0x7f, 1));
+            params.append (i * BLOCK / N_EVENTS, make_param_value (1 + (i & 7), i));
+          }
+        MidiEventReader<2> reader ({ notes.range(), params.range() });
+        for (const MidiEvent &event : reader)
+          accu += event.frame;
+      }
+  };
+  Test::Timer timer (MAXTIME);
+  const double bench_time = timer.benchmark (loop_blocks);
+  printerr ("  BENCH    MidiEventOutput append+merge:  %11.1f MEvents/s\n", 2 * N_EVENTS * BLOCKS / bench_time / M);
+  TASSERT (accu > 0 && notes.dropped() == 0);
+}
+
 // == Allocator Tests ==
 namespace { // Anon
 using namespace Ase;
@@ -408,4 +780,181 @@ zbench_aligned_allocator_loft_alloc()
   ase_aligned_allocator_benchloop<AllocatorType::LoftAlloc> (2654435769);
 }
 
+static void
+ase_aligned_allocator_fragmentation_bench (size_t n_extents)
+{
+  // fragment an arena into `n_extents` free extents of varying sizes
+  constexpr const uint32 MAX_UNITS = 8;
+  constexpr const size_t N_OPS = 4096;
+  FastMemory::Arena arena { uint32 ((2 * n_extents + N_OPS) * MAX_UNITS * FastMemory::cache_line_size) };
+  std::vector<FastMemory::Block> blocks;
+  quick_rand32_seed = 2654435769;
+  for (size_t i = 0; i < 2 * n_extents; i++)
+    {
+      const uint32 units = 1 + ((uint64 (quick_rand32()) * MAX_UNITS) >> 32);
+      blocks.push_back (arena.allocate (units * FastMemory::cache_line_size));
+    }
+  for (size_t i = 0; i < blocks.size(); i += 2)
+    arena.release (blocks[i]);
+  // measure best-fit allocation + coalescing release within the fragmented arena
+  FastMemory::Block ops[N_OPS];
+  auto loop_frag = [&] () {
+    for (size_t i = 0; i < N_OPS; i++)
+      {
+        const uint32 units = 1 + ((uint64 (quick_rand32()) * MAX_UNITS) >> 32);
+        ops[i] = arena.allocate (units * FastMemory::cache_line_size);
+      }
+    for (size_t i = 0; i < N_OPS; i++)
+      arena.release (ops[i]);
+  };
+  Ase::Test::Timer timer (0.1);
+  const double bench_frag = timer.benchmark (loop_frag);
+  const double ns_p_a = 1000000000.0 * bench_frag / N_OPS;
+  Ase::printerr ("  BENCH    %-25s %6u free extents, %.1fnsecs/allocation+release\n",
+                 "Ase::FastMemoryArea:", n_extents, ns_p_a);
+  for (size_t i = 1; i < blocks.size(); i += 2)
+    arena.release (blocks[i]);
+}
+
+TEST_BENCHMARK (zbench_aligned_allocator_fragmentation);
+static void
+zbench_aligned_allocator_fragmentation()
+{
+  for (size_t n_extents : { 16, 256, 4096, 65536 })
+    ase_aligned_allocator_fragmentation_bench (n_extents);
+}
+
+template<AllocatorType AT> static void
+ase_aligned_allocator_mt_benchloop (uint32 seed)
+{
+  constexpr const int64 MAX_CHUNK_SIZE = 3 * 1024;
+  constexpr const int64 N_ALLOCS = 2048;
+  constexpr const int64 RESIDENT = N_ALLOCS / 3;
+  const size_t n_threads = std::max (2u, std::min (8u, std::thread::hardware_concurrency()));
+  // each thread churns through its own blocks, but frees the resident blocks of its neighbour
+  std::vector<std::vector<FastMemory::Block>> thread_blocks (n_threads);
+  std::atomic<uint> ready = 0;
+  auto thread_loop = [&] (uint t) {
+    std::vector<FastMemory::Block> &blocks = thread_blocks[t];
+    uint32 rand32 = seed + t;
+    double accu = 0;
+    ready++;
+    while (ready < n_threads)
+      std::this_thread::yield();
+    for (size_t i = 0; i < N_ALLOCS; i++)
+      {
+        rand32 = 1664525 * rand32 + 1013904223;
+        const size_t length = MAX (8, (uint64 (rand32) * MAX_CHUNK_SIZE) >> 32);
+        blocks.push_back (TestAllocator<AT>::allocate_block (length));
+        accu += *(double*) blocks.back().block_start;
+        if (i > RESIDENT && (i & 1))
+          {
+            FastMemory::Block &rblock = blocks[i - RESIDENT];
+            TestAllocator<AT>::release_block (rblock);
+            rblock = {};
+          }
+      }
+    TASSERT (accu == 0);
+  };
+  auto loop_mt = [&] () {
+    ready = 0;
+    std::vector<std::thread> threads;
+    for (uint t = 0; t < n_threads; t++)
+      threads.push_back (std::thread (thread_loop, t));
+    for (auto &thread : threads)
+      thread.join();
+    // cross-thread release of the remaining blocks
+    for (size_t t = 0; t < n_threads; t++)
+      {
+        std::vector<FastMemory::Block> &blocks = thread_blocks[(t + 1) % n_threads];
+        threads[t] = std::thread ([&blocks] () {
+          for (auto &block : blocks)
+            if (block.block_length)
+              TestAllocator<AT>::release_block (block);
+          blocks.clear();
+        });
+      }
+    for (auto &thread : threads)
+      thread.join();
+  };
+  Ase::Test::Timer timer (0.1);
+  const double bench_mt = timer.benchmark (loop_mt);
+  const size_t n_allocations = n_threads * N_ALLOCS;
+  const double ns_p_a = 1000000000.0 * bench_mt / n_allocations;
+  Ase::printerr ("  BENCH    %-25s %u allocations in %.1f msecs, %.1fnsecs/allocation (%u threads)\n",
+                 TestAllocator<AT>::name() + ":", n_allocations, 1000 * bench_mt, ns_p_a, n_threads);
+}
+
+TEST_BENCHMARK (zbench_aligned_allocator_mt_memalign);
+static void
+zbench_aligned_allocator_mt_memalign()
+{
+  ensure_block_allocator_initialization();
+  ase_aligned_allocator_mt_benchloop<AllocatorType::PosixMemalign> (2654435769);
+}
+
+TEST_BENCHMARK (zbench_aligned_allocator_mt_calloc);
+static void
+zbench_aligned_allocator_mt_calloc()
+{
+  ensure_block_allocator_initialization();
+  ase_aligned_allocator_mt_benchloop<AllocatorType::LibcCalloc> (2654435769);
+}
+
+TEST_BENCHMARK (zbench_aligned_allocator_mt_fast_mem_alloc);
+static void
+zbench_aligned_allocator_mt_fast_mem_alloc()
+{
+  ensure_block_allocator_initialization();
+  ase_aligned_allocator_mt_benchloop<AllocatorType::FastMemAlloc> (2654435769);
+}
+
+TEST_BENCHMARK (zbench_aligned_allocator_mt_loft_alloc);
+static void
+zbench_aligned_allocator_mt_loft_alloc()
+{
+  ensure_block_allocator_initialization();
+  ase_aligned_allocator_mt_benchloop<AllocatorType::LoftAlloc> (2654435769);
+}
+
 } // Anon
+
+TEST_BENCHMARK (blepsynth_unison_bench);
+static void
+blepsynth_unison_bench()
+{
+  using namespace Ase;
+  constexpr uint RATE = 48000, BLOCK = 128, N_VOICES = 32, UNISON = 16;
+  std::vector<BlepUtils::OscImpl> bleps (N_VOICES);
+  std::vector<BlepUtils::WavetableOsc> wavetables (N_VOICES);
+  for (uint v = 0; v < N_VOICES; v++)   // pad with detuned saw/pulse morph over 4 octaves
+    {
+      const double freq = 55 * exp2 (v / 8.0);
+      bleps[v].set_rate (RATE);
+      bleps[v].frequency_base = freq;
+      bleps[v].shape_base = -0.3;
+      bleps[v].pulse_width_base = 0.3;
+      bleps[v].set_unison (UNISON, 12, 0.8);
+      wavetables[v].set_rate (RATE);
+      wavetables[v].frequency_base = freq;
+      wavetables[v].shape_base = -0.3;
+      wavetables[v].pulse_width_base = 0.3;
+      wavetables[v].set_unison (UNISON, 12, 0.8);
+    }
+  float left[BLOCK], right[BLOCK], accu = 0;
+  auto render_second = [&] (auto &oscs) {
+    for (uint f = 0; f < RATE; f += BLOCK)
+      for (auto &osc : oscs)
+        {
+          osc.process_sample_stereo (left, right, BLOCK);
+          accu += left[0] + right[0];
+        }
+  };
+  Test::Timer timer (MAXTIME);
+  const double blep_time = timer.benchmark ([&] () { render_second (bleps); });
+  printerr ("  BENCH    BlepSynth BLEP 32 voices x16 unison:      %8.2f%% CPU\n", blep_time * 100);
+  const double wavetable_time = timer.benchmark ([&] () { render_second (wavetables); });
+  printerr ("  BENCH    BlepSynth Wavetable 32 voices x16 unison: %8.2f%% CPU (%.1fx faster)\n",
+            wavetable_time * 100, blep_time / wavetable_time);
+  TASSERT (std::isfinite (accu));
+}
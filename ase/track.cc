@@ -1,13 +1,17 @@
 // This Source Code Form is licensed MPL-2.0: http://mozilla.org/MPL/2.0
 #include "track.hh"
 #include "combo.hh"
+#include "audioclip.hh"
 #include "project.hh"
 #include "nativedevice.hh"
 #include "clip.hh"
+#include "monitor.hh"
 #include "midilib.hh"
 #include "server.hh"
 #include "main.hh"
 #include "serialize.hh"
+#include "randomhash.hh"
+#include "path.hh"
 #include "jsonipc/jsonipc.hh"
 #include "internal.hh"
 
@@ -23,6 +27,7 @@ TrackImpl::TrackImpl (ProjectImpl &project, bool masterflag)
 
 TrackImpl::~TrackImpl()
 {
+  main_loop->clear_source (&freeze_timer_);
   assert_return (_parent() == nullptr);
 }
 
@@ -77,6 +82,33 @@ TrackImpl::serialize (WritNode &xs)
     }
   // device chain
   xs["chain"] & *dynamic_cast<Serializable*> (&*chain_); // always exists
+  // output fader, aux sends are stored by the project
+  if (xs.in_save() && volume_ != 1.0)
+    xs["volume"] & volume_;
+  if (xs.in_load())
+    {
+      double gain = 1.0;
+      xs["volume"] & gain;
+      volume (gain);
+    }
+  // live MIDI input, tracks without are rendered ahead
+  if (xs.in_save() && !live_input_)
+    xs["live_input"] & live_input_;
+  if (xs.in_load())
+    {
+      bool onoff = true;
+      xs["live_input"] & onoff;
+      live_input (onoff);
+    }
+  // freezing, the recording is redone after loading
+  if (xs.in_save() && frozen_)
+    xs["frozen"] & frozen_;
+  if (xs.in_load())
+    {
+      bool onoff = false;
+      xs["frozen"] & onoff;
+      frozen (onoff);
+    }
 }
 
 void
@@ -94,15 +126,28 @@ TrackImpl::_set_parent (GadgetImpl *parent)
       midi_prod_->_set_parent (this);
       AudioProcessorP esource = midi_prod_->_audio_processor()->engine().get_event_source();
       midi_prod_->_set_event_source (esource);
-      midi_prod_->_audio_processor()->connect_event_input (*esource);
+      if (live_input_)
+        midi_prod_->_audio_processor()->connect_event_input (*esource);
       assert_return (!chain_);
       chain_ = create_processor_device (*engine, "Ase::AudioChain", true);
       assert_return (chain_);
       chain_->_set_parent (this);
       chain_->_set_event_source (midi_prod_->_audio_processor());
+      onchainstate_ = chain_->on_event ("state", [this] (const Event &event) {
+        freeze_update();
+      });
+      if (volume_ != 1.0)
+        {
+          AudioChainP chain = std::dynamic_pointer_cast<AudioChain> (chain_->_audio_processor());
+          chain->engine().async_jobs += [chain, gain = volume_] () { chain->set_volume (gain); };
+        }
+      update_anticipation();
     }
   else if (chain_)
     {
+      freeze_stop();
+      clear_sends();
+      onchainstate_.reset();
       midi_prod_->_disconnect_remove();
       chain_->_disconnect_remove();
       chain_->_set_parent (nullptr);
@@ -166,6 +211,7 @@ TrackImpl::midi_channel (int32 midichannel) // TODO: implement
   return_unless (midichannel != midi_channel_);
   midi_channel_ = midichannel;
   emit_notify ("midi_channel");
+  freeze_invalidate();
 }
 
 static constexpr const uint MAX_LAUNCHER_CLIPS = 8;
@@ -224,6 +270,7 @@ TrackImpl::update_clips ()
     // swap MidiFeedP copy to defer dtor to user thread
   };
   midi_iface->engine().async_jobs += job;
+  freeze_invalidate();
 }
 
 DeviceP
@@ -232,10 +279,20 @@ TrackImpl::access_device ()
   return chain_;
 }
 
+/// List the devices contained in the track chain.
+DeviceS
+TrackImpl::list_chain_devices () const
+{
+  NativeDeviceImpl *chain = dynamic_cast<NativeDeviceImpl*> (chain_.get());
+  return chain ? chain->list_devices() : DeviceS{};
+}
+
 MonitorP
-TrackImpl::create_monitor (int32 ochannel) // TODO: implement
+TrackImpl::create_monitor (int32 ochannel)
 {
-  return nullptr;
+  return_unless (chain_ && ochannel >= 0, nullptr);
+  return_unless (uint (ochannel) < chain_->_audio_processor()->n_ochannels (OBusId (1)), nullptr);
+  return MonitorImpl::make_shared (chain_, ochannel);
 }
 
 TelemetryFieldS
@@ -273,6 +330,317 @@ TrackImpl::_set_event_source (AudioProcessorP esource)
   // TODO: _set_event_source
 }
 
+// == Fader and aux sends ==
+void
+TrackImpl::volume (double gain)
+{
+  gain = CLAMP (gain, 0.0, 4.0);
+  return_unless (gain != volume_);
+  volume_ = gain;
+  if (chain_)
+    {
+      AudioChainP chain = std::dynamic_pointer_cast<AudioChain> (chain_->_audio_processor());
+      auto job = [chain, gain] () {
+        chain->set_volume (gain);
+      };
+      chain->engine().async_jobs += job;
+    }
+  emit_notify ("volume");
+}
+
+/// Route live MIDI input through the track, tracks without live input can be rendered ahead of time.
+void
+TrackImpl::live_input (bool onoff)
+{
+  return_unless (onoff != live_input_);
+  live_input_ = onoff;
+  if (midi_prod_)
+    {
+      AudioProcessorP proc = midi_prod_->_audio_processor();
+      AudioProcessorP esource = proc->engine().get_event_source();
+      auto job = [proc, esource, onoff] () {
+        if (onoff)
+          proc->connect_event_input (*esource);
+        else
+          proc->disconnect_event_input();
+      };
+      proc->engine().async_jobs += job;
+    }
+  update_anticipation();
+  emit_notify ("live_input");
+}
+
+/// Let the chain render ahead of the PCM output if it depends neither on live input nor on other tracks.
+void
+TrackImpl::update_anticipation ()
+{
+  return_unless (chain_);
+  bool anticipate = !live_input_ && !is_master();
+  for (const DeviceP &device : list_chain_devices())
+    if (device->get_sidechain())
+      anticipate = false;               // sidechains are rendered in lockstep
+  if (ProjectImpl *project_ = project())
+    for (const TrackP &track : project_->all_tracks())
+      if (track.get() != this && track->send_level (shared_ptr_cast<Track> (this)) > 0)
+        anticipate = false;             // buses sum their inputs in lockstep
+  AudioChainP chain = std::dynamic_pointer_cast<AudioChain> (chain_->_audio_processor());
+  if (chain->engine().anticipation_ms() == 0)
+    anticipate = false;                 // opt-in, see "driver.pcm.anticipation"
+  if (anticipate && !anticipation_)
+    anticipation_ = chain->create_anticipation();
+  auto job = [chain, anticipate, anticipation = anticipation_] () {
+    chain->anticipate (anticipate, anticipation);
+  };
+  chain->engine().async_jobs += job;
+}
+
+/// Check if the output of this track reaches `target`, via aux sends, sidechains or other tracks.
+bool
+TrackImpl::feeds (const TrackImpl &target) const
+{
+  for (const AuxSend &send : sends_)
+    if (send.bus.get() == &target || send.bus->feeds (target))
+      return true;
+  ProjectImpl *project_ = project();
+  return_unless (project_, false);
+  for (const TrackP &track : project_->all_tracks())
+    {
+      TrackImpl *other = dynamic_cast<TrackImpl*> (track.get());
+      if (other == this)
+        continue;
+      for (const DeviceP &device : other->list_chain_devices())
+        if (device->get_sidechain().get() == this && (other == &target || other->feeds (target)))
+          return true;
+    }
+  return false;
+}
+
+/// Mix the track output into the input of `bus`, so its devices (e.g. a reverb) are shared by
+/// all sending tracks and rendered once per block. A `level` of 0 removes the send.
+bool
+TrackImpl::set_send (TrackP bus, double level, bool prefader)
+{
+  TrackImplP busp = shared_ptr_cast<TrackImpl> (bus);
+  return_unless (busp && busp.get() != this, false);
+  return_unless (chain_ && busp->chain_ && busp->project() == project(), false);
+  return_unless (!is_master() && !busp->is_master(), false); // all tracks are mixed into the master output
+  level = CLAMP (level, 0.0, 4.0);
+  if (level > 0 && busp->feeds (*this))
+    return false;                       // avoid feedback loops
+  auto it = std::find_if (sends_.begin(), sends_.end(), [&busp] (const AuxSend &s) { return s.bus == busp; });
+  if (it == sends_.end() && level == 0)
+    return true;
+  if (it != sends_.end() && it->level == level && it->prefader == prefader)
+    return true;
+  AudioChainP chain = std::dynamic_pointer_cast<AudioChain> (chain_->_audio_processor());
+  AudioChainP bchain = std::dynamic_pointer_cast<AudioChain> (busp->chain_->_audio_processor());
+  AudioChain::SendDelay *delay = nullptr;
+  AudioChain::AuxSendS *storage = nullptr;
+  if (level == 0)
+    {
+      sends_.erase (it);
+      bchain->release_send_ml();
+    }
+  else if (it == sends_.end())
+    {
+      sends_.push_back ({ busp, level, prefader });
+      delay = AudioChain::create_send_delay(); // latency compensation for the new send
+      storage = bchain->reserve_send_ml();     // grow the bus send list outside the engine thread
+    }
+  else
+    *it = { busp, level, prefader };
+  auto job = [bchain, chain, level, prefader, delay, storage] () {
+    bchain->aux_send (chain, level, prefader, delay, storage);
+  };
+  bchain->engine().async_jobs += job;
+  busp->update_anticipation();
+  busp->freeze_invalidate();
+  emit_notify ("sends");
+  return true;
+}
+
+double
+TrackImpl::send_level (TrackP bus) const
+{
+  for (const AuxSend &send : sends_)
+    if (send.bus == bus)
+      return send.level;
+  return 0;
+}
+
+bool
+TrackImpl::send_prefader (TrackP bus) const
+{
+  for (const AuxSend &send : sends_)
+    if (send.bus == bus)
+      return send.prefader;
+  return false;
+}
+
+/// Remove all aux sends of this track.
+void
+TrackImpl::clear_sends ()
+{
+  return_unless (chain_);
+  AudioChainP chain = std::dynamic_pointer_cast<AudioChain> (chain_->_audio_processor());
+  for (const AuxSend &send : sends_)
+    if (send.bus->chain_)
+      {
+        AudioChainP bchain = std::dynamic_pointer_cast<AudioChain> (send.bus->chain_->_audio_processor());
+        bchain->release_send_ml();
+        auto job = [bchain, chain] () {
+          bchain->aux_send (chain, 0, false);
+        };
+        bchain->engine().async_jobs += job;
+        send.bus->freeze_invalidate();
+      }
+  std::vector<TrackImplP> buses;
+  for (const AuxSend &send : sends_)
+    buses.push_back (send.bus);
+  sends_.clear();
+  for (TrackImplP &bus : buses)
+    bus->update_anticipation();
+}
+
+// == Track freezing ==
+static constexpr uint FREEZE_REARM_MS = 500;    // debounce edits before recording again
+static constexpr uint FREEZE_POLL_MS = 20;
+
+static String
+freeze_dir()
+{
+  return Path::join (Path::cache_home(), "anklang", "freeze");
+}
+
+/// Remove leftover freeze recordings of this process, called at shutdown.
+void
+TrackImpl::freeze_cleanup ()
+{
+  StringS files;
+  Path::glob (Path::join (freeze_dir(), string_format ("track-%u-*.wav", getpid())), files);
+  for (const String &file : files)
+    unlink (file.c_str());
+}
+
+/// Freeze the track, i.e. record the chain output during the next playback from the song beginning
+/// and afterwards play back the recording instead of rendering the devices of the chain.
+void
+TrackImpl::frozen (bool onoff)
+{
+  return_unless (onoff != frozen_);
+  frozen_ = onoff;
+  freeze_stop();
+  if (frozen_)
+    freeze_start();
+  emit_notify ("frozen");
+}
+
+/// Arm the chain for recording into a new cache file.
+void
+TrackImpl::freeze_start ()
+{
+  return_unless (chain_ && !freeze_capture_);
+  AudioChainP chain = std::dynamic_pointer_cast<AudioChain> (chain_->_audio_processor());
+  const String dir = freeze_dir();
+  Path::mkdirs (dir);
+  const String filename = Path::join (dir, string_format ("track-%u-%08x.wav", getpid(), uint32 (random_int64())));
+  freeze_capture_ = AudioClipCapture::create (filename, chain->engine().sample_rate());
+  if (!freeze_capture_)
+    {
+      warning ("%s: failed to create freeze recording", filename);
+      return;
+    }
+  int64 end_tick = 0;                   // the recording must reach past the last clip events
+  for (const ClipImplP &clip : clips_)
+    if (clip && clip->tick_events()->size())
+      end_tick = std::max (end_tick, clip->end_tick());
+  // the job is destroyed in the main thread, along with the recordings it releases
+  auto job = [chain, capture = freeze_capture_, end_tick, released = Mutable<AudioChain::FreezeRelease> ({})] () {
+    chain->freeze_capture (capture, end_tick, released.value);
+  };
+  chain->engine().async_jobs += job;
+}
+
+/// Render the chain devices again and remove the cache file.
+void
+TrackImpl::freeze_stop ()
+{
+  main_loop->clear_source (&freeze_timer_);
+  return_unless (freeze_capture_);
+  if (chain_)
+    {
+      AudioChainP chain = std::dynamic_pointer_cast<AudioChain> (chain_->_audio_processor());
+      auto job = [chain, released = Mutable<AudioChain::FreezeRelease> ({})] () {
+        chain->freeze_release (released.value);
+      };
+      chain->engine().async_jobs += job;
+    }
+  if (freeze_stream_)
+    freeze_stream_->close();
+  freeze_stream_ = nullptr;
+  freeze_capture_->finish();
+  unlink (freeze_capture_->filename().c_str());
+  freeze_capture_ = nullptr;
+}
+
+/// Handle the end of a recording, switches the chain to playback once the file is written.
+void
+TrackImpl::freeze_update ()
+{
+  return_unless (frozen_ && freeze_capture_ && !freeze_stream_ && !freeze_timer_);
+  return_unless (freeze_capture_->completed());
+  freeze_capture_->finish();
+  freeze_timer_ = main_loop->exec_timer ([this] () {
+    if (!freeze_capture_->closed())
+      return true;
+    freeze_timer_ = 0;
+    freeze_play();
+    return false;
+  }, 0, FREEZE_POLL_MS);
+}
+
+void
+TrackImpl::freeze_play ()
+{
+  if (freeze_capture_->failed())
+    {
+      freeze_stop();            // incomplete recording, try again
+      freeze_start();
+      return;
+    }
+  AudioChainP chain = std::dynamic_pointer_cast<AudioChain> (chain_->_audio_processor());
+  freeze_stream_ = AudioClipStream::create();
+  const uint pathquark = CString::temp_quark_impl (CString (freeze_capture_->filename()));
+  auto job = [chain, stream = freeze_stream_, pathquark, released = Mutable<AudioChain::FreezeRelease> ({})] () {
+    stream->load (pathquark);
+    chain->freeze_playback (stream, released.value);
+  };
+  chain->engine().async_jobs += job;
+}
+
+/// Discard audio rendered ahead and the recording of a frozen track after edits,
+/// recording is re-armed once edits settle. Parameter edits of an `edited` effect after the
+/// first device keep the audio rendered ahead, they reach the output within the anticipation.
+void
+TrackImpl::freeze_invalidate (const Device *edited)
+{
+  if (anticipation_)
+    {
+      const DeviceS devices = edited ? list_chain_devices() : DeviceS();
+      const bool downstream = devices.size() && devices[0].get() != edited &&
+                              std::any_of (devices.begin(), devices.end(), [edited] (const DeviceP &d) { return d.get() == edited; });
+      if (!downstream)
+        anticipation_->invalidate_mt();
+    }
+  return_unless (frozen_);
+  freeze_stop();
+  freeze_timer_ = main_loop->exec_timer ([this] () {
+    freeze_timer_ = 0;
+    freeze_start();
+    return false;
+  }, FREEZE_REARM_MS);
+}
+
 // == TrackImpl::ClipScout ==
 TrackImpl::ClipScout::ClipScout() noexcept
 {
@@ -11,9 +11,24 @@ class TrackImpl : public DeviceImpl, public virtual Track {
   DeviceP      chain_, midi_prod_;
   ClipImplS    clips_;
   uint         midi_channel_ = 0;
+  bool         frozen_ = false;
+  uint         freeze_timer_ = 0;
+  AudioClipCaptureP freeze_capture_;
+  AudioClipStreamP  freeze_stream_;
+  Connection   onchainstate_;
+  double       volume_ = 1;
+  bool         live_input_ = true;
+  AnticipationP anticipation_;  // allocated once rendering ahead is enabled
+  struct AuxSend { TrackImplP bus; double level; bool prefader; };
+  std::vector<AuxSend> sends_;
   ASE_DEFINE_MAKE_SHARED (TrackImpl);
   friend class ProjectImpl;
   virtual         ~TrackImpl        ();
+  void            freeze_start      ();
+  void            freeze_stop       ();
+  void            freeze_update     ();
+  void            freeze_play       ();
+  void            clear_sends       ();
 protected:
   String          fallback_name     () const override;
   void            serialize         (WritNode &xs) override;
@@ -37,6 +52,20 @@ public:
   ssize_t         clip_index        (const ClipImpl &clip) const;
   int             clip_succession   (const ClipImpl &clip) const;
   TelemetryFieldS telemetry         () const override;
+  bool            frozen            () const override      { return frozen_; }
+  void            frozen            (bool onoff) override;
+  void            freeze_invalidate (const Device *edited = nullptr);
+  static void     freeze_cleanup    ();
+  void            update_anticipation ();
+  bool            feeds             (const TrackImpl &target) const;
+  DeviceS         list_chain_devices () const;
+  double          volume            () const override      { return volume_; }
+  void            volume            (double gain) override;
+  bool            set_send          (TrackP bus, double level, bool prefader) override;
+  double          send_level        (TrackP bus) const override;
+  bool            send_prefader     (TrackP bus) const override;
+  bool            live_input        () const override      { return live_input_; }
+  void            live_input        (bool onoff) override;
   enum Cmd { STOP, START, };
   void            queue_cmd         (CallbackS&, Cmd cmd, double arg = 0);
   void            queue_cmd         (DCallbackS&, Cmd cmd);
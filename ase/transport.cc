@@ -147,6 +147,114 @@ TickSignature::bar_to_tick (int32 bar) const
   return tick;
 }
 
+// == TempoMap ==
+TempoMap::TempoMap (uint samplerate, double bpm) :
+  segments_ (1), samplerate_ (samplerate)
+{
+  segments_[0].bpm = CLAMP (bpm, MIN_BPM, MAX_BPM);
+  update (0);
+}
+
+/// Assign sample rate and recalculate sample positions.
+void
+TempoMap::set_samplerate (uint samplerate)
+{
+  assert_return (samplerate >= MIN_SAMPLERATE && samplerate <= MAX_SAMPLERATE);
+  return_unless (samplerate != samplerate_);
+  samplerate_ = samplerate;
+  update (0);
+}
+
+/// Assign the initial tempo, i.e. the tempo before the first tempo change.
+void
+TempoMap::set_bpm (double bpm)
+{
+  bpm = CLAMP (bpm, MIN_BPM, MAX_BPM);
+  return_unless (bpm != segments_[0].bpm);
+  segments_[0].bpm = bpm;
+  update (0);
+}
+
+/// Change tempo to `bpm` at `tick`, a `bpm` of 0 removes the tempo change at `tick`.
+/// New tempo changes are refused once MAX_CHANGES is reached.
+bool
+TempoMap::set_change (int64 tick, double bpm)
+{
+  if (tick <= 0)
+    {
+      const double old = segments_[0].bpm;
+      set_bpm (bpm > 0 ? bpm : old);
+      return old != segments_[0].bpm;
+    }
+  auto it = std::lower_bound (segments_.begin(), segments_.end(), tick,
+                              [] (const Segment &s, int64 t) { return s.tick < t; });
+  const bool exists = it != segments_.end() && it->tick == tick;
+  if (bpm <= 0)
+    {
+      return_unless (exists, false);
+      it = segments_.erase (it);
+    }
+  else
+    {
+      bpm = CLAMP (bpm, MIN_BPM, MAX_BPM);
+      if (exists && it->bpm == bpm)
+        return false;
+      if (!exists && segments_.size() > MAX_CHANGES)
+        return false;
+      if (!exists)
+        it = segments_.insert (it, Segment { .tick = tick });
+      it->bpm = bpm;
+    }
+  update (it - segments_.begin() - 1);
+  return true;
+}
+
+/// Remove all tempo changes, keeps the initial tempo.
+void
+TempoMap::clear_changes ()
+{
+  segments_.resize (1);
+}
+
+/// Recalculate segment conversion factors and sample positions starting at segment `first`.
+void
+TempoMap::update (size_t first)
+{
+  for (size_t i = first; i < segments_.size(); i++)
+    {
+      Segment &s = segments_[i];
+      const double ticks_per_minute = TRANSPORT_PPQN * s.bpm;
+      s.ticks_per_sample = ticks_per_minute / (60.0 * samplerate_);
+      s.samples_per_tick = (60.0 * samplerate_) / ticks_per_minute;
+      if (i == 0)
+        s.sample = 0;
+      else
+        {
+          const Segment &p = segments_[i - 1];
+          s.sample = p.sample + (s.tick - p.tick) * p.samples_per_tick;
+        }
+    }
+}
+
+/// Calculate the tick position after `nsamples` from `tick`, accounting for all tempo changes in between.
+/// The `cursor` is used as lookup hint and updated to the segment of the returned position.
+double
+TempoMap::tick_after (double tick, double nsamples, size_t *cursor) const
+{
+  size_t i = find_tick (tick, *cursor);
+  while (i + 1 < segments_.size())
+    {
+      const double boundary = (segments_[i + 1].tick - tick) * segments_[i].samples_per_tick;
+      if (nsamples < boundary)
+        break;
+      nsamples -= boundary;
+      tick = segments_[i + 1].tick;
+      i++;
+    }
+  *cursor = i;
+  return tick + nsamples * segments_[i].ticks_per_sample;
+}
+
 // == SpeakerArrangement ==
 // Count the number of channels described by the SpeakerArrangement.
 uint8
@@ -229,7 +337,8 @@ speaker_arrangement_desc (SpeakerArrangement spa)
 AudioTransport::AudioTransport (SpeakerArrangement speakerarrangement, uint sample_rate) :
   samplerate (sample_rate), nyquist (sample_rate / 2),
   isamplerate (1.0 / sample_rate), inyquist (2.0 / sample_rate),
-  speaker_arrangement (speakerarrangement)
+  speaker_arrangement (speakerarrangement),
+  tempo_map (sample_rate, tick_sig.bpm())
 {
   tick_sig.set_samplerate (sample_rate);
   assert_return (sample_rate >= MIN_SAMPLERATE && sample_rate <= MAX_SAMPLERATE);
@@ -239,7 +348,7 @@ AudioTransport::AudioTransport (SpeakerArrangement speakerarrangement, uint samp
 void
 AudioTransport::running (bool r)
 {
-  current_bpm = r ? tick_sig.bpm() : 0;
+  current_bpm = r ? bpm() : 0;
 }
 
 void
@@ -255,6 +364,8 @@ AudioTransport::set_tick (int64 newtick)
 {
   current_tick = newtick;
   current_tick_d = current_tick;
+  tempo_cursor_ = tempo_map.find_tick (current_tick_d, tempo_cursor_);
+  current_bpm = current_bpm ? bpm() : 0;
   update_current();
 }
 
@@ -263,10 +374,51 @@ AudioTransport::tempo (double newbpm, uint8 numerator, uint8 denominator)
 {
   tick_sig.set_bpm (CLAMP (newbpm, MIN_BPM, MAX_BPM));
   tick_sig.set_signature (numerator, denominator);
-  current_bpm = current_bpm ? newbpm : 0;
+  tempo_map.set_bpm (tick_sig.bpm());
+  current_bpm = current_bpm ? bpm() : 0;
   update_current();
 }
 
+/// Exchange `tempomap` with the current tempo_map, so the old map can be released outside the audio thread.
+void
+AudioTransport::swap_tempo_map (TempoMap &tempomap)
+{
+  tempomap.set_samplerate (samplerate);
+  std::swap (tempo_map, tempomap);
+  tempo_cursor_ = tempo_map.find_tick (current_tick_d);
+  current_bpm = current_bpm ? bpm() : 0;
+  update_current();
+}
+
+/// Copy position, signature and tempo map of `other`, reuses the tempo map storage if it is large enough.
+void
+AudioTransport::assign (const AudioTransport &other)
+{
+  assert_return (samplerate == other.samplerate);
+  tick_sig = other.tick_sig;
+  current_frame = other.current_frame;
+  current_tick = other.current_tick;
+  current_tick_d = other.current_tick_d;
+  current_bar = other.current_bar;
+  current_beat = other.current_beat;
+  current_semiquaver = other.current_semiquaver;
+  current_bpm = other.current_bpm;
+  current_minutes = other.current_minutes;
+  current_seconds = other.current_seconds;
+  current_bar_tick = other.current_bar_tick;
+  next_bar_tick = other.next_bar_tick;
+  tempo_map = other.tempo_map;
+  tempo_cursor_ = other.tempo_cursor_;
+}
+
+/// Calculate the tick that advance() reaches after `nsamples`, i.e. the end of the current block.
+int64
+AudioTransport::block_end_tick (uint nsamples) const
+{
+  size_t cursor = tempo_cursor_;
+  return tempo_map.tick_after (current_tick_d, nsamples, &cursor);
+}
+
 void
 AudioTransport::tempo (const TickSignature &ticksignature)
 {
@@ -279,8 +431,9 @@ AudioTransport::advance (uint nsamples)
   current_frame += nsamples;
   if (ISLIKELY (current_bpm > 0.0))
     {
-      current_tick_d += nsamples * tick_sig.ticks_per_sample();
+      current_tick_d = tempo_map.tick_after (current_tick_d, nsamples, &tempo_cursor_);
       current_tick = current_tick_d;
+      current_bpm = bpm();
       update_current();
     }
 }
@@ -296,9 +449,9 @@ AudioTransport::update_current ()
   current_bar_tick = tick_sig.bar_to_tick (current_bar);
   next_bar_tick = current_bar_tick + tick_sig.bar_ticks();
 
-  TickSignature::Time time = tick_sig.time_from_tick (current_tick);
-  current_minutes = time.minutes;
-  current_seconds = time.seconds;
+  const double seconds = tempo_map.sample_from_tick (current_tick, tempo_cursor_) * isamplerate;
+  current_minutes = std::floor (seconds * (1.0 / 60.0));
+  current_seconds = seconds - current_minutes * 60.0;
 
   if (old_next != next_bar_tick && false)
     printerr ("%3d.%2d.%5.2f %02d:%06.3f frame=%d tick=%d next=%d bpm=%d sig=%d/%d ppqn=%d pps=%f rate=%d\n",
@@ -348,4 +501,87 @@ transport_tests()
   TCMP (ts.bar_to_tick (tb.bar), ==, ts.beat_to_tick (tb));
 }
 
+TEST_INTEGRITY (tempo_map_tests);
+
+static void
+tempo_map_tests()
+{
+  const int64 Q = TRANSPORT_PPQN;
+  TempoMap tmap (48000, 120);
+  // constant tempo matches TickSignature
+  TickSignature ts { 120, 4, 4 };
+  ts.set_samplerate (48000);
+  for (int64 tick : { int64 (0), Q / 3, 7 * Q, 170000000077 })
+    TCMP (tmap.sample_from_tick (tick), ==, ts.sample_from_tick (tick));
+  // 120 bpm for one bar, then 60 bpm, then 240 bpm from bar 2
+  TASSERT (tmap.set_change (4 * Q, 60));
+  TASSERT (tmap.set_change (8 * Q, 240));
+  TASSERT (!tmap.set_change (8 * Q, 240));
+  TCMP (tmap.size(), ==, 3u);
+  TCMP (tmap.sample_from_tick (4 * Q), ==, 96000);
+  TCMP (tmap.sample_from_tick (5 * Q), ==, 96000 + 48000);
+  TCMP (tmap.sample_from_tick (8 * Q), ==, 96000 + 4 * 48000);
+  TCMP (tmap.sample_from_tick (9 * Q), ==, 96000 + 4 * 48000 + 12000);
+  TCMP (tmap.sample_from_tick (-Q), ==, -24000);       // pre-roll uses the initial tempo
+  TCMP (tmap.sample_to_tick (96000 + 48000), ==, 5 * Q);
+  TCMP (tmap.sample_to_tick (-24000), ==, -Q);
+  TCMP (tmap.bpm_at (4 * Q - 1), ==, 120);
+  TCMP (tmap.bpm_at (4 * Q), ==, 60);
+  TCMP (tmap.bpm_at (Q * 1000), ==, 240);
+  // the number of tempo changes is limited
+  TempoMap full (48000, 120);
+  for (size_t i = 1; i <= TempoMap::MAX_CHANGES; i++)
+    TASSERT (full.set_change (i * Q, 60 + i % 100));
+  TASSERT (!full.set_change (Q / 2, 90));
+  TASSERT (full.set_change (Q, 90));            // existing changes can still be modified and removed
+  TASSERT (full.set_change (2 * Q, 0));
+  TASSERT (full.set_change (Q / 2, 90));
+  TCMP (full.size(), ==, TempoMap::MAX_CHANGES + 1);
+  // round trips and hints must not affect results
+  for (int64 sample = -4800; sample < 500000; sample += 997)
+    {
+      const int64 tick = tmap.sample_to_tick (sample);
+      for (size_t hint = 0; hint < 5; hint++)
+        {
+          TCMP (tmap.sample_to_tick (sample, hint), ==, tick);
+          TCMP (tmap.sample_from_tick (tick, hint), ==, tmap.sample_from_tick (tick));
+        }
+      TASSERT (std::abs (tmap.sample_from_tick (tick) - sample) <= 1);
+    }
+  // advancing across tempo changes within a block
+  size_t cursor = 0;
+  double tick = tmap.tick_after (4 * Q - Q / 2, 24000, &cursor); // 12000 samples at 120 bpm, 12000 at 60 bpm
+  TCMP (cursor, ==, 1u);
+  TCMP (int64 (tick), ==, 4 * Q + Q / 4);
+  tick = tmap.tick_after (0, 96000 + 4 * 48000 + 12000, &cursor);
+  TCMP (cursor, ==, 2u);
+  TCMP (int64 (tick), ==, 9 * Q);
+  // AudioTransport block advancing agrees with direct conversion
+  AudioTransport transport (SpeakerArrangement::STEREO, 48000);
+  transport.tempo (120, 4, 4);
+  TempoMap copy = tmap;
+  transport.swap_tempo_map (copy);
+  TCMP (copy.size(), ==, 1u);
+  transport.running (true);
+  TCMP (transport.current_bpm, ==, 120);
+  int64 frames = 0;
+  while (frames < 96000 + 4 * 48000 + 12000)
+    {
+      const uint n = 128 + frames % 97;
+      const int64 end_tick = transport.block_end_tick (n);
+      transport.advance (n);
+      frames += n;
+      TCMP (transport.current_tick, ==, end_tick);
+      TASSERT (std::abs (transport.sample_from_tick (transport.current_tick) - frames) <= 1);
+    }
+  TCMP (transport.current_bpm, ==, 240);
+  TCMP (transport.current_minutes, ==, 0);
+  TASSERT (std::abs (transport.current_seconds - frames / 48000.0) < 0.001);
+  // removal
+  TASSERT (tmap.set_change (4 * Q, 0));
+  TCMP (tmap.sample_from_tick (8 * Q), ==, 8 * 24000);
+  tmap.clear_changes();
+  TCMP (tmap.size(), ==, 1u);
+}
+
 } // Anon
@@ -3,6 +3,7 @@
 #define __ASE_TRANSPORT_HH__
 
 #include <ase/defs.hh>
+#include <algorithm>
 
 namespace Ase {
 
@@ -109,6 +110,39 @@ public:
   TickSignature& operator=      (const TickSignature &src);
 };
 
+/// Tempo map, piecewise constant tempo along the tick axis with precomputed sample positions.
+/// Lookups are O(log n), a segment `hint` (cursor) makes lookups within the hinted or following segment O(1).
+class TempoMap {
+public:
+  struct Segment {
+    int64  tick = 0;                    ///< Tick at which the tempo takes effect.
+    double bpm = 0;                     ///< Tempo in beats per minute.
+    double sample = 0;                  ///< Sample position of `tick`.
+    double ticks_per_sample = 0;
+    double samples_per_tick = 0;
+  };
+  static constexpr size_t MAX_CHANGES = 1024;  ///< Limits tempo changes, so copies in audio threads need no allocations.
+  explicit       TempoMap         (uint samplerate = 48000, double bpm = 120);
+  uint           samplerate       () const              { return samplerate_; }
+  void           set_samplerate   (uint samplerate);
+  void           set_bpm          (double bpm);
+  bool           set_change       (int64 tick, double bpm);
+  void           clear_changes    ();
+  void           reserve          (size_t n)            { segments_.reserve (n); }
+  size_t         size             () const              { return segments_.size(); }
+  const Segment& operator[]       (size_t i) const      { return segments_[i]; }
+  size_t         find_tick        (double tick, size_t hint = 0) const;
+  size_t         find_sample      (double sample, size_t hint = 0) const;
+  double         bpm_at           (int64 tick, size_t hint = 0) const  { return segments_[find_tick (tick, hint)].bpm; }
+  int64          sample_from_tick (int64 tick, size_t hint = 0) const;
+  int64          sample_to_tick   (int64 sample, size_t hint = 0) const;
+  double         tick_after       (double tick, double nsamples, size_t *cursor) const;
+private:
+  std::vector<Segment> segments_;       // sorted by tick, segments_[0] starts at tick 0 and extends backwards
+  uint                 samplerate_ = 0;
+  void           update           (size_t first);
+};
+
 /// Transport information for AudioSignal processing.
 struct AudioTransport {
   static constexpr int64 ppqn = TRANSPORT_PPQN;
@@ -131,17 +165,24 @@ struct AudioTransport {
   double         current_seconds = 0;           ///< Seconds of *current_tick* position
   int64          current_bar_tick = 0;
   int64          next_bar_tick = 0;
+  TempoMap       tempo_map;                     ///< Tempo changes, the first segment follows *tick_sig*.
   bool     running        () const      { return current_bpm != 0; }
   void     running        (bool r);
+  double   bpm            () const      { return tempo_map[tempo_cursor_].bpm; } ///< Tempo at *current_tick*.
   void     tempo          (double newbpm, uint8 newnumerator, uint8 newdenominator);
   void     tempo          (const TickSignature &ticksignature);
+  void     swap_tempo_map (TempoMap &tempomap);
+  void     assign         (const AudioTransport &other);
   void     set_tick       (int64 newtick);
   void     set_beat       (TickSignature::Beat b);
   void     advance        (uint nsamples);
   void     update_current ();
   explicit AudioTransport (SpeakerArrangement speakerarrangement, uint samplerate);
-  int64    sample_to_tick  (int64 sample) const { return tick_sig.sample_to_tick (sample); }
-  int64    sample_from_tick (int64 tick) const  { return tick_sig.sample_from_tick (tick); }
+  int64    sample_to_tick  (int64 sample) const { return tempo_map.sample_to_tick (sample, tempo_cursor_); }
+  int64    sample_from_tick (int64 tick) const  { return tempo_map.sample_from_tick (tick, tempo_cursor_); }
+  int64    block_end_tick  (uint nsamples) const;
+private:
+  size_t   tempo_cursor_ = 0;                   // tempo_map segment of current_tick
 };
 
 // == Implementations ==
@@ -157,6 +198,56 @@ TickSignature::sample_from_tick (int64 tick) const
   return sample_per_ticks_ * tick;
 }
 
+/// Find the segment index of `tick`, checks `hint` and its successor before resorting to a binary search.
+inline size_t
+TempoMap::find_tick (double tick, size_t hint) const
+{
+  const size_t n = segments_.size();
+  if (ASE_ISLIKELY (hint < n) && (hint == 0 || segments_[hint].tick <= tick))
+    {
+      if (hint + 1 == n || tick < segments_[hint + 1].tick)
+        return hint;
+      if (hint + 2 == n || tick < segments_[hint + 2].tick)
+        return hint + 1;
+    }
+  auto it = std::upper_bound (segments_.begin() + 1, segments_.end(), tick,
+                              [] (double t, const Segment &s) { return t < s.tick; });
+  return it - segments_.begin() - 1;
+}
+
+/// Find the segment index of `sample`, see find_tick().
+inline size_t
+TempoMap::find_sample (double sample, size_t hint) const
+{
+  const size_t n = segments_.size();
+  if (ASE_ISLIKELY (hint < n) && (hint == 0 || segments_[hint].sample <= sample))
+    {
+      if (hint + 1 == n || sample < segments_[hint + 1].sample)
+        return hint;
+      if (hint + 2 == n || sample < segments_[hint + 2].sample)
+        return hint + 1;
+    }
+  auto it = std::upper_bound (segments_.begin() + 1, segments_.end(), sample,
+                              [] (double v, const Segment &s) { return v < s.sample; });
+  return it - segments_.begin() - 1;
+}
+
+/// Calculate the sample position of `tick`.
+inline int64
+TempoMap::sample_from_tick (int64 tick, size_t hint) const
+{
+  const Segment &s = segments_[find_tick (tick, hint)];
+  return std::floor (s.sample + (tick - s.tick) * s.samples_per_tick);
+}
+
+/// Calculate the tick position of `sample`.
+inline int64
+TempoMap::sample_to_tick (int64 sample, size_t hint) const
+{
+  const Segment &s = segments_[find_sample (sample, hint)];
+  return std::floor (s.tick + (sample - s.sample) * s.ticks_per_sample);
+}
+
 } // Ase
 
 #endif // __ASE_TRANSPORT_HH__
@@ -5,6 +5,8 @@ devices/4ase.ccfiles ::=
 
 # subdir Makefiles add to devices/4ase.ccfiles
 include devices/blepsynth/Makefile.mk
+include devices/compressor/Makefile.mk
+include devices/convolver/Makefile.mk
 include devices/freeverb/Makefile.mk
 include devices/liquidsfz/Makefile.mk
 include devices/saturation/Makefile.mk
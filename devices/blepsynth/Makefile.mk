@@ -3,4 +3,5 @@
 devices/4ase.ccfiles += $(strip			\
 	devices/blepsynth/bleposcdata.cc	\
 	devices/blepsynth/blepsynth.cc		\
+	devices/blepsynth/wavetableosc.cc	\
 )
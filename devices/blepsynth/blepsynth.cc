@@ -2,6 +2,7 @@
 #include "ase/processor.hh"
 #include "ase/midievent.hh"
 #include "devices/blepsynth/bleposc.hh"
+#include "devices/blepsynth/wavetableosc.hh"
 #include "devices/blepsynth/laddervcf.hh"
 #include "devices/blepsynth/skfilter.hh"
 #include "devices/blepsynth/linearsmooth.hh"
@@ -345,8 +346,11 @@ class BlepSynth : public AudioProcessor {
     FIL_ATTACK, FIL_DECAY, FIL_SUSTAIN, FIL_RELEASE, FIL_CUT_MOD,
     MIX, VEL_TRACK, POST_GAIN,
     KEY_C, KEY_D, KEY_E, KEY_F, KEY_G,
+    OSC1_ENGINE, OSC2_ENGINE,
   };
 
+  enum { ENGINE_BLEP, ENGINE_WAVETABLE };
+
   enum { FILTER_TYPE_BYPASS, FILTER_TYPE_LADDER, FILTER_TYPE_SKFILTER };
   int filter_type_ = 0;
 
@@ -389,6 +393,9 @@ class BlepSynth : public AudioProcessor {
     BlepUtils::OscImpl osc1_;
     BlepUtils::OscImpl osc2_;
 
+    BlepUtils::WavetableOsc wt_osc1_;
+    BlepUtils::WavetableOsc wt_osc2_;
+
     static constexpr int FILTER_OVERSAMPLE = 4;
 
     LadderVCF ladder_filter_ { FILTER_OVERSAMPLE };
@@ -402,6 +409,7 @@ class BlepSynth : public AudioProcessor {
   {
     using namespace MakeIcon;
     set_max_voices (32);
+    BlepUtils::WavetableOsc::level_table (0); // generate wavetables outside of the render thread
 
     ParameterMap pmap;
 
@@ -427,6 +435,12 @@ class BlepSynth : public AudioProcessor {
       pmap[O+OSC1_UNISON_VOICES] = Param { o+"unison_voices", _("Osc %u Unison Voices", I), _("Voi%u", I), 1, "Voices", { 1, 16, }, };
       pmap[O+OSC1_UNISON_DETUNE] = Param { o+"unison_detune", _("Osc %u Unison Detune", I), _("Dtu%u", I), 6, "%", { 0.5, 50, }, };
       pmap[O+OSC1_UNISON_STEREO] = Param { o+"unison_stereo", _("Osc %u Unison Stereo", I), _("Ste%u", I), 0, "%", { 0, 100, }, };
+
+      ChoiceS engine_cs;
+      engine_cs += { "BLP"_uc, "Band-Limited Steps" };
+      engine_cs += { "WT"_uc, "Mipmapped Wavetables" };
+      pmap[OSC1_ENGINE + oscnum] = Param { o+"engine", _("Osc %u Engine", I), _("Eng%u", I), ENGINE_BLEP, "", std::move (engine_cs), "",
+                                           { String ("blurb=") + _("Wavetables are cheaper for large unison, band-limited steps have clean hard sync"), } };
     };
 
     oscparams (0);
@@ -568,8 +582,8 @@ class BlepSynth : public AudioProcessor {
     set_max_voices (32);
     adjust_all_params();
   }
-  void
-  init_osc (BlepUtils::OscImpl& osc, float freq)
+  template<class Osc> void
+  init_osc (Osc& osc, float freq)
   {
     osc.frequency_base = freq;
     osc.set_rate (sample_rate());
@@ -637,8 +651,8 @@ class BlepSynth : public AudioProcessor {
         case KEY_G: check_note (KEY_G, old_g_, 67); break;
       }
   }
-  void
-  update_osc (BlepUtils::OscImpl& osc, int oscnum)
+  template<class Osc> void
+  update_osc (Osc& osc, int oscnum)
   {
     const uint O = oscnum * (OSC2_SHAPE - OSC1_SHAPE);
     osc.shape_base          = get_param (O+OSC1_SHAPE) * 0.01;
@@ -739,8 +753,13 @@ class BlepSynth : public AudioProcessor {
         init_osc (voice->osc1_, voice->freq_);
         init_osc (voice->osc2_, voice->freq_);
 
+        init_osc (voice->wt_osc1_, voice->freq_);
+        init_osc (voice->wt_osc2_, voice->freq_);
+
         voice->osc1_.reset();
         voice->osc2_.reset();
+        voice->wt_osc1_.reset();
+        voice->wt_osc2_.reset();
 
         const float cutoff_min_hz = convert_cutoff (CUTOFF_MIN_MIDI);
         const float cutoff_max_hz = convert_cutoff (CUTOFF_MAX_MIDI);
@@ -796,6 +815,20 @@ class BlepSynth : public AudioProcessor {
       }
   }
   void
+  render_osc (BlepUtils::OscImpl& osc, BlepUtils::WavetableOsc& wt_osc, int oscnum, float *left_out, float *right_out, uint n_frames)
+  {
+    if (irintf (get_param (OSC1_ENGINE + oscnum)) == ENGINE_WAVETABLE)
+      {
+        update_osc (wt_osc, oscnum);
+        wt_osc.process_sample_stereo (left_out, right_out, n_frames);
+      }
+    else
+      {
+        update_osc (osc, oscnum);
+        osc.process_sample_stereo (left_out, right_out, n_frames);
+      }
+  }
+  void
   render_voice (Voice *voice, uint n_frames, float *mix_left_out, float *mix_right_out)
   {
     float osc1_left_out[n_frames];
@@ -803,10 +836,8 @@ class BlepSynth : public AudioProcessor {
     float osc2_left_out[n_frames];
     float osc2_right_out[n_frames];
 
-    update_osc (voice->osc1_, 0);
-    update_osc (voice->osc2_, 1);
-    voice->osc1_.process_sample_stereo (osc1_left_out, osc1_right_out, n_frames);
-    voice->osc2_.process_sample_stereo (osc2_left_out, osc2_right_out, n_frames);
+    render_osc (voice->osc1_, voice->wt_osc1_, 0, osc1_left_out, osc1_right_out, n_frames);
+    render_osc (voice->osc2_, voice->wt_osc2_, 1, osc2_left_out, osc2_right_out, n_frames);
 
     // apply volume envelope & mix
     const float mix_norm = get_param (MIX) * 0.01;
@@ -1066,3 +1097,96 @@ public:
 static auto blepsynth = register_audio_processor<BlepSynth> ("Ase::Devices::BlepSynth");
 
 } // Anon
+
+// == Tests ==
+#include "ase/fft.hh"
+#include "ase/testing.hh"
+
+namespace {
+using namespace Ase;
+
+// Windowed power spectrum of the last `fft.size()` samples of `osc` output at `freq`
+template<class Osc> static std::vector<double>
+osc_power_spectrum (Osc &osc, RealFFT &fft, double freq, double shape, double pulse_width, double sub)
+{
+  const uint N = fft.size();
+  osc.set_rate (48000);
+  osc.frequency_base = freq;
+  osc.shape_base = shape;
+  osc.pulse_width_base = pulse_width;
+  osc.sub_base = sub;
+  osc.reset();
+  std::vector<float> left (N), right (N), re (fft.n_bins()), im (fft.n_bins());
+  for (uint i = 0; i < 4; i++)  // skip the onset, the BLEP leaky integrator needs to settle
+    osc.process_sample_stereo (left.data(), right.data(), N);
+  for (uint i = 0; i < N; i++)  // Blackman-Harris window
+    left[i] *= 0.35875 - 0.48829 * cos (2 * M_PI * i / N) + 0.14128 * cos (4 * M_PI * i / N) - 0.01168 * cos (6 * M_PI * i / N);
+  fft.forward (left.data(), re.data(), im.data());
+  std::vector<double> power (fft.n_bins());
+  for (uint k = 0; k < power.size(); k++)
+    power[k] = re[k] * re[k] + im[k] * im[k];
+  return power;
+}
+
+TEST_INTEGRITY (wavetable_osc_tests);
+static void
+wavetable_osc_tests()
+{
+  TCMP (BlepUtils::WavetableOsc::select_level (0.5 / BlepUtils::WavetableOsc::MAX_HARMONICS), ==, 0u);
+  TCMP (BlepUtils::WavetableOsc::select_level (1.0 / BlepUtils::WavetableOsc::MAX_HARMONICS), ==, 2u);
+  TCMP (BlepUtils::WavetableOsc::select_level (0.49), ==, BlepUtils::WavetableOsc::N_LEVELS - 1);
+  // 0.5 - frac (phase) band-limited, the first level is accurate away from the jump
+  const float *saw = BlepUtils::WavetableOsc::level_table (0);
+  TCMP (std::abs (saw[BlepUtils::WavetableOsc::TABLE_SIZE / 4] - 0.25), <, 1e-3);
+  TCMP (saw[0], ==, saw[BlepUtils::WavetableOsc::TABLE_SIZE]);
+  // per sample modulation path matches the cached waveform
+  {
+    constexpr uint N = 256;
+    BlepUtils::WavetableOsc osc1, osc2;
+    for (auto *osc : { &osc1, &osc2 })
+      {
+        osc->set_rate (48000);
+        osc->frequency_base = 1234;
+        osc->shape_base = -0.4;
+        osc->pulse_width_base = 0.3;
+        osc->sub_base = 0.2;
+      }
+    float left1[N], right1[N], left2[N], right2[N], zeros[N] = { 0, };
+    osc1.process_sample_stereo (left1, right1, N);
+    osc2.process_sample_stereo (left2, right2, N, nullptr, nullptr, zeros);
+    for (uint i = 0; i < N; i++)
+      TCMP (std::abs (left1[i] - left2[i]), <, 1e-3);
+  }
+
+  // compare harmonics and alias levels with the BLEP oscillator at a high pitch
+  constexpr uint N = 8192, BIN = 437;   // fundamental between bins, so aliases miss the harmonics
+  const double freq = 48000.0 * BIN / N;
+  RealFFT fft (N);
+  const struct { double shape, pulse_width, sub; } waves[] = {
+    { 0, 0.5, 0 },      // saw
+    { -1, 0.5, 0 },     // square
+    { -1, 0.2, 0 },     // pulse
+    { 0.5, 0.3, 0.5 },  // morph with subharmonic
+  };
+  for (const auto &w : waves)
+    {
+      BlepUtils::OscImpl blep;
+      BlepUtils::WavetableOsc wt;
+      const std::vector<double> bp = osc_power_spectrum (blep, fft, freq, w.shape, w.pulse_width, w.sub);
+      const std::vector<double> wp = osc_power_spectrum (wt, fft, freq, w.shape, w.pulse_width, w.sub);
+      double blep_alias = 0, wt_alias = 0, blep_signal = 0, wt_signal = 0;
+      for (uint k = 8; k < bp.size(); k++)    // skip DC, subharmonics lie at half multiples of BIN
+        {
+          const double r = fmod (k, BIN * 0.5);
+          const bool harmonic = std::min (r, BIN * 0.5 - r) <= 6 && k < N / 2 * 0.9;
+          (harmonic ? blep_signal : blep_alias) += bp[k];
+          (harmonic ? wt_signal : wt_alias) += wp[k];
+        }
+      TCMP (std::abs (10 * log10 (wt_signal / blep_signal)), <, 0.5); // same waveform and level
+      const double blep_db = 10 * log10 (blep_alias / blep_signal), wt_db = 10 * log10 (wt_alias / wt_signal);
+      TCMP (wt_db, <, -80);
+      TCMP (wt_db, <, blep_db);
+    }
+}
+
+} // Anon
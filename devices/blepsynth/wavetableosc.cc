@@ -0,0 +1,34 @@
+// This Source Code Form is licensed MPL-2.0: http://mozilla.org/MPL/2.0
+#include "wavetableosc.hh"
+#include "ase/fft.hh"
+#include "ase/internal.hh"
+
+namespace Ase {
+namespace BlepUtils {
+
+/// Band-limited sawtooth `0.5 - frac (phase)` for mipmap `level`, with TABLE_SIZE + 1 samples.
+const float*
+WavetableOsc::level_table (uint level)
+{
+  static const std::vector<float> tables = [] () {
+    constexpr uint STRIDE = TABLE_SIZE + 1;
+    std::vector<float> tables (N_LEVELS * STRIDE);
+    RealFFT fft (TABLE_SIZE);
+    std::vector<float> re (fft.n_bins()), im (fft.n_bins());
+    for (uint l = 0; l < N_LEVELS; l++)
+      {
+        const uint n_harmonics = std::max (1.0, MAX_HARMONICS * exp2 (-0.5 * l));
+        std::fill (im.begin(), im.end(), 0);
+        for (uint h = 1; h <= n_harmonics; h++)
+          im[h] = -0.5 / (M_PI * h);    // backward() yields sum (2 * (re cos - im sin))
+        float *table = &tables[l * STRIDE];
+        fft.backward (re.data(), im.data(), table);
+        table[TABLE_SIZE] = table[0];   // guard sample for linear interpolation
+      }
+    return tables;
+  } ();
+  return &tables[std::min (level, N_LEVELS - 1) * (TABLE_SIZE + 1)];
+}
+
+} // BlepUtils
+} // Ase
@@ -0,0 +1,289 @@
+// This Source Code Form is licensed MPL-2.0: http://mozilla.org/MPL/2.0
+#ifndef __ASE_DEVICES_WAVETABLEOSC_HH__
+#define __ASE_DEVICES_WAVETABLEOSC_HH__
+
+#include <ase/randomhash.hh>
+#include <ase/datautils.hh>
+#include <ase/signalmath.hh>
+
+namespace Ase {
+namespace BlepUtils {
+
+/* Wavetable variant of OscImpl with the same parameters
+ *
+ * The OscImpl waveform is piecewise linear with a constant slope and four jumps per period, so it is
+ * the sum of four sawtooth waves shifted to the jump positions and weighted by the jump heights.
+ * Shape, pulse width and subharmonic settings thus morph continuously by crossfading the weights of
+ * band-limited sawtooth lookups. The sawtooth tables are mipmapped per half octave, each level holds
+ * as many harmonics as fit below Nyquist for the highest frequency it is selected for.
+ * Without modulation inputs, the crossfaded waveform is cached in a single table which is shared by
+ * all unison voices and only rebuilt when the shape parameters or the mipmap level change.
+ *
+ * Unlike OscImpl, hard sync restarts the slave phase without band-limiting the discontinuity.
+ */
+class WavetableOsc
+{
+public:
+  static constexpr uint TABLE_SIZE = 4096;          // samples per table, a guard sample follows
+  static constexpr uint MAX_HARMONICS = 1024;       // harmonics of the first level
+  static constexpr uint N_LEVELS = 21;              // levels per half octave, down to a single harmonic
+  static const float*   level_table (uint level);
+private:
+  double rate_ = 48000;
+
+  struct Jump {
+    float position, height;
+  };
+  std::array<Jump, 4> jumps_ {};
+  uint                n_jumps_ = 0;
+
+  std::vector<float>  wave_;                // cached waveform, TABLE_SIZE + 1 samples
+  std::array<Jump, 4> wave_jumps_ {};
+  uint                wave_n_jumps_ = 0;
+  uint                wave_level_ = ~0u;
+
+  static constexpr uint   FRAC_BITS = 32 - 12;  // phase bits below the table index, TABLE_SIZE == 1 << 12
+  static constexpr double PHASE_SCALE = 4294967296.0;
+public:
+  double frequency_base   = 440;
+  double frequency_factor = 1;
+
+  double freq_mod_octaves = 0;
+
+  double shape_base       = 0; // 0 = saw, range [-1:1]
+  double shape_mod        = 1.0;
+
+  double pulse_width_base = 0.5;
+  double pulse_width_mod  = 0.0;
+
+  double sync_base        = 0;
+  double sync_mod         = 0;
+
+  double sub_base         = 0;
+  double sub_mod          = 0;
+
+  double sub_width_base   = 0.5;
+  double sub_width_mod    = 0.0;
+
+  struct UnisonVoice
+  {
+    double freq_factor     = 1;
+    double left_factor     = 1;
+    double right_factor    = 0;
+
+    uint32_t master_phase  = 0;             // fixed point, 1 << 32 is a full sub-cycle
+  };
+  std::vector<UnisonVoice> unison_voices;
+
+  WavetableOsc() :
+    wave_ (TABLE_SIZE + 1)
+  {
+    set_unison (1, 0, 0); // default
+  }
+  void
+  reset()
+  {
+    const bool randomize_phase = unison_voices.size() > 1;
+
+    for (auto& voice : unison_voices)
+      voice.master_phase = randomize_phase ? uint32_t (random_frange (0, 1) * (PHASE_SCALE - 1)) : 0; // randomize start phase for true unison
+  }
+  void
+  set_unison (size_t n_voices, float detune, float stereo)
+  {
+    const bool unison_voices_changed = unison_voices.size() != n_voices;
+
+    unison_voices.resize (n_voices);
+
+    bool left_channel = true; /* start spreading voices at the left channel */
+    for (size_t i = 0; i < unison_voices.size(); i++)
+      {
+        if (n_voices == 1)
+          unison_voices[i].freq_factor = 1;
+        else
+          {
+            const float detune_cent = -detune / 2.0 + i / float (n_voices - 1) * detune;
+            unison_voices[i].freq_factor = pow (2, detune_cent / 1200);
+          }
+        /* stereo spread factors, see OscImpl::set_unison() */
+        double left_factor, right_factor;
+        bool odd_n_voices = unison_voices.size() & 1;
+        if (odd_n_voices && i == unison_voices.size() / 2)  // odd number of voices: this voice is centered
+          {
+            left_factor  = (1 - stereo) + stereo * 0.5;
+            right_factor = (1 - stereo) + stereo * 0.5;
+          }
+        else if (left_channel) // alternate beween left and right voices
+          {
+            left_factor  = 0.5 + stereo / 2;
+            right_factor = 0.5 - stereo / 2;
+            left_channel = false;
+          }
+        else
+          {
+            left_factor  = 0.5 - stereo / 2;
+            right_factor = 0.5 + stereo / 2;
+            left_channel = true;
+          }
+        const double norm = sqrt (left_factor * left_factor + right_factor * right_factor) * sqrt (n_voices / 2.0);
+        unison_voices[i].left_factor  = left_factor / norm;
+        unison_voices[i].right_factor = right_factor / norm;
+      }
+    if (unison_voices_changed)
+      reset();
+  }
+  void
+  set_rate (double rate)
+  {
+    rate_ = rate;
+  }
+  double
+  rate()
+  {
+    return rate_;
+  }
+  /// Select the level with the most harmonics that stay below Nyquist for phase increment `inc`.
+  static uint
+  select_level (double inc)
+  {
+    const double top = MAX_HARMONICS * inc * 2;       // highest harmonic relative to Nyquist at level 0
+    if (top <= 1)
+      return 0;
+    return std::min (uint (std::ceil (2 * std::log2 (top) - 1e-9)), N_LEVELS - 1);
+  }
+  /// Compute jump positions and heights of the OscImpl waveform, see OscImpl::estimate_dc().
+  void
+  update_jumps (double shape, double pulse_width, double sub, double sub_width)
+  {
+    const Jump jumps[4] = {
+      { float (0),                                                     float (2 * (1 - sub)) },
+      { float (sub_width * pulse_width),                               float (2 * (shape * (1 - sub) - sub)) },
+      { float (2 * sub_width * pulse_width + 1 - sub_width - pulse_width), float (2 * (1 - sub)) },
+      { float (sub_width * pulse_width + (1 - sub_width)),             float (2 * (shape * (1 - sub) + sub)) },
+    };
+    n_jumps_ = 0;
+    for (const Jump &jump : jumps)
+      if (std::abs (jump.height) > 1e-6)      // skip silent lookups, e.g. half of the saw jumps
+        jumps_[n_jumps_++] = { 1 - jump.position, jump.height };
+  }
+  /// Crossfade the sawtooth lookups into wave_, unless it already holds the current jumps and `level`.
+  void
+  update_wave (uint level)
+  {
+    if (level == wave_level_ && n_jumps_ == wave_n_jumps_ &&
+        std::equal (jumps_.begin(), jumps_.begin() + n_jumps_, wave_jumps_.begin(), [] (const Jump &a, const Jump &b) {
+          return a.position == b.position && a.height == b.height;
+        }))
+      return;
+    const float *table = level_table (level);
+    for (uint i = 0; i < TABLE_SIZE; i++)
+      wave_[i] = lookup (table, i * (1.0 / TABLE_SIZE));
+    wave_[TABLE_SIZE] = wave_[0];
+    wave_jumps_ = jumps_;
+    wave_n_jumps_ = n_jumps_;
+    wave_level_ = level;
+  }
+  /// Band-limited waveform at `phase` (in [0,1)), sums the sawtooth of `table` shifted to each jump.
+  float
+  lookup (const float *table, double phase) const
+  {
+    float value = 0;
+    for (uint j = 0; j < n_jumps_; j++)
+      {
+        float pos = (phase + jumps_[j].position) * TABLE_SIZE;
+        int ipos = int (pos);
+        const float frac = pos - ipos;
+        ipos &= TABLE_SIZE - 1;
+        value += jumps_[j].height * (table[ipos] + frac * (table[ipos + 1] - table[ipos]));
+      }
+    return value;
+  }
+  void
+  process_sample_stereo (float *left_out, float *right_out, unsigned int n_values,
+                         const float *freq_in = nullptr,
+                         const float *freq_mod_in = nullptr,
+                         const float *shape_mod_in = nullptr,
+                         const float *sub_mod_in = nullptr,
+                         const float *sync_mod_in = nullptr,
+                         const float *pulse_mod_in = nullptr,
+                         const float *sub_width_mod_in = nullptr)
+  {
+    floatfill (left_out, 0.0, n_values);
+    floatfill (right_out, 0.0, n_values);
+
+    const double pulse_width = std::clamp (pulse_width_base, 0.01, 0.99);
+    const double sub         = std::clamp (sub_base, 0.0, 1.0);
+    const double sub_width   = std::clamp (sub_width_base, 0.01, 0.99);
+    const double shape       = std::clamp (shape_base, -1.0, 1.0);
+    const double sync_factor = fast_exp2 (std::clamp (sync_base, 0.0, 60.0) / 12);
+    update_jumps (shape, pulse_width, sub, sub_width);
+
+    const bool modulated = freq_in || freq_mod_in || shape_mod_in || sub_mod_in || sync_mod_in || pulse_mod_in || sub_width_mod_in;
+    if (!modulated) // fast path, one cached table lookup per sample and unison voice
+      {
+        double max_freq_factor = 0;
+        for (const auto& voice : unison_voices)
+          max_freq_factor = std::max (max_freq_factor, voice.freq_factor);
+        update_wave (select_level (frequency_factor * frequency_base * 0.5 / rate_ * max_freq_factor * sync_factor));
+        const float *wave = wave_.data();
+        const uint64_t sync_q16 = sync_factor * 65536;
+        for (auto& voice : unison_voices)
+          {
+            const uint32_t master_inc = std::min (frequency_factor * frequency_base * 0.5 / rate_ * voice.freq_factor, 0.5) * PHASE_SCALE;
+            const float left_factor = voice.left_factor, right_factor = voice.right_factor;
+            uint32_t master_phase = voice.master_phase;
+            for (unsigned int n = 0; n < n_values; n++)
+              {
+                master_phase += master_inc;
+                const uint32_t phase = sync_q16 > 65536 ? uint32_t ((master_phase * sync_q16) >> 16) : master_phase;
+                const uint idx = phase >> FRAC_BITS;
+                const float frac = (phase & ((1 << FRAC_BITS) - 1)) * (1.0f / (1 << FRAC_BITS));
+                const float value = wave[idx] + frac * (wave[idx + 1] - wave[idx]);
+
+                left_out[n] += value * left_factor;
+                right_out[n] += value * right_factor;
+              }
+            voice.master_phase = master_phase;
+          }
+        return;
+      }
+    for (auto& voice : unison_voices) // slow path, per sample parameters
+      {
+        const double master_freq2inc = 0.5 / rate_ * voice.freq_factor;
+        double slave_factor = sync_factor;
+        double master_phase = voice.master_phase / PHASE_SCALE;
+        for (unsigned int n = 0; n < n_values; n++)
+          {
+            double master_inc;
+            if (freq_in)
+              master_inc = frequency_factor * fast_voltage2hz (freq_in[n]) * master_freq2inc;
+            else
+              master_inc = frequency_factor * frequency_base * master_freq2inc;
+            if (freq_mod_in)
+              master_inc *= fast_exp2 (freq_mod_in[n] * freq_mod_octaves);
+            if (sync_mod_in)
+              slave_factor = fast_exp2 (std::clamp (sync_base + sync_mod * sync_mod_in[n], 0.0, 60.0) / 12);
+            update_jumps (shape_mod_in ? std::clamp (shape_base + shape_mod * shape_mod_in[n], -1.0, 1.0) : shape,
+                          pulse_mod_in ? std::clamp (pulse_width_base + pulse_width_mod * pulse_mod_in[n], 0.01, 0.99) : pulse_width,
+                          sub_mod_in ? std::clamp (sub_base + sub_mod * sub_mod_in[n], 0.0, 1.0) : sub,
+                          sub_width_mod_in ? std::clamp (sub_width_base + sub_width_mod * sub_width_mod_in[n], 0.01, 0.99) : sub_width);
+
+            master_phase += master_inc;
+            master_phase -= int (master_phase);
+
+            double slave_phase = master_phase * slave_factor;
+            slave_phase -= int (slave_phase);
+            const float value = lookup (level_table (select_level (master_inc * slave_factor)), slave_phase);
+
+            left_out[n] += value * voice.left_factor;
+            right_out[n] += value * voice.right_factor;
+          }
+        voice.master_phase = master_phase * PHASE_SCALE;
+      }
+  }
+};
+
+} // BlepUtils
+} // Ase
+
+#endif // __ASE_DEVICES_WAVETABLEOSC_HH__
@@ -0,0 +1,306 @@
+// This Source Code Form is licensed MPL-2.0: http://mozilla.org/MPL/2.0
+#include "ase/processor.hh"
+#include "ase/internal.hh"
+#include "compressordsp.hh"
+
+namespace {
+
+using namespace Ase;
+
+class Compressor : public AudioProcessor {
+  IBusId stereoin;
+  IBusId sidechain;
+  OBusId stereout;
+  CompressorDSP compressor;
+  bool use_sidechain = false;
+public:
+  Compressor (const ProcessorSetup &psetup) :
+    AudioProcessor (psetup)
+  {}
+  static void
+  static_info (AudioProcessorInfo &info)
+  {
+    info.version = "1";
+    info.label = "Compressor";
+    info.category = "Dynamics";
+    info.website_url  = "https://anklang.testbit.eu";
+  }
+  enum Params { KEY = 1, THRESHOLD, RATIO, KNEE, ATTACK, RELEASE, MAKEUP };
+  void
+  initialize (SpeakerArrangement busses) override
+  {
+    stereoin  = add_input_bus  ("Stereo In",  SpeakerArrangement::STEREO);
+    sidechain = add_input_bus  ("Sidechain",  SpeakerArrangement::STEREO); // connected via Device::set_sidechain()
+    stereout  = add_output_bus ("Stereo Out", SpeakerArrangement::STEREO);
+
+    ParameterMap pmap;
+    pmap.group = "Settings";
+
+    ChoiceS centries;
+    centries += { "Input",     "Compress according to the input level" };
+    centries += { "Sidechain", "Duck the input according to the sidechain level" };
+    pmap[KEY]       = Param { "key",       "Key",       "Key",     0, "", std::move (centries), "", { String ("blurb=") + _("Signal that controls the gain reduction"), } };
+    pmap[THRESHOLD] = Param { "threshold", "Threshold", "Thresh",  -20, "dB", { -60, 0 } };
+    pmap[RATIO]     = Param { "ratio",     "Ratio",     "Ratio",   4, "", { 1, 20 } };
+    pmap[KNEE]      = Param { "knee",      "Knee",      "Knee",    6, "dB", { 0, 24 } };
+
+    pmap.group = "Envelope";
+    pmap[ATTACK]    = Param { "attack",    "Attack",    "Attack",  5, "ms", { 0, 100 } };
+    pmap[RELEASE]   = Param { "release",   "Release",   "Release", 100, "ms", { 0, 1000 } };
+    pmap[MAKEUP]    = Param { "makeup",    "Makeup Gain", "Makeup", 0, "dB", { 0, 24 } };
+
+    install_params (pmap);
+
+    prepare_event_input();
+  }
+  void
+  adjust_param (uint32_t tag) override
+  {
+    switch (Params (tag))
+      {
+      case KEY:         use_sidechain = irintf (get_param (KEY)) == 1;
+                        return;
+      case THRESHOLD:   compressor.set_threshold (get_param (THRESHOLD));
+                        return;
+      case RATIO:       compressor.set_ratio (get_param (RATIO));
+                        return;
+      case KNEE:        compressor.set_knee (get_param (KNEE));
+                        return;
+      case ATTACK:      compressor.set_attack (get_param (ATTACK));
+                        return;
+      case RELEASE:     compressor.set_release (get_param (RELEASE));
+                        return;
+      case MAKEUP:      compressor.set_makeup (get_param (MAKEUP));
+                        return;
+      }
+  }
+  void
+  reset (uint64 target_stamp) override
+  {
+    compressor.reset (sample_rate());
+    adjust_all_params();
+  }
+  void
+  render (uint n_frames) override
+  {
+    const float *left_in = ifloats (stereoin, 0);
+    const float *right_in = ifloats (stereoin, 1);
+    // the sidechain buffers are the output buffers of the source track, scheduled before us
+    const float *left_key = use_sidechain ? ifloats (sidechain, 0) : left_in;
+    const float *right_key = use_sidechain ? ifloats (sidechain, 1) : right_in;
+    float *left_out = oblock (stereout, 0);
+    float *right_out = oblock (stereout, 1);
+
+    uint offset = 0;
+    MidiEventInput evinput = midi_event_input();
+    for (const auto &ev : evinput)
+      {
+        // process any audio that is before the event
+        const uint frame = std::min (uint (ev.frame), n_frames);
+        compressor.process (left_key + offset, right_key + offset, left_in + offset, right_in + offset,
+                            left_out + offset, right_out + offset, frame - offset);
+        offset = frame;
+
+        switch (ev.message())
+          {
+          case MidiMessage::PARAM_VALUE:
+            apply_event (ev);
+            adjust_param (ev.param);
+            break;
+          default: ;
+          }
+      }
+    // process frames after last event
+    compressor.process (left_key + offset, right_key + offset, left_in + offset, right_in + offset,
+                        left_out + offset, right_out + offset, n_frames - offset);
+  }
+};
+static auto compressor = register_audio_processor<Compressor> ("Ase::Devices::Compressor");
+
+} // Anon
+
+// == Tests ==
+#include "ase/testing.hh"
+#include "ase/combo.hh"
+#include "ase/device.hh"
+#include "ase/main.hh"
+
+namespace {
+using namespace Ase;
+
+TEST_INTEGRITY (compressor_alignment_tests);
+static void
+compressor_alignment_tests()
+{
+  constexpr uint N = 256, KEY_START = 37, KEY_FRAMES = 20;
+  float input[N], key[N], out1[N], out2[N], scratch[N];
+  for (uint i = 0; i < N; i++)
+    {
+      input[i] = 0.5;
+      key[i] = i >= KEY_START && i < KEY_START + KEY_FRAMES ? 1.0 : 0.0;
+    }
+  auto setup = [] (CompressorDSP &dsp) {
+    dsp.set_threshold (-20);
+    dsp.set_ratio (1000);
+    dsp.set_knee (0);
+    dsp.set_attack (0);
+    dsp.set_release (0);
+    dsp.reset (48000);
+  };
+  // ducking must start and end on the exact frames of the key signal
+  CompressorDSP dsp;
+  setup (dsp);
+  dsp.process (key, key, input, input, out1, scratch, N);
+  for (uint i = 0; i < N; i++)
+    if (i >= KEY_START && i < KEY_START + KEY_FRAMES)
+      TCMP (std::abs (out1[i] - 0.05), <, 0.001);    // -20dB of 0dBFS key, limited at -20dB
+    else
+      TCMP (std::abs (out1[i] - 0.5), <, 0.0001);
+  // block splitting must not shift or alter the output
+  CompressorDSP dsp2;
+  setup (dsp2);
+  dsp2.set_attack (1);
+  dsp2.set_release (10);
+  dsp2.reset (48000);
+  setup (dsp);
+  dsp.set_attack (1);
+  dsp.set_release (10);
+  dsp.reset (48000);
+  dsp.process (key, key, input, input, out1, scratch, N);
+  for (uint offset = 0, n = 1; offset < N; offset += n, n = n * 2 + 1)
+    {
+      n = std::min (n, N - offset);
+      dsp2.process (key + offset, key + offset, input + offset, input + offset, out2 + offset, scratch + offset, n);
+    }
+  for (uint i = 0; i < N; i++)
+    TCMP (out1[i], ==, out2[i]);
+  TCMP (std::abs (out1[KEY_START - 1] - 0.5), <, 0.0001); // no lookahead, unaffected before the onset
+  TCMP (out1[KEY_START], <, 0.5);                      // attack starts at the key onset
+}
+
+// Key pattern of the routing test, repeats every 64 frames of the engine frame counter
+static bool
+sidechain_key_at (uint64 frame)
+{
+  return frame % 64 >= 37 && frame % 64 < 37 + 20;
+}
+
+/// Generate the main input (0.5) or the key signal in sync with the engine frame counter.
+class SidechainTestSource : public AudioProcessor {
+  OBusId stereout;
+  const bool key_;
+public:
+  SidechainTestSource (const ProcessorSetup &psetup, bool key) :
+    AudioProcessor (psetup), key_ (key)
+  {}
+  static void static_info (AudioProcessorInfo &info) {}
+  void
+  initialize (SpeakerArrangement busses) override
+  {
+    stereout = add_output_bus ("Stereo Out", SpeakerArrangement::STEREO);
+  }
+  void reset (uint64 target_stamp) override {}
+  void
+  render (uint n_frames) override
+  {
+    const uint64 frame = engine().frame_counter();
+    float *left = oblock (stereout, 0), *right = oblock (stereout, 1);
+    for (uint i = 0; i < n_frames; i++)
+      left[i] = right[i] = key_ ? sidechain_key_at (frame + i) : 0.5;
+  }
+};
+
+/// Compare the compressor output against the key pattern, frame by frame.
+class SidechainTestChecker : public AudioProcessor {
+  IBusId stereoin;
+  OBusId stereout;
+  uint64 start_ = 0;
+public:
+  static constexpr uint WARMUP = 1024;  // frames for parameter changes to settle
+  static constexpr float DUCKED = 0.0561; // 0.5 reduced by 19dB, a 0dBFS key at -20dB threshold and ratio 20
+  std::atomic<uint> checked = 0, mismatches = 0;
+  SidechainTestChecker (const ProcessorSetup &psetup) :
+    AudioProcessor (psetup)
+  {}
+  static void static_info (AudioProcessorInfo &info) {}
+  void
+  initialize (SpeakerArrangement busses) override
+  {
+    stereoin = add_input_bus ("Stereo In", SpeakerArrangement::STEREO);
+    stereout = add_output_bus ("Stereo Out", SpeakerArrangement::STEREO);
+  }
+  void reset (uint64 target_stamp) override {}
+  void
+  render (uint n_frames) override
+  {
+    const uint64 frame = engine().frame_counter();
+    if (!start_)
+      start_ = frame + WARMUP;
+    const float *left = ifloats (stereoin, 0);
+    if (frame >= start_)
+      {
+        uint misses = 0;
+        for (uint i = 0; i < n_frames; i++)
+          misses += std::abs (left[i] - (sidechain_key_at (frame + i) ? DUCKED : 0.5)) > 0.001;
+        mismatches += misses;
+        checked += n_frames;
+      }
+    for (uint c = 0; c < 2; c++)
+      redirect_oblock (stereout, c, ifloats (stereoin, c));
+  }
+};
+
+struct SidechainTestWiring : ProcessorManager {
+  static void
+  connect (AudioProcessor &proc, AudioProcessor &source)
+  {
+    pm_connect (proc, DeviceImpl::SIDECHAIN, source, OBusId (1)); // as Device::set_sidechain() does
+  }
+  static void
+  disconnect (AudioProcessor &proc)
+  {
+    pm_disconnect (proc, DeviceImpl::SIDECHAIN);
+  }
+};
+
+TEST_INTEGRITY (compressor_sidechain_routing_tests);
+static void
+compressor_sidechain_routing_tests()
+{
+  AudioEngine *engine = main_config.engine;
+  return_unless (engine);
+  // a source chain feeds the key, the compressor ducks the main input of another chain
+  auto key_chain = AudioProcessor::create_processor<AudioChain> (*engine);
+  auto key_source = AudioProcessor::create_processor<SidechainTestSource> (*engine, true);
+  auto main_chain = AudioProcessor::create_processor<AudioChain> (*engine);
+  auto main_source = AudioProcessor::create_processor<SidechainTestSource> (*engine, false);
+  auto compressor = AudioProcessor::create_processor<Compressor> (*engine);
+  auto checker = AudioProcessor::create_processor<SidechainTestChecker> (*engine);
+  compressor->send_param (Compressor::KEY, 1);
+  compressor->send_param (Compressor::THRESHOLD, -20);
+  compressor->send_param (Compressor::RATIO, 20);
+  compressor->send_param (Compressor::KNEE, 0);
+  compressor->send_param (Compressor::ATTACK, 0);
+  compressor->send_param (Compressor::RELEASE, 0);
+  engine->async_jobs += [=] () {
+    key_chain->insert (key_source);
+    main_chain->insert (main_source);
+    main_chain->insert (compressor);
+    main_chain->insert (checker);
+    SidechainTestWiring::connect (*compressor, *key_chain); // key_chain is scheduled via schedule_processor()
+    main_chain->enable_engine_output (true);
+  };
+  const uint64 start_usecs = timestamp_realtime();
+  do {
+    usleep (1500);      // give the audio engine some time
+    main_loop->iterate (false);
+  } while (timestamp_realtime() < start_usecs + 3000 * 1000 && checker->checked < 8192);
+  engine->async_jobs += [=] () {
+    main_chain->enable_engine_output (false);
+    SidechainTestWiring::disconnect (*compressor);
+  };
+  TCMP (checker->checked.load(), >=, 8192u);
+  TCMP (checker->mismatches.load(), ==, 0u);
+}
+
+} // Anon
@@ -0,0 +1,78 @@
+// This Source Code Form is licensed MPL-2.0: http://mozilla.org/MPL/2.0
+#include "ase/signalmath.hh"
+#include <algorithm>
+#include <cmath>
+
+namespace Ase {
+
+/// Feed-forward compressor, gain reduction is computed from a separate key signal (internal or sidechain).
+/// The gain of each output sample is derived from the key sample at the same frame, no lookahead delay is added.
+class CompressorDSP
+{
+  float threshold_db_ = -20;
+  float ratio_ = 4;
+  float knee_db_ = 6;
+  float makeup_db_ = 0;
+  float attack_ms_ = 5;
+  float release_ms_ = 100;
+  float attack_coeff_ = 0;
+  float release_coeff_ = 0;
+  float reduction_db_ = 0;      // smoothed gain reduction, <= 0
+  float sample_rate_ = 48000;
+  float
+  time_coeff (float ms) const
+  {
+    return ms > 0 ? std::exp (-1000.0f / (ms * sample_rate_)) : 0;
+  }
+  /// Static gain curve with soft knee, returns the gain change in dB for `level_db`.
+  float
+  gain_computer (float level_db) const
+  {
+    const float over = level_db - threshold_db_;
+    const float slope = 1.0f / ratio_ - 1.0f;
+    if (2 * over < -knee_db_)
+      return 0;
+    if (2 * std::abs (over) <= knee_db_)
+      {
+        const float k = over + 0.5f * knee_db_;
+        return slope * k * k / (2 * knee_db_);
+      }
+    return slope * over;
+  }
+public:
+  void
+  reset (float sample_rate)
+  {
+    sample_rate_ = sample_rate;
+    attack_coeff_ = time_coeff (attack_ms_);
+    release_coeff_ = time_coeff (release_ms_);
+    reduction_db_ = 0;
+  }
+  void set_threshold (float db)  { threshold_db_ = db; }
+  void set_ratio     (float r)   { ratio_ = std::max (1.0f, r); }
+  void set_knee      (float db)  { knee_db_ = std::max (0.0f, db); }
+  void set_makeup    (float db)  { makeup_db_ = db; }
+  void set_attack    (float ms)  { attack_ms_ = ms; attack_coeff_ = time_coeff (ms); }
+  void set_release   (float ms)  { release_ms_ = ms; release_coeff_ = time_coeff (ms); }
+  float gain_reduction_db () const { return reduction_db_; }
+  void
+  process (const float *key_left, const float *key_right, const float *left_in, const float *right_in,
+           float *left_out, float *right_out, uint n_frames)
+  {
+    const float makeup = fast_db2voltage (makeup_db_);
+    float reduction = reduction_db_;
+    for (uint i = 0; i < n_frames; i++)
+      {
+        const float key = std::max (std::abs (key_left[i]), std::abs (key_right[i]));
+        const float target = key > 1e-9f ? gain_computer (fast_voltage2db (key)) : 0;
+        const float coeff = target < reduction ? attack_coeff_ : release_coeff_;
+        reduction = target + coeff * (reduction - target);
+        const float gain = reduction < 0 ? makeup * fast_db2voltage (reduction) : makeup;
+        left_out[i] = gain * left_in[i];
+        right_out[i] = gain * right_in[i];
+      }
+    reduction_db_ = reduction;
+  }
+};
+
+} // Ase
@@ -0,0 +1,5 @@
+# This Source Code Form is licensed MPL-2.0: http://mozilla.org/MPL/2.0
+
+devices/4ase.ccfiles += $(strip			\
+	devices/convolver/convolver.cc	\
+)
@@ -0,0 +1,290 @@
+// This Source Code Form is licensed MPL-2.0: http://mozilla.org/MPL/2.0
+#include "ase/processor.hh"
+#include "ase/convolver.hh"
+#include "ase/resampler.hh"
+#include "ase/signalmath.hh"
+#include "ase/simd.hh"
+#include "ase/internal.hh"
+#include "external/libsndfile/include/sndfile.h"
+
+#define CDEBUG(...)     Ase::debug ("convolver", __VA_ARGS__)
+
+namespace {
+
+using namespace Ase;
+
+static constexpr uint MAX_IR_SECONDS = 20;
+
+/// Read the first two channels of an impulse response file, resampled to `sample_rate` and normalized to unit energy.
+static bool
+load_impulse_response (const String &path, uint sample_rate, std::vector<float> &left, std::vector<float> &right)
+{
+  SF_INFO info = {};
+  SNDFILE *sndfile = sf_open (path.c_str(), SFM_READ, &info);
+  if (!sndfile || info.channels < 1 || info.frames <= 0 || info.samplerate <= 0)
+    {
+      CDEBUG ("%s: failed to open: %s", path, sf_strerror (sndfile));
+      if (sndfile)
+        sf_close (sndfile);
+      return false;
+    }
+  const uint n_channels = info.channels, n_frames = std::min (info.frames, sf_count_t (MAX_IR_SECONDS) * info.samplerate);
+  std::vector<float> buffer (n_frames * n_channels), stereo (2 * n_frames);
+  const sf_count_t r = std::max (sf_readf_float (sndfile, buffer.data(), n_frames), sf_count_t (0));
+  sf_close (sndfile);
+  for (sf_count_t i = 0; i < r; i++)
+    {
+      stereo[2 * i] = buffer[i * n_channels];
+      stereo[2 * i + 1] = buffer[i * n_channels + (n_channels > 1)];
+    }
+  stereo.resize (2 * r);
+  PolyphaseResampler resampler;
+  if (uint (info.samplerate) != sample_rate && resampler.setup (info.samplerate, sample_rate, 2, PolyphaseResampler::HIGH))
+    {
+      // flush the filter delay and skip its output, so the response onset stays in place
+      const uint skip = resampler.max_output (resampler.delay()) - 1;
+      stereo.resize (stereo.size() + 2 * resampler.delay() + 2);
+      std::vector<float> output (2 * resampler.max_output (stereo.size() / 2));
+      const size_t n_output = resampler.process (stereo.size() / 2, stereo.data(), output.data());
+      stereo.assign (output.begin() + 2 * std::min (size_t (skip), n_output), output.begin() + 2 * n_output);
+    }
+  else if (uint (info.samplerate) != sample_rate)
+    CDEBUG ("%s: unsupported sample rate conversion: %d -> %d", path, info.samplerate, sample_rate);
+  left.resize (stereo.size() / 2);
+  right.resize (stereo.size() / 2);
+  deinterleave_stereo (left.size(), left.data(), right.data(), stereo.data());
+  double lsum = 0, rsum = 0;
+  for (size_t i = 0; i < left.size(); i++)
+    {
+      lsum += left[i] * left[i];
+      rsum += right[i] * right[i];
+    }
+  const double energy = std::max (lsum, rsum);
+  if (energy > 0)
+    {
+      scale_gain (left.size(), left.data(), left.data(), 1 / std::sqrt (energy), 1 / std::sqrt (energy));
+      scale_gain (right.size(), right.data(), right.data(), 1 / std::sqrt (energy), 1 / std::sqrt (energy));
+    }
+  CDEBUG ("%s: frames=%d rate=%d channels=%d", path, info.frames, info.samplerate, info.channels);
+  return r > 0;
+}
+
+// == ConvolverLoader ==
+/// Thread that loads impulse responses and prepares their partitioned convolution off the engine thread.
+class ConvolverLoader {
+  std::atomic<uint>                  want_file_ { 0 }, want_rate_ { 0 };
+  std::atomic<PartitionedConvolver*> ready_ { nullptr };       // handed to the engine thread
+  std::atomic<PartitionedConvolver*> trash_ { nullptr };       // replaced by the engine thread
+  std::atomic<bool>                  quit_ { false };
+  ScopedSemaphore                    sem_;
+  std::thread                        thread_;
+  void
+  run()
+  {
+    this_thread_set_name ("ConvolverLoad");
+    uint have_file = 0, have_rate = 0;
+    while (!quit_)
+      {
+        sem_.wait();
+        delete trash_.exchange (nullptr);
+        const uint file = want_file_, rate = want_rate_;
+        if (quit_ || !rate || (file == have_file && rate == have_rate))
+          continue;
+        std::vector<float> left, right;
+        const String path = CString::temp_quark_impl (file);
+        if (!path.empty() && !load_impulse_response (path, rate, left, right))
+          left.clear(), right.clear();
+        const float *irs[2] = { left.data(), right.data() };
+        delete ready_.exchange (new PartitionedConvolver (2, irs, left.size()));  // drop if unclaimed
+        have_file = file;
+        have_rate = rate;
+      }
+  }
+public:
+  ConvolverLoader()
+  {
+    thread_ = std::thread (&ConvolverLoader::run, this);
+  }
+  ~ConvolverLoader()
+  {
+    quit_ = true;
+    sem_.post();
+    thread_.join();
+    delete ready_.exchange (nullptr);
+    delete trash_.exchange (nullptr);
+  }
+  // called from audio thread
+  void
+  request (uint pathquark, uint sample_rate)
+  {
+    return_unless (pathquark != want_file_ || sample_rate != want_rate_);
+    want_file_ = pathquark;
+    want_rate_ = sample_rate;
+    sem_.post();
+  }
+  // called from audio thread, replaces `current` once a new convolver is ready
+  PartitionedConvolver*
+  update (PartitionedConvolver *current)
+  {
+    if (trash_.load() || !ready_.load())        // wait for the loader to free the previous one
+      return current;
+    PartitionedConvolver *fresh = ready_.exchange (nullptr);
+    if (current)
+      {
+        trash_.store (current);
+        sem_.post();
+      }
+    return fresh;
+  }
+};
+
+// == Convolver ==
+// Convolution reverb, applies impulse responses loaded from audio files
+class Convolver : public AudioProcessor {
+  IBusId stereoin_;
+  OBusId stereout_;
+  ConvolverLoader loader_;
+  PartitionedConvolver *convolver_ = nullptr;   // owned by loader_ once replaced
+  float dry_gain_ = 1, wet_gain_ = 0;
+  float want_dry_ = 1, want_wet_ = 0;
+  enum Params { IMPULSE_RESPONSE = 1, MIX, GAIN };
+public:
+  Convolver (const ProcessorSetup &psetup) :
+    AudioProcessor (psetup)
+  {}
+  ~Convolver()
+  {
+    delete convolver_;
+  }
+  static void
+  static_info (AudioProcessorInfo &info)
+  {
+    info.version = "1";
+    info.label = "Convolution Reverb";
+    info.category = "Reverb";
+    info.website_url = "https://anklang.testbit.eu";
+  }
+  void
+  initialize (SpeakerArrangement busses) override
+  {
+    stereoin_ = add_input_bus  ("Stereo In",  SpeakerArrangement::STEREO);
+    stereout_ = add_output_bus ("Stereo Out", SpeakerArrangement::STEREO);
+
+    ParameterMap pmap;
+    pmap.group = "Settings";
+    pmap[IMPULSE_RESPONSE] = Param { "impulse_response", _("Impulse Response"), _("IR"), "", "", {}, "",
+                                     { String ("blurb=") + _("Audio file with the impulse response to convolve with"), } };
+    pmap[MIX]  = Param { "mix",  _("Mix"),  _("Mix"),  35, "%", { 0, 100 }, "", { String ("blurb=") + _("Balance between dry and reverberated signal"), } };
+    pmap[GAIN] = Param { "gain", _("Gain"), _("Gain"), 0, "dB", { -48, 12 }, "", { String ("blurb=") + _("Level of the reverberated signal"), } };
+    install_params (pmap);
+
+    prepare_event_input();
+  }
+  void
+  adjust_param (uint32_t tag) override
+  {
+    switch (Params (tag))
+      {
+      case IMPULSE_RESPONSE:
+        loader_.request (irintf (get_param (IMPULSE_RESPONSE)), sample_rate());
+        return;
+      case MIX:
+      case GAIN:
+        want_dry_ = 1 - 0.01 * get_param (MIX);
+        want_wet_ = 0.01 * get_param (MIX) * db2voltage (get_param (GAIN));
+        return;
+      }
+  }
+  void
+  reset (uint64 target_stamp) override
+  {
+    adjust_all_params();
+    dry_gain_ = want_dry_;
+    wet_gain_ = want_wet_;
+    if (convolver_)
+      convolver_->reset();
+  }
+  void
+  render_frames (uint offset, uint n_frames)
+  {
+    const float *in[2] = { ifloats (stereoin_, 0) + offset, ifloats (stereoin_, 1) + offset };
+    float *out[2] = { oblock (stereout_, 0) + offset, oblock (stereout_, 1) + offset };
+    const float wet_gain = convolver_ ? want_wet_ : 0;
+    if (convolver_)
+      convolver_->process (in, out, n_frames);
+    for (uint c = 0; c < 2; c++)
+      {
+        if (convolver_)
+          scale_gain (n_frames, out[c], out[c], wet_gain_, wet_gain);
+        else
+          floatfill (out[c], 0.0f, n_frames);
+        mix_gain (n_frames, out[c], in[c], dry_gain_, want_dry_);
+      }
+    wet_gain_ = wet_gain;
+    dry_gain_ = want_dry_;
+  }
+  void
+  render (uint n_frames) override
+  {
+    convolver_ = loader_.update (convolver_);
+
+    uint offset = 0;
+    MidiEventInput evinput = midi_event_input();
+    for (const auto &ev : evinput)
+      {
+        // process any audio that is before the event
+        const uint frame = std::min (uint (ev.frame), n_frames);
+        render_frames (offset, frame - offset);
+        offset = frame;
+
+        switch (ev.message())
+          {
+          case MidiMessage::PARAM_VALUE:
+            apply_event (ev);
+            adjust_param (ev.param);
+            break;
+          default: ;
+          }
+      }
+    // process frames after last event
+    render_frames (offset, n_frames - offset);
+  }
+};
+static auto convolver = register_audio_processor<Convolver> ("Ase::Devices::Convolver");
+
+} // Anon
+
+// == Tests ==
+#include "ase/testing.hh"
+#include "ase/wave.hh"
+#include "ase/path.hh"
+
+namespace {
+using namespace Ase;
+
+TEST_INTEGRITY (convolver_load_tests);
+static void
+convolver_load_tests()
+{
+  const char *tmpdir = getenv ("TMPDIR");
+  const String filename = Path::join (tmpdir ? tmpdir : "/tmp", string_format ("convolver-%u.wav", getpid()));
+  constexpr uint N = 4410, ONSET = 441;
+  std::vector<float> frames (2 * N);
+  frames[2 * ONSET] = 0.5;              // left impulse
+  frames[2 * ONSET + 1] = -0.25;        // quieter right impulse
+  WaveWriterP wavewriter = wave_writer_create_wav (44100, 2, filename);
+  TASSERT (wavewriter && wavewriter->write (frames.data(), N) && wavewriter->close());
+  std::vector<float> left, right;
+  TASSERT (load_impulse_response (filename, 44100, left, right));
+  TCMP (left.size(), ==, N);
+  TCMP (left[ONSET], ==, 1);            // normalized to unit energy
+  TCMP (right[ONSET], ==, -0.5);
+  TASSERT (load_impulse_response (filename, 48000, left, right));
+  TCMP (std::abs (int (left.size()) - int (N * 48000 / 44100)), <=, 2);
+  const size_t peak = std::max_element (left.begin(), left.end()) - left.begin();
+  TCMP (peak, ==, size_t (ONSET * 48000 / 44100 + 0.5));   // onset stays in place
+  unlink (filename.c_str());
+  TASSERT (!load_impulse_response (filename, 48000, left, right));
+}
+
+} // Anon